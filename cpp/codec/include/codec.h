@@ -11,6 +11,11 @@ extern "C" {
 
 #define CODEC_DEFAULT_SEED (int32_t)0xFFFFFFFFu
 
+// codec_context_params.graph_bucket_frames: round decode frame counts up to
+// the next power of two.
+#define CODEC_GRAPH_BUCKET_POW2 (-1)
+#define CODEC_GRAPH_CACHE_DEFAULT_MAX 32
+
 enum codec_arch {
     CODEC_ARCH_UNKNOWN = 0,
     CODEC_ARCH_WAVTOKENIZER_LARGE = 1,
@@ -60,6 +65,14 @@ struct codec_model_params {
 
 struct codec_context_params {
     int32_t seed;
+    // Shape buckets for decode graphs of causal codecs (Mimi, Qwen3-TTS
+    // tokenizer): 0 = exact frame count, N > 0 = round up to a multiple of N,
+    // CODEC_GRAPH_BUCKET_POW2 = next power of two.  Calls that land in the same
+    // bucket reuse the built + allocated graph; the padded tail is dropped.
+    int32_t graph_bucket_frames;
+    // Max graph cache entries kept (least recently used are evicted); <= 0
+    // uses CODEC_GRAPH_CACHE_DEFAULT_MAX.
+    int32_t graph_cache_max;
 };
 
 struct codec_encode_params {
@@ -154,6 +167,9 @@ void codec_model_free(struct codec_model * model);
 
 struct codec_context * codec_init_from_model(struct codec_model * model, struct codec_context_params params);
 void codec_free(struct codec_context * ctx);
+// Changes codec_context_params.graph_bucket_frames for later decode calls;
+// graphs already cached for other bucket sizes stay until evicted.
+void codec_set_graph_bucket_frames(struct codec_context * ctx, int32_t graph_bucket_frames);
 
 enum codec_status codec_encode(struct codec_context * ctx, const struct codec_audio * audio, struct codec_token_buffer * out_tokens, struct codec_encode_params params);
 enum codec_status codec_encode_latent(
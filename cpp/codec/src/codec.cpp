@@ -274,7 +274,9 @@ struct codec_model_params codec_model_default_params(void) {
 
 struct codec_context_params codec_context_default_params(void) {
     struct codec_context_params result = {
-        /*.seed =*/ CODEC_DEFAULT_SEED,
+        /*.seed                =*/ CODEC_DEFAULT_SEED,
+        /*.graph_bucket_frames =*/ 0,
+        /*.graph_cache_max     =*/ CODEC_GRAPH_CACHE_DEFAULT_MAX,
     };
 
     return result;
@@ -510,6 +512,12 @@ void codec_free(struct codec_context * ctx) {
     delete ctx;
 }
 
+void codec_set_graph_bucket_frames(struct codec_context * ctx, int32_t graph_bucket_frames) {
+    if (ctx != nullptr) {
+        ctx->params.graph_bucket_frames = graph_bucket_frames;
+    }
+}
+
 static enum codec_status codec_encode_impl(
     struct codec_context * ctx,
     const struct codec_audio * audio,
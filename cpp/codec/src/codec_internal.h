@@ -9,6 +9,9 @@
 
 #include <string>
 #include <cstdint>
+#include <functional>
+#include <list>
+#include <unordered_map>
 #include <vector>
 
 struct codec_model {
@@ -62,6 +65,28 @@ struct codec_graph_cache_key {
     int32_t latent_dim = 0; // DAC latent dimension
 };
 
+struct codec_graph_cache_key_hash {
+    size_t operator()(const codec_graph_cache_key & k) const noexcept {
+        const int32_t f[] = { k.kind, k.n_frames, k.n_q, k.hop, k.n_in, k.latent_dim };
+        size_t h = 0;
+        for (int32_t v : f) {
+            h ^= std::hash<int32_t>{}(v) + 0x9e3779b9 + (h << 6) + (h >> 2);
+        }
+        return h;
+    }
+};
+
+struct codec_graph_cache_key_equal {
+    bool operator()(const codec_graph_cache_key & a, const codec_graph_cache_key & b) const noexcept {
+        return a.kind == b.kind &&
+               a.n_frames == b.n_frames &&
+               a.n_q == b.n_q &&
+               a.hop == b.hop &&
+               a.n_in == b.n_in &&
+               a.latent_dim == b.latent_dim;
+    }
+};
+
 typedef bool (*codec_graph_build_fn)(lm_ggml_context * ctx_eval, void * user_data, lm_ggml_tensor ** out);
 
 struct codec_graph_cache_entry {
@@ -80,7 +105,13 @@ struct codec_context {
     lm_ggml_backend_sched_t sched = nullptr;
     struct codec_context_params params;
     std::string last_error;
-    std::vector<codec_graph_cache_entry> graph_cache;
+    // Most recently used first; entries stay put in memory, so eval_entry and
+    // the index iterators remain valid until the entry is evicted.
+    std::list<codec_graph_cache_entry> graph_cache;
+    std::unordered_map<codec_graph_cache_key, std::list<codec_graph_cache_entry>::iterator,
+                       codec_graph_cache_key_hash, codec_graph_cache_key_equal> graph_cache_index;
+    int64_t graph_cache_hits = 0;   // calls that reused the live graph + allocation
+    int64_t graph_cache_misses = 0; // calls that rebuilt and re-planned
     void * eval_arena_buf = nullptr;
     size_t eval_arena_size = 0;
     lm_ggml_context * eval_ctx = nullptr;
@@ -1056,19 +1056,24 @@ enum codec_status codec_mimi_decode_with(
 
     const int32_t t = tokens->n_frames;
     const int32_t q = use_n_q;
+    // The decoder is causal end to end (convs, transposed convs, attention),
+    // so padding to the bucket size leaves the first t frames of PCM intact.
+    const int32_t t_graph = codec_graph_bucket_frames(ctx, t);
 
-    codec_graph_eval_guard eval_guard(ctx);
+    // With buckets enabled, keep the graph alive so the next decode landing in
+    // the same bucket skips the rebuild and galloc re-plan.
+    codec_graph_eval_guard eval_guard(ctx, /*persist=*/ctx->params.graph_bucket_frames != 0);
     const int32_t n_sem = std::max(1, std::min(mm.num_semantic_quantizers, q));
     mimi_decode_build build = {};
     std::string err;
-    if (!codec_mimi_init_decode_build(ctx, &mm, t, q, n_sem, &build, &err)) {
+    if (!codec_mimi_init_decode_build(ctx, &mm, t_graph, q, n_sem, &build, &err)) {
         codec_context_set_error(ctx, err);
         return CODEC_STATUS_INTERNAL_ERROR;
     }
     codec_graph_cache_entry * entry = nullptr;
     if (!codec_graph_cache_get_or_build(
             ctx,
-            { CODEC_GRAPH_MIMI_DECODE, /*n_frames=*/t, /*n_q=*/q, /*hop=*/build.hop, /*n_in=*/0, /*latent_dim=*/0 },
+            { CODEC_GRAPH_MIMI_DECODE, /*n_frames=*/t_graph, /*n_q=*/q, /*hop=*/build.hop, /*n_in=*/0, /*latent_dim=*/0 },
             codec_mimi_build_decode,
             &build,
             sizeof(build),
@@ -1090,12 +1095,13 @@ enum codec_status codec_mimi_decode_with(
         return CODEC_STATUS_INTERNAL_ERROR;
     }
 
-    std::vector<int32_t> tok_i32((size_t) t * (size_t) q, 0);
+    // pad frames stay code 0; their samples are cut below
+    std::vector<int32_t> tok_i32((size_t) t_graph * (size_t) q, 0);
     for (int32_t ti = 0; ti < t; ++ti) {
         for (int32_t qi = 0; qi < q; ++qi) {
             int32_t tok = tokens->data[(size_t) ti * (size_t) tokens->n_q + (size_t) qi];
             tok = std::max(0, std::min(build.codebook_size - 1, tok));
-            tok_i32[(size_t) qi * (size_t) t + (size_t) ti] = tok;
+            tok_i32[(size_t) qi * (size_t) t_graph + (size_t) ti] = tok;
         }
     }
 
@@ -1110,18 +1116,24 @@ enum codec_status codec_mimi_decode_with(
         return CODEC_STATUS_INTERNAL_ERROR;
     }
 
-    const int32_t n_samples = (int32_t) t_out->ne[0];
-    float * pcm = static_cast<float *>(std::malloc((size_t) n_samples * sizeof(float)));
+    const int32_t n_graph_samples = (int32_t) t_out->ne[0];
+    const int32_t n_samples = (int32_t) ((int64_t) n_graph_samples * t / t_graph);
+    float * pcm = static_cast<float *>(std::malloc((size_t) n_graph_samples * sizeof(float)));
     if (pcm == nullptr) {
         codec_context_set_error(ctx, "failed to allocate pcm output");
         return CODEC_STATUS_INTERNAL_ERROR;
     }
 
-    if (!codec_runtime_read_tensor(t_out, pcm, (size_t) n_samples * sizeof(float), &err)) {
+    if (!codec_runtime_read_tensor(t_out, pcm, (size_t) n_graph_samples * sizeof(float), &err)) {
         std::free(pcm);
         codec_context_set_error(ctx, err);
         return CODEC_STATUS_INTERNAL_ERROR;
     }
+    if (n_samples < n_graph_samples) {
+        if (void * shrunk = std::realloc(pcm, (size_t) n_samples * sizeof(float))) {
+            pcm = static_cast<float *>(shrunk);
+        }
+    }
 
     codec_pcm_buffer_reset(out_pcm);
     out_pcm->data = pcm;
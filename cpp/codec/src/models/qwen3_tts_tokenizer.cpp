@@ -604,17 +604,20 @@ enum codec_status codec_qwen3_tts_tokenizer_decode(
 
     const int32_t t = tokens->n_frames;
     const int32_t q = use_n_q;
-    codec_graph_eval_guard eval_guard(ctx);
+    // Causal decoder (causal convs + masked attention): a bucket-padded graph
+    // produces the same first t frames of PCM.
+    const int32_t t_graph = codec_graph_bucket_frames(ctx, t);
+    codec_graph_eval_guard eval_guard(ctx, /*persist=*/ctx->params.graph_bucket_frames != 0);
     q3t_decode_build build = {};
     std::string err;
-    if (!codec_q3t_init_decode_build(ctx, t, q, &build, &err)) {
+    if (!codec_q3t_init_decode_build(ctx, t_graph, q, &build, &err)) {
         codec_context_set_error(ctx, err);
         return CODEC_STATUS_INTERNAL_ERROR;
     }
     codec_graph_cache_entry * entry = nullptr;
     if (!codec_graph_cache_get_or_build(
             ctx,
-            { CODEC_GRAPH_Q3T_DECODE, /*n_frames=*/t, /*n_q=*/q, /*hop=*/build.codebook_dim, /*n_in=*/0, /*latent_dim=*/build.latent_dim },
+            { CODEC_GRAPH_Q3T_DECODE, /*n_frames=*/t_graph, /*n_q=*/q, /*hop=*/build.codebook_dim, /*n_in=*/0, /*latent_dim=*/build.latent_dim },
             codec_q3t_build_decode,
             &build,
             sizeof(build),
@@ -636,12 +639,12 @@ enum codec_status codec_qwen3_tts_tokenizer_decode(
     }
 
     // tokens -> per-quantizer index vectors (column-major layout)
-    std::vector<int32_t> tok_i32((size_t) t * (size_t) q, 0);
+    std::vector<int32_t> tok_i32((size_t) t_graph * (size_t) q, 0);
     for (int32_t ti = 0; ti < t; ++ti) {
         for (int32_t qi = 0; qi < q; ++qi) {
             int32_t tok = tokens->data[(size_t) ti * (size_t) tokens->n_q + (size_t) qi];
             tok = std::max(0, std::min(build.codebook_size - 1, tok));
-            tok_i32[(size_t) qi * (size_t) t + (size_t) ti] = tok;
+            tok_i32[(size_t) qi * (size_t) t_graph + (size_t) ti] = tok;
         }
     }
     for (int32_t qi = 0; qi < q; ++qi) {
@@ -651,8 +654,8 @@ enum codec_status codec_qwen3_tts_tokenizer_decode(
             codec_context_set_error(ctx, "cached Qwen3 decode graph is invalid");
             return CODEC_STATUS_INTERNAL_ERROR;
         }
-        const size_t offset = (size_t) qi * (size_t) t;
-        if (!codec_runtime_write_tensor(t_idx, tok_i32.data() + offset, (size_t) t * sizeof(int32_t), &err)) {
+        const size_t offset = (size_t) qi * (size_t) t_graph;
+        if (!codec_runtime_write_tensor(t_idx, tok_i32.data() + offset, (size_t) t_graph * sizeof(int32_t), &err)) {
             codec_context_set_error(ctx, err);
             return CODEC_STATUS_INTERNAL_ERROR;
         }
@@ -664,12 +667,13 @@ enum codec_status codec_qwen3_tts_tokenizer_decode(
         return CODEC_STATUS_INTERNAL_ERROR;
     }
 
-    const int32_t n_samples = (int32_t) t_out->ne[0];
-    std::vector<float> out(n_samples, 0.0f);
+    std::vector<float> out((size_t) t_out->ne[0], 0.0f);
     if (!codec_runtime_read_tensor(t_out, out.data(), out.size() * sizeof(float), &err)) {
         codec_context_set_error(ctx, err);
         return CODEC_STATUS_INTERNAL_ERROR;
     }
+    const int32_t n_samples = (int32_t) ((int64_t) out.size() * t / t_graph);
+    out.resize((size_t) n_samples);
 
     float * data = static_cast<float *>(std::malloc(out.size() * sizeof(float)));
     if (data == nullptr) {
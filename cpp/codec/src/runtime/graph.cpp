@@ -3,16 +3,56 @@
 
 #include <algorithm>
 #include <array>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 
-static bool codec_graph_key_equal(const codec_graph_cache_key & a, const codec_graph_cache_key & b) {
-    return a.kind == b.kind &&
-           a.n_frames == b.n_frames &&
-           a.n_q == b.n_q &&
-           a.hop == b.hop &&
-           a.n_in == b.n_in &&
-           a.latent_dim == b.latent_dim;
+int32_t codec_graph_bucket_frames(const codec_context * ctx, int32_t n_frames) {
+    const int32_t bucket = ctx != nullptr ? ctx->params.graph_bucket_frames : 0;
+    if (n_frames <= 0 || bucket == 0) {
+        return n_frames;
+    }
+    if (bucket == CODEC_GRAPH_BUCKET_POW2) {
+        int32_t padded = 1;
+        while (padded < n_frames) {
+            padded <<= 1;
+        }
+        return padded;
+    }
+    if (bucket < 0) {
+        return n_frames;
+    }
+    return (n_frames + bucket - 1) / bucket * bucket;
+}
+
+static void codec_graph_cache_report(codec_context * ctx, const codec_graph_cache_key & key, bool hit) {
+    if (hit) {
+        ++ctx->graph_cache_hits;
+    } else {
+        ++ctx->graph_cache_misses;
+    }
+    char det[128];
+    std::snprintf(det, sizeof(det), "kind=%d n_frames=%d %s hits=%lld misses=%lld entries=%zu",
+                  key.kind, key.n_frames, hit ? "hit" : "miss",
+                  (long long) ctx->graph_cache_hits, (long long) ctx->graph_cache_misses,
+                  ctx->graph_cache.size());
+    codec_perf_event("graph_cache", det);
+}
+
+// Drop least recently used entries beyond the configured cap.  Only metadata
+// lives in an entry (the eval graph is owned by ctx), so eviction just costs
+// the next call for that shape a fresh arena-size estimate.
+static void codec_graph_cache_evict(codec_context * ctx) {
+    const size_t cap = (size_t) (ctx->params.graph_cache_max > 0 ? ctx->params.graph_cache_max
+                                                                  : CODEC_GRAPH_CACHE_DEFAULT_MAX);
+    while (ctx->graph_cache.size() > cap) {
+        codec_graph_cache_entry & victim = ctx->graph_cache.back();
+        if (&victim == ctx->eval_entry) {
+            break;
+        }
+        ctx->graph_cache_index.erase(victim.key);
+        ctx->graph_cache.pop_back();
+    }
 }
 
 struct codec_graph_count_state {
@@ -138,11 +178,10 @@ bool codec_graph_cache_get_or_build(
     }
 
     codec_graph_cache_entry * cached = nullptr;
-    for (codec_graph_cache_entry & entry : ctx->graph_cache) {
-        if (codec_graph_key_equal(entry.key, key)) {
-            cached = &entry;
-            break;
-        }
+    auto found = ctx->graph_cache_index.find(key);
+    if (found != ctx->graph_cache_index.end()) {
+        ctx->graph_cache.splice(ctx->graph_cache.begin(), ctx->graph_cache, found->second);
+        cached = &*found->second;
     }
 
     // Consecutive-call fast path: if the resolved entry is the exact same entry
@@ -162,10 +201,12 @@ bool codec_graph_cache_get_or_build(
             (user_data_size == nbytes) &&
             (nbytes == 0 || std::memcmp(cached->build_user_data.data(), user_data, nbytes) == 0);
         if (same_bytes) {
+            codec_graph_cache_report(ctx, key, true);
             *out_entry = cached;
             return true;
         }
     }
+    codec_graph_cache_report(ctx, key, false);
 
     // Slow path: a rebuild is actually needed.  Release the previously built
     // eval graph now (this also clears eval_graph_allocated so codec_graph_prepare_io
@@ -185,8 +226,10 @@ bool codec_graph_cache_get_or_build(
             const uint8_t * src = static_cast<const uint8_t *>(user_data);
             entry.build_user_data.assign(src, src + user_data_size);
         }
-        ctx->graph_cache.push_back(entry);
-        cached = &ctx->graph_cache.back();
+        ctx->graph_cache.push_front(std::move(entry));
+        ctx->graph_cache_index[key] = ctx->graph_cache.begin();
+        cached = &ctx->graph_cache.front();
+        codec_graph_cache_evict(ctx);
     } else if (user_data_size > 0) {
         // Existing entry, but the user_data bytes differ (or were never stored):
         // refresh the stored copy so the rebuilt graph uses the current inputs
@@ -56,6 +56,11 @@ enum codec_graph_kind {
 bool codec_runtime_init(codec_context * ctx, std::string * error);
 void codec_runtime_free(codec_context * ctx);
 
+// Frame count to build a decode graph for: n_frames rounded up per
+// codec_context_params.graph_bucket_frames.  Only valid for causal graphs,
+// where trailing pad frames cannot change the first n_frames of output.
+int32_t codec_graph_bucket_frames(const codec_context * ctx, int32_t n_frames);
+
 bool codec_graph_cache_get_or_build(
     codec_context * ctx,
     codec_graph_cache_key key,
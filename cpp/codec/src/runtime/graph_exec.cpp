@@ -380,6 +380,7 @@ void codec_runtime_free(codec_context * ctx) {
     }
 
     codec_graph_release(ctx);
+    ctx->graph_cache_index.clear();
     ctx->graph_cache.clear();
 
     if (ctx->eval_arena_buf != nullptr) {
@@ -21,8 +21,10 @@
 #include <ctime>
 #include <exception>
 #include <functional>
+#include <list>
 #include <map>
 
+#include <mutex>
 #include <optional>
 #include <sstream>
 #include <stdexcept>
@@ -3292,6 +3294,39 @@ std::optional<common_chat_params> common_chat_try_specialized_template(
     return std::nullopt;
 }
 
+// The differential analysis renders the template many times over and depends on
+// the template alone, so keep it for the templates seen most recently
+static autoparser::autoparser common_chat_analyze_template_cached(const common_chat_template & tmpl) {
+    static const size_t max_entries = 8;
+    static std::mutex mutex;
+    static std::list<std::pair<std::string, autoparser::autoparser>> cache; // most recent first
+
+    std::string key = tmpl.bos_token();
+    key += '\0';
+    key += tmpl.eos_token();
+    key += '\0';
+    key += tmpl.source();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto it = cache.begin(); it != cache.end(); ++it) {
+            if (it->first == key) {
+                cache.splice(cache.begin(), cache, it);
+                return cache.front().second;
+            }
+        }
+    }
+
+    autoparser::autoparser analysis;
+    analysis.analyze_template(tmpl);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    cache.emplace_front(std::move(key), analysis);
+    if (cache.size() > max_entries) {
+        cache.pop_back();
+    }
+    return analysis;
+}
+
 static common_chat_params common_chat_templates_apply_jinja(const struct common_chat_templates *        tmpls,
                                                             const struct common_chat_templates_inputs & inputs) {
     autoparser::generation_params params;
@@ -3404,8 +3439,7 @@ static common_chat_params common_chat_templates_apply_jinja(const struct common_
 
     try {
         LOG_DBG("%s: using differential autoparser\n", __func__);
-        struct autoparser::autoparser autoparser;
-        autoparser.analyze_template(tmpl);
+        struct autoparser::autoparser autoparser = common_chat_analyze_template_cached(tmpl);
         auto auto_params = autoparser::peg_generator::generate_parser(tmpl, params, autoparser);
 
         common_chat_msg_delimiters delimiters;
@@ -3538,6 +3572,7 @@ common_chat_msg common_chat_peg_parse(const common_peg_arena &          src_pars
     }
 
     common_peg_parse_context ctx(effective_input, flags);
+    ctx.memo = params.scan_memo;
     auto result = parser.parse(ctx);
 
     if (result.fail()) {
@@ -299,6 +299,8 @@ struct common_chat_parser_params {
     bool                    echo                 = false;  // Include assistant prefilled msg in output
     bool                    debug                = false;  // Enable debug output for PEG parser
     common_peg_arena        parser               = {};
+    // Optional: reused across streamed parses of one growing output (see common_peg_scan_memo)
+    common_peg_scan_memo *  scan_memo            = nullptr;
     common_chat_parser_params() = default;
     common_chat_parser_params(const common_chat_params & chat_params) {
         format  = chat_params.format;
@@ -208,9 +208,10 @@ struct parser_executor {
     const common_peg_arena & arena;
     common_peg_parse_context & ctx;
     size_t start_pos;
+    common_peg_parser_id id;
 
-    parser_executor(const common_peg_arena & arena, common_peg_parse_context & ctx, size_t start)
-        : arena(arena), ctx(ctx), start_pos(start) {}
+    parser_executor(const common_peg_arena & arena, common_peg_parse_context & ctx, size_t start, common_peg_parser_id id)
+        : arena(arena), ctx(ctx), start_pos(start), id(id) {}
 
     std::string debug_indent() const { return std::string(ctx.parse_depth * 2, ' '); }
 
@@ -651,9 +652,18 @@ struct parser_executor {
     common_peg_parse_result operator()(const common_peg_until_parser & p) const {
         common_trie matcher(p.delimiters);
 
-        // Scan input and check for delimiters
+        // Scan input and check for delimiters, resuming past the prefix an
+        // earlier parse of the same (shorter) input already cleared
         size_t pos = start_pos;
-        size_t last_valid_pos = start_pos;
+        size_t * resume = nullptr;
+        if (ctx.memo != nullptr) {
+            resume = &ctx.memo->until_resume[((uint64_t) id << 32) | (uint64_t) start_pos];
+            if (*resume > pos && *resume <= ctx.input.size()) {
+                pos = *resume;
+            }
+            *resume = pos;
+        }
+        size_t last_valid_pos = pos;
 
         while (pos < ctx.input.size()) {
             auto utf8_result = common_parse_utf8_codepoint(ctx.input, pos);
@@ -688,6 +698,9 @@ struct parser_executor {
 
             pos += utf8_result.bytes_consumed;
             last_valid_pos = pos;
+            if (resume != nullptr) {
+                *resume = pos;
+            }
         }
 
         if (last_valid_pos == ctx.input.size() && ctx.is_lenient()) {
@@ -789,7 +802,7 @@ common_peg_parse_result common_peg_arena::parse(common_peg_parse_context & ctx,
 common_peg_parse_result common_peg_arena::parse(common_peg_parser_id id, common_peg_parse_context & ctx, size_t start) const {
     // Execute parser
     const auto & parser = parsers_.at(id);
-    parser_executor exec(*this, ctx, start);
+    parser_executor exec(*this, ctx, start, id);
     return std::visit(exec, parser);
 }
 
@@ -164,6 +164,17 @@ inline common_peg_parse_flags operator~(common_peg_parse_flags a) {
     return static_cast<common_peg_parse_flags>(~int(a));
 }
 
+// Scan positions kept across parses of a growing input (streamed output).
+// until() parsers record, per (parser, start), how far they scanned without a
+// delimiter starting; a position that matched no delimiter keeps not matching
+// when input is appended, so the next parse resumes the scan there instead of
+// rescanning the stable prefix. Only valid while the input grows by appending.
+struct common_peg_scan_memo {
+    std::unordered_map<uint64_t, size_t> until_resume;
+
+    void clear() { until_resume.clear(); }
+};
+
 struct common_peg_parse_context {
     std::string input;
     common_peg_parse_flags flags;
@@ -171,6 +182,8 @@ struct common_peg_parse_context {
 
     int parse_depth;
 
+    common_peg_scan_memo * memo = nullptr;
+
     common_peg_parse_context(common_peg_parse_flags flags = COMMON_PEG_PARSE_FLAG_NONE)
         : flags(flags), parse_depth(0) {}
 
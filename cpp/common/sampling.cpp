@@ -121,6 +121,9 @@ struct common_sampler {
 
     llama_token_data_array cur_p;
 
+    // scratch for common_sampler_forced_token
+    std::vector<llama_token_data> cur_forced;
+
     void reset() {
         prev.clear();
 
@@ -161,6 +164,15 @@ struct common_sampler {
         cur_p = { cur.data(), cur.size(), -1, false };
     }
 
+    void set_logits(const float * logits, int n_vocab) {
+        cur.resize(n_vocab);
+        for (llama_token token_id = 0; token_id < n_vocab; token_id++) {
+            cur[token_id] = llama_token_data{token_id, logits[token_id], 0.0f};
+        }
+
+        cur_p = { cur.data(), cur.size(), -1, false };
+    }
+
     common_time_meas tm() {
         return common_time_meas(t_total_us, params.no_perf);
     }
@@ -447,6 +459,7 @@ struct common_sampler * common_sampler_init(
         /* .prev    = */ ring_buffer<llama_token>(std::max(32, params.n_prev)),
         /* .cur     = */ {},
         /* .cur_p   = */ {},
+        /* .cur_forced = */ {},
     };
 
     return result;
@@ -530,6 +543,7 @@ struct common_sampler * common_sampler_clone(common_sampler * gsmpl) {
         /* .prev    = */ gsmpl->prev,
         /* .cur     = */ gsmpl->cur,
         /* .cur_p   = */ gsmpl->cur_p,
+        /* .cur_forced = */ {},
     };
 }
 
@@ -586,42 +600,16 @@ struct llama_sampler * common_sampler_get(const struct common_sampler * gsmpl) {
     return gsmpl->chain;
 }
 
-llama_token common_sampler_sample(struct common_sampler * gsmpl, struct llama_context * ctx, int idx, bool grammar_first) {
-    llama_synchronize(ctx);
-
-    // start measuring sampling time after the llama_context synchronization in order to not measure any ongoing async operations
-    const auto tm = gsmpl->tm();
-
+// CPU sampler chain over gsmpl->cur_p (filled by set_logits); refill
+// restores the candidates for grammar resampling
+template <typename refill_fn>
+static llama_token common_sampler_sample_cur(struct common_sampler * gsmpl, bool grammar_first, const refill_fn & refill) {
     llama_token id = LLAMA_TOKEN_NULL;
 
-    auto & grmr  = gsmpl->grmr;
+    auto & grmr    = gsmpl->grmr;
     auto & rbudget = gsmpl->rbudget;
-    auto & chain = gsmpl->chain;
-    auto & cur_p = gsmpl->cur_p; // initialized by set_logits
-
-    gsmpl->set_logits(ctx, idx);
-
-    // Check if a backend sampler has already sampled a token in which case we
-    // return that token id directly.
-    {
-        id = llama_get_sampled_token_ith(ctx, idx);
-
-        if (id != LLAMA_TOKEN_NULL) {
-            LOG_DBG("%s: Backend sampler selected token: '%d'. Will not run any CPU samplers\n", __func__, id);
-
-            LM_GGML_ASSERT(!gsmpl->grmr    && "using grammar in combination with backend sampling is not supported");
-            LM_GGML_ASSERT(!gsmpl->rbudget && "using reasoning budget in combination with backend sampling is not supported");
-
-            for (size_t i = 0; i < cur_p.size; ++i) {
-                if (cur_p.data[i].id == id) {
-                    cur_p.selected = i;
-                    break;
-                }
-            }
-
-            return id;
-        }
-    }
+    auto & chain   = gsmpl->chain;
+    auto & cur_p   = gsmpl->cur_p;
 
     // apply reasoning budget first
     llama_sampler_apply(rbudget, &cur_p);
@@ -653,7 +641,7 @@ llama_token common_sampler_sample(struct common_sampler * gsmpl, struct llama_co
 
     // resampling:
     // if the token is not valid, sample again, but first apply the grammar sampler and then the sampling chain
-    gsmpl->set_logits(ctx, idx);
+    refill();
 
     llama_sampler_apply(rbudget,  &cur_p);
 
@@ -670,6 +658,51 @@ llama_token common_sampler_sample(struct common_sampler * gsmpl, struct llama_co
     return id;
 }
 
+llama_token common_sampler_sample(struct common_sampler * gsmpl, struct llama_context * ctx, int idx, bool grammar_first) {
+    llama_synchronize(ctx);
+
+    // start measuring sampling time after the llama_context synchronization in order to not measure any ongoing async operations
+    const auto tm = gsmpl->tm();
+
+    llama_token id = LLAMA_TOKEN_NULL;
+
+    auto & cur_p = gsmpl->cur_p; // initialized by set_logits
+
+    gsmpl->set_logits(ctx, idx);
+
+    // Check if a backend sampler has already sampled a token in which case we
+    // return that token id directly.
+    {
+        id = llama_get_sampled_token_ith(ctx, idx);
+
+        if (id != LLAMA_TOKEN_NULL) {
+            LOG_DBG("%s: Backend sampler selected token: '%d'. Will not run any CPU samplers\n", __func__, id);
+
+            LM_GGML_ASSERT(!gsmpl->grmr    && "using grammar in combination with backend sampling is not supported");
+            LM_GGML_ASSERT(!gsmpl->rbudget && "using reasoning budget in combination with backend sampling is not supported");
+
+            for (size_t i = 0; i < cur_p.size; ++i) {
+                if (cur_p.data[i].id == id) {
+                    cur_p.selected = i;
+                    break;
+                }
+            }
+
+            return id;
+        }
+    }
+
+    return common_sampler_sample_cur(gsmpl, grammar_first, [&]() { gsmpl->set_logits(ctx, idx); });
+}
+
+llama_token common_sampler_sample_logits(struct common_sampler * gsmpl, const float * logits, int n_vocab, bool grammar_first) {
+    const auto tm = gsmpl->tm();
+
+    gsmpl->set_logits(logits, n_vocab);
+
+    return common_sampler_sample_cur(gsmpl, grammar_first, [&]() { gsmpl->set_logits(logits, n_vocab); });
+}
+
 std::vector<llama_token> common_sampler_sample_and_accept_n(struct common_sampler * gsmpl, struct llama_context * ctx, const std::vector<int> & idxs, const llama_tokens & draft, bool grammar_first) {
     LM_GGML_ASSERT(idxs.size() == draft.size() + 1 && "idxs.size() must be draft.size() + 1");
 
@@ -721,6 +754,104 @@ bool common_sampler_reasoning_budget_force(struct common_sampler * gsmpl) {
     return common_reasoning_budget_force(gsmpl->rbudget);
 }
 
+static bool forcing_allowed(struct common_sampler * gsmpl) {
+    if (!gsmpl || !grammar_should_apply(gsmpl)) {
+        return false;
+    }
+    if (gsmpl->rbudget) {
+        const auto state = common_reasoning_budget_get_state(gsmpl->rbudget);
+        if (state != REASONING_BUDGET_IDLE && state != REASONING_BUDGET_DONE) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool forced_token_banned(const struct common_sampler * gsmpl, llama_token token) {
+    for (const auto & bias : gsmpl->params.logit_bias) {
+        if (bias.token == token && std::isinf(bias.bias) && bias.bias < 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool common_sampler_forced_prefix(struct common_sampler * gsmpl, const struct llama_vocab * vocab, std::vector<llama_token> & tokens) {
+    tokens.clear();
+    if (!forcing_allowed(gsmpl)) {
+        return false;
+    }
+
+    char buf[256];
+    bool complete = false;
+    const int32_t n = llama_sampler_grammar_forced_text(gsmpl->grmr, buf, (int32_t) sizeof(buf), &complete);
+    if (n < 0) {
+        return false;
+    }
+    if (n == 0) {
+        return true;
+    }
+
+    const std::string text(buf, n);
+    tokens = common_tokenize(vocab, text, false, false);
+    std::string round_trip;
+    for (const llama_token token : tokens) {
+        round_trip += common_token_to_piece(vocab, token);
+    }
+    if (round_trip != text) {
+        // the tokenizer rewrites the text (space prefix, normalization)
+        tokens.clear();
+        return true;
+    }
+    if (!complete) {
+        // the last token could merge with the text that follows the run
+        tokens.pop_back();
+    }
+    for (size_t i = 0; i < tokens.size(); i++) {
+        if (forced_token_banned(gsmpl, tokens[i])) {
+            tokens.resize(i);
+            break;
+        }
+    }
+    return true;
+}
+
+llama_token common_sampler_forced_token(struct common_sampler * gsmpl, const struct llama_vocab * vocab) {
+    if (!forcing_allowed(gsmpl)) {
+        return LLAMA_TOKEN_NULL;
+    }
+    // the vocab probe is only worth it while the grammar has a single path
+    bool complete = false;
+    char buf[1];
+    if (llama_sampler_grammar_forced_text(gsmpl->grmr, buf, 0, &complete) < 0) {
+        return LLAMA_TOKEN_NULL;
+    }
+
+    const int n_vocab = llama_vocab_n_tokens(vocab);
+    auto & cur = gsmpl->cur_forced;
+    cur.resize(n_vocab);
+    for (llama_token id = 0; id < n_vocab; id++) {
+        cur[id] = llama_token_data{ id, 0.0f, 0.0f };
+    }
+    llama_token_data_array cur_p = { cur.data(), cur.size(), -1, false };
+    llama_sampler_apply(gsmpl->grmr, &cur_p);
+
+    llama_token forced = LLAMA_TOKEN_NULL;
+    for (size_t i = 0; i < cur_p.size; i++) {
+        if (std::isinf(cur_p.data[i].logit)) {
+            continue;
+        }
+        if (forced != LLAMA_TOKEN_NULL) {
+            return LLAMA_TOKEN_NULL;
+        }
+        forced = cur_p.data[i].id;
+    }
+    if (forced == LLAMA_TOKEN_NULL || llama_vocab_is_eog(vocab, forced) || forced_token_banned(gsmpl, forced)) {
+        return LLAMA_TOKEN_NULL;
+    }
+    return forced;
+}
+
 // helpers
 
 llama_token_data_array * common_sampler_get_candidates(struct common_sampler * gsmpl, bool do_sort) {
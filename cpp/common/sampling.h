@@ -67,6 +67,11 @@ struct llama_sampler * common_sampler_get(const struct common_sampler * gsmpl);
 //
 llama_token common_sampler_sample(struct common_sampler * gsmpl, struct llama_context * ctx, int idx, bool grammar_first = false);
 
+// like common_sampler_sample, but from logits the caller fetched (llama_get_logits_ith after
+// one llama_synchronize). does not touch the llama_context, so samplers of different sequences
+// can run concurrently on one decode's outputs. CPU samplers only (no backend sampling)
+llama_token common_sampler_sample_logits(struct common_sampler * gsmpl, const float * logits, int n_vocab, bool grammar_first = false);
+
 // generalized version of common_sampler_sample
 //
 // will cross-reference the sampled tokens with a batch of draft tokens and accept those that match
@@ -93,6 +98,17 @@ uint32_t common_sampler_get_seed(const struct common_sampler * gsmpl);
 // force the reasoning budget sampler (if any) to begin forcing its end sequence now.
 bool common_sampler_reasoning_budget_force(struct common_sampler * gsmpl);
 
+// the text the grammar pins next, tokenized once; the last token is left out
+// unless the text ends the grammar, as it may merge with what follows. false
+// when the grammar has several paths, is inactive, or another sampler may
+// override it (tokens is then empty)
+bool common_sampler_forced_prefix(struct common_sampler * gsmpl, const struct llama_vocab * vocab, std::vector<llama_token> & tokens);
+
+// the only token the grammar accepts next, or LLAMA_TOKEN_NULL when it admits
+// several (or EOG), has several paths, is inactive, or another sampler may
+// override it. scans the vocab: use after common_sampler_forced_prefix
+llama_token common_sampler_forced_token(struct common_sampler * gsmpl, const struct llama_vocab * vocab);
+
 // helpers
 
 // access the internal list of current candidate tokens
@@ -140,6 +140,25 @@ extern "C" {
 
     LM_GGML_BACKEND_API lm_ggml_backend_reg_t lm_ggml_backend_cpu_reg(void);
 
+    // Identity of the model file a repack cache is built from
+    struct lm_ggml_cpu_repack_cache_model {
+        uint64_t size;
+        int64_t  mtime;
+        uint64_t content_hash;
+    };
+
+    // Sidecar cache for CPU_REPACK weight buffers (opt-in, per calling thread).
+    // While a prefix is set, the n-th repack buffer allocated by this thread is
+    // backed by "<path_prefix>.<n>.bin": a valid file is mmap'd as the buffer and
+    // the repack is skipped; otherwise the file is written on a background thread
+    // once the buffer is filled (freeing the buffer waits for the write).
+    // The file header records the model identity; a file written for another
+    // size, mtime or content hash is rebuilt. CPU features are checked internally.
+    // No-op on Windows.
+    LM_GGML_BACKEND_API void lm_ggml_backend_cpu_repack_cache_begin(const char * path_prefix,
+                                                                 const struct lm_ggml_cpu_repack_cache_model * model);
+    LM_GGML_BACKEND_API void lm_ggml_backend_cpu_repack_cache_end(void);
+
     LM_GGML_BACKEND_API void lm_ggml_cpu_fp32_to_fp32(const float *,       float *, int64_t);
     LM_GGML_BACKEND_API void lm_ggml_cpu_fp32_to_i32 (const float *,     int32_t *, int64_t);
     LM_GGML_BACKEND_API void lm_ggml_cpu_fp32_to_fp16(const float *, lm_ggml_fp16_t *, int64_t);
@@ -15,6 +15,17 @@
 #include <cstring>
 #include <cassert>
 #include <cstdio>  // for LM_GGML_ASSERT
+#include <future>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include "repack.h"
 
@@ -4723,10 +4734,273 @@ static const ggml::cpu::tensor_traits * lm_ggml_repack_get_optimal_repack_type(c
     return nullptr;
 }
 
+// Sidecar cache of repacked weights, see lm_ggml_backend_cpu_repack_cache_begin().
+// A cache file is a fixed-size header followed by a raw image of the buffer.
+// The image is only reused when the model identity (size, mtime, content hash),
+// CPU key, buffer size and tensor layout (name, offset, type and shape of every
+// tensor) match the current load.
+namespace ggml::cpu::repack::cache {
+
+static constexpr uint32_t MAGIC       = 0x4b505052; // "RPPK"
+static constexpr uint32_t VERSION     = 2;
+static constexpr size_t   HEADER_SIZE = 64 * 1024; // keeps the image page aligned for 4K and 16K pages
+static constexpr uint64_t FNV_OFFSET  = 14695981039346656037ULL;
+
+struct header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t cpu_key;
+    uint64_t layout;
+    uint64_t size;
+    uint64_t model_size;
+    int64_t  model_mtime;
+    uint64_t model_hash;
+};
+
+struct buffer_state {
+    std::string path;
+    lm_ggml_cpu_repack_cache_model model {};    // identity written to the header
+    void *      map_addr        = nullptr; // mapping incl. header, null when heap backed
+    size_t      map_size        = 0;
+    uint64_t    expected_layout = 0;
+    uint64_t    layout          = FNV_OFFSET;
+    size_t      bytes_expected  = 0;
+    size_t      bytes_set       = 0;
+    bool        checked         = false;
+    bool        hit             = false;
+    std::future<void> writer;              // background write of the filled buffer
+    void     (* free_buffer)(lm_ggml_backend_buffer_t) = nullptr;
+};
+
+static thread_local std::string                    tl_prefix;
+static thread_local int                            tl_index = 0;
+static thread_local lm_ggml_cpu_repack_cache_model tl_model {};
+
+static std::mutex                                                   g_mutex;
+static std::unordered_map<lm_ggml_backend_buffer_t, buffer_state> g_states;
+
+static uint64_t fnv1a(uint64_t h, const void * data, size_t n) {
+    const uint8_t * p = (const uint8_t *) data;
+    for (size_t i = 0; i < n; ++i) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+template <typename T> static uint64_t fnv1a(uint64_t h, const T & v) {
+    return fnv1a(h, &v, sizeof(v));
+}
+
+// everything lm_ggml_repack_get_optimal_repack_type() looks at besides the tensor
+static uint64_t cpu_key() {
+    static const uint64_t key = [] {
+        const int feats[] = {
+            (int) VERSION, (int) sizeof(void *), QK_K,
+            lm_ggml_cpu_has_avx2(), lm_ggml_cpu_has_avx512(),
+            lm_ggml_cpu_has_neon(), lm_ggml_cpu_has_dotprod(), lm_ggml_cpu_has_matmul_int8(),
+            lm_ggml_cpu_has_sve(), lm_ggml_cpu_has_sve() ? lm_ggml_cpu_get_sve_cnt() : 0,
+            lm_ggml_cpu_has_riscv_v(), lm_ggml_cpu_has_riscv_v() ? lm_ggml_cpu_get_rvv_vlen() : 0,
+        };
+        return fnv1a(FNV_OFFSET, feats, sizeof(feats));
+    }();
+    return key;
+}
+
+// empty when the cache is off; always on Windows, where cache files are never mapped
+static std::string next_path(size_t size) {
+#ifndef _WIN32
+    if (tl_prefix.empty() || size == 0) {
+        return {};
+    }
+    return tl_prefix + "." + std::to_string(tl_index++) + ".bin";
+#else
+    LM_GGML_UNUSED(size);
+    return {};
+#endif
+}
+
+#ifndef _WIN32
+// maps a matching cache file copy-on-write; the image starts at HEADER_SIZE
+static void * map_file(const std::string & path, size_t size, uint64_t * layout) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+    header      hdr {};
+    struct stat st  {};
+    const bool valid = pread(fd, &hdr, sizeof(hdr), 0) == (ssize_t) sizeof(hdr) &&
+                       hdr.magic == MAGIC && hdr.version == VERSION;
+    const bool same_model = valid && hdr.model_size == tl_model.size && hdr.model_mtime == tl_model.mtime &&
+                            hdr.model_hash == tl_model.content_hash;
+    if (valid && !same_model) {
+        LM_GGML_LOG_WARN("%s: %s was built from a different model file, rebuilding\n", __func__, path.c_str());
+    }
+    const bool ok = same_model && hdr.cpu_key == cpu_key() && hdr.size == size &&
+                    fstat(fd, &st) == 0 && (size_t) st.st_size >= HEADER_SIZE + size;
+    void * addr = ok ? mmap(nullptr, HEADER_SIZE + size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return nullptr;
+    }
+    *layout = hdr.layout;
+    return addr;
+}
+#endif
+
+static bool write_file(const std::string & path, const void * data, size_t size, uint64_t layout,
+                       const lm_ggml_cpu_repack_cache_model & model) {
+    const std::string tmp = path + ".tmp";
+    FILE * f = fopen(tmp.c_str(), "wb");
+    if (f == nullptr) {
+        return false;
+    }
+    const header hdr = { MAGIC, VERSION, cpu_key(), layout, (uint64_t) size,
+                         model.size, model.mtime, model.content_hash };
+    bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1 &&
+              fseek(f, (long) HEADER_SIZE, SEEK_SET) == 0 &&
+              fwrite(data, 1, size, f) == size;
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+static void free_buffer(lm_ggml_backend_buffer_t buffer) {
+    buffer_state st;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        auto it = g_states.find(buffer);
+        LM_GGML_ASSERT(it != g_states.end());
+        st = std::move(it->second);
+        g_states.erase(it);
+    }
+    if (st.writer.valid()) {
+        // the write reads the buffer memory
+        st.writer.wait();
+    }
+    if (st.free_buffer) {
+        st.free_buffer(buffer);
+    }
+#ifndef _WIN32
+    if (st.map_addr) {
+        munmap(st.map_addr, st.map_size);
+    }
+#endif
+}
+
+// returns a buffer backed by the cache file when it matches, nullptr otherwise
+static lm_ggml_backend_buffer_t map_buffer(const std::string & path, size_t size, buffer_state & st) {
+#ifndef _WIN32
+    uint64_t layout = 0;
+    void *   addr   = map_file(path, size, &layout);
+    if (addr == nullptr) {
+        return nullptr;
+    }
+    lm_ggml_backend_buffer_t buffer = lm_ggml_backend_cpu_buffer_from_ptr((char *) addr + HEADER_SIZE, size);
+    if (buffer == nullptr) {
+        munmap(addr, HEADER_SIZE + size);
+        return nullptr;
+    }
+    st.map_addr        = addr;
+    st.map_size        = HEADER_SIZE + size;
+    st.expected_layout = layout;
+    return buffer;
+#else
+    LM_GGML_UNUSED(path);
+    LM_GGML_UNUSED(size);
+    LM_GGML_UNUSED(st);
+    return nullptr;
+#endif
+}
+
+static void track(lm_ggml_backend_buffer_t buffer, buffer_state && st) {
+    st.free_buffer            = buffer->iface.free_buffer;
+    buffer->iface.free_buffer = free_buffer;
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_states[buffer] = std::move(st);
+}
+
+static void init_tensor(lm_ggml_backend_buffer_t buffer, const struct lm_ggml_tensor * tensor) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    auto it = g_states.find(buffer);
+    if (it == g_states.end()) {
+        return;
+    }
+    auto &         st     = it->second;
+    const uint64_t offset = (uint64_t) ((const char *) tensor->data - (const char *) lm_ggml_backend_buffer_get_base(buffer));
+    st.layout = fnv1a(st.layout, tensor->name, strnlen(tensor->name, sizeof(tensor->name)));
+    st.layout = fnv1a(st.layout, offset);
+    st.layout = fnv1a(st.layout, tensor->type);
+    st.layout = fnv1a(st.layout, tensor->ne);
+    st.bytes_expected += lm_ggml_nbytes(tensor);
+}
+
+// true when the buffer already holds the repacked data for its tensors
+static bool is_hit(lm_ggml_backend_buffer_t buffer) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    auto it = g_states.find(buffer);
+    if (it == g_states.end()) {
+        return false;
+    }
+    auto & st = it->second;
+    if (!st.checked) {
+        // all tensors are allocated before the first upload, so the layout is final here
+        st.checked = true;
+        st.hit     = st.map_addr != nullptr && st.layout == st.expected_layout;
+        if (st.hit) {
+            LM_GGML_LOG_INFO("%s: using repacked weights from %s\n", __func__, st.path.c_str());
+        } else if (st.map_addr != nullptr) {
+            LM_GGML_LOG_WARN("%s: %s does not match the model layout, rebuilding\n", __func__, st.path.c_str());
+        }
+    }
+    return st.hit;
+}
+
+// once the buffer is filled, writes it to the cache file on a background
+// thread so the load does not wait for the disk; freeing the buffer waits
+static void tensor_done(lm_ggml_backend_buffer_t buffer, size_t size) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    auto it = g_states.find(buffer);
+    if (it == g_states.end()) {
+        return;
+    }
+    auto & st = it->second;
+    st.bytes_set += size;
+    if (st.bytes_set != st.bytes_expected) {
+        return;
+    }
+    st.writer = std::async(std::launch::async,
+        [path = st.path, data = lm_ggml_backend_buffer_get_base(buffer), n = lm_ggml_backend_buffer_get_size(buffer),
+         layout = st.layout, model = st.model, func = __func__]() {
+            if (write_file(path, data, n, layout, model)) {
+                LM_GGML_LOG_INFO("%s: wrote repacked weights to %s\n", func, path.c_str());
+            } else {
+                LM_GGML_LOG_WARN("%s: failed to write %s\n", func, path.c_str());
+            }
+        });
+}
+
+}  // namespace ggml::cpu::repack::cache
+
+void lm_ggml_backend_cpu_repack_cache_begin(const char * path_prefix, const struct lm_ggml_cpu_repack_cache_model * model) {
+    ggml::cpu::repack::cache::tl_prefix = path_prefix && model ? path_prefix : "";
+    ggml::cpu::repack::cache::tl_index  = 0;
+    ggml::cpu::repack::cache::tl_model  = model ? *model : lm_ggml_cpu_repack_cache_model {};
+}
+
+void lm_ggml_backend_cpu_repack_cache_end(void) {
+    ggml::cpu::repack::cache::tl_prefix.clear();
+    ggml::cpu::repack::cache::tl_index = 0;
+    ggml::cpu::repack::cache::tl_model = {};
+}
+
 static enum lm_ggml_status lm_ggml_backend_cpu_repack_buffer_init_tensor(lm_ggml_backend_buffer_t buffer, struct lm_ggml_tensor * tensor) {
     tensor->extra = (void *) const_cast<ggml::cpu::tensor_traits *>(lm_ggml_repack_get_optimal_repack_type(tensor));
 
-    LM_GGML_UNUSED(buffer);
+    ggml::cpu::repack::cache::init_tensor(buffer, tensor);
     return LM_GGML_STATUS_SUCCESS;
 }
 
@@ -4735,11 +5009,15 @@ static void lm_ggml_backend_cpu_repack_buffer_set_tensor(lm_ggml_backend_buffer_
     LM_GGML_ASSERT(offset == 0);
     LM_GGML_ASSERT(size == lm_ggml_nbytes(tensor));
 
+    if (ggml::cpu::repack::cache::is_hit(buffer)) {
+        return;
+    }
+
     auto tensor_traits = (ggml::cpu::repack::tensor_traits_base *) tensor->extra;
     auto OK            = tensor_traits->repack(tensor, data, size);
 
     LM_GGML_ASSERT(OK == 0);
-    LM_GGML_UNUSED(buffer);
+    ggml::cpu::repack::cache::tensor_done(buffer, size);
 }
 
 static const char * lm_ggml_backend_cpu_repack_buffer_type_get_name(lm_ggml_backend_buffer_type_t buft) {
@@ -4749,7 +5027,18 @@ static const char * lm_ggml_backend_cpu_repack_buffer_type_get_name(lm_ggml_back
 }
 
 static lm_ggml_backend_buffer_t lm_ggml_backend_cpu_repack_buffer_type_alloc_buffer(lm_ggml_backend_buffer_type_t buft, size_t size) {
-    lm_ggml_backend_buffer_t buffer = lm_ggml_backend_buft_alloc_buffer(lm_ggml_backend_cpu_buffer_type(), size);
+    const std::string cache_path = ggml::cpu::repack::cache::next_path(size);
+    ggml::cpu::repack::cache::buffer_state cache_state;
+    cache_state.path  = cache_path;
+    cache_state.model = ggml::cpu::repack::cache::tl_model;
+
+    lm_ggml_backend_buffer_t buffer = nullptr;
+    if (!cache_path.empty()) {
+        buffer = ggml::cpu::repack::cache::map_buffer(cache_path, size, cache_state);
+    }
+    if (buffer == nullptr) {
+        buffer = lm_ggml_backend_buft_alloc_buffer(lm_ggml_backend_cpu_buffer_type(), size);
+    }
 
     if (buffer == nullptr) {
         return nullptr;
@@ -4760,6 +5049,10 @@ static lm_ggml_backend_buffer_t lm_ggml_backend_cpu_repack_buffer_type_alloc_buf
     buffer->iface.set_tensor  = lm_ggml_backend_cpu_repack_buffer_set_tensor;
     buffer->iface.get_tensor  = nullptr;
     buffer->iface.cpy_tensor  = nullptr;
+
+    if (!cache_path.empty()) {
+        ggml::cpu::repack::cache::track(buffer, std::move(cache_state));
+    }
     return buffer;
 }
 
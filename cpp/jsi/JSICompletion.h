@@ -42,6 +42,18 @@ namespace rnllama_jsi {
         if (!output.accumulated_text.empty()) {
             target.setProperty(runtime, "accumulated_text", jsi::String::createFromUtf8(runtime, output.accumulated_text));
         }
+        if (!output.content_delta.empty()) {
+            target.setProperty(runtime, "content_delta", jsi::String::createFromUtf8(runtime, output.content_delta));
+        }
+        if (!output.reasoning_content_delta.empty()) {
+            target.setProperty(runtime, "reasoning_content_delta", jsi::String::createFromUtf8(runtime, output.reasoning_content_delta));
+        }
+        if (output.content_replaced) {
+            target.setProperty(runtime, "content_replaced", true);
+        }
+        if (output.reasoning_content_replaced) {
+            target.setProperty(runtime, "reasoning_content_replaced", true);
+        }
     }
 
     inline jsi::Array createCompletionProbabilities(
@@ -283,6 +295,7 @@ namespace rnllama_jsi {
         bool incomplete = false;
         bool truncated = false;
         bool interrupted = false;
+        bool state_reused = false;
         std::string stopping_word;
         size_t tokens_predicted = 0;
         size_t tokens_evaluated = 0;
@@ -315,6 +328,7 @@ namespace rnllama_jsi {
         result.incomplete = slot->incomplete;
         result.truncated = slot->truncated;
         result.interrupted = slot->is_interrupted;
+        result.state_reused = slot->state_reused;
         result.stopping_word = slot->stopping_word;
         result.tokens_predicted = slot->num_tokens_predicted;
         result.tokens_evaluated = slot->num_prompt_tokens;
@@ -362,6 +376,7 @@ namespace rnllama_jsi {
         res.setProperty(runtime, "incomplete", result.incomplete);
         res.setProperty(runtime, "truncated", result.truncated);
         res.setProperty(runtime, "interrupted", result.interrupted);
+        res.setProperty(runtime, "state_reused", result.state_reused);
         res.setProperty(
             runtime,
             "stopping_word",
@@ -559,6 +559,7 @@ namespace rnllama_jsi {
         }
 
         sparams.grammar_lazy = getPropertyAsBool(runtime, params, "grammar_lazy", false);
+        sparams.jump_forward = getPropertyAsBool(runtime, params, "jump_forward", false);
 
         if (params.hasProperty(runtime, "preserved_tokens")) {
             auto preservedVal = params.getProperty(runtime, "preserved_tokens");
@@ -3,6 +3,7 @@
 #include "JSIHelpers.h"
 #include "JSINativeHeaders.h"
 #include <algorithm>
+#include <cstring>
 #include <iterator>
 #include <string>
 #include <vector>
@@ -135,11 +136,27 @@ namespace rnllama_jsi {
         int default_size = session_tokens.size();
         int save_size = size > 0 && size <= default_size ? size : default_size;
 
-        // Drop any previous sidecar before overwriting the state file so a
-        // failure in between can never pair stale hashes with the new file
-        rnllama::write_state_meta(path, {});
+        // Same layout as llama_state_save_file, but staged in RAM and written
+        // through a temp file with fsync + rename, so a failed or interrupted
+        // save leaves the previous session intact
+        rnllama::rn_state_save_job job;
+        job.path = path;
+        const size_t n_state = llama_state_get_size(ctx->ctx);
+        job.blob.resize(n_state);
+        if (n_state == 0 || llama_state_get_data(ctx->ctx, job.blob.data(), n_state) != n_state) {
+             throw std::runtime_error("Failed to save session");
+        }
+        const uint32_t head[3] = { LLAMA_SESSION_MAGIC, LLAMA_SESSION_VERSION, (uint32_t) save_size };
+        job.header.resize(sizeof(head) + save_size * sizeof(llama_token));
+        memcpy(job.header.data(), head, sizeof(head));
+        if (save_size > 0) {
+            memcpy(job.header.data() + sizeof(head), session_tokens.data(), save_size * sizeof(llama_token));
+        }
+        // Drop any previous sidecar before the new state file replaces the old
+        // one so a failure in between can never pair stale hashes with it
+        job.before_commit = [&path]() { rnllama::write_state_meta(path, {}); };
 
-        if (!llama_state_save_file(ctx->ctx, path.c_str(), session_tokens.data(), save_size)) {
+        if (!rnllama::rn_write_state_file(job)) {
              throw std::runtime_error("Failed to save session");
         }
 
@@ -1,9 +1,14 @@
 #pragma once
 #include <jsi/jsi.h>
 #include <ReactCommon/CallInvoker.h>
+#include <cstdint>
+#include <cstring>
 #include <functional>
 #include <memory>
+#include <stdexcept>
 #include <string>
+#include <type_traits>
+#include <vector>
 
 using namespace facebook;
 
@@ -41,6 +46,93 @@ namespace rnllama_jsi {
         std::function<void(bool shouldProceed)> callback
     );
 
+    // Native storage behind a JS ArrayBuffer: the buffer owns the vector, so
+    // results cross to JS without copying or boxing elements
+    template <typename T>
+    class VectorBuffer : public jsi::MutableBuffer {
+    public:
+        explicit VectorBuffer(std::vector<T>&& data) : data_(std::move(data)) {}
+        size_t size() const override { return data_.size() * sizeof(T); }
+        uint8_t* data() override { return reinterpret_cast<uint8_t*>(data_.data()); }
+    private:
+        std::vector<T> data_;
+    };
+
+    template <typename T>
+    inline jsi::ArrayBuffer createArrayBuffer(jsi::Runtime& runtime, std::vector<T>&& data) {
+        auto buffer = std::make_shared<VectorBuffer<T>>(std::move(data));
+        try {
+            return jsi::ArrayBuffer(runtime, buffer);
+        } catch (const std::exception&) {
+            // Runtime without external ArrayBuffers: one memcpy into a JS-owned one
+            jsi::Function ctor = runtime.global().getPropertyAsFunction(runtime, "ArrayBuffer");
+            jsi::ArrayBuffer copy = ctor.callAsConstructor(runtime, (double)buffer->size())
+                .asObject(runtime)
+                .getArrayBuffer(runtime);
+            if (buffer->size() > 0) {
+                std::memcpy(copy.data(runtime), buffer->data(), buffer->size());
+            }
+            return copy;
+        }
+    }
+
+    // Typed array view (ctor is the JS global, e.g. "Float32Array") over the
+    // vector's storage
+    template <typename T>
+    inline jsi::Object createTypedArray(jsi::Runtime& runtime, const char* ctor, std::vector<T>&& data) {
+        jsi::ArrayBuffer buffer = createArrayBuffer(runtime, std::move(data));
+        return runtime.global().getPropertyAsFunction(runtime, ctor)
+            .callAsConstructor(runtime, buffer)
+            .asObject(runtime);
+    }
+
+    inline jsi::Object createFloat32Array(jsi::Runtime& runtime, std::vector<float>&& data) {
+        return createTypedArray(runtime, "Float32Array", std::move(data));
+    }
+
+    inline jsi::Object createInt32Array(jsi::Runtime& runtime, std::vector<int32_t>&& data) {
+        return createTypedArray(runtime, "Int32Array", std::move(data));
+    }
+
+    // Typed array constructor holding T: Float32Array for float, Int32Array
+    // for int32_t (token ids)
+    template <typename T>
+    inline const char* typedArrayName() {
+        static_assert(std::is_same<T, float>::value || std::is_same<T, int32_t>::value,
+                      "no typed array for this element type");
+        return std::is_same<T, float>::value ? "Float32Array" : "Int32Array";
+    }
+
+    // Reads a number[] or the typed array of T (bulk copy from its buffer)
+    template <typename T>
+    inline std::vector<T> readNumberArray(jsi::Runtime& runtime, const jsi::Value& value) {
+        jsi::Object obj = value.asObject(runtime);
+        std::vector<T> out;
+        if (obj.isArray(runtime)) {
+            jsi::Array arr = obj.asArray(runtime);
+            const size_t n = arr.size(runtime);
+            out.reserve(n);
+            for (size_t i = 0; i < n; i++) {
+                out.push_back((T)arr.getValueAtIndex(runtime, i).asNumber());
+            }
+            return out;
+        }
+        // Same-size arrays (Uint32Array for Float32Array, ...) would be
+        // reinterpreted bit for bit, so only the exact type is accepted
+        const char* ctor = typedArrayName<T>();
+        if (!obj.instanceOf(runtime, runtime.global().getPropertyAsFunction(runtime, ctor))) {
+            throw std::runtime_error(std::string("Expected a number array or ") + ctor);
+        }
+        jsi::ArrayBuffer buffer = obj.getPropertyAsObject(runtime, "buffer").getArrayBuffer(runtime);
+        const size_t offset = (size_t)obj.getProperty(runtime, "byteOffset").asNumber();
+        const size_t length = (size_t)obj.getProperty(runtime, "length").asNumber();
+        out.resize(length);
+        if (length > 0) {
+            std::memcpy(out.data(), buffer.data(runtime) + offset, length * sizeof(T));
+        }
+        return out;
+    }
+
     // Safe console.log wrapper for JSI context
     inline void consoleLog(jsi::Runtime& runtime, const std::string& message) {
         auto console = runtime.global().getPropertyAsObject(runtime, "console");
@@ -192,6 +192,59 @@ namespace rnllama_jsi {
         }
     }
 
+    static rnllama::llama_rn_audio_stream_options parseAudioStreamOptions(jsi::Runtime& runtime, const jsi::Object& params) {
+        rnllama::llama_rn_audio_stream_options options;
+        options.first_chunk_frames = getPropertyAsInt(runtime, params, "audio_first_chunk_frames", options.first_chunk_frames);
+        options.chunk_frames = getPropertyAsInt(runtime, params, "audio_chunk_frames", options.chunk_frames);
+        options.context_frames = getPropertyAsInt(runtime, params, "audio_context_frames", options.context_frames);
+        options.lookahead_frames = getPropertyAsInt(runtime, params, "audio_lookahead_frames", options.lookahead_frames);
+        options.crossfade_samples = getPropertyAsInt(runtime, params, "audio_crossfade_samples", options.crossfade_samples);
+        options.graph_bucket_frames = getPropertyAsInt(runtime, params, "audio_graph_bucket_frames", options.graph_bucket_frames);
+        return options;
+    }
+
+    // Forwards streamed PCM chunks to onAudioChunk on the JS thread
+    static rnllama::llama_rn_audio_chunk_cb makeAudioChunkCallback(
+        std::shared_ptr<jsi::Function> onAudioChunk,
+        int contextId,
+        std::shared_ptr<jsi::Runtime> runtime,
+        std::shared_ptr<react::CallInvoker> callInvoker
+    ) {
+        return [onAudioChunk, contextId, runtime, callInvoker](const std::vector<float> &pcm, bool is_final) {
+            std::vector<float> pcm_copy = pcm;
+            callInvoker->invokeAsync([onAudioChunk, contextId, runtime, pcm_copy = std::move(pcm_copy), is_final]() mutable {
+                if (!g_llamaContexts.get(contextId)) {
+                    return;
+                }
+                auto& rt = *runtime;
+                jsi::Object res(rt);
+                res.setProperty(rt, "audio", createFloat32Array(rt, std::move(pcm_copy)));
+                res.setProperty(rt, "is_final", is_final);
+                onAudioChunk->call(rt, res);
+            });
+        };
+    }
+
+    // Ends the context-wide audio stream when a completion leaves early
+    // (throws); the normal path finishes it first, which makes this a no-op.
+    class AudioStreamGuard {
+    public:
+        explicit AudioStreamGuard(rnllama::llama_rn_context* ctx) : ctx(ctx) {}
+        ~AudioStreamGuard() {
+            if (ctx->isVocoderEnabled() && ctx->tts_wrapper->isAudioStreamActive()) {
+                try {
+                    ctx->tts_wrapper->abortAudioStream();
+                } catch (...) {
+                    ctx->tts_wrapper->stopAudioStream();
+                }
+            }
+        }
+        AudioStreamGuard(const AudioStreamGuard&) = delete;
+        AudioStreamGuard& operator=(const AudioStreamGuard&) = delete;
+    private:
+        rnllama::llama_rn_context* ctx;
+    };
+
     static void ensureBackendInitialized() {
         std::call_once(backend_init_once, []() {
             llama_backend_init();
@@ -517,6 +570,14 @@ namespace rnllama_jsi {
                     getPropertyAsInt(runtime, params, "state_cache_budget_mb", 160);
                 int stateCacheMaxCheckpoints =
                     getPropertyAsInt(runtime, params, "state_cache_max_checkpoints", 8);
+                int stateCacheHotMb =
+                    getPropertyAsInt(runtime, params, "state_cache_hot_mb", 0);
+                std::string stateCacheDir =
+                    stripFileScheme(getPropertyAsString(runtime, params, "state_cache_dir", ""));
+                int stateCacheDiskMb =
+                    getPropertyAsInt(runtime, params, "state_cache_disk_mb", 512);
+                std::string repackCacheDir =
+                    getPropertyAsString(runtime, params, "repack_cache_dir", "");
 
                 return createPromiseTask(runtime, callInvoker, [
                     contextId,
@@ -527,7 +588,11 @@ namespace rnllama_jsi {
                     useProgressCallback,
                     progressData,
                     stateCacheBudgetMb,
-                    stateCacheMaxCheckpoints
+                    stateCacheMaxCheckpoints,
+                    stateCacheHotMb,
+                    stateCacheDir,
+                    stateCacheDiskMb,
+                    repackCacheDir
                 ]() mutable -> PromiseResultGenerator {
                     if (isContextLimitReached()) {
                         throw std::runtime_error("Context limit reached");
@@ -593,7 +658,13 @@ namespace rnllama_jsi {
                         ctx->state_cache_budget_bytes =
                             stateCacheBudgetMb > 0 ? (size_t) stateCacheBudgetMb * 1024 * 1024 : 0;
                         ctx->state_cache_max_checkpoints = stateCacheMaxCheckpoints;
+                        ctx->state_cache_hot_bytes =
+                            stateCacheHotMb > 0 ? (size_t) stateCacheHotMb * 1024 * 1024 : 0;
+                        ctx->state_cache_dir = stateCacheDir;
+                        ctx->state_cache_disk_bytes =
+                            stateCacheDiskMb > 0 ? (size_t) stateCacheDiskMb * 1024 * 1024 : 0;
                     }
+                    ctx->repack_cache_dir = repackCacheDir;
                     if (ctx->loadModel(cparams)) {
                          ctx->attachThreadpoolsIfAvailable();
 
@@ -780,6 +851,38 @@ namespace rnllama_jsi {
         );
         runtime.global().setProperty(runtime, "llamaTokenize", tokenize);
 
+        auto tokenizeBatch = jsi::Function::createFromHostFunction(runtime,
+            jsi::PropNameID::forAscii(runtime, "llamaTokenizeBatch"),
+            2,
+            [callInvoker](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+                int contextId = (int)arguments[0].asNumber();
+                jsi::Array textsArr = arguments[1].asObject(runtime).asArray(runtime);
+                std::vector<std::string> texts;
+                texts.reserve(textsArr.size(runtime));
+                for (size_t i = 0; i < textsArr.size(runtime); i++) {
+                    texts.push_back(textsArr.getValueAtIndex(runtime, i).asString(runtime).utf8(runtime));
+                }
+
+                return createPromiseTask(runtime, callInvoker, [contextId, texts]() -> PromiseResultGenerator {
+                    auto ctx = getContextOrThrow(contextId);
+                    auto result = std::make_shared<std::vector<std::vector<llama_token>>>(ctx->tokenizeBatch(texts));
+                    return [result](jsi::Runtime& rt) {
+                        jsi::Array arr(rt, result->size());
+                        for (size_t i = 0; i < result->size(); i++) {
+                            const auto& tokens = (*result)[i];
+                            jsi::Array tokensArr(rt, tokens.size());
+                            for (size_t j = 0; j < tokens.size(); j++) {
+                                tokensArr.setValueAtIndex(rt, j, (double)tokens[j]);
+                            }
+                            arr.setValueAtIndex(rt, i, tokensArr);
+                        }
+                        return arr;
+                    };
+                }, contextId);
+            }
+        );
+        runtime.global().setProperty(runtime, "llamaTokenizeBatch", tokenizeBatch);
+
         auto detokenize = jsi::Function::createFromHostFunction(runtime,
             jsi::PropNameID::forAscii(runtime, "llamaDetokenize"),
             2,
@@ -934,8 +1037,9 @@ namespace rnllama_jsi {
                     embd_normalize = getPropertyAsInt(runtime, params, "embd_normalize", 2);
                     has_embd_normalize = true;
                 }
+                const bool typed_array = getPropertyAsBool(runtime, params, "typed_array", false);
 
-                return createPromiseTask(runtime, callInvoker, [contextId, text, embd_normalize, has_embd_normalize]() -> PromiseResultGenerator {
+                return createPromiseTask(runtime, callInvoker, [contextId, text, embd_normalize, has_embd_normalize, typed_array]() -> PromiseResultGenerator {
                     auto ctx = getContextOrThrow(contextId);
 
                     if (!ctx->completion) throw std::runtime_error("Completion not initialized");
@@ -949,13 +1053,17 @@ namespace rnllama_jsi {
                     ctx->params.prompt = text;
                     ctx->params.n_predict = 0;
 
-                    std::vector<float> result = ctx->completion->embedding(embdParams);
+                    auto result = std::make_shared<std::vector<float>>(ctx->completion->embedding(embdParams));
 
-                    return [result](jsi::Runtime& rt) {
+                    return [result, typed_array](jsi::Runtime& rt) {
                         jsi::Object resultDict(rt);
-                        jsi::Array embeddingResult(rt, result.size());
-                        for (size_t i = 0; i < result.size(); i++) {
-                            embeddingResult.setValueAtIndex(rt, i, (double)result[i]);
+                        if (typed_array) {
+                            resultDict.setProperty(rt, "embedding", createFloat32Array(rt, std::move(*result)));
+                            return resultDict;
+                        }
+                        jsi::Array embeddingResult(rt, result->size());
+                        for (size_t i = 0; i < result->size(); i++) {
+                            embeddingResult.setValueAtIndex(rt, i, (double)(*result)[i]);
                         }
                         resultDict.setProperty(rt, "embedding", embeddingResult);
                         return resultDict;
@@ -965,6 +1073,50 @@ namespace rnllama_jsi {
         );
         runtime.global().setProperty(runtime, "llamaEmbedding", embedding);
 
+        auto embeddingBatch = jsi::Function::createFromHostFunction(runtime,
+            jsi::PropNameID::forAscii(runtime, "llamaEmbeddingBatch"),
+            3,
+            [callInvoker](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+                int contextId = (int)arguments[0].asNumber();
+                jsi::Array textsArr = arguments[1].asObject(runtime).asArray(runtime);
+                std::vector<std::string> texts;
+                texts.reserve(textsArr.size(runtime));
+                for (size_t i = 0; i < textsArr.size(runtime); i++) {
+                    texts.push_back(textsArr.getValueAtIndex(runtime, i).asString(runtime).utf8(runtime));
+                }
+                jsi::Object params = arguments[2].asObject(runtime);
+
+                int embd_normalize = 0;
+                bool has_embd_normalize = false;
+                if (params.hasProperty(runtime, "embd_normalize")) {
+                    embd_normalize = getPropertyAsInt(runtime, params, "embd_normalize", 2);
+                    has_embd_normalize = true;
+                }
+
+                return createPromiseTask(runtime, callInvoker, [contextId, texts, embd_normalize, has_embd_normalize]() -> PromiseResultGenerator {
+                    auto ctx = getContextOrThrow(contextId);
+
+                    if (!ctx->completion) throw std::runtime_error("Completion not initialized");
+                    if (ctx->params.embedding != true) throw std::runtime_error("Embedding is not enabled");
+                    throwIfContextBusy(ctx);
+
+                    const int normalize = has_embd_normalize ? embd_normalize : ctx->params.embd_normalize;
+                    const int n_embd = llama_model_n_embd(ctx->model);
+                    auto result = std::make_shared<std::vector<float>>(
+                        ctx->completion->embeddingBatch(texts, normalize));
+
+                    return [result, n_embd, n_texts = texts.size()](jsi::Runtime& rt) {
+                        jsi::Object resultDict(rt);
+                        resultDict.setProperty(rt, "embeddings", createArrayBuffer(rt, std::move(*result)));
+                        resultDict.setProperty(rt, "n_embd", n_embd);
+                        resultDict.setProperty(rt, "count", (int)n_texts);
+                        return resultDict;
+                    };
+                }, contextId);
+            }
+        );
+        runtime.global().setProperty(runtime, "llamaEmbeddingBatch", embeddingBatch);
+
         auto rerank = jsi::Function::createFromHostFunction(runtime,
             jsi::PropNameID::forAscii(runtime, "llamaRerank"),
             4,
@@ -1028,18 +1180,24 @@ namespace rnllama_jsi {
 
         auto completion = jsi::Function::createFromHostFunction(runtime,
             jsi::PropNameID::forAscii(runtime, "llamaCompletion"),
-            3,
+            4,
             [callInvoker](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
                 int contextId = (int)arguments[0].asNumber();
                 jsi::Object params = arguments[1].asObject(runtime);
                 std::shared_ptr<jsi::Function> onToken;
+                std::shared_ptr<jsi::Function> onAudioChunk;
 
                 if (count > 2 && arguments[2].isObject() && arguments[2].asObject(runtime).isFunction(runtime)) {
                     onToken = makeJsiFunction(runtime, arguments[2], callInvoker);
                 }
+                if (count > 3 && arguments[3].isObject() && arguments[3].asObject(runtime).isFunction(runtime)) {
+                    onAudioChunk = makeJsiFunction(runtime, arguments[3], callInvoker);
+                }
 
                 bool emitPartial = getPropertyAsBool(runtime, params, "emit_partial_completion", false);
 
+                rnllama::llama_rn_audio_stream_options audioStreamOptions = parseAudioStreamOptions(runtime, params);
+
                 auto ctx = getContextOrThrow(contextId);
                 throwIfContextBusy(ctx);
                 ctx->completion->rewind();
@@ -1061,7 +1219,7 @@ namespace rnllama_jsi {
                 std::string chat_parser = getPropertyAsString(runtime, params, "chat_parser");
                 std::string prefill_text = getPropertyAsString(runtime, params, "prefill_text");
 
-                return createPromiseTask(runtime, callInvoker, [runtimePtr = std::shared_ptr<jsi::Runtime>(&runtime, [](jsi::Runtime*){}), contextId, onToken, emitPartial, mediaPaths, chat_format, reasoning_format, generation_prompt, chat_parser, prefill_text, callInvoker]() -> PromiseResultGenerator {
+                return createPromiseTask(runtime, callInvoker, [runtimePtr = std::shared_ptr<jsi::Runtime>(&runtime, [](jsi::Runtime*){}), contextId, onToken, onAudioChunk, audioStreamOptions, emitPartial, mediaPaths, chat_format, reasoning_format, generation_prompt, chat_parser, prefill_text, callInvoker]() -> PromiseResultGenerator {
                     auto ctx = getContextOrThrow(contextId);
 
                     if (ctx->completion == nullptr) {
@@ -1101,6 +1259,14 @@ namespace rnllama_jsi {
                         throw std::runtime_error("Context is full");
                     }
 
+                    AudioStreamGuard audioStreamGuard(ctx);
+                    if (onAudioChunk && ctx->isVocoderEnabled()) {
+                        // PCM chunks are decoded from the audio codes while they
+                        // are generated, so playback can start before the end
+                        ctx->tts_wrapper->startAudioStream(ctx, audioStreamOptions,
+                            makeAudioChunkCallback(onAudioChunk, contextId, runtimePtr, callInvoker));
+                    }
+
                     size_t sent_count = 0;
 
                     while (ctx->completion->has_next_token && !ctx->completion->is_interrupted) {
@@ -1165,6 +1331,9 @@ namespace rnllama_jsi {
                     }
 
                     common_perf_print(ctx->ctx, ctx->completion->ctx_sampling);
+                    if (ctx->isVocoderEnabled()) {
+                        ctx->tts_wrapper->finishAudioStream(ctx);
+                    }
                     ctx->completion->endCompletion();
 
                     return [contextId](jsi::Runtime& rt) -> jsi::Value {
@@ -1244,11 +1413,15 @@ namespace rnllama_jsi {
                 bool enabled = getPropertyAsBool(runtime, params, "enabled", true);
                 int nParallel = getPropertyAsInt(runtime, params, "n_parallel", 2);
                 int nBatch = getPropertyAsInt(runtime, params, "n_batch", 512);
+                std::string prefillPolicyStr = getPropertyAsString(runtime, params, "prefill_policy", "fifo");
+                int prefillPolicy = prefillPolicyStr == "fair" ? rnllama::PREFILL_POLICY_FAIR : rnllama::PREFILL_POLICY_FIFO;
+                int prefillChunk = getPropertyAsInt(runtime, params, "prefill_chunk", 0);
+                int prefillDecodeBudget = getPropertyAsInt(runtime, params, "prefill_decode_budget", 0);
 
-                return createPromiseTask(runtime, callInvoker, [contextId, enabled, nParallel, nBatch]() -> PromiseResultGenerator {
+                return createPromiseTask(runtime, callInvoker, [contextId, enabled, nParallel, nBatch, prefillPolicy, prefillChunk, prefillDecodeBudget]() -> PromiseResultGenerator {
                     auto ctx = getContextOrThrow(contextId);
                     if (enabled) {
-                        ctx->enableParallelMode(nParallel, nBatch);
+                        ctx->enableParallelMode(nParallel, nBatch, prefillPolicy, prefillChunk, prefillDecodeBudget);
                         if (ctx->slot_manager) {
                             ctx->slot_manager->start_processing_loop();
                         }
@@ -1266,13 +1439,18 @@ namespace rnllama_jsi {
 
         auto queueCompletion = jsi::Function::createFromHostFunction(runtime,
             jsi::PropNameID::forAscii(runtime, "llamaQueueCompletion"),
-            4,
+            5,
             [callInvoker](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
                 int contextId = (int)arguments[0].asNumber();
                 jsi::Object params = arguments[1].asObject(runtime);
 
                 auto onToken = makeJsiFunction(runtime, arguments[2], callInvoker);
                 auto onComplete = makeJsiFunction(runtime, arguments[3], callInvoker);
+                std::shared_ptr<jsi::Function> onAudioChunk;
+                if (count > 4 && arguments[4].isObject() && arguments[4].asObject(runtime).isFunction(runtime)) {
+                    onAudioChunk = makeJsiFunction(runtime, arguments[4], callInvoker);
+                }
+                rnllama::llama_rn_audio_stream_options audioStreamOptions = parseAudioStreamOptions(runtime, params);
 
                 auto ctxPtr = getContextOrThrow(contextId);
                 auto originalParams = ctxPtr->params;
@@ -1299,13 +1477,42 @@ namespace rnllama_jsi {
                 std::string save_prompt_state_path = stripFileScheme(getPropertyAsString(runtime, params, "save_prompt_state_path"));
                 int load_state_size = getPropertyAsInt(runtime, params, "load_state_size", -1);
                 int save_state_size = getPropertyAsInt(runtime, params, "save_state_size", -1);
+                bool reuse_state = getPropertyAsBool(runtime, params, "reuse_state", false);
+                int priority = getPropertyAsInt(runtime, params, "priority", 0);
+
+                std::vector<common_adapter_lora_info> loraAdapters;
+                if (params.hasProperty(runtime, "lora_list")) {
+                    jsi::Value loraListValue = params.getProperty(runtime, "lora_list");
+                    if (loraListValue.isObject() && loraListValue.asObject(runtime).isArray(runtime)) {
+                        jsi::Array loraList = loraListValue.asObject(runtime).asArray(runtime);
+                        for (size_t i = 0; i < loraList.size(runtime); i++) {
+                            jsi::Value itemValue = loraList.getValueAtIndex(runtime, i);
+                            if (!itemValue.isObject()) {
+                                continue;
+                            }
+                            jsi::Object item = itemValue.asObject(runtime);
+                            common_adapter_lora_info la;
+                            la.path = stripFileScheme(getPropertyAsString(runtime, item, "path"));
+                            la.scale = getPropertyAsFloat(runtime, item, "scaled", 1.0f);
+                            if (!la.path.empty()) {
+                                loraAdapters.push_back(la);
+                            }
+                        }
+                    }
+                }
 
-                return createPromiseTask(runtime, callInvoker, [runtimePtr = std::shared_ptr<jsi::Runtime>(&runtime, [](jsi::Runtime*){}), contextId, cparams, mediaPaths, chat_format, reasoning_format, generation_prompt, chat_parser, prefill_text, load_state_path, save_state_path, save_prompt_state_path, load_state_size, save_state_size, onToken, onComplete, callInvoker]() -> PromiseResultGenerator {
+                return createPromiseTask(runtime, callInvoker, [runtimePtr = std::shared_ptr<jsi::Runtime>(&runtime, [](jsi::Runtime*){}), contextId, cparams, mediaPaths, chat_format, reasoning_format, generation_prompt, chat_parser, prefill_text, load_state_path, save_state_path, save_prompt_state_path, load_state_size, save_state_size, reuse_state, priority, loraAdapters, onToken, onComplete, onAudioChunk, audioStreamOptions, callInvoker]() mutable -> PromiseResultGenerator {
                     auto ctx = getContextOrThrow(contextId);
                     if (!ctx->parallel_mode_enabled || !ctx->slot_manager) {
                         throw std::runtime_error("Parallel mode not enabled");
                     }
 
+                    // Load (and validate) the adapters up front; the slot takes its
+                    // own reference on each when the request is scheduled
+                    for (auto& la : loraAdapters) {
+                        la.ptr = ctx->getLoraAdapter(la.path);
+                    }
+
                     auto tokenizeResult = ctx->tokenize(cparams.prompt, mediaPaths);
                     std::vector<llama_token> tokens = tokenizeResult.tokens;
 
@@ -1375,12 +1582,18 @@ namespace rnllama_jsi {
                         }
                     };
 
+                    rnllama::llama_rn_audio_chunk_cb audioChunkCallback;
+                    if (onAudioChunk && ctx->isVocoderEnabled()) {
+                        audioChunkCallback = makeAudioChunkCallback(onAudioChunk, contextId, runtimePtr, callInvoker);
+                    }
+
                     int requestId = ctx->slot_manager->reserve_request_id();
                     RequestManager::getInstance().addRequest(contextId, requestId, {onToken, onComplete, nullptr});
                     try {
                         int queuedRequestId = ctx->slot_manager->queue_request(
                             cparams, tokens, mediaPaths, cparams.prompt, chat_format, reasoning_format, generation_prompt, chat_parser, prefill_text, load_state_path, save_state_path, save_prompt_state_path, load_state_size, save_state_size,
-                            tokenCallback, completeCallback, requestId
+                            tokenCallback, completeCallback, requestId, tokenizeResult.bitmap_hashes, priority, loraAdapters, reuse_state,
+                            audioChunkCallback, audioStreamOptions
                         );
                         if (queuedRequestId != requestId) {
                             RequestManager::getInstance().takeRequest(contextId, requestId);
@@ -1499,6 +1712,93 @@ namespace rnllama_jsi {
         );
         runtime.global().setProperty(runtime, "llamaQueueEmbedding", queueEmbedding);
 
+        auto queueEmbeddingBatch = jsi::Function::createFromHostFunction(runtime,
+            jsi::PropNameID::forAscii(runtime, "llamaQueueEmbeddingBatch"),
+            4,
+            [callInvoker](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+                int contextId = (int)arguments[0].asNumber();
+                jsi::Array textsArr = arguments[1].asObject(runtime).asArray(runtime);
+                std::vector<std::string> texts;
+                texts.reserve(textsArr.size(runtime));
+                for (size_t i = 0; i < textsArr.size(runtime); i++) {
+                    texts.push_back(textsArr.getValueAtIndex(runtime, i).asString(runtime).utf8(runtime));
+                }
+                jsi::Object params = arguments[2].asObject(runtime);
+                auto onResult = makeJsiFunction(runtime, arguments[3], callInvoker);
+
+                int embd_normalize = 0;
+                bool has_embd_normalize = false;
+                if (params.hasProperty(runtime, "embd_normalize")) {
+                    embd_normalize = getPropertyAsInt(runtime, params, "embd_normalize", 2);
+                    has_embd_normalize = true;
+                }
+
+                return createPromiseTask(runtime, callInvoker, [runtimePtr = std::shared_ptr<jsi::Runtime>(&runtime, [](jsi::Runtime*){}), contextId, texts, embd_normalize, has_embd_normalize, onResult, callInvoker]() -> PromiseResultGenerator {
+                    auto ctx = getContextOrThrow(contextId);
+                    if (!ctx->parallel_mode_enabled || !ctx->slot_manager) {
+                        throw std::runtime_error("Parallel mode not enabled");
+                    }
+
+                    const llama_vocab* vocab = llama_model_get_vocab(ctx->model);
+                    const bool add_bos = llama_vocab_get_add_bos(vocab);
+                    const bool is_enc_dec = llama_model_has_encoder(ctx->model);
+                    std::vector<std::vector<llama_token>> inputs;
+                    inputs.reserve(texts.size());
+                    for (const auto& text : texts) {
+                        inputs.push_back(common_tokenize(ctx->ctx, text, add_bos || is_enc_dec, true));
+                    }
+
+                    const int n_embd = llama_model_n_embd(ctx->model);
+                    auto resultCallback = [contextId, callInvoker, runtimePtr, n_embd](int32_t requestId, const std::vector<float>& embeddings, bool incomplete) {
+                        auto callbacks = RequestManager::getInstance().takeRequest(contextId, requestId);
+                        if (callbacks.onResult) {
+                            auto embCopy = std::make_shared<std::vector<float>>(embeddings);
+                            auto runtime = runtimePtr;
+                            if (!runtime) {
+                              return;
+                            }
+                            invokeAsyncTracked(callInvoker, contextId, [callbacks, embCopy, n_embd, incomplete, runtime](bool shouldProceed) {
+                                if (!shouldProceed) return;
+                                auto& rt = *runtime;
+                                const int count = n_embd > 0 ? (int)(embCopy->size() / n_embd) : 0;
+                                jsi::Object res(rt);
+                                res.setProperty(rt, "embeddings", createArrayBuffer(rt, std::move(*embCopy)));
+                                res.setProperty(rt, "n_embd", n_embd);
+                                res.setProperty(rt, "count", count);
+                                if (incomplete) {
+                                    res.setProperty(rt, "incomplete", true);
+                                }
+                                callbacks.onResult->call(rt, res);
+                            });
+                        }
+                    };
+
+                    const int normalize = has_embd_normalize ? embd_normalize : ctx->params.embd_normalize;
+                    int requestId = ctx->slot_manager->reserve_request_id();
+                    RequestManager::getInstance().addRequest(contextId, requestId, {nullptr, nullptr, onResult});
+                    try {
+                        int queuedRequestId = ctx->slot_manager->queue_embedding_batch_request(
+                            inputs, normalize, resultCallback, requestId
+                        );
+                        if (queuedRequestId != requestId) {
+                            RequestManager::getInstance().takeRequest(contextId, requestId);
+                            throw std::runtime_error("Failed to queue embedding batch request");
+                        }
+                    } catch (...) {
+                        RequestManager::getInstance().takeRequest(contextId, requestId);
+                        throw;
+                    }
+
+                    return [requestId](jsi::Runtime& rt) {
+                        jsi::Object res(rt);
+                        res.setProperty(rt, "requestId", requestId);
+                        return res;
+                    };
+                }, contextId);
+            }
+        );
+        runtime.global().setProperty(runtime, "llamaQueueEmbeddingBatch", queueEmbeddingBatch);
+
         auto queueRerank = jsi::Function::createFromHostFunction(runtime,
             jsi::PropNameID::forAscii(runtime, "llamaQueueRerank"),
             5,
@@ -1521,7 +1821,7 @@ namespace rnllama_jsi {
                         throw std::runtime_error("Parallel mode not enabled");
                     }
 
-                    auto resultCallback = [contextId, callInvoker, runtimePtr](int32_t requestId, const std::vector<float>& scores) {
+                    auto resultCallback = [contextId, callInvoker, runtimePtr](int32_t requestId, const std::vector<float>& scores, bool incomplete) {
                         auto callbacks = RequestManager::getInstance().takeRequest(contextId, requestId);
                         if (callbacks.onResult) {
                             std::vector<float> scoresCopy = scores;
@@ -1529,7 +1829,7 @@ namespace rnllama_jsi {
                             if (!runtime) {
                               return;
                             }
-                            invokeAsyncTracked(callInvoker, contextId, [callbacks, scoresCopy, runtime](bool shouldProceed) {
+                            invokeAsyncTracked(callInvoker, contextId, [callbacks, scoresCopy, incomplete, runtime](bool shouldProceed) {
                                 if (!shouldProceed) return;
                                 auto& rt = *runtime;
                                 jsi::Array res(rt, scoresCopy.size());
@@ -1539,7 +1839,7 @@ namespace rnllama_jsi {
                                     item.setProperty(rt, "index", (int)i);
                                     res.setValueAtIndex(rt, i, item);
                                 }
-                                callbacks.onResult->call(rt, res);
+                                callbacks.onResult->call(rt, res, incomplete);
                             });
                         }
                     };
@@ -1575,6 +1875,11 @@ namespace rnllama_jsi {
             result.setProperty(rt, "n_parallel", status.n_parallel);
             result.setProperty(rt, "active_slots", status.active_slots);
             result.setProperty(rt, "queued_requests", status.queued_requests);
+            result.setProperty(rt, "shared_prefix_hits", status.shared_prefix_hits);
+            result.setProperty(rt, "shared_prefix_tokens", (double)status.shared_prefix_tokens);
+            result.setProperty(rt, "n_steps", (double)status.n_steps);
+            result.setProperty(rt, "decode_ms", status.decode_ms);
+            result.setProperty(rt, "sample_ms", status.sample_ms);
 
             jsi::Array requests(rt, status.requests.size());
             for (size_t i = 0; i < status.requests.size(); i++) {
@@ -1588,6 +1893,9 @@ namespace rnllama_jsi {
                 reqObj.setProperty(rt, "prompt_ms", req.prompt_ms);
                 reqObj.setProperty(rt, "generation_ms", req.generation_ms);
                 reqObj.setProperty(rt, "tokens_per_second", req.tokens_per_second);
+                reqObj.setProperty(rt, "slot_id", req.slot_id);
+                reqObj.setProperty(rt, "slot_selection", jsi::String::createFromUtf8(rt, req.slot_selection));
+                reqObj.setProperty(rt, "cache_n", req.cache_n);
                 requests.setValueAtIndex(rt, i, reqObj);
             }
             result.setProperty(rt, "requests", requests);
@@ -1615,6 +1923,11 @@ namespace rnllama_jsi {
                         result.setProperty(rt, "n_parallel", status.n_parallel);
                         result.setProperty(rt, "active_slots", status.active_slots);
                         result.setProperty(rt, "queued_requests", status.queued_requests);
+                        result.setProperty(rt, "shared_prefix_hits", status.shared_prefix_hits);
+                        result.setProperty(rt, "shared_prefix_tokens", (double)status.shared_prefix_tokens);
+                        result.setProperty(rt, "n_steps", (double)status.n_steps);
+                        result.setProperty(rt, "decode_ms", status.decode_ms);
+                        result.setProperty(rt, "sample_ms", status.sample_ms);
 
                         jsi::Array requests(rt, status.requests.size());
                         for (size_t i = 0; i < status.requests.size(); i++) {
@@ -1628,6 +1941,9 @@ namespace rnllama_jsi {
                             reqObj.setProperty(rt, "prompt_ms", req.prompt_ms);
                             reqObj.setProperty(rt, "generation_ms", req.generation_ms);
                             reqObj.setProperty(rt, "tokens_per_second", req.tokens_per_second);
+                            reqObj.setProperty(rt, "slot_id", req.slot_id);
+                            reqObj.setProperty(rt, "slot_selection", jsi::String::createFromUtf8(rt, req.slot_selection));
+                            reqObj.setProperty(rt, "cache_n", req.cache_n);
                             requests.setValueAtIndex(rt, i, reqObj);
                         }
                         result.setProperty(rt, "requests", requests);
@@ -1639,6 +1955,28 @@ namespace rnllama_jsi {
         );
         runtime.global().setProperty(runtime, "llamaGetParallelStatus", getParallelStatus);
 
+        // Wait until every queued slot state save is on disk
+        auto flushStateSaves = jsi::Function::createFromHostFunction(runtime,
+            jsi::PropNameID::forAscii(runtime, "llamaFlushStateSaves"),
+            1,
+            [callInvoker](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+                int contextId = (int)arguments[0].asNumber();
+
+                return createPromiseTask(runtime, callInvoker, [contextId]() -> PromiseResultGenerator {
+                    auto ctx = getContextOrThrow(contextId);
+                    if (!ctx->parallel_mode_enabled || !ctx->slot_manager) {
+                        throw std::runtime_error("Parallel mode not enabled");
+                    }
+
+                    const bool ok = ctx->slot_manager->state_writer.flush();
+                    return [ok](jsi::Runtime& rt) {
+                        return jsi::Value(ok);
+                    };
+                }, contextId);
+            }
+        );
+        runtime.global().setProperty(runtime, "llamaFlushStateSaves", flushStateSaves);
+
         // Subscribe to parallel status changes
         auto subscribeParallelStatus = jsi::Function::createFromHostFunction(runtime,
             jsi::PropNameID::forAscii(runtime, "llamaSubscribeParallelStatus"),
@@ -1670,6 +2008,11 @@ namespace rnllama_jsi {
                             result.setProperty(rt, "n_parallel", statusCopy.n_parallel);
                             result.setProperty(rt, "active_slots", statusCopy.active_slots);
                             result.setProperty(rt, "queued_requests", statusCopy.queued_requests);
+                            result.setProperty(rt, "shared_prefix_hits", statusCopy.shared_prefix_hits);
+                            result.setProperty(rt, "shared_prefix_tokens", (double)statusCopy.shared_prefix_tokens);
+                            result.setProperty(rt, "n_steps", (double)statusCopy.n_steps);
+                            result.setProperty(rt, "decode_ms", statusCopy.decode_ms);
+                            result.setProperty(rt, "sample_ms", statusCopy.sample_ms);
 
                             jsi::Array requests(rt, statusCopy.requests.size());
                             for (size_t i = 0; i < statusCopy.requests.size(); i++) {
@@ -1683,6 +2026,9 @@ namespace rnllama_jsi {
                                 reqObj.setProperty(rt, "prompt_ms", req.prompt_ms);
                                 reqObj.setProperty(rt, "generation_ms", req.generation_ms);
                                 reqObj.setProperty(rt, "tokens_per_second", req.tokens_per_second);
+                                reqObj.setProperty(rt, "slot_id", req.slot_id);
+                                reqObj.setProperty(rt, "slot_selection", jsi::String::createFromUtf8(rt, req.slot_selection));
+                                reqObj.setProperty(rt, "cache_n", req.cache_n);
                                 requests.setValueAtIndex(rt, i, reqObj);
                             }
                             result.setProperty(rt, "requests", requests);
@@ -1895,11 +2241,15 @@ namespace rnllama_jsi {
                 bool use_gpu = getPropertyAsBool(runtime, params, "use_gpu", true);
                 int image_min_tokens = getPropertyAsInt(runtime, params, "image_min_tokens", -1);
                 int image_max_tokens = getPropertyAsInt(runtime, params, "image_max_tokens", -1);
+                int media_cache_mb = getPropertyAsInt(runtime, params, "media_cache_mb", 32);
+                std::string media_cache_dir = stripFileScheme(getPropertyAsString(runtime, params, "media_cache_dir"));
+                int media_cache_disk_mb = getPropertyAsInt(runtime, params, "media_cache_disk_mb", 256);
 
-                return createPromiseTask(runtime, callInvoker, [contextId, path, use_gpu, image_min_tokens, image_max_tokens]() -> PromiseResultGenerator {
+                return createPromiseTask(runtime, callInvoker, [contextId, path, use_gpu, image_min_tokens, image_max_tokens, media_cache_mb, media_cache_dir, media_cache_disk_mb]() -> PromiseResultGenerator {
                     auto ctx = getContextOrThrow(contextId);
                     throwIfContextBusy(ctx);
-                    bool result = ctx->initMultimodal(path, use_gpu, image_min_tokens, image_max_tokens);
+                    bool result = ctx->initMultimodal(path, use_gpu, image_min_tokens, image_max_tokens,
+                                                      media_cache_mb, media_cache_dir, media_cache_disk_mb);
                     return [result](jsi::Runtime& rt) { return jsi::Value(result); };
                 }, contextId);
             }
@@ -2063,22 +2413,23 @@ namespace rnllama_jsi {
             2,
             [callInvoker](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
                 int contextId = (int)arguments[0].asNumber();
-                jsi::Array tokensArr = arguments[1].asObject(runtime).asArray(runtime);
-                std::vector<llama_token> tokens;
-                for (size_t i = 0; i < tokensArr.size(runtime); i++) {
-                    tokens.push_back((llama_token)tokensArr.getValueAtIndex(runtime, i).asNumber());
-                }
+                std::vector<llama_token> tokens = readNumberArray<llama_token>(runtime, arguments[1]);
+                const bool typed_array = count > 2 && arguments[2].isBool() && arguments[2].getBool();
 
-                return createPromiseTask(runtime, callInvoker, [contextId, tokens]() -> PromiseResultGenerator {
+                return createPromiseTask(runtime, callInvoker, [contextId, tokens, typed_array]() -> PromiseResultGenerator {
                     auto ctx = getContextOrThrow(contextId);
                     if (!ctx->isVocoderEnabled()) throw std::runtime_error("Vocoder is not enabled");
 
                     try {
-                        auto audio_data = ctx->tts_wrapper->decodeAudioTokens(ctx, tokens);
-                        return [audio_data](jsi::Runtime& rt) {
-                            jsi::Array res(rt, audio_data.size());
-                            for (size_t i = 0; i < audio_data.size(); i++) {
-                                res.setValueAtIndex(rt, i, (double)audio_data[i]);
+                        auto audio_data = std::make_shared<std::vector<float>>(
+                            ctx->tts_wrapper->decodeAudioTokens(ctx, tokens));
+                        return [audio_data, typed_array](jsi::Runtime& rt) -> jsi::Value {
+                            if (typed_array) {
+                                return createFloat32Array(rt, std::move(*audio_data));
+                            }
+                            jsi::Array res(rt, audio_data->size());
+                            for (size_t i = 0; i < audio_data->size(); i++) {
+                                res.setValueAtIndex(rt, i, (double)(*audio_data)[i]);
                             }
                             return res;
                         };
@@ -2298,24 +2649,24 @@ namespace rnllama_jsi {
             3,
             [callInvoker](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
                 int contextId = (int)arguments[0].asNumber();
-                jsi::Array embeddingsArr = arguments[1].asObject(runtime).asArray(runtime);
+                std::vector<float> embeddings = readNumberArray<float>(runtime, arguments[1]);
                 int embeddingDim = (int)arguments[2].asNumber();
-                std::vector<float> embeddings;
-                embeddings.reserve(embeddingsArr.size(runtime));
-                for (size_t i = 0; i < embeddingsArr.size(runtime); i++) {
-                    embeddings.push_back((float)embeddingsArr.getValueAtIndex(runtime, i).asNumber());
-                }
+                const bool typed_array = count > 3 && arguments[3].isBool() && arguments[3].getBool();
 
-                return createPromiseTask(runtime, callInvoker, [contextId, embeddings, embeddingDim]() -> PromiseResultGenerator {
+                return createPromiseTask(runtime, callInvoker, [contextId, embeddings, embeddingDim, typed_array]() -> PromiseResultGenerator {
                     auto ctx = getContextOrThrow(contextId);
                     if (!ctx->isVocoderEnabled()) throw std::runtime_error("Vocoder is not enabled");
 
                     try {
-                        auto audio_data = ctx->tts_wrapper->decodeAudioEmbeddings(ctx, embeddings, embeddingDim);
-                        return [audio_data](jsi::Runtime& rt) {
-                            jsi::Array res(rt, audio_data.size());
-                            for (size_t i = 0; i < audio_data.size(); i++) {
-                                res.setValueAtIndex(rt, i, (double)audio_data[i]);
+                        auto audio_data = std::make_shared<std::vector<float>>(
+                            ctx->tts_wrapper->decodeAudioEmbeddings(ctx, embeddings, embeddingDim));
+                        return [audio_data, typed_array](jsi::Runtime& rt) -> jsi::Value {
+                            if (typed_array) {
+                                return createFloat32Array(rt, std::move(*audio_data));
+                            }
+                            jsi::Array res(rt, audio_data->size());
+                            for (size_t i = 0; i < audio_data->size(); i++) {
+                                res.setValueAtIndex(rt, i, (double)(*audio_data)[i]);
                             }
                             return res;
                         };
@@ -4,6 +4,7 @@
 
 #include "ggml-cpp.h"
 
+#include <map>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -89,3 +90,22 @@ struct llama_adapter_lora {
 
 using llama_adapter_loras = std::unordered_map<llama_adapter_lora *, float>;
 using llama_adapter_loras_ptr = std::unique_ptr<llama_adapter_loras>;
+
+// adapters routed per sequence: the graph applies every adapter in `adapters` to all
+// tokens, masked by a per-token scale taken from the token's sequence
+struct llama_adapter_loras_seq {
+    std::vector<llama_adapter_lora *> adapters;
+
+    // per sequence, one scale per entry of `adapters` (missing sequences use none)
+    std::map<llama_seq_id, std::vector<float>> scales;
+
+    uint32_t get_n_nodes() const {
+        uint32_t res = 0;
+        for (const auto * lora : adapters) {
+            res += lora->ab_map.size() * 8u; // a, b, 2 x mul_mat, mask view + reshape, mul, add
+        }
+        return res;
+    }
+};
+
+using llama_adapter_loras_seq_ptr = std::unique_ptr<llama_adapter_loras_seq>;
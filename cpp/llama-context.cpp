@@ -12,6 +12,7 @@
 #include "llama-ext.h"
 #include "llama.h"
 
+#include <algorithm>
 #include <cinttypes>
 #include <cmath>
 #include <cstring>
@@ -85,6 +86,7 @@ llama_context::llama_context(
     model(model),
     cvec(std::make_unique<llama_adapter_cvec>()),
     loras(std::make_unique<llama_adapter_loras>()),
+    loras_seq(std::make_unique<llama_adapter_loras_seq>()),
     balloc(std::make_unique<llama_batch_allocr>(model.hparams.n_pos_per_embd())) {
     // TODO warning when creating llama_context with awkward ctx size that is not a power of 2,
     //     may need to be backend-dependent
@@ -1303,6 +1305,79 @@ bool llama_context::adapters_lora_are_same(llama_adapter_lora ** adapters, size_
     return true;
 }
 
+void llama_context::set_adapters_lora_seq(llama_seq_id seq_id, llama_adapter_lora ** adapters, size_t n_adapters, float * scales) {
+    LLAMA_LOG_DEBUG("%s: seq_id = %d, adapters = %p\n", __func__, seq_id, (void *) adapters);
+
+    // this sequence's scales, keyed by adapter
+    std::map<llama_adapter_lora *, float> seq_scales;
+    for (size_t i = 0; i < n_adapters; i ++) {
+        if (scales[i] != 0.0f) {
+            seq_scales[adapters[i]] += scales[i];
+        }
+    }
+
+    // adapters still in use by the other sequences keep their position
+    std::vector<llama_adapter_lora *> in_use;
+    for (size_t j = 0; j < loras_seq->adapters.size(); j ++) {
+        bool used = seq_scales.count(loras_seq->adapters[j]) > 0;
+        for (const auto & [id, row] : loras_seq->scales) {
+            if (id != seq_id && row[j] != 0.0f) {
+                used = true;
+                break;
+            }
+        }
+        if (used) {
+            in_use.push_back(loras_seq->adapters[j]);
+        }
+    }
+    for (const auto & [adapter, scale] : seq_scales) {
+        if (std::find(in_use.begin(), in_use.end(), adapter) == in_use.end()) {
+            in_use.push_back(adapter);
+        }
+    }
+
+    auto row_for = [&](const std::vector<float> & old_row) {
+        std::vector<float> row(in_use.size(), 0.0f);
+        for (size_t k = 0; k < in_use.size(); k ++) {
+            for (size_t j = 0; j < loras_seq->adapters.size(); j ++) {
+                if (loras_seq->adapters[j] == in_use[k]) {
+                    row[k] = old_row[j];
+                }
+            }
+        }
+        return row;
+    };
+
+    std::map<llama_seq_id, std::vector<float>> new_scales;
+    for (const auto & [id, row] : loras_seq->scales) {
+        if (id != seq_id) {
+            new_scales[id] = row_for(row);
+        }
+    }
+    if (!seq_scales.empty()) {
+        std::vector<float> row(in_use.size(), 0.0f);
+        for (size_t k = 0; k < in_use.size(); k ++) {
+            auto it = seq_scales.find(in_use[k]);
+            if (it != seq_scales.end()) {
+                row[k] = it->second;
+            }
+        }
+        new_scales[seq_id] = std::move(row);
+    }
+
+    if (in_use == loras_seq->adapters) {
+        // same graph, only the per-token scales change
+        loras_seq->scales = std::move(new_scales);
+        return;
+    }
+
+    loras_seq.reset(new llama_adapter_loras_seq());
+    loras_seq->adapters = std::move(in_use);
+    loras_seq->scales   = std::move(new_scales);
+
+    sched_need_reserve = true;
+}
+
 bool llama_context::set_adapter_cvec(
             const float * data,
                  size_t   len,
@@ -2363,6 +2438,7 @@ uint32_t llama_context::graph_max_nodes(uint32_t n_tokens) const {
     for (const auto & lora : model.loras) {
         res += lora->get_n_nodes();
     }
+    res += loras_seq->get_n_nodes();
     return res;
 }
 
@@ -2444,6 +2520,7 @@ llm_graph_params llama_context::graph_params(
         /*.backend_cpu =*/ backend_cpu,
         /*.cvec        =*/ cvec.get(),
         /*.loras       =*/ loras.get(),
+        /*.loras_seq   =*/ loras_seq.get(),
         /*.mctx        =*/ mctx,
         /*.cross       =*/ &cross,
         /*.samplers    =*/ sampling.samplers,
@@ -2626,6 +2703,15 @@ public:
         buf_size -= size;
     }
 
+    void skip(size_t size) override {
+        if (size > buf_size) {
+            throw std::runtime_error("unexpectedly reached end of buffer");
+        }
+        ptr += size;
+        size_read += size;
+        buf_size -= size;
+    }
+
     size_t n_bytes() override {
         return size_read;
     }
@@ -2684,6 +2770,14 @@ public:
         lm_ggml_backend_tensor_set(tensor, temp_buffer.data(), offset, size);
     }
 
+    void skip(size_t size) override {
+        if (size > file->size() - file->tell()) {
+            throw std::runtime_error("unexpectedly reached end of file");
+        }
+        file->seek(size, SEEK_CUR);
+        size_read += size;
+    }
+
     size_t n_bytes() override {
         return size_read;
     }
@@ -3121,6 +3215,57 @@ size_t llama_context::state_seq_load_file(llama_seq_id seq_id, const char * file
     return file.tell();
 }
 
+size_t llama_context::state_seq_load_file_prefix(llama_seq_id seq_id, const char * filepath, int32_t n_pos, llama_token * tokens_out, size_t n_token_capacity, size_t * n_token_count_out) {
+    llama_file file(filepath, "rb");
+
+    // version checks
+    {
+        const uint32_t magic   = file.read_u32();
+        const uint32_t version = file.read_u32();
+
+        if (magic != LLAMA_STATE_SEQ_MAGIC || version != LLAMA_STATE_SEQ_VERSION) {
+            LLAMA_LOG_ERROR("%s: unknown (magic, version) for sequence state file: %08x, %08x\n", __func__, magic, version);
+            return 0;
+        }
+    }
+
+    // load the prompt, cut to the restored positions
+    {
+        const uint32_t n_token_count = file.read_u32();
+
+        if (n_token_count > n_token_capacity) {
+            LLAMA_LOG_ERROR("%s: token count in sequence state file exceeded capacity! %u > %zu\n", __func__, n_token_count, n_token_capacity);
+            return 0;
+        }
+
+        file.read_raw(tokens_out, sizeof(llama_token) * n_token_count);
+        *n_token_count_out = n_pos < 0 ? n_token_count : std::min<size_t>(n_token_count, n_pos);
+    }
+
+    // restore the context state; the cell data past n_pos is skipped without being read
+    const size_t offset = file.tell();
+    size_t nread = 0;
+    if (llama_mmap::SUPPORTED) {
+        llama_mmap map(&file, 0);
+        {
+            // the io applies its tensor reads on destruction, while the map is alive
+            llama_io_read_host io((const uint8_t *) map.addr() + offset, map.size() - offset);
+            io.pos_end = n_pos;
+            nread = state_seq_read_data(io, seq_id, 0);
+        }
+    } else {
+        llama_io_read_file io(&file);
+        io.pos_end = n_pos;
+        nread = state_seq_read_data(io, seq_id, 0);
+    }
+    if (!nread) {
+        LLAMA_LOG_ERROR("%s: failed to restore sequence state\n", __func__);
+        return 0;
+    }
+
+    return offset + nread;
+}
+
 size_t llama_context::state_seq_save_file(llama_seq_id seq_id, const char * filepath, const llama_token * tokens, size_t n_token_count) {
     llama_file file(filepath, "wb");
 
@@ -3855,6 +4000,21 @@ int32_t llama_set_adapters_lora(
     return 0;
 }
 
+int32_t llama_set_adapters_lora_seq(
+            llama_context * ctx,
+            llama_seq_id seq_id,
+            llama_adapter_lora ** adapters,
+            size_t n_adapters,
+            float * scales) {
+    if (adapters == nullptr || scales == nullptr) {
+        LM_GGML_ASSERT(n_adapters == 0 && "invalid llama_set_adapters_lora_seq call");
+    }
+
+    ctx->set_adapters_lora_seq(seq_id, adapters, n_adapters, scales);
+
+    return 0;
+}
+
 int32_t llama_set_adapter_cvec(
         llama_context * ctx,
           const float * data,
@@ -4085,6 +4245,17 @@ size_t llama_state_seq_load_file(llama_context * ctx, const char * filepath, lla
     }
 }
 
+size_t llama_state_seq_load_file_prefix(llama_context * ctx, const char * filepath, llama_seq_id dest_seq_id, int32_t n_pos, llama_token * tokens_out, size_t n_token_capacity, size_t * n_token_count_out) {
+    ctx->synchronize();
+
+    try {
+        return ctx->state_seq_load_file_prefix(dest_seq_id, filepath, n_pos, tokens_out, n_token_capacity, n_token_count_out);
+    } catch (const std::exception & err) {
+        LLAMA_LOG_ERROR("%s: error loading sequence state file: %s\n", __func__, err.what());
+        return 0;
+    }
+}
+
 ///
 
 int32_t llama_encode(
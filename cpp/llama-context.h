@@ -123,6 +123,8 @@ struct llama_context {
 
     bool adapters_lora_are_same(llama_adapter_lora ** adapters, size_t n_adapters, float * scales);
 
+    void set_adapters_lora_seq(llama_seq_id seq_id, llama_adapter_lora ** adapters, size_t n_adapters, float * scales);
+
     bool set_adapter_cvec(
             const float * data,
                  size_t   len,
@@ -174,6 +176,14 @@ struct llama_context {
                 size_t   n_token_capacity,
                 size_t * n_token_count_out);
 
+    size_t state_seq_load_file_prefix(
+          llama_seq_id   seq_id,
+            const char * filepath,
+               int32_t   n_pos,
+           llama_token * tokens_out,
+                size_t   n_token_capacity,
+                size_t * n_token_count_out);
+
     size_t state_seq_save_file(
           llama_seq_id   seq_id,
             const char * filepath,
@@ -283,6 +293,7 @@ private:
 
     llama_adapter_cvec_ptr  cvec;
     llama_adapter_loras_ptr loras;
+    llama_adapter_loras_seq_ptr loras_seq;
 
     llama_cross cross; // TODO: tmp for handling cross-attention - need something better probably
 
@@ -3,12 +3,19 @@
 #include "llama-impl.h"
 #include "llama-vocab.h"
 #include "llama-sampler.h"
+#include "unicode.h"
 
 #include <cmath>
 #include <algorithm>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <set>
 #include <stdexcept>
+#include <unordered_map>
 
 #define MAX_REPETITION_THRESHOLD 2000
 //
@@ -1050,6 +1057,47 @@ void llama_grammar_accept(struct llama_grammar * grammar, uint32_t chr) {
     grammar->stacks = std::move(stacks_new);
 }
 
+bool llama_grammar_forced_text(
+        const struct llama_grammar & grammar,
+                            size_t   max_bytes,
+                       std::string & text,
+                              bool & complete) {
+    text.clear();
+    complete = false;
+    if (grammar.awaiting_trigger || grammar.partial_utf8.n_remain != 0 || grammar.stacks.size() != 1) {
+        return false;
+    }
+
+    llama_grammar_stack stack = grammar.stacks.front();
+    while (!stack.empty()) {
+        const llama_grammar_element * pos = stack.back();
+        // a lone char; ranges, alternates, negations and tokens end the run
+        if (pos->type != LLAMA_GRETYPE_CHAR ||
+            pos[1].type == LLAMA_GRETYPE_CHAR_ALT || pos[1].type == LLAMA_GRETYPE_CHAR_RNG_UPPER) {
+            return true;
+        }
+        const std::string chr = unicode_cpt_to_utf8(pos->value);
+        if (text.size() + chr.size() > max_bytes) {
+            return true;
+        }
+
+        llama_grammar_stack next(stack.begin(), stack.end() - 1);
+        if (!llama_grammar_is_end_of_sequence(pos + 1)) {
+            next.push_back(pos + 1);
+        }
+        llama_grammar_stacks next_stacks;
+        llama_grammar_advance_stack(grammar.rules, next, next_stacks);
+        text += chr;
+        if (next_stacks.size() != 1) {
+            // the char is pinned, what follows it is not
+            return true;
+        }
+        stack = std::move(next_stacks.front());
+    }
+    complete = true;
+    return true;
+}
+
 llama_grammar_candidates llama_grammar_reject_candidates_for_stack(
         const llama_grammar_rules      & rules,
         const llama_grammar_stack      & stack,
@@ -1201,6 +1249,7 @@ struct llama_grammar * llama_grammar_init_impl(
         /* .trigger_buffer_positions = */ {},
         /* .trigger_tokens = */           {},
         /* .trigger_patterns = */         {},
+        /* .mask_state = */               {},
     };
 }
 
@@ -1307,6 +1356,7 @@ struct llama_grammar * llama_grammar_init_impl(
         /* .trigger_buffer_positions = */ {},
         std::move(vec_trigger_tokens),
         std::move(vec_trigger_patterns),
+        /* .mask_state = */               {},
     };
 }
 
@@ -1330,6 +1380,7 @@ struct llama_grammar * llama_grammar_clone_impl(const struct llama_grammar & gra
         grammar.trigger_buffer_positions,
         grammar.trigger_tokens,
         grammar.trigger_patterns,
+        /* .mask_state = */ {},
     };
 
     // redirect elements in stacks to point to new rules
@@ -1348,6 +1399,224 @@ struct llama_grammar * llama_grammar_clone_impl(const struct llama_grammar & gra
     return result;
 }
 
+//
+// allowed-token masks
+//
+
+// Rejecting candidates walks every token's code points through every stack,
+// which for a full vocab can cost more than the decode. A stack (with the
+// pending partial UTF-8) alone decides which tokens it accepts, so that set is
+// kept as a bitset over the vocab, shared by every grammar with the same rules
+// and vocab: across sampling steps, clones and requests. Grammar states recur
+// constantly (e.g. inside a JSON string), so most applies reduce to ORing a few
+// bitsets and one pass over the candidates.
+//
+// LLAMA_GRAMMAR_NO_MASK_CACHE disables it (for testing against the plain walk).
+
+#define LLAMA_GRAMMAR_MASK_CACHE_BYTES (64u * 1024 * 1024)
+
+using llama_grammar_mask = std::vector<uint64_t>;
+
+struct llama_grammar_mask_cache {
+    using entry = std::pair<std::string, std::shared_ptr<const llama_grammar_mask>>;
+
+    std::mutex                                                  mutex;
+    size_t                                                      bytes = 0;
+    std::list<entry>                                            lru;
+    std::unordered_map<std::string, std::list<entry>::iterator> index;
+
+    std::shared_ptr<const llama_grammar_mask> get(const std::string & key) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(key);
+        if (it == index.end()) {
+            return nullptr;
+        }
+        lru.splice(lru.begin(), lru, it->second);
+        return it->second->second;
+    }
+
+    void put(const std::string & key, std::shared_ptr<const llama_grammar_mask> mask) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (index.count(key) != 0) {
+            return;
+        }
+        bytes += key.size() + mask->size() * sizeof(uint64_t);
+        lru.emplace_front(key, std::move(mask));
+        index[key] = lru.begin();
+        while (bytes > LLAMA_GRAMMAR_MASK_CACHE_BYTES && lru.size() > 1) {
+            const auto & last = lru.back();
+            bytes -= last.first.size() + last.second->size() * sizeof(uint64_t);
+            index.erase(last.first);
+            lru.pop_back();
+        }
+    }
+};
+
+static llama_grammar_mask_cache & llama_grammar_get_mask_cache() {
+    static llama_grammar_mask_cache cache;
+    return cache;
+}
+
+static void llama_grammar_hash(uint64_t & h, const void * data, size_t n) {
+    const auto * p = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < n; i++) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+}
+
+static void llama_grammar_init_mask_state(const llama_grammar & grammar) {
+    auto & state = grammar.mask_state;
+    state.initialized = true;
+    state.enabled     = grammar.vocab != nullptr && getenv("LLAMA_GRAMMAR_NO_MASK_CACHE") == nullptr;
+    if (!state.enabled) {
+        return;
+    }
+
+    // the vocab is part of the key (not just its address, which a reloaded model may reuse)
+    uint64_t h = 14695981039346656037ULL;
+    const uint32_t n_vocab = grammar.vocab->n_tokens();
+    llama_grammar_hash(h, &n_vocab, sizeof(n_vocab));
+    for (uint32_t id = 0; id < n_vocab; ++id) {
+        const std::string & piece = grammar.vocab->token_to_piece(id);
+        const uint32_t      len   = piece.size();
+        const uint8_t       eog   = grammar.vocab->is_eog(id);
+        llama_grammar_hash(h, &len, sizeof(len));
+        llama_grammar_hash(h, piece.data(), piece.size());
+        llama_grammar_hash(h, &eog, sizeof(eog));
+    }
+    for (const auto & rule : grammar.rules) {
+        const uint32_t len = rule.size();
+        llama_grammar_hash(h, &len, sizeof(len));
+        for (const auto & elem : rule) {
+            const uint32_t type = elem.type;
+            llama_grammar_hash(h, &type, sizeof(type));
+            llama_grammar_hash(h, &elem.value, sizeof(elem.value));
+        }
+    }
+    state.key = h;
+
+    state.rule_bases.reserve(grammar.rules.size());
+    for (size_t i = 0; i < grammar.rules.size(); i++) {
+        state.rule_bases.emplace_back(grammar.rules[i].data(), (uint32_t) i);
+    }
+    std::sort(state.rule_bases.begin(), state.rule_bases.end());
+}
+
+// cache key of one stack: the grammar key, the partial UTF-8 and each element as (rule, offset)
+static std::string llama_grammar_stack_key(const llama_grammar & grammar, const llama_grammar_stack & stack) {
+    const auto & state = grammar.mask_state;
+
+    std::string key;
+    key.reserve(sizeof(uint64_t) + sizeof(llama_partial_utf8) + stack.size() * 2 * sizeof(uint32_t));
+    key.append(reinterpret_cast<const char *>(&state.key), sizeof(state.key));
+    key.append(reinterpret_cast<const char *>(&grammar.partial_utf8.value), sizeof(uint32_t));
+    key.append(reinterpret_cast<const char *>(&grammar.partial_utf8.n_remain), sizeof(int32_t));
+    for (const llama_grammar_element * pos : stack) {
+        auto it = std::upper_bound(state.rule_bases.begin(), state.rule_bases.end(),
+            std::make_pair(pos, UINT32_MAX));
+        LM_GGML_ASSERT(it != state.rule_bases.begin());
+        --it;
+        const uint32_t ids[2] = { it->second, (uint32_t) (pos - it->first) };
+        key.append(reinterpret_cast<const char *>(ids), sizeof(ids));
+    }
+    return key;
+}
+
+// masks out the candidates no stack accepts; returns false (leaving cur_p
+// untouched) when the masks are disabled, or when cur_p is a small subset of
+// the vocab and some mask isn't cached: building one walks the whole vocab
+static bool llama_grammar_apply_masks(const llama_grammar & grammar, llama_token_data_array * cur_p, bool allow_eog) {
+    if (!grammar.mask_state.initialized) {
+        llama_grammar_init_mask_state(grammar);
+    }
+    if (!grammar.mask_state.enabled) {
+        return false;
+    }
+
+    const uint32_t n_vocab = grammar.vocab->n_tokens();
+    const size_t   n_words = (n_vocab + 63) / 64;
+    const bool     full    = cur_p->size * 2 >= n_vocab;
+    auto & cache = llama_grammar_get_mask_cache();
+
+    std::vector<std::shared_ptr<const llama_grammar_mask>> masks;
+    std::vector<size_t> missing;
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < grammar.stacks.size(); ++i) {
+        const auto & stack = grammar.stacks[i];
+        if (stack.empty()) {
+            // accepts only EOG, handled below
+            continue;
+        }
+        keys.push_back(llama_grammar_stack_key(grammar, stack));
+        auto mask = cache.get(keys.back());
+        if (mask) {
+            masks.push_back(std::move(mask));
+        } else if (!full) {
+            return false;
+        } else {
+            missing.push_back(i);
+            masks.push_back(nullptr);
+        }
+    }
+
+    if (!missing.empty()) {
+        // the same candidates as llama_grammar_apply_impl, for every token
+        std::vector<std::pair<std::vector<uint32_t>, llama_partial_utf8>> decoded;
+        decoded.reserve(n_vocab);
+        llama_grammar_candidates candidates;
+        candidates.reserve(n_vocab);
+        llama_grammar_mask all(n_words, 0);
+        for (uint32_t id = 0; id < n_vocab; ++id) {
+            const std::string & piece = grammar.vocab->token_to_piece(id);
+            if (grammar.vocab->is_eog(id) || piece.empty() || piece[0] == 0) {
+                continue;
+            }
+            decoded.push_back(decode_utf8(piece, grammar.partial_utf8));
+            candidates.push_back({ id, decoded.back().first.data(), decoded.back().second, (llama_token) id });
+            all[id / 64] |= 1ULL << (id % 64);
+        }
+
+        size_t i_mask = 0;
+        for (size_t i = 0, i_miss = 0; i < grammar.stacks.size() && i_miss < missing.size(); ++i) {
+            if (grammar.stacks[i].empty()) {
+                continue;
+            }
+            if (i == missing[i_miss]) {
+                auto mask = std::make_shared<llama_grammar_mask>(all);
+                for (const auto & reject : llama_grammar_reject_candidates_for_stack(grammar.rules, grammar.stacks[i], candidates)) {
+                    (*mask)[reject.index / 64] &= ~(1ULL << (reject.index % 64));
+                }
+                cache.put(keys[i_mask], mask);
+                masks[i_mask] = std::move(mask);
+                ++i_miss;
+            }
+            ++i_mask;
+        }
+    }
+
+    llama_grammar_mask allowed(n_words, 0);
+    for (const auto & mask : masks) {
+        const uint64_t * src = mask->data();
+        uint64_t       * dst = allowed.data();
+        for (size_t w = 0; w < n_words; ++w) {
+            dst[w] |= src[w];
+        }
+    }
+
+    for (size_t i = 0; i < cur_p->size; ++i) {
+        const llama_token id = cur_p->data[i].id;
+        if (grammar.vocab->is_eog(id)) {
+            if (!allow_eog) {
+                cur_p->data[i].logit = -INFINITY;
+            }
+        } else if ((uint32_t) id >= n_vocab || !((allowed[id / 64] >> (id % 64)) & 1)) {
+            cur_p->data[i].logit = -INFINITY;
+        }
+    }
+    return true;
+}
+
 void llama_grammar_apply_impl(const struct llama_grammar & grammar, llama_token_data_array * cur_p) {
     LM_GGML_ASSERT(grammar.vocab != nullptr);
 
@@ -1363,6 +1632,10 @@ void llama_grammar_apply_impl(const struct llama_grammar & grammar, llama_token_
         }
     }
 
+    if (llama_grammar_apply_masks(grammar, cur_p, allow_eog)) {
+        return;
+    }
+
     std::vector<std::pair<std::vector<uint32_t>, llama_partial_utf8>> candidates_decoded;
     candidates_decoded.reserve(cur_p->size);
 
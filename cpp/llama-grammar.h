@@ -116,6 +116,16 @@ struct llama_grammar_parser {
     void print(FILE * file);
 };
 
+// per-instance view of the shared allowed-token mask cache (see llama-grammar.cpp)
+struct llama_grammar_mask_state {
+    bool     initialized = false;
+    bool     enabled     = false;
+    uint64_t key         = 0; // fingerprint of the vocab and the rules
+
+    // rule start addresses, sorted, to key stacks by (rule, offset)
+    std::vector<std::pair<const llama_grammar_element *, uint32_t>> rule_bases;
+};
+
 struct llama_grammar_trigger_pattern {
     std::string pattern;
     std::regex  regex;
@@ -148,6 +158,8 @@ struct llama_grammar {
                              trigger_patterns;         // Regular expressions that trigger a lazy grammar. Must be a full match of the entire generated
                                                        // string, and the grammar will be given the string from the first match group onwards.
 
+    // lazily initialized on the first apply; not copied by clones, whose stacks point to their own rules
+    mutable llama_grammar_mask_state mask_state;
 };
 
 //
@@ -192,3 +204,13 @@ void llama_grammar_accept_token(
               struct llama_grammar & grammar,
                        llama_token   token,
                  const std::string & piece);
+
+// the text every continuation of the grammar starts with: the run of single
+// characters on top of its parse stack, at most max_bytes (whole code points).
+// returns false if the grammar awaits a trigger, is inside a code point or has
+// several parse paths; complete is set when the run ends the grammar
+bool llama_grammar_forced_text(
+        const struct llama_grammar & grammar,
+                            size_t   max_bytes,
+                       std::string & text,
+                              bool & complete);
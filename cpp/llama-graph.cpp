@@ -1276,6 +1276,51 @@ bool llm_graph_input_sampling::can_reuse(const llm_graph_params & params) {
     return true;
 }
 
+void llm_graph_input_lora_seq::set_input(const llama_ubatch * ubatch) {
+    const int64_t n_tokens   = ubatch->n_tokens;
+    const size_t  n_adapters = loras_seq->adapters.size();
+
+    if (scales) {
+        LM_GGML_ASSERT(lm_ggml_backend_buffer_is_host(scales->buffer));
+    }
+    if (scales_out) {
+        LM_GGML_ASSERT(lm_ggml_backend_buffer_is_host(scales_out->buffer));
+    }
+
+    float * data     = scales     ? (float *) scales->data     : nullptr;
+    float * data_out = scales_out ? (float *) scales_out->data : nullptr;
+
+    int64_t i_out = 0;
+    for (int64_t i = 0; i < n_tokens; ++i) {
+        const auto it = loras_seq->scales.find(ubatch->seq_id[i][0]);
+        const bool is_output = n_outputs == n_tokens || (ubatch->output && ubatch->output[i]);
+
+        for (size_t j = 0; j < n_adapters; ++j) {
+            const float scale = it != loras_seq->scales.end() ? it->second[j] : 0.0f;
+            if (data) {
+                data[j*n_tokens + i] = scale;
+            }
+            if (data_out && is_output && i_out < n_outputs) {
+                data_out[j*n_outputs + i_out] = scale;
+            }
+        }
+
+        if (is_output) {
+            i_out++;
+        }
+    }
+}
+
+bool llm_graph_input_lora_seq::can_reuse(const llm_graph_params & params) {
+    bool res = true;
+
+    res &= loras_seq == params.loras_seq;
+    res &= n_outputs == params.n_outputs;
+    res &= scales == nullptr || scales->ne[0] == params.ubatch.n_tokens;
+
+    return res;
+}
+
 //
 // llm_graph_result
 //
@@ -1459,6 +1504,7 @@ llm_graph_context::llm_graph_context(const llm_graph_params & params) :
     backend_cpu      (params.backend_cpu),
     cvec             (params.cvec),
     loras            (params.loras),
+    loras_seq        (params.loras_seq),
     mctx             (params.mctx),
     cross            (params.cross),
     samplers         (params.samplers),
@@ -1511,6 +1557,29 @@ lm_ggml_tensor * llm_graph_context::build_lora_mm(
         res = lm_ggml_add(ctx0, res, ab_cur);
     }
 
+    for (size_t i = 0; loras_seq && i < loras_seq->adapters.size(); ++i) {
+        llama_adapter_lora * lora = loras_seq->adapters[i];
+        llama_adapter_lora_weight * lw = lora->get_weight(w);
+        if (lw == nullptr) {
+            continue;
+        }
+
+        lm_ggml_tensor * seq_scale = build_lora_seq_scale(i, res);
+        if (seq_scale == nullptr) {
+            LLAMA_LOG_WARN("%s: cannot route LoRA per sequence for %s, skipping\n", __func__, w->name);
+            continue;
+        }
+
+        lm_ggml_tensor * ab_cur = lm_ggml_mul_mat(
+                ctx0, lw->b,
+                lm_ggml_mul_mat(ctx0, lw->a, cur)
+                );
+
+        ab_cur = lm_ggml_mul(ctx0, ab_cur, seq_scale);
+        ab_cur = lm_ggml_scale(ctx0, ab_cur, lw->get_scale(lora->alpha, 1.0f));
+        res = lm_ggml_add(ctx0, res, ab_cur);
+    }
+
     return res;
 }
 
@@ -1549,9 +1618,73 @@ lm_ggml_tensor * llm_graph_context::build_lora_mm_id(
         res = lm_ggml_add(ctx0, res, ab_cur);
     }
 
+    for (size_t i = 0; loras_seq && i < loras_seq->adapters.size(); ++i) {
+        llama_adapter_lora * lora = loras_seq->adapters[i];
+        llama_adapter_lora_weight * lw = lora->get_weight(w);
+        if (lw == nullptr) {
+            continue;
+        }
+
+        lm_ggml_tensor * seq_scale = build_lora_seq_scale(i, res);
+        if (seq_scale == nullptr) {
+            LLAMA_LOG_WARN("%s: cannot route LoRA per sequence for %s, skipping\n", __func__, w->name);
+            continue;
+        }
+
+        const float alpha = lora->alpha;
+        const float rank  = (float) lw->b->ne[0];
+        const float scale = alpha ? alpha / rank : 1.0f;
+
+        lm_ggml_tensor * ab_cur = lm_ggml_mul_mat_id(
+                ctx0, lw->b,
+                lm_ggml_mul_mat_id(ctx0, lw->a, cur, ids),
+                ids
+                );
+
+        ab_cur = lm_ggml_mul(ctx0, ab_cur, seq_scale);
+        ab_cur = lm_ggml_scale(ctx0, ab_cur, scale);
+        res = lm_ggml_add(ctx0, res, ab_cur);
+    }
+
     return res;
 }
 
+lm_ggml_tensor * llm_graph_context::build_lora_seq_scale(
+                size_t   i_adapter,
+    const lm_ggml_tensor * cur) const {
+    if (inp_lora_seq == nullptr) {
+        auto inp = std::make_unique<llm_graph_input_lora_seq>(loras_seq, n_outputs);
+        inp_lora_seq = inp.get();
+        res->add_input(std::move(inp));
+    }
+
+    // the token index runs over the trailing dims of cur (e.g. [n_embd, n_tokens] or
+    // [n_embd, n_expert_used, n_tokens]): find where they multiply up to the row count
+    for (int d = 1; d < 4; ++d) {
+        int64_t n = 1;
+        for (int k = d; k < 4; ++k) {
+            n *= cur->ne[k];
+        }
+        if (n != n_tokens && n != n_outputs) {
+            continue;
+        }
+
+        lm_ggml_tensor *& scales = n == n_tokens ? inp_lora_seq->scales : inp_lora_seq->scales_out;
+        if (scales == nullptr) {
+            scales = lm_ggml_new_tensor_2d(ctx0, LM_GGML_TYPE_F32, n, loras_seq->adapters.size());
+            lm_ggml_set_input(scales);
+        }
+
+        lm_ggml_tensor * s = lm_ggml_view_1d(ctx0, scales, n, i_adapter*scales->nb[1]);
+        return lm_ggml_reshape_4d(ctx0, s, 1,
+                d <= 1 ? cur->ne[1] : 1,
+                d <= 2 ? cur->ne[2] : 1,
+                cur->ne[3]);
+    }
+
+    return nullptr;
+}
+
 lm_ggml_tensor * llm_graph_context::build_norm(
          lm_ggml_tensor * cur,
          lm_ggml_tensor * mw,
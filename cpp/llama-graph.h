@@ -707,6 +707,25 @@ public:
     const llama_memory_hybrid_iswa_context * mctx;
 };
 
+// per-token scales of the adapters routed per sequence, laid out one adapter after the
+// other; scales_out holds the rows of the output tokens only
+class llm_graph_input_lora_seq : public llm_graph_input_i {
+public:
+    llm_graph_input_lora_seq(const llama_adapter_loras_seq * loras_seq, int64_t n_outputs) :
+        loras_seq(loras_seq), n_outputs(n_outputs) {}
+    virtual ~llm_graph_input_lora_seq() = default;
+
+    void set_input(const llama_ubatch * ubatch) override;
+    bool can_reuse(const llm_graph_params & params) override;
+
+    lm_ggml_tensor * scales     = nullptr; // F32 [n_tokens,  n_adapters]
+    lm_ggml_tensor * scales_out = nullptr; // F32 [n_outputs, n_adapters]
+
+    const llama_adapter_loras_seq * loras_seq;
+
+    const int64_t n_outputs;
+};
+
 class llm_graph_input_sampling : public llm_graph_input_i {
 public:
     llm_graph_input_sampling(std::map<llama_seq_id, llama_sampler *> samplers) :
@@ -749,6 +768,7 @@ struct llm_graph_params {
 
     const llama_adapter_cvec     * cvec;
     const llama_adapter_loras    * loras;
+    const llama_adapter_loras_seq * loras_seq;
     const llama_memory_context_i * mctx;
     const llama_cross            * cross;
 
@@ -845,6 +865,7 @@ struct llm_graph_params {
             gtype == other.gtype &&
             cvec  == other.cvec  &&
             loras == other.loras &&
+            loras_seq == other.loras_seq &&
             cross == other.cross;
     }
 };
@@ -989,6 +1010,7 @@ struct llm_graph_context {
 
     const llama_adapter_cvec     * cvec;
     const llama_adapter_loras    * loras;
+    const llama_adapter_loras_seq * loras_seq;
     const llama_memory_context_i * mctx;
     const llama_cross            * cross;
 
@@ -1001,6 +1023,9 @@ struct llm_graph_context {
     lm_ggml_context * ctx0 = nullptr;
     lm_ggml_cgraph  * gf   = nullptr;
 
+    // created by the first matmul that applies a sequence-routed adapter
+    mutable llm_graph_input_lora_seq * inp_lora_seq = nullptr;
+
     llm_graph_context(const llm_graph_params & params);
     virtual ~llm_graph_context() = default;
 
@@ -1027,6 +1052,12 @@ struct llm_graph_context {
               lm_ggml_tensor * ids,
               lm_ggml_tensor * w_s = nullptr) const;
 
+    // per-token scale of a sequence-routed adapter, shaped to broadcast over the rows of
+    // a matmul result (tokens or output tokens); nullptr if its rows are neither
+    lm_ggml_tensor * build_lora_seq_scale(
+                    size_t   i_adapter,
+        const lm_ggml_tensor * cur) const;
+
     lm_ggml_tensor * build_norm(
              lm_ggml_tensor * cur,
              lm_ggml_tensor * mw,
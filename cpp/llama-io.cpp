@@ -18,3 +18,8 @@ void llama_io_read_i::read_string(std::string & str) {
 
     str.assign(buf.data(), str_size);
 }
+
+void llama_io_read_i::skip(size_t size) {
+    std::vector<uint8_t> buf(size);
+    read(buf.data(), size);
+}
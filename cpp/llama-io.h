@@ -28,8 +28,15 @@ public:
     virtual void read(void * dst, size_t size) = 0;
     virtual void read_tensor(lm_ggml_tensor * tensor, size_t offset, size_t size) = 0;
 
+    // advance past size bytes that are not needed (counted in n_bytes); sources
+    // that can seek or are memory-mapped never touch them
+    virtual void skip(size_t size);
+
     // bytes read so far
     virtual size_t n_bytes() = 0;
 
     void read_string(std::string & str);
+
+    // single-sequence restores keep only the cells at positions < pos_end (-1: all)
+    int32_t pos_end = -1;
 };
@@ -2057,12 +2057,13 @@ void llama_kv_cache::state_read(llama_io_read_i & io, llama_seq_id seq_id, llama
         const uint32_t strm = seq_id == -1 ? s : seq_to_stream[seq_id];
 
         slot_info sinfo;
+        std::vector<bool> keep;
 
         bool res = true;
-        res = res && state_read_meta(io, strm, cell_count, sinfo, seq_id);
+        res = res && state_read_meta(io, strm, cell_count, sinfo, seq_id, keep);
 
         try {
-            res = res && state_read_data(io, strm, cell_count, sinfo);
+            res = res && state_read_data(io, strm, cell_count, sinfo, keep);
         } catch (...) {
             res = false;
         }
@@ -2210,25 +2211,26 @@ void llama_kv_cache::state_write_data(llama_io_write_i & io, const cell_ranges_t
     }
 }
 
-bool llama_kv_cache::state_read_meta(llama_io_read_i & io, uint32_t strm, uint32_t cell_count, slot_info & sinfo, llama_seq_id dest_seq_id) {
+bool llama_kv_cache::state_read_meta(llama_io_read_i & io, uint32_t strm, uint32_t cell_count, slot_info & sinfo, llama_seq_id dest_seq_id, std::vector<bool> & keep) {
     auto & cells = v_cells[strm];
     auto & head  = v_heads[strm];
 
+    keep.clear();
+
     if (dest_seq_id != -1) {
         // single sequence
         seq_rm(dest_seq_id, -1, -1);
 
-        llama_batch_allocr balloc(hparams.n_pos_per_embd());
-
-        llama_ubatch ubatch = balloc.ubatch_reserve(cell_count, 1);
-
-        ubatch.seq_id_unq[0] = dest_seq_id;
+        // read all cell metadata first: with io.pos_end set, only the cells
+        // below it are restored and the rest of their data is skipped
+        std::vector<llama_pos> pos(cell_count);
+        std::vector<llama_kv_cell_ext> ext(hparams.n_pos_per_embd() > 1 ? cell_count : 0);
+        uint32_t n_keep = 0;
 
         for (uint32_t i = 0; i < cell_count; ++i) {
-            llama_pos pos;
             uint32_t n_seq_id;
 
-            io.read(&pos,      sizeof(pos));
+            io.read(&pos[i],   sizeof(pos[i]));
             io.read(&n_seq_id, sizeof(n_seq_id));
 
             if (n_seq_id != 1) {
@@ -2237,11 +2239,7 @@ bool llama_kv_cache::state_read_meta(llama_io_read_i & io, uint32_t strm, uint32
             }
 
             if (hparams.n_pos_per_embd() > 1) {
-                llama_kv_cell_ext ext;
-                io.read(&ext, sizeof(ext));
-
-                ubatch.pos[i + ubatch.n_tokens]   = ext.y;
-                ubatch.pos[i + ubatch.n_tokens*2] = ext.x;
+                io.read(&ext[i], sizeof(ext[i]));
             }
 
             // read the sequence id, but directly discard it - we will use dest_seq_id instead
@@ -2250,14 +2248,45 @@ bool llama_kv_cache::state_read_meta(llama_io_read_i & io, uint32_t strm, uint32
                 io.read(&seq_id, sizeof(seq_id));
             }
 
-            ubatch.pos[i]      = pos;
-            ubatch.n_seq_id[i] = n_seq_id;
-            ubatch.seq_id[i]   = &dest_seq_id;
+            n_keep += io.pos_end < 0 || pos[i] < io.pos_end;
+        }
+
+        if (n_keep < cell_count) {
+            keep.resize(cell_count);
+            for (uint32_t i = 0; i < cell_count; ++i) {
+                keep[i] = pos[i] < io.pos_end;
+            }
+        }
+
+        if (n_keep == 0) {
+            return true;
+        }
+
+        llama_batch_allocr balloc(hparams.n_pos_per_embd());
+
+        llama_ubatch ubatch = balloc.ubatch_reserve(n_keep, 1);
+
+        ubatch.seq_id_unq[0] = dest_seq_id;
+
+        for (uint32_t i = 0, k = 0; i < cell_count; ++i) {
+            if (!keep.empty() && !keep[i]) {
+                continue;
+            }
+
+            if (hparams.n_pos_per_embd() > 1) {
+                ubatch.pos[k + ubatch.n_tokens]   = ext[i].y;
+                ubatch.pos[k + ubatch.n_tokens*2] = ext[i].x;
+            }
+
+            ubatch.pos[k]      = pos[i];
+            ubatch.n_seq_id[k] = 1;
+            ubatch.seq_id[k]   = &dest_seq_id;
+            ++k;
         }
 
         sinfo = find_slot(ubatch, false);
         if (sinfo.empty()) {
-            LLAMA_LOG_ERROR("%s: failed to find %d available cells in kv cache\n", __func__,  cell_count);
+            LLAMA_LOG_ERROR("%s: failed to find %d available cells in kv cache\n", __func__,  n_keep);
             return false;
         }
 
@@ -2265,12 +2294,12 @@ bool llama_kv_cache::state_read_meta(llama_io_read_i & io, uint32_t strm, uint32
         //       see: https://github.com/ggml-org/llama.cpp/pull/16825#issuecomment-3460868350
         apply_ubatch(sinfo, ubatch);
 
-        LLAMA_LOG_DEBUG("%s: cell_count = %d, dest_seq_id = %d\n", __func__, cell_count, dest_seq_id);
+        LLAMA_LOG_DEBUG("%s: cell_count = %d (restoring %d), dest_seq_id = %d\n", __func__, cell_count, n_keep, dest_seq_id);
 
         // DEBUG CHECK: verify that all cells were allocated and have correct seq_id and pos values
         LM_GGML_ASSERT(sinfo.n_stream() == 1);
-        LM_GGML_ASSERT(sinfo.idxs[0].size() == cell_count);
-        for (uint32_t i = 0; i < cell_count; ++i) {
+        LM_GGML_ASSERT(sinfo.idxs[0].size() == n_keep);
+        for (uint32_t i = 0; i < n_keep; ++i) {
             const uint32_t idx = sinfo.idxs[0][i];
             LM_GGML_ASSERT(cells.pos_get(idx) == ubatch.pos[i]);
             LM_GGML_ASSERT(cells.seq_has(idx, dest_seq_id));
@@ -2329,9 +2358,40 @@ bool llama_kv_cache::state_read_meta(llama_io_read_i & io, uint32_t strm, uint32
     return true;
 }
 
-bool llama_kv_cache::state_read_data(llama_io_read_i & io, uint32_t strm, uint32_t cell_count, const slot_info & sinfo) {
+bool llama_kv_cache::state_read_data(llama_io_read_i & io, uint32_t strm, uint32_t cell_count, const slot_info & sinfo, const std::vector<bool> & keep) {
     auto & cells = v_cells[strm];
 
+    const uint32_t n_keep = keep.empty() ? cell_count : (uint32_t) std::count(keep.begin(), keep.end(), true);
+
+    // the kept cells are the first n_keep stored ones (the usual case for a
+    // truncated restore): one block read, the tail is skipped unread
+    const bool keep_head = n_keep > 0 && std::all_of(keep.begin(), keep.begin() + std::min<size_t>(keep.size(), n_keep), [](bool b) { return b; });
+
+    // read cell_count stored elements of el_size bytes each into the kept
+    // cells' slots at dst_base + slot * el_size, skipping the others
+    auto read_cells = [&](lm_ggml_tensor * t, size_t dst_base, size_t el_size) {
+        if (n_keep == 0) {
+            io.skip(cell_count * el_size);
+            return;
+        }
+        if (keep_head && sinfo.is_contiguous()) {
+            // Fast path: contiguous cells, single memcpy
+            io.read_tensor(t, dst_base + sinfo.head() * el_size, n_keep * el_size);
+            if (n_keep < cell_count) {
+                io.skip((cell_count - n_keep) * el_size);
+            }
+            return;
+        }
+        // Slow path: scatter to non-contiguous positions
+        for (uint32_t i = 0, k = 0; i < cell_count; ++i) {
+            if (!keep.empty() && !keep[i]) {
+                io.skip(el_size);
+                continue;
+            }
+            io.read_tensor(t, dst_base + sinfo.idxs[0][k++] * el_size, el_size);
+        }
+    };
+
     uint32_t v_trans;
     uint32_t n_layer;
 
@@ -2343,8 +2403,8 @@ bool llama_kv_cache::state_read_data(llama_io_read_i & io, uint32_t strm, uint32
         return false;
     }
 
-    if (cell_count > cells.size()) {
-        LLAMA_LOG_ERROR("%s: not enough cells in kv cache to restore state (%u > %u)\n", __func__, cell_count, cells.size());
+    if (n_keep > cells.size()) {
+        LLAMA_LOG_ERROR("%s: not enough cells in kv cache to restore state (%u > %u)\n", __func__, n_keep, cells.size());
         return false;
     }
 
@@ -2380,16 +2440,7 @@ bool llama_kv_cache::state_read_data(llama_io_read_i & io, uint32_t strm, uint32
         }
 
         if (cell_count) {
-            if (sinfo.is_contiguous()) {
-                // Fast path: contiguous cells, single memcpy
-                io.read_tensor(k, sinfo.head() * k_size_row, cell_count * k_size_row);
-            } else {
-                // Slow path: scatter to non-contiguous positions
-                for (uint32_t i = 0; i < cell_count; ++i) {
-                    const size_t dst_offset = sinfo.idxs[0][i] * k_size_row;
-                    io.read_tensor(k, dst_offset, k_size_row);
-                }
-            }
+            read_cells(k, 0, k_size_row);
         }
     }
 
@@ -2423,16 +2474,7 @@ bool llama_kv_cache::state_read_data(llama_io_read_i & io, uint32_t strm, uint32
             }
 
             if (cell_count) {
-                if (sinfo.is_contiguous()) {
-                    // Fast path: contiguous cells, single memcpy
-                    io.read_tensor(v, sinfo.head() * v_size_row, cell_count * v_size_row);
-                } else {
-                    // Slow path: scatter to non-contiguous positions
-                    for (uint32_t i = 0; i < cell_count; ++i) {
-                        const size_t dst_offset = sinfo.idxs[0][i] * v_size_row;
-                        io.read_tensor(v, dst_offset, v_size_row);
-                    }
-                }
+                read_cells(v, 0, v_size_row);
             }
         }
     } else {
@@ -2474,21 +2516,8 @@ bool llama_kv_cache::state_read_data(llama_io_read_i & io, uint32_t strm, uint32
             }
 
             if (cell_count) {
-                if (sinfo.is_contiguous()) {
-                    // Fast path: contiguous cells
-                    const uint32_t h = sinfo.head();
-                    for (uint32_t j = 0; j < n_embd_v_gqa; ++j) {
-                        const size_t dst_offset = (h + j * cells.size()) * v_size_el;
-                        io.read_tensor(v, dst_offset, cell_count * v_size_el);
-                    }
-                } else {
-                    // Slow path: scatter to non-contiguous positions
-                    for (uint32_t j = 0; j < n_embd_v_gqa; ++j) {
-                        for (uint32_t i = 0; i < cell_count; ++i) {
-                            const size_t dst_offset = (sinfo.idxs[0][i] + j * cells.size()) * v_size_el;
-                            io.read_tensor(v, dst_offset, v_size_el);
-                        }
-                    }
+                for (uint32_t j = 0; j < n_embd_v_gqa; ++j) {
+                    read_cells(v, (size_t) j * cells.size() * v_size_el, v_size_el);
                 }
             }
         }
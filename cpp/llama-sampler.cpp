@@ -2615,6 +2615,34 @@ struct llama_sampler * llama_sampler_init_grammar(
     return llama_sampler_init_grammar_impl(vocab, grammar_str, grammar_root, /* lazy= */ false, nullptr, 0, nullptr, 0, nullptr, 0);
 }
 
+int32_t llama_sampler_grammar_forced_text(
+        const struct llama_sampler * smpl,
+                              char * buf,
+                           int32_t   len,
+                              bool * complete) {
+    if (complete) {
+        *complete = false;
+    }
+    if (smpl == nullptr || smpl->iface != &llama_sampler_grammar_i || len < 0) {
+        return -1;
+    }
+    const auto * ctx = (const llama_sampler_grammar *) smpl->ctx;
+    if (!ctx->grammar) {
+        return -1;
+    }
+
+    std::string text;
+    bool ends = false;
+    if (!llama_grammar_forced_text(*ctx->grammar, (size_t) len, text, ends)) {
+        return -1;
+    }
+    memcpy(buf, text.data(), text.size());
+    if (complete) {
+        *complete = ends;
+    }
+    return (int32_t) text.size();
+}
+
 struct llama_sampler * llama_sampler_init_grammar_lazy(
         const struct llama_vocab * vocab,
                       const char * grammar_str,
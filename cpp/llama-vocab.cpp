@@ -8,17 +8,22 @@
 #include "unicode.h"
 
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <cctype>
 #include <cfloat>
 #include <cmath>
 #include <cstdarg>
+#include <cstdlib>
 #include <cstring>
 #include <forward_list>
 #include <limits>
+#include <list>
 #include <map>
+#include <mutex>
 #include <queue>
 #include <set>
+#include <string_view>
 #include <unordered_map>
 
 //
@@ -276,6 +281,24 @@ struct llm_bigram_bpe {
     size_t size;
 };
 
+// bigram of the compiled merge path: operands are identified by token id
+struct llm_bigram_bpe_id {
+    struct comparator {
+        bool operator()(const llm_bigram_bpe_id & l, const llm_bigram_bpe_id & r) const {
+            return l.rank > r.rank || (l.rank == r.rank && l.left > r.left);
+        }
+    };
+
+    using queue_storage = std::vector<llm_bigram_bpe_id>;
+    using queue = llama_priority_queue<llm_bigram_bpe_id, queue_storage, comparator>;
+    llm_symbol::index left;
+    llm_symbol::index right;
+    llama_token left_id;
+    llama_token right_id;
+    llama_token merged_id;
+    int rank;
+};
+
 struct llm_tokenizer_bpe : llm_tokenizer {
     llm_tokenizer_bpe(const llama_vocab & vocab) {
         LM_GGML_ASSERT(vocab.get_type() == LLAMA_VOCAB_TYPE_BPE);
@@ -554,8 +577,100 @@ struct llm_tokenizer_bpe : llm_tokenizer {
         }
     }
 
+    // build the integer merge table from the string pair ranks; if any merge
+    // operand or result is not a vocab token, the string path stays in use
+    // (set LLAMA_BPE_NO_FAST_PATH to force the string path and disable the word cache)
+    template <typename ranks_map>
+    void compile_merges(const llama_vocab & vocab, const ranks_map & ranks) {
+        merges_by_id.clear();
+        merges_compiled = false;
+        word_cache_enabled = std::getenv("LLAMA_BPE_NO_FAST_PATH") == nullptr;
+        if (!word_cache_enabled) {
+            return;
+        }
+
+        merges_by_id.reserve(ranks.size());
+        for (const auto & it : ranks) {
+            const llama_token left   = vocab.text_to_token(it.first.first);
+            const llama_token right  = vocab.text_to_token(it.first.second);
+            const llama_token merged = vocab.text_to_token(it.first.first + it.first.second);
+            if (left == LLAMA_TOKEN_NULL || right == LLAMA_TOKEN_NULL || merged == LLAMA_TOKEN_NULL) {
+                LLAMA_LOG_DEBUG("%s: merge '%s %s' is not made of vocab tokens, using string merges\n",
+                        __func__, it.first.first.c_str(), it.first.second.c_str());
+                merges_by_id.clear();
+                return;
+            }
+            merges_by_id.emplace(merge_key(left, right), merge_entry{ it.second, merged });
+        }
+        merges_compiled = true;
+    }
+
+    static uint64_t merge_key(llama_token left, llama_token right) {
+        return ((uint64_t) (uint32_t) left << 32) | (uint32_t) right;
+    }
+
+    // appends the cached tokens of a pre-token word, if present
+    bool word_cache_get(const std::string & word, std::vector<llama_token> & output) const {
+        if (!word_cache_enabled || word.size() > word_cache_max_word_len) {
+            return false;
+        }
+        word_cache_shard & shard = word_cache_shard_for(word);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(word);
+        if (it == shard.index.end()) {
+            return false;
+        }
+        if (it->second != shard.lru.begin()) {
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        }
+        const auto & tokens = it->second->second;
+        output.insert(output.end(), tokens.begin(), tokens.end());
+        return true;
+    }
+
+    void word_cache_put(const std::string & word, const llama_token * tokens, size_t n_tokens) const {
+        if (!word_cache_enabled || word.size() > word_cache_max_word_len) {
+            return;
+        }
+        word_cache_shard & shard = word_cache_shard_for(word);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.index.find(word) != shard.index.end()) {
+            return;
+        }
+        shard.lru.emplace_front(word, std::vector<llama_token>(tokens, tokens + n_tokens));
+        shard.index.emplace(shard.lru.front().first, shard.lru.begin());
+        if (shard.lru.size() > word_cache_max_entries / word_cache_n_shards) {
+            shard.index.erase(shard.lru.back().first);
+            shard.lru.pop_back();
+        }
+    }
+
     std::vector<std::string> regex_exprs;
     bool byte_encode = true; // GPT-2 byte encoding; false for SPM-style BPE (raw UTF-8)
+
+    struct merge_entry {
+        int         rank;
+        llama_token merged;
+    };
+    std::unordered_map<uint64_t, merge_entry> merges_by_id;
+    bool merges_compiled = false;
+
+    // bounded LRU cache: pre-token word -> token ids, sharded by word hash so
+    // concurrent tokenize calls (parallel slots, embeddings) rarely contend
+    static constexpr size_t word_cache_max_entries  = 16384;
+    static constexpr size_t word_cache_max_word_len = 64; // bytes; longer words are rare and not cached
+    static constexpr size_t word_cache_n_shards     = 16;
+    struct word_cache_shard {
+        std::mutex mutex;
+        std::list<std::pair<std::string, std::vector<llama_token>>> lru;
+        std::unordered_map<std::string_view, decltype(lru)::iterator> index;
+    };
+    bool word_cache_enabled = false;
+    mutable std::array<word_cache_shard, word_cache_n_shards> word_cache_shards;
+
+    word_cache_shard & word_cache_shard_for(const std::string & word) const {
+        return word_cache_shards[std::hash<std::string_view>{}(word) % word_cache_n_shards];
+    }
 };
 
 struct llm_tokenizer_bpe_session {
@@ -601,128 +716,200 @@ struct llm_tokenizer_bpe_session {
     }
 
     virtual void tokenize(const std::string & text, std::vector<llama_token> & output) {
-        int final_prev_index = -1;
         const auto word_collection = unicode_regex_split(text, tokenizer.regex_exprs, tokenizer.byte_encode);
 
-        symbols_final.clear();
-        auto tok_pre = vocab.get_pre_type();
-
+        // words are merged independently, so their tokens can be emitted (and cached) word by word
         for (const auto & word : word_collection) {
-            work_queue = llm_bigram_bpe::queue();
-            symbols.clear();
+            if (tokenizer.word_cache_get(word, output)) {
+                continue;
+            }
+            const size_t n_before = output.size();
+            if (tokenizer.merges_compiled) {
+                tokenize_word_ids(word, output);
+            } else {
+                tokenize_word(word, output);
+            }
+            tokenizer.word_cache_put(word, output.data() + n_before, output.size() - n_before);
+        }
+    }
 
-            int index = 0;
-            size_t offset = 0;
+private:
+    // split a word into UTF-8 characters, or keep it whole when it is a token that skips merging
+    void init_symbols(const std::string & word) {
+        symbols.clear();
 
-            //if (vocab.tokenizer_ignore_merges && vocab.token_to_id.find(word) != vocab.token_to_id.end()) {
-            if (vocab.get_ignore_merges() && vocab.text_to_token(word) != LLAMA_TOKEN_NULL) {
+        int index = 0;
+        size_t offset = 0;
+
+        //if (vocab.tokenizer_ignore_merges && vocab.token_to_id.find(word) != vocab.token_to_id.end()) {
+        if (vocab.get_ignore_merges() && vocab.text_to_token(word) != LLAMA_TOKEN_NULL) {
+            symbols.emplace_back(llm_symbol{-1, -1, word.c_str(), word.size()});
+            offset = word.size();
+        } else if (vocab.get_pre_type() == LLAMA_VOCAB_PRE_TYPE_GEMMA4 && word.find_first_not_of('\n') == std::string::npos) {
+            // fix for gemma 4, ref: https://github.com/ggml-org/llama.cpp/pull/21343
+            auto tok = vocab.text_to_token(word);
+            if (tok != LLAMA_TOKEN_NULL) {
                 symbols.emplace_back(llm_symbol{-1, -1, word.c_str(), word.size()});
                 offset = word.size();
-            } else if (tok_pre == LLAMA_VOCAB_PRE_TYPE_GEMMA4 && word.find_first_not_of('\n') == std::string::npos) {
-                // fix for gemma 4, ref: https://github.com/ggml-org/llama.cpp/pull/21343
-                auto tok = vocab.text_to_token(word);
-                if (tok != LLAMA_TOKEN_NULL) {
-                    symbols.emplace_back(llm_symbol{-1, -1, word.c_str(), word.size()});
-                    offset = word.size();
-                }
             }
+        }
+
+        while (offset < word.size()) {
+            llm_symbol sym;
+            size_t char_len = std::min(word.size() - offset, (size_t) unicode_len_utf8(word[offset]));
+            sym.text = word.c_str() + offset;
+            sym.n = char_len;
+            offset += sym.n;
+            sym.prev = index - 1;
+            sym.next = offset == word.size() ? -1 : index + 1;
+            index++;
+            symbols.emplace_back(sym);
+        }
+    }
 
-            while (offset < word.size()) {
-                llm_symbol sym;
-                size_t char_len = std::min(word.size() - offset, (size_t) unicode_len_utf8(word[offset]));
-                sym.text = word.c_str() + offset;
-                sym.n = char_len;
-                offset += sym.n;
-                sym.prev = index - 1;
-                sym.next = offset == word.size() ? -1 : index + 1;
-                index++;
-                symbols.emplace_back(sym);
+    // emit a finished symbol: its token, or its bytes when the text is not a token
+    void append_symbol(const llm_symbol & symbol, llama_token token, std::vector<llama_token> & output) const {
+        if (token != LLAMA_TOKEN_NULL) {
+            output.push_back(token);
+            return;
+        }
+        for (size_t j = 0; j < symbol.n; ++j) {
+            llama_token token_multibyte = LLAMA_TOKEN_NULL;
+            if (tokenizer.byte_encode) {
+                std::string byte_str(1, symbol.text[j]);
+                token_multibyte = vocab.text_to_token(byte_str);
+            } else {
+                // For non-byte-encoded BPE (e.g. gemma-4), byte tokens use <0xXX> format
+                static const char * hex = "0123456789ABCDEF";
+                const uint8_t ch = (uint8_t) symbol.text[j];
+                const char buf[7] = { '<', '0', 'x', hex[ch >> 4], hex[ch & 15], '>', 0 };
+                token_multibyte = vocab.text_to_token(buf);
             }
-            for (int i = 1; i < (int) symbols.size(); ++i) {
-                add_new_bigram(i - 1, i);
+            if (token_multibyte != LLAMA_TOKEN_NULL) {
+                output.push_back(token_multibyte);
             }
+        }
+    }
 
-            // build token(s)
-            while (!work_queue.empty()) {
-                auto bigram = work_queue.pop_move();
+    // merge path on the compiled table: every merge operand is a vocab token,
+    // so a bigram is stale exactly when either operand changed its token id
+    void tokenize_word_ids(const std::string & word, std::vector<llama_token> & output) {
+        init_symbols(word);
+        work_queue_id = llm_bigram_bpe_id::queue();
+        symbol_ids.resize(symbols.size());
+        for (size_t i = 0; i < symbols.size(); ++i) {
+            symbol_ids[i] = vocab.text_to_token(std::string(symbols[i].text, symbols[i].n));
+        }
+        for (int i = 1; i < (int) symbols.size(); ++i) {
+            add_new_bigram_id(i - 1, i);
+        }
 
-                auto & left_symbol = symbols[bigram.left];
-                auto & right_symbol = symbols[bigram.right];
+        while (!work_queue_id.empty()) {
+            const auto bigram = work_queue_id.pop_move();
 
-                if (left_symbol.n == 0 || right_symbol.n == 0) {
-                    continue;
-                }
-                std::string left_token = std::string(left_symbol.text, left_symbol.n);
-                std::string right_token = std::string(right_symbol.text, right_symbol.n);
-                if (left_token + right_token != bigram.text) {
-                    continue;  // Skip this bigram if it's outdated
-                }
+            auto & left_symbol  = symbols[bigram.left];
+            auto & right_symbol = symbols[bigram.right];
 
-                // merge the right sym into the left one
-                left_symbol.n += right_symbol.n;
-                right_symbol.n = 0;
+            if (left_symbol.n == 0 || right_symbol.n == 0 ||
+                symbol_ids[bigram.left] != bigram.left_id || symbol_ids[bigram.right] != bigram.right_id) {
+                continue;  // Skip this bigram if it's outdated
+            }
 
-                // remove the right sym from the chain
-                left_symbol.next = right_symbol.next;
-                if (right_symbol.next >= 0) {
-                    symbols[right_symbol.next].prev = bigram.left;
-                }
+            // merge the right sym into the left one
+            left_symbol.n += right_symbol.n;
+            right_symbol.n = 0;
+            symbol_ids[bigram.left] = bigram.merged_id;
 
-                add_new_bigram(left_symbol.prev, bigram.left);  // left side of current symbol
-                add_new_bigram(bigram.left, left_symbol.next);  // right side of current symbol
+            // remove the right sym from the chain
+            left_symbol.next = right_symbol.next;
+            if (right_symbol.next >= 0) {
+                symbols[right_symbol.next].prev = bigram.left;
             }
 
-            // add the finished tokens to the final list keeping correct order for next and prev
-            for (auto & sym : symbols) {
-                if (sym.n > 0) {
-                    sym.prev = final_prev_index;
-                    sym.next = -1;
-                    if (final_prev_index != -1) {
-                        symbols_final[final_prev_index].next = symbols_final.size();
-                    }
-                    symbols_final.emplace_back(sym);
-                    final_prev_index = symbols_final.size() - 1;
-                }
+            add_new_bigram_id(left_symbol.prev, bigram.left);  // left side of current symbol
+            add_new_bigram_id(bigram.left, left_symbol.next);  // right side of current symbol
+        }
+
+        for (size_t i = 0; i < symbols.size(); ++i) {
+            if (symbols[i].n > 0) {
+                append_symbol(symbols[i], symbol_ids[i], output);
             }
         }
+    }
 
-        symbols = symbols_final;
+    void add_new_bigram_id(int left, int right) {
+        if (left == -1 || right == -1) {
+            return;
+        }
+        const llama_token left_id  = symbol_ids[left];
+        const llama_token right_id = symbol_ids[right];
+        if (left_id == LLAMA_TOKEN_NULL || right_id == LLAMA_TOKEN_NULL) {
+            return;
+        }
+        const auto it = tokenizer.merges_by_id.find(llm_tokenizer_bpe::merge_key(left_id, right_id));
+        if (it == tokenizer.merges_by_id.end()) {
+            return;
+        }
 
-        if (!symbols.empty()) {
-            for (int i = 0; i != -1; i = symbols[i].next) {
-                auto & symbol = symbols[i];
-                if (symbol.n == 0) {
-                    continue;
-                }
+        llm_bigram_bpe_id bigram;
 
-                const std::string str = std::string(symbol.text, symbol.n);
-                const auto token = vocab.text_to_token(str);
+        bigram.left      = left;
+        bigram.right     = right;
+        bigram.left_id   = left_id;
+        bigram.right_id  = right_id;
+        bigram.merged_id = it->second.merged;
+        bigram.rank      = it->second.rank;
 
-                if (token == LLAMA_TOKEN_NULL) {
-                    for (auto j = str.begin(); j != str.end(); ++j) {
-                        llama_token token_multibyte = LLAMA_TOKEN_NULL;
-                        if (tokenizer.byte_encode) {
-                            std::string byte_str(1, *j);
-                            token_multibyte = vocab.text_to_token(byte_str);
-                        } else {
-                            // For non-byte-encoded BPE (e.g. gemma-4), byte tokens use <0xXX> format
-                            static const char * hex = "0123456789ABCDEF";
-                            const uint8_t ch = (uint8_t)*j;
-                            const char buf[7] = { '<', '0', 'x', hex[ch >> 4], hex[ch & 15], '>', 0 };
-                            token_multibyte = vocab.text_to_token(buf);
-                        }
-                        if (token_multibyte != LLAMA_TOKEN_NULL) {
-                            output.push_back(token_multibyte);
-                        }
-                    }
-                } else {
-                    output.push_back(token);
-                }
+        work_queue_id.push(bigram);
+    }
+
+    // merge path on string pairs, used when the merge table could not be compiled
+    void tokenize_word(const std::string & word, std::vector<llama_token> & output) {
+        init_symbols(word);
+        work_queue = llm_bigram_bpe::queue();
+
+        for (int i = 1; i < (int) symbols.size(); ++i) {
+            add_new_bigram(i - 1, i);
+        }
+
+        // build token(s)
+        while (!work_queue.empty()) {
+            auto bigram = work_queue.pop_move();
+
+            auto & left_symbol = symbols[bigram.left];
+            auto & right_symbol = symbols[bigram.right];
+
+            if (left_symbol.n == 0 || right_symbol.n == 0) {
+                continue;
+            }
+            std::string left_token = std::string(left_symbol.text, left_symbol.n);
+            std::string right_token = std::string(right_symbol.text, right_symbol.n);
+            if (left_token + right_token != bigram.text) {
+                continue;  // Skip this bigram if it's outdated
+            }
+
+            // merge the right sym into the left one
+            left_symbol.n += right_symbol.n;
+            right_symbol.n = 0;
+
+            // remove the right sym from the chain
+            left_symbol.next = right_symbol.next;
+            if (right_symbol.next >= 0) {
+                symbols[right_symbol.next].prev = bigram.left;
+            }
+
+            add_new_bigram(left_symbol.prev, bigram.left);  // left side of current symbol
+            add_new_bigram(bigram.left, left_symbol.next);  // right side of current symbol
+        }
+
+        // emit the finished tokens in order
+        for (const auto & sym : symbols) {
+            if (sym.n > 0) {
+                append_symbol(sym, vocab.text_to_token(std::string(sym.text, sym.n)), output);
             }
         }
     }
 
-private:
     void add_new_bigram(int left, int right) {
         if (left == -1 || right == -1) {
             return;
@@ -753,8 +940,9 @@ private:
     const llm_tokenizer_bpe & tokenizer;
 
     std::vector<llm_symbol> symbols;
-    std::vector<llm_symbol> symbols_final;
+    std::vector<llama_token> symbol_ids;
     llm_bigram_bpe::queue work_queue;
+    llm_bigram_bpe_id::queue work_queue_id;
 };
 
 //
@@ -3135,8 +3323,11 @@ void llama_vocab::impl::init_tokenizer(enum llama_vocab_type type) {
             tokenizer = std::make_unique<llm_tokenizer_spm>(vocab);
             break;
         case LLAMA_VOCAB_TYPE_BPE:
-            tokenizer = std::make_unique<llm_tokenizer_bpe>(vocab);
-            break;
+            {
+                auto tokenizer_bpe = std::make_unique<llm_tokenizer_bpe>(vocab);
+                tokenizer_bpe->compile_merges(vocab, bpe_ranks);
+                tokenizer = std::move(tokenizer_bpe);
+            } break;
         case LLAMA_VOCAB_TYPE_WPM:
             tokenizer = std::make_unique<llm_tokenizer_wpm>(vocab);
             break;
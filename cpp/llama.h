@@ -703,6 +703,17 @@ extern "C" {
             size_t n_adapters,
             float * scales);
 
+    // Set LoRa adapters for one sequence only, on top of the context-wide ones. Tokens of
+    // different sequences can use different adapters within the same llama_decode call;
+    // a token in several sequences uses the adapters of its first one.
+    // Pass n_adapters = 0 to clear the sequence's adapters.
+    LLAMA_API int32_t llama_set_adapters_lora_seq(
+            struct llama_context * ctx,
+            llama_seq_id seq_id,
+            struct llama_adapter_lora ** adapters,
+            size_t n_adapters,
+            float * scales);
+
     // Apply a loaded control vector to a llama_context, or if data is NULL, clear
     // the currently loaded vector.
     // n_embd should be the size of a single layer's control, and data should point
@@ -889,6 +900,19 @@ extern "C" {
                           size_t   n_token_capacity,
                           size_t * n_token_count_out);
 
+    // Like llama_state_seq_load_file, but restores only positions [0, n_pos) (n_pos < 0: all)
+    // and cuts the token list to match. The file is memory-mapped where supported and the
+    // KV data of the positions past n_pos is skipped, never read. Memories that cannot be
+    // truncated (recurrent state) are restored whole.
+    LLAMA_API size_t llama_state_seq_load_file_prefix(
+            struct llama_context * ctx,
+                      const char * filepath,
+                    llama_seq_id   dest_seq_id,
+                         int32_t   n_pos,
+                     llama_token * tokens_out,
+                          size_t   n_token_capacity,
+                          size_t * n_token_count_out);
+
 #define LLAMA_STATE_SEQ_FLAGS_NONE 0
 
 // for backwards-compat
@@ -1399,6 +1423,18 @@ extern "C" {
                           const char * grammar_str,
                           const char * grammar_root);
 
+    /// @details Text the grammar of a grammar sampler pins next (jump-forward): the characters
+    /// every continuation starts with, read from its parse stack while it has a single path.
+    /// @param buf Receives up to len bytes of the text (whole UTF-8 code points, not NUL-terminated).
+    /// @param complete Set when the text runs to the end of the grammar.
+    /// @return The number of bytes written, or -1 if smpl is not a grammar sampler, its grammar is
+    /// inactive, awaits a trigger or has several parse paths.
+    LLAMA_API int32_t llama_sampler_grammar_forced_text(
+            const struct llama_sampler * smpl,
+                                  char * buf,
+                               int32_t   len,
+                                  bool * complete);
+
     DEPRECATED(LLAMA_API struct llama_sampler * llama_sampler_init_grammar_lazy(
             const struct llama_vocab * vocab,
                           const char * grammar_str,
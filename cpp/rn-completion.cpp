@@ -33,6 +33,8 @@ llama_rn_context_completion::~llama_rn_context_completion() {
 
 void llama_rn_context_completion::rewind() {
     resetSpeculative();
+    jump_pending_tokens.clear();
+    jump_forward_batch = false;
     is_interrupted = false;
     parent_ctx->params.antiprompt.clear();
     parent_ctx->params.sampling.grammar = {};
@@ -98,6 +100,12 @@ void llama_rn_context_completion::probeStateCache() {
     } else if (parent_ctx->state_cache_max_checkpoints == 0) {
         state_cache_max_checkpoints = std::numeric_limits<size_t>::max();
     }
+    state_cache_hot_bytes = parent_ctx->state_cache_hot_bytes > 0
+        ? std::min(parent_ctx->state_cache_hot_bytes, state_cache_budget_bytes)
+        : state_cache_budget_bytes / 2;
+    state_cache_dir = parent_ctx->state_cache_dir;
+    state_cache_disk_bytes = state_cache_dir.empty() ? 0 : parent_ctx->state_cache_disk_bytes;
+    state_cache_disk_failed = false;
 
     const llama_model *model = parent_ctx->model;
     if (model == nullptr || state_cache_budget_bytes == 0) {
@@ -118,11 +126,19 @@ void llama_rn_context_completion::probeStateCache() {
 }
 
 void llama_rn_context_completion::evictStateCheckpoints() {
-    // Oldest first, but always keep the smallest-position snapshot: that is the
-    // first message boundary (system-prompt end) a brand-new session shares.
-    auto total_bytes = [&]() {
+    // Oldest first: pack hot snapshots past the hot share (the newest, next
+    // turn's likely restore, stays raw), move RAM past the budget to disk, then
+    // drop. The smallest-position snapshot is never dropped: that is the first
+    // message boundary (system-prompt end) a brand-new session shares.
+    // Packing runs off the decode thread; a pack only blocks it when the RAM
+    // budget cannot be met without the packed sizes.
+    auto bytes_in = [&](bool on_disk) {
         size_t n = 0;
-        for (const auto &c : state_checkpoints) n += c.size_bytes();
+        for (const auto &c : state_checkpoints) {
+            if ((c.tier == RN_STATE_TIER_DISK) == on_disk) {
+                n += on_disk ? c.disk_size : c.size_bytes();
+            }
+        }
         return n;
     };
     auto smallest_pos = [&]() {
@@ -132,24 +148,95 @@ void llama_rn_context_completion::evictStateCheckpoints() {
         }
         return idx;
     };
+    auto erase_at = [&](size_t i) {
+        checkpoint_index.remove(RN_PREFIX_CHECKPOINT, (int32_t) state_checkpoints[i].n_tokens());
+        state_checkpoints.erase(state_checkpoints.begin() + i);
+    };
+
+    size_t hot_bytes = 0;
+    for (auto &c : state_checkpoints) {
+        c.finish_compress(false);
+        // A snapshot being packed no longer counts toward the hot share
+        if (c.tier == RN_STATE_TIER_HOT && !c.compress_pending()) hot_bytes += c.size_bytes();
+    }
+    for (size_t i = 0; i + 1 < state_checkpoints.size() && hot_bytes > state_cache_hot_bytes; i++) {
+        const size_t raw = state_checkpoints[i].size_bytes();
+        if (state_checkpoints[i].compress_async()) {
+            hot_bytes -= raw;
+        }
+    }
+
+    while (state_checkpoints.size() > 1 && bytes_in(false) > state_cache_budget_bytes) {
+        bool waited = false;
+        for (auto &c : state_checkpoints) {
+            if (c.compress_pending()) {
+                c.finish_compress(true);
+                waited = true;
+            }
+        }
+        if (waited) {
+            continue;
+        }
+        const size_t keep = smallest_pos();
+        size_t victim = state_checkpoints.size();
+        bool spilled = false;
+        for (size_t i = 0; i < state_checkpoints.size() && !spilled; i++) {
+            auto &c = state_checkpoints[i];
+            if (c.tier == RN_STATE_TIER_DISK) {
+                continue;
+            }
+            if (!state_cache_disk_failed && c.size_bytes() <= state_cache_disk_bytes) {
+                spilled = c.spill(state_cache_dir);
+                if (!spilled) {
+                    LOG_WARNING("state checkpoint spill to %s failed, disk tier disabled",
+                        state_cache_dir.c_str());
+                    state_cache_disk_failed = true;
+                }
+            }
+            if (!spilled && i != keep && victim == state_checkpoints.size()) {
+                victim = i;
+            }
+        }
+        if (spilled) {
+            continue;
+        }
+        if (victim == state_checkpoints.size()) {
+            break;
+        }
+        erase_at(victim);
+    }
+
     while (state_checkpoints.size() > 1 &&
            (state_checkpoints.size() > state_cache_max_checkpoints ||
-            total_bytes() > state_cache_budget_bytes)) {
+            bytes_in(true) > state_cache_disk_bytes)) {
         const size_t keep = smallest_pos();
-        // Evict the oldest snapshot that is not the pinned stable-prefix one.
-        size_t victim = (keep == 0 && state_checkpoints.size() > 1) ? 1 : 0;
-        state_checkpoints.erase(state_checkpoints.begin() + victim);
+        // Over the count: the oldest of any tier; over the disk budget: the
+        // oldest spilled one.
+        const bool over_count = state_checkpoints.size() > state_cache_max_checkpoints;
+        size_t victim = state_checkpoints.size();
+        for (size_t i = 0; i < state_checkpoints.size(); i++) {
+            if (i != keep && (over_count || state_checkpoints[i].tier == RN_STATE_TIER_DISK)) {
+                victim = i;
+                break;
+            }
+        }
+        if (victim == state_checkpoints.size()) {
+            break;
+        }
+        erase_at(victim);
     }
 }
 
 void llama_rn_context_completion::clearStateCheckpoints() {
     state_checkpoints.clear();
+    checkpoint_index.clear();
     // Boundary positions index into the current prompt; invalidated together.
     boundary_ckpts.clear();
     prompt_checkpoint_pending = false;
 }
 
 void llama_rn_context_completion::eraseStateCheckpointAt(size_t n_tokens) {
+    checkpoint_index.remove(RN_PREFIX_CHECKPOINT, (int32_t) n_tokens);
     state_checkpoints.erase(
         std::remove_if(state_checkpoints.begin(), state_checkpoints.end(),
             [&](const rn_state_checkpoint &c) { return c.n_tokens() == n_tokens; }),
@@ -160,7 +247,13 @@ void llama_rn_context_completion::eraseStateCheckpointsAfter(size_t n_tokens) {
     const size_t old_size = state_checkpoints.size();
     state_checkpoints.erase(
         std::remove_if(state_checkpoints.begin(), state_checkpoints.end(),
-            [&](const rn_state_checkpoint &c) { return c.n_tokens() > n_tokens; }),
+            [&](const rn_state_checkpoint &c) {
+                if (c.n_tokens() <= n_tokens) {
+                    return false;
+                }
+                checkpoint_index.remove(RN_PREFIX_CHECKPOINT, (int32_t) c.n_tokens());
+                return true;
+            }),
         state_checkpoints.end());
     if (state_checkpoints.size() != old_size) {
         LOG_VERBOSE("invalidated %zu state checkpoint(s) after position %zu",
@@ -185,11 +278,8 @@ void llama_rn_context_completion::captureStateCheckpoint(
         return;
     }
     // Already hold this exact snapshot (e.g. just restored): skip the readback.
-    for (const auto &c : state_checkpoints) {
-        if (c.n_tokens() == n &&
-            std::equal(c.tokens.begin(), c.tokens.end(), seq.begin())) {
-            return;
-        }
+    if (checkpoint_index.find_longest_entry(RN_PREFIX_CHECKPOINT, seq, n).n_match == n) {
+        return;
     }
 
     const size_t size = llama_state_seq_get_size_ext(
@@ -218,7 +308,7 @@ void llama_rn_context_completion::captureStateCheckpoint(
     }
 
     rn_state_checkpoint ckpt;
-    ckpt.tokens.assign(seq.begin(), seq.begin() + n);
+    ckpt.n = n;
     try {
         ckpt.data.resize(size);
     } catch (const std::bad_alloc &) {
@@ -237,10 +327,12 @@ void llama_rn_context_completion::captureStateCheckpoint(
         return;
     }
     ckpt.data.resize(written);
+    ckpt.raw_size = written;
 
     // Replace any snapshot at this boundary only after a successful capture
     // (a stale same-length one would shadow the current tokens).
     eraseStateCheckpointAt(n);
+    checkpoint_index.insert(RN_PREFIX_CHECKPOINT, (int32_t) n, seq.data(), n);
     state_checkpoints.push_back(std::move(ckpt));
     evictStateCheckpoints();
     LOG_VERBOSE("captured state checkpoint: n_tokens=%zu, size=%.1f KiB, total=%zu",
@@ -251,23 +343,17 @@ int llama_rn_context_completion::findStateCheckpoint(
         const std::vector<llama_token> &target, size_t max_len) const {
     // Pick the longest snapshot whose tokens are a prefix of `target` and whose
     // length does not exceed `max_len` (the verified shared-prefix length).
-    int best = -1;
-    size_t best_len = 0;
+    const rn_prefix_match match =
+        checkpoint_index.find_longest_entry(RN_PREFIX_CHECKPOINT, target, max_len);
+    if (match.key <= 0) {
+        return -1;
+    }
     for (size_t i = 0; i < state_checkpoints.size(); i++) {
-        const auto &c = state_checkpoints[i];
-        const size_t n = c.n_tokens();
-        if (n == 0 || n > max_len || n > target.size()) {
-            continue;
-        }
-        if (n <= best_len) {
-            continue; // can't beat the current best
-        }
-        if (std::equal(c.tokens.begin(), c.tokens.end(), target.begin())) {
-            best = (int) i;
-            best_len = n;
+        if (state_checkpoints[i].n_tokens() == (size_t) match.key) {
+            return (int) i;
         }
     }
-    return best;
+    return -1;
 }
 
 bool llama_rn_context_completion::recoverStateCheckpoint(
@@ -298,8 +384,13 @@ bool llama_rn_context_completion::restoreStateCheckpoint(size_t index) {
         return false;
     }
     const auto &c = state_checkpoints[index];
+    rn_state_reader reader;
+    if (!reader.open(c)) {
+        LOG_WARNING("state checkpoint unreadable (n_tokens=%zu, tier=%d)", c.n_tokens(), (int) c.tier);
+        return false;
+    }
     const size_t read = llama_state_seq_set_data_ext(
-        parent_ctx->ctx, c.data.data(), c.data.size(), /*dest_seq_id*/ 0,
+        parent_ctx->ctx, reader.data(), reader.size(), /*dest_seq_id*/ 0,
         LLAMA_STATE_SEQ_FLAGS_PARTIAL_ONLY);
     if (read == 0) {
         LOG_WARNING("state checkpoint restore failed (n_tokens=%zu)", c.n_tokens());
@@ -402,7 +493,8 @@ void llama_rn_context_completion::loadPrompt(const std::vector<std::string> &med
         }
 
         // Text-only path - use modified tokenization for encoder-decoder models
-        text_tokens = ::common_tokenize(parent_ctx->ctx, parent_ctx->params.prompt, add_bos || is_enc_dec, true);
+        text_tokens = tokenize_parallel(vocab, parent_ctx->params.prompt, add_bos || is_enc_dec, true,
+            parent_ctx->params.cpuparams.n_threads, parent_ctx->vocab_word_local);
         num_prompt_tokens = text_tokens.size();
 
         // LOG tokens
@@ -607,6 +699,7 @@ void llama_rn_context_completion::beginCompletion(int chat_format, common_reason
     current_reasoning_format = reasoning_format;
     current_generation_prompt = generation_prompt;
     current_chat_parser = chat_parser;
+    chat_parse_state.reset();
 }
 
 void llama_rn_context_completion::endCompletion() {
@@ -951,6 +1044,18 @@ completion_token_output llama_rn_context_completion::nextToken()
     completion_token_output result;
     result.tok = -1;
 
+    // Grammar-forced tokens queued by the last sample; they decode with the
+    // next batch, so hand them out without a decode.
+    if (!jump_pending_tokens.empty()) {
+        result = std::move(jump_pending_tokens.front());
+        jump_pending_tokens.pop_front();
+        --n_remain;
+        num_tokens_predicted++;
+        updateGenerationTiming();
+        has_next_token = parent_ctx->params.n_predict == -1 || n_remain != 0;
+        return result;
+    }
+
     if (embd.size() >= (size_t)parent_ctx->params.n_ctx)
     {
         if (!parent_ctx->params.ctx_shift) {
@@ -1326,7 +1431,7 @@ completion_token_output llama_rn_context_completion::nextToken()
             }
         }
         int n_eval = (int)(decode_to - n_past);
-        tg = ((int) embd.size() - n_past) == 1;
+        tg = ((int) embd.size() - n_past) == 1 || jump_forward_batch;
         if (n_eval > parent_ctx->params.n_batch)
         {
             n_eval = parent_ctx->params.n_batch;
@@ -1666,6 +1771,31 @@ completion_token_output llama_rn_context_completion::nextToken()
     --n_remain;
 
     has_next_token = parent_ctx->params.n_predict == -1 || n_remain != 0;
+    jump_forward_batch = false;
+
+    // Jump-forward: when the grammar pins the next tokens (JSON keys, tool-call
+    // wrappers), accept them now and decode them with this token in one batch.
+    if (has_next_token && parent_ctx->params.sampling.jump_forward &&
+        !parent_ctx->params.embedding && !parent_ctx->isVocoderEnabled()) {
+        int32_t max_forced = std::min(
+            parent_ctx->params.n_batch - 1,
+            parent_ctx->params.n_ctx - (int32_t) embd.size() - 1);
+        if (parent_ctx->params.n_predict != -1) {
+            max_forced = std::min(max_forced, (int32_t) n_remain);
+        }
+        const int32_t n_probs = parent_ctx->params.sampling.n_probs;
+        for (const llama_token tok : sample_forced_tokens(ctx_sampling, vocab, max_forced)) {
+            completion_token_output forced;
+            forced.tok = tok;
+            forced.text = common_token_to_piece(parent_ctx->ctx, tok);
+            if (n_probs > 0) {
+                forced.probs.push_back({tok, 1.0f});
+            }
+            embd.push_back(tok);
+            jump_pending_tokens.push_back(std::move(forced));
+        }
+        jump_forward_batch = !jump_pending_tokens.empty();
+    }
     return result;
 }
 
@@ -1714,6 +1844,7 @@ completion_token_output llama_rn_context_completion::doCompletion()
             parent_ctx->tts_wrapper->type = type;
         }
         parent_ctx->tts_wrapper->tryAddAudioToken(parent_ctx, token_with_probs.tok, token_text);
+        parent_ctx->tts_wrapper->pumpAudioStream(parent_ctx);
     }
 
     if (parent_ctx->params.sampling.n_probs > 0)
@@ -1748,30 +1879,89 @@ completion_token_output llama_rn_context_completion::doCompletion()
     return token_with_probs;
 }
 
-completion_chat_output llama_rn_context_completion::parseChatOutput(bool is_partial) {
-    common_chat_parser_params syntax;
-    syntax.format = static_cast<common_chat_format>(current_chat_format);
-    syntax.reasoning_format = current_reasoning_format;
-    syntax.generation_prompt = current_generation_prompt;
-    syntax.parse_tool_calls = true;
-
-    // Load the PEG parser if available (required for COMMON_CHAT_FORMAT_PEG_* formats)
-    if (!current_chat_parser.empty()) {
-        syntax.parser.load(current_chat_parser);
+// Suffix of `now` past `prev`; all of `now`, flagged as a replacement, when
+// `prev` is not its prefix
+static std::string chat_field_delta(const std::string &prev, const std::string &now, bool &replaced) {
+    replaced = false;
+    if (now.size() >= prev.size() && now.compare(0, prev.size(), prev) == 0) {
+        return now.substr(prev.size());
     }
+    replaced = true;
+    return now;
+}
 
-    common_chat_msg parsed_msg = common_chat_parse(prefill_text + generated_text, is_partial, syntax);
-
-    completion_chat_output result;
+void rn_chat_parse_state::reset() {
+    has_syntax = false;
+    parser_src.clear();
+    generation_prompt_src.clear();
+    syntax = common_chat_parser_params();
+    has_last = false;
+    last_text.clear();
+    last_msg = common_chat_msg();
+    scan_memo.clear();
+}
 
-    result.content = parsed_msg.content;
-    result.reasoning_content = parsed_msg.reasoning_content;
-    result.accumulated_text = prefill_text + generated_text;
-    result.tool_calls = parsed_msg.tool_calls;
+completion_chat_output rn_chat_parse_state::parse(
+        const std::string &text, bool is_partial,
+        int chat_format, common_reasoning_format reasoning_format,
+        const std::string &generation_prompt, const std::string &chat_parser) {
+    if (!has_syntax || format != chat_format || reasoning != reasoning_format ||
+        generation_prompt_src != generation_prompt || parser_src != chat_parser) {
+        reset();
+        syntax.format = static_cast<common_chat_format>(chat_format);
+        syntax.reasoning_format = reasoning_format;
+        syntax.generation_prompt = generation_prompt;
+        syntax.parse_tool_calls = true;
+        // Load the PEG parser if available (required for COMMON_CHAT_FORMAT_PEG_* formats)
+        if (!chat_parser.empty()) {
+            syntax.parser.load(chat_parser);
+        }
+        format = chat_format;
+        reasoning = reasoning_format;
+        generation_prompt_src = generation_prompt;
+        parser_src = chat_parser;
+        has_syntax = true;
+    }
+
+    const common_chat_msg prev_msg = has_last ? last_msg : common_chat_msg();
+    if (!has_last || last_partial != is_partial || last_text != text) {
+        // The content-only parser passes the text through untouched
+        if (syntax.parser.empty() && syntax.generation_prompt.empty() &&
+            syntax.format == COMMON_CHAT_FORMAT_CONTENT_ONLY) {
+            last_msg = common_chat_msg();
+            last_msg.role = "assistant";
+            last_msg.content = text;
+        } else {
+            // Scan positions only carry over while the text grows by appending
+            if (!has_last || text.size() < last_text.size() ||
+                text.compare(0, last_text.size(), last_text) != 0) {
+                scan_memo.clear();
+            }
+            syntax.scan_memo = &scan_memo;
+            last_msg = common_chat_parse(text, is_partial, syntax);
+        }
+        last_text = text;
+        last_partial = is_partial;
+        has_last = true;
+    }
 
+    completion_chat_output result;
+    result.content = last_msg.content;
+    result.reasoning_content = last_msg.reasoning_content;
+    result.accumulated_text = text;
+    result.tool_calls = last_msg.tool_calls;
+    result.content_delta = chat_field_delta(prev_msg.content, last_msg.content, result.content_replaced);
+    result.reasoning_content_delta = chat_field_delta(
+        prev_msg.reasoning_content, last_msg.reasoning_content, result.reasoning_content_replaced);
     return result;
 }
 
+completion_chat_output llama_rn_context_completion::parseChatOutput(bool is_partial) {
+    return chat_parse_state.parse(prefill_text + generated_text, is_partial,
+                                  current_chat_format, current_reasoning_format,
+                                  current_generation_prompt, current_chat_parser);
+}
+
 std::vector<float> llama_rn_context_completion::embedding(common_params &embd_params)
 {
     llama_memory_clear(llama_get_memory(parent_ctx->ctx), true);
@@ -1809,10 +1999,48 @@ std::vector<float> llama_rn_context_completion::embedding(common_params &embd_pa
     return out;
 }
 
-std::vector<float> llama_rn_context_completion::rerank(const std::string &query, const std::vector<std::string> &documents)
+std::vector<float> llama_rn_context_completion::embeddingBatch(const std::vector<std::string> &texts, int embd_normalize)
 {
-    std::vector<float> scores;
+    if (!parent_ctx->params.embedding) {
+        throw std::runtime_error("embedding disabled");
+    }
+
+    const int n_embd = llama_model_n_embd(parent_ctx->model);
+    std::vector<float> out(texts.size() * n_embd, 0.0f);
+    if (texts.empty()) {
+        return out;
+    }
+
+    // Per-token embeddings have no per-sequence output to pack; keep the
+    // single-input path and its semantics
+    if (llama_pooling_type(parent_ctx->ctx) == LLAMA_POOLING_TYPE_NONE) {
+        common_params embd_params = parent_ctx->params;
+        embd_params.embd_normalize = embd_normalize;
+        for (size_t i = 0; i < texts.size(); ++i) {
+            parent_ctx->params.prompt = texts[i];
+            const std::vector<float> e = embedding(embd_params);
+            std::copy(e.begin(), e.end(), out.begin() + i * n_embd);
+        }
+        return out;
+    }
+
+    const llama_vocab * vocab = llama_model_get_vocab(parent_ctx->model);
+    const bool add_bos = llama_vocab_get_add_bos(vocab) || llama_model_has_encoder(parent_ctx->model);
+    const std::vector<std::vector<llama_token>> inputs =
+        tokenize_batch(vocab, texts, add_bos, true, parent_ctx->params.cpuparams.n_threads, parent_ctx->vocab_word_local);
+
+    decodePooledSequences(inputs, 0, [&](size_t i, const float * data) {
+        if (data) {
+            common_embd_normalize(data, out.data() + i * n_embd, n_embd, embd_normalize);
+        } else {
+            LOG_WARNING("embedding computation failed for input %zu", i);
+        }
+    });
+    return out;
+}
 
+std::vector<float> llama_rn_context_completion::rerank(const std::string &query, const std::vector<std::string> &documents)
+{
     // Check if this model supports reranking (requires rank pooling type)
     const enum llama_pooling_type pooling_type = llama_pooling_type(parent_ctx->ctx);
     if (pooling_type != LLAMA_POOLING_TYPE_RANK) {
@@ -1823,49 +2051,141 @@ std::vector<float> llama_rn_context_completion::rerank(const std::string &query,
         throw std::runtime_error("embedding disabled but required for reranking");
     }
 
-    const llama_vocab * vocab = llama_model_get_vocab(parent_ctx->model);
-    std::vector<llama_token> query_tokens = common_tokenize(vocab, query, false, true);
+    std::vector<float> scores(documents.size(), -1e6f); // Default low score if computation failed
+    if (documents.empty()) {
+        return scores;
+    }
 
-    scores.reserve(documents.size());
+    const std::vector<std::vector<llama_token>> inputs =
+        tokenize_rerank_inputs(parent_ctx->ctx, query, documents);
 
-    for (size_t i = 0; i < documents.size(); ++i) {
-        rewind();
-        embd = {};
+    size_t n_prefix = 0;
+    if (inputs.size() > 1 && model_rerank_shares_prefix(parent_ctx->model)) {
+        n_prefix = inputs[0].size();
+        for (const auto & tokens : inputs) {
+            n_prefix = std::min(n_prefix, find_common_prefix_length(inputs[0], tokens));
+            // Each document keeps at least its last token to pool from
+            n_prefix = std::min(n_prefix, tokens.empty() ? 0 : tokens.size() - 1);
+        }
+    }
 
-        const std::string & document = documents[i];
+    decodePooledSequences(inputs, n_prefix, [&](size_t i, const float * data) {
+        if (data) {
+            scores[i] = data[0]; // For rank pooling, the score is the first (and only) dimension
+        } else {
+            LOG_WARNING("rerank computation failed for document %zu", i);
+        }
+    });
+    return scores;
+}
 
-        std::vector<llama_token> doc_tokens = common_tokenize(vocab, document, false, true);
+void llama_rn_context_completion::decodePooledSequences(
+    const std::vector<std::vector<llama_token>> &inputs,
+    size_t n_prefix,
+    const std::function<void(size_t, const float *)> &on_output
+) {
+    rewind();
+    embd = {};
+    llama_perf_context_reset(parent_ctx->ctx);
+    is_predicting = true;
 
-        std::vector<llama_token> rerank_tokens = format_rerank_tokens(vocab, query_tokens, doc_tokens);
+    llama_context * ctx = parent_ctx->ctx;
+    llama_memory_t mem = llama_get_memory(ctx);
+    const llama_model * model = parent_ctx->model;
 
-        llama_memory_clear(llama_get_memory(parent_ctx->ctx), false);
+    // Pooled outputs come from one decode, so without a KV memory (or with
+    // non-causal attention) a sequence can't be split across ubatches
+    const bool causal = mem != nullptr && model->hparams.causal_attn;
+    const int32_t n_budget = (int32_t) (causal ? llama_n_batch(ctx) : llama_n_ubatch(ctx));
+    const int32_t n_seq = std::max<int32_t>(1, (int32_t) llama_n_seq_max(ctx));
 
-        // Process the rerank input
-        try {
-            parent_ctx->params.prompt = tokens_to_str(parent_ctx->ctx, rerank_tokens.begin(), rerank_tokens.end());
-            initSampling();
-            loadPrompt({}, /*allow_state_cache*/ false); // No media paths for rerank
-            beginCompletion();
-            doCompletion();
+    // The prefix lives on seq 0 and is forked into the other sequences (a
+    // metadata-only copy within a unified KV)
+    if (!causal || !parent_ctx->params.kv_unified) {
+        n_prefix = 0;
+    }
 
-            // Get the rerank score (single embedding value for rank pooling)
-            float *data = llama_get_embeddings_seq(parent_ctx->ctx, 0);
-            if (data) {
-                scores.push_back(data[0]); // For rank pooling, the score is the first (and only) dimension
-            } else {
-                scores.push_back(-1e6f); // Default low score if computation failed
+    if (mem) {
+        llama_memory_clear(mem, false);
+    }
+
+    llama_batch batch = llama_batch_init(n_budget, 0, 1);
+
+    // Decode tokens[from, to) of one sequence, in n_budget chunks
+    auto decode_range = [&](const std::vector<llama_token> & tokens, size_t from, size_t to, llama_seq_id seq) {
+        for (size_t i = from; i < to; i += n_budget) {
+            common_batch_clear(batch);
+            const size_t end = std::min(to, i + (size_t) n_budget);
+            for (size_t j = i; j < end; ++j) {
+                common_batch_add(batch, tokens[j], (llama_pos) j, { seq }, true);
+            }
+            if (llama_decode(ctx, batch) != 0) {
+                return false;
             }
-        } catch (const std::exception &e) {
-            LOG_WARNING("rerank computation failed for document %zu: %s", i, e.what());
-            scores.push_back(-1e6f);
         }
-        endCompletion();
+        return true;
+    };
 
-        // Clear KV cache again to prepare for next document or restore original state
-        llama_memory_clear(llama_get_memory(parent_ctx->ctx), false);
+    if (n_prefix > 0 && !decode_range(inputs[0], 0, n_prefix, 0)) {
+        LOG_WARNING("failed to decode the shared prefix, decoding inputs in full");
+        llama_memory_clear(mem, false);
+        n_prefix = 0;
+    }
+    const llama_seq_id first_seq = (n_prefix > 0 && n_seq > 1) ? 1 : 0;
+
+    size_t next = 0;
+    while (next < inputs.size() && !is_interrupted) {
+        // Pack as many inputs as fit in one decode, one sequence each
+        common_batch_clear(batch);
+        std::vector<std::pair<size_t, llama_seq_id>> packed;
+        for (llama_seq_id seq = first_seq; seq < n_seq && next < inputs.size(); ++seq) {
+            const auto & tokens = inputs[next];
+            const size_t n_tail = tokens.size() - n_prefix;
+            if (batch.n_tokens + n_tail > (size_t) n_budget) {
+                break;
+            }
+            if (n_prefix > 0 && seq != 0) {
+                llama_memory_seq_cp(mem, 0, seq, -1, -1);
+            }
+            for (size_t j = n_prefix; j < tokens.size(); ++j) {
+                common_batch_add(batch, tokens[j], (llama_pos) j, { seq }, true);
+            }
+            packed.emplace_back(next++, seq);
+        }
+
+        bool ok;
+        if (packed.empty()) {
+            // A single input longer than one decode: only a causal sequence
+            // can be fed in chunks
+            if (n_prefix > 0 && first_seq != 0) {
+                llama_memory_seq_cp(mem, 0, first_seq, -1, -1);
+            }
+            packed.emplace_back(next, first_seq);
+            ok = causal && decode_range(inputs[next], n_prefix, inputs[next].size(), first_seq);
+            if (!causal) {
+                LOG_WARNING("input %zu (%zu tokens) exceeds n_ubatch %d", next, inputs[next].size(), n_budget);
+            }
+            next++;
+        } else {
+            ok = llama_decode(ctx, batch) == 0;
+        }
+
+        for (const auto & p : packed) {
+            on_output(p.first, ok ? llama_get_embeddings_seq(ctx, p.second) : nullptr);
+            // Drop the input, keeping the shared prefix on seq 0
+            if (mem) {
+                llama_memory_seq_rm(mem, p.second, p.second == 0 ? (llama_pos) n_prefix : 0, -1);
+            }
+        }
     }
 
-    return scores;
+    llama_batch_free(batch);
+
+    // Clear KV cache again to restore a clean state
+    if (mem) {
+        llama_memory_clear(mem, false);
+    }
+    is_predicting = false;
 }
 
 std::string llama_rn_context_completion::bench(int pp, int tg, int pl, int nr) {
@@ -4,11 +4,14 @@
 #include "common.h"
 #include "llama.h"
 #include "rn-llama.h"
+#include "rn-prefix-index.h"
+#include "rn-state-store.h"
 #include "sampling.h"
 #include "nlohmann/json.hpp"
 #include "chat.h"
 #include "speculative.h"
 #include <deque>
+#include <functional>
 
 using json = nlohmann::ordered_json;
 
@@ -22,20 +25,6 @@ static inline void llama_batch_clear(llama_batch *batch) {
 // Forward declarations
 struct llama_rn_context;
 
-// A snapshot of the non-rollbackable memory state (recurrent/SWA cells,
-// PARTIAL_ONLY) at a token boundary.
-struct rn_state_checkpoint {
-    // Exact token sequence the snapshot represents (memory positions [0, n)).
-    std::vector<llama_token> tokens;
-    // PARTIAL_ONLY per-sequence state blob for seq_id 0.
-    std::vector<uint8_t> data;
-
-    size_t n_tokens() const { return tokens.size(); }
-    size_t size_bytes() const {
-        return data.size() + tokens.size() * sizeof(llama_token);
-    }
-};
-
 // Types defined in rn-llama.h (needed here for compilation)
 enum stop_type
 {
@@ -63,6 +52,42 @@ struct completion_chat_output
   std::string reasoning_content;
   std::vector<common_chat_tool_call> tool_calls;
   std::string accumulated_text;
+  // Change since the previous parse of the same stream. When the parser
+  // revised earlier output the *_replaced flag is set and the delta is the
+  // whole field, replacing what was accumulated instead of extending it
+  std::string content_delta;
+  std::string reasoning_content_delta;
+  bool content_replaced = false;
+  bool reasoning_content_replaced = false;
+};
+
+// Streaming chat output parser state, one per generation. Keeps the PEG
+// parser deserialized across calls (instead of parser.load() per token),
+// memoizes the last parse so unchanged text is not parsed again, and keeps
+// the parser's scan positions while the text only grows, so a new token
+// rescans the unsettled tail rather than the whole output. Each result
+// carries the delta against the previous one.
+struct rn_chat_parse_state {
+    completion_chat_output parse(const std::string &text, bool is_partial,
+                                 int chat_format, common_reasoning_format reasoning_format,
+                                 const std::string &generation_prompt, const std::string &chat_parser);
+    void reset();
+
+private:
+    // Parser identity
+    bool has_syntax = false;
+    int format = 0;
+    common_reasoning_format reasoning = COMMON_REASONING_FORMAT_NONE;
+    std::string generation_prompt_src;
+    std::string parser_src;
+    common_chat_parser_params syntax;
+
+    // Last parse
+    bool has_last = false;
+    bool last_partial = false;
+    std::string last_text;
+    common_chat_msg last_msg;
+    common_peg_scan_memo scan_memo;
 };
 
 // Completion context class
@@ -94,6 +119,10 @@ struct llama_rn_context_completion {
     // Saved snapshots, oldest first; empty for pure-attention models (seq_rm
     // already reuses the prefix for free).
     std::vector<rn_state_checkpoint> state_checkpoints;
+    // Radix index over the snapshots' tokens, keyed by n_tokens (one snapshot
+    // per boundary), so lookups don't scan every snapshot. It is the only copy
+    // of those tokens: snapshots of one conversation share the prefix.
+    rn_prefix_index checkpoint_index;
     bool state_cache_enabled = false;   // set once, from the model architecture
     bool state_cache_probed = false;    // whether we've inspected the model yet
     bool prompt_checkpoint_pending = false; // prompt-region snapshots armed for this ingest
@@ -105,6 +134,15 @@ struct llama_rn_context_completion {
     // per model, fixed in the token count).
     size_t state_cache_max_checkpoints = 8;
     size_t state_cache_budget_bytes = (size_t) 160 * 1024 * 1024;
+    // Tiers (see evictStateCheckpoints): raw snapshots up to hot_bytes of the
+    // budget, LZ-packed ones for the rest, then spilled to state_cache_dir up
+    // to disk_bytes (no directory = no disk tier).
+    size_t state_cache_hot_bytes = (size_t) 80 * 1024 * 1024;
+    std::string state_cache_dir;
+    size_t state_cache_disk_bytes = 0;
+    // Set by the first failed spill (full disk, dir gone); later evictions
+    // drop instead of retrying the disk on every capture
+    bool state_cache_disk_failed = false;
     // Minimum spacing between message-boundary restore points on a COLD ingest:
     // a boundary less than this far past the previous one saves less reprocess
     // than a full-state snapshot costs (see computeMessageBoundaries).
@@ -141,6 +179,11 @@ struct llama_rn_context_completion {
     llama_pos spec_n_past = 0;
     llama_tokens spec_draft;
     std::deque<completion_token_output> spec_pending_tokens;
+    // Jump-forward: grammar-forced tokens already accepted and appended to
+    // embd, handed out one per nextToken() before the next decode.
+    std::deque<completion_token_output> jump_pending_tokens;
+    // The next decode carries a forced run, so it still counts as generation.
+    bool jump_forward_batch = false;
     // Number of prompt tokens the last MTP prompt eval actually decoded (vs.
     // reused from the cache). Instrumentation for the reuse tests.
     size_t mtp_prompt_reprocessed = 0;
@@ -170,7 +213,7 @@ struct llama_rn_context_completion {
     // < total_tokens) and truncate the live prefix to it. Sets n_past_out.
     bool recoverStateCheckpoint(const std::vector<llama_token> &target, size_t max_reuse,
                                 size_t total_tokens, llama_pos &n_past_out);
-    void evictStateCheckpoints();                 // enforce count / byte bounds
+    void evictStateCheckpoints();                 // demote / spill / drop to the bounds
     void clearStateCheckpoints();                 // drop all snapshots
     void eraseStateCheckpointAt(size_t n_tokens); // drop the snapshot at a boundary
     // Drop snapshots whose state includes tokens after this position. A
@@ -200,10 +243,21 @@ struct llama_rn_context_completion {
     size_t findStoppingStrings(const std::string &text, const size_t last_token_size, const stop_type type);
     completion_token_output doCompletion();
     completion_chat_output parseChatOutput(bool is_partial);
+    rn_chat_parse_state chat_parse_state;
 
     // Embedding methods
     std::vector<float> embedding(common_params &embd_params);
+    // Embeds every text, packed across sequences without sampler setup;
+    // n_embd normalized floats per text, contiguous in input order
+    std::vector<float> embeddingBatch(const std::vector<std::string> &texts, int embd_normalize);
     std::vector<float> rerank(const std::string &query, const std::vector<std::string> &documents);
+    // Decodes each input as its own sequence, as many per decode as fit, and
+    // passes each one's pooled output to on_output(index, data) (nullptr if
+    // its decode failed). Inputs sharing their first n_prefix tokens decode
+    // that prefix once, when the memory allows forking it.
+    void decodePooledSequences(const std::vector<std::vector<llama_token>> &inputs,
+                               size_t n_prefix,
+                               const std::function<void(size_t, const float *)> &on_output);
 
     // Benchmarking methods
     std::string bench(int pp, int tg, int pl, int nr);
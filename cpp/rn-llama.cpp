@@ -12,9 +12,17 @@
 #include "tools/mtmd/clip.h"
 
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <cstdarg>
 #include <cstdio>
+#include <cstring>
+#include <deque>
 #include <fstream>
+#include <functional>
+#include <memory>
+#include <system_error>
+#include <sys/stat.h>
 
 namespace rnllama {
 
@@ -34,20 +42,277 @@ void populate_lora_metadata(common_adapter_lora_info &la) {
     la.prompt_prefix = buf;
 }
 
-void clear_init_lora_ownership(common_init_result_ptr &llama_init) {
-    if (llama_init != nullptr) {
-        // common_init_from_params() owns adapters loaded during init. Once runtime
-        // adapter state changes, those original handles should be released too.
-        llama_init->lora().clear();
+bool has_speculative_type(const common_params_speculative &speculative, common_speculative_type type) {
+    return std::find(speculative.types.begin(), speculative.types.end(), type) != speculative.types.end();
+}
+
+uint64_t fnv1a_mix(uint64_t h, const void *data, size_t n) {
+    const auto *p = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < n; i++) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
     }
+    return h;
 }
 
-bool has_speculative_type(const common_params_speculative &speculative, common_speculative_type type) {
-    return std::find(speculative.types.begin(), speculative.types.end(), type) != speculative.types.end();
+// Cache file prefix for the model's repacked weights, keyed by path only: a
+// model replaced in place rebuilds the same files rather than leaving stale
+// ones behind. Which model a file was built from is checked from its header.
+std::string repack_cache_prefix(const std::string &dir, const std::string &model_path) {
+    const uint64_t h = fnv1a_mix(14695981039346656037ULL, model_path.data(), model_path.size());
+    std::string name = model_path.substr(model_path.find_last_of("/\\") + 1);
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", (unsigned long long) h);
+    std::string prefix = dir;
+    if (!prefix.empty() && prefix.back() != '/') {
+        prefix += '/';
+    }
+    return prefix + name + "-" + hex + ".repack";
+}
+
+// Model identity stored in the repack cache header: size, mtime and a hash of
+// the GGUF header region plus evenly spaced samples of the tensor data.
+// Hashing the whole file would cost as much as the repack; the samples catch
+// a file rewritten with the same size and a preserved mtime.
+constexpr size_t kRepackHashHeadBytes = 1 << 20;
+constexpr size_t kRepackHashSampleBytes = 64 * 1024;
+constexpr int kRepackHashSamples = 16;
+
+bool repack_cache_model_id(const std::string &model_path, lm_ggml_cpu_repack_cache_model &id) {
+    struct stat st {};
+    if (stat(model_path.c_str(), &st) != 0) {
+        return false;
+    }
+    std::ifstream file(model_path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    const uint64_t size = (uint64_t) st.st_size;
+    uint64_t h = 14695981039346656037ULL;
+    std::vector<char> buf(std::max(kRepackHashHeadBytes, kRepackHashSampleBytes));
+    auto mix_range = [&](uint64_t offset, size_t n) {
+        n = (size_t) std::min<uint64_t>(n, size - std::min(offset, size));
+        file.seekg((std::streamoff) offset);
+        file.read(buf.data(), (std::streamsize) n);
+        h = fnv1a_mix(h, buf.data(), (size_t) file.gcount());
+        file.clear();
+    };
+    mix_range(0, kRepackHashHeadBytes);
+    for (int i = 1; i <= kRepackHashSamples; i++) {
+        mix_range(size / (kRepackHashSamples + 1) * i, kRepackHashSampleBytes);
+    }
+    mix_range(size - std::min<uint64_t>(size, kRepackHashSampleBytes), kRepackHashSampleBytes);
+
+    id.size = size;
+    id.mtime = (int64_t) st.st_mtime;
+    id.content_hash = h;
+    return true;
+}
+
+struct repack_cache_scope {
+    repack_cache_scope(const std::string &prefix, const lm_ggml_cpu_repack_cache_model &model)
+        : active(!prefix.empty()) {
+        if (active) {
+            lm_ggml_backend_cpu_repack_cache_begin(prefix.c_str(), &model);
+        }
+    }
+    ~repack_cache_scope() {
+        if (active) {
+            lm_ggml_backend_cpu_repack_cache_end();
+        }
+    }
+    bool active;
+};
+
+// Custom chat templates kept parsed, and formatted chats kept for reuse
+constexpr size_t kChatTemplateCacheEntries = 4;
+constexpr size_t kChatFormatCacheEntries = 4;
+
+// Pieces handed to one tokenizer thread are at least this long; below that
+// the hand-off costs more than the tokenization it saves
+constexpr size_t kParallelTokenizeMinPiece = 16 * 1024;
+
+// one tokenize_parallel_for call: its indices are claimed one at a time by
+// the calling thread and by any pool worker that picks up one of its tickets
+struct tokenize_job {
+    std::function<void(int)> fn;
+    int n = 0;
+    std::atomic<int> next{0};
+    std::atomic<int> n_done{0};
+    std::mutex mutex;
+    std::condition_variable cv;
+
+    void run() {
+        for (int i = next++; i < n; i = next++) {
+            fn(i);
+            if (++n_done == n) {
+                std::lock_guard<std::mutex> lock(mutex);
+                cv.notify_all();
+            }
+        }
+    }
+};
+
+// workers shared by every parallel tokenization in the process: started on
+// first use, grown to the largest thread count asked for, joined at exit
+class tokenize_pool {
+public:
+    static tokenize_pool &get() {
+        static tokenize_pool pool;
+        return pool;
+    }
+
+    // queue n_tickets helpers for job; the caller runs it too, so the job
+    // finishes even if no worker is free (or none could be started)
+    void submit(const std::shared_ptr<tokenize_job> &job, int n_tickets) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            try {
+                while ((int) workers.size() < n_tickets) {
+                    workers.emplace_back([this]() { worker_loop(); });
+                }
+            } catch (const std::system_error &) {
+                // run with the workers we have
+            }
+            for (int i = 0; i < n_tickets; ++i) {
+                tickets.push_back(job);
+            }
+        }
+        cv.notify_all();
+    }
+
+    ~tokenize_pool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (auto &w : workers) {
+            w.join();
+        }
+    }
+
+private:
+    void worker_loop() {
+        while (true) {
+            std::shared_ptr<tokenize_job> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this]() { return stopping || !tickets.empty(); });
+                if (tickets.empty()) {
+                    return;
+                }
+                job = std::move(tickets.front());
+                tickets.pop_front();
+            }
+            // a ticket for a job the caller already finished claims nothing
+            job->run();
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::shared_ptr<tokenize_job>> tickets;
+    std::vector<std::thread> workers;
+    bool stopping = false;
+};
+
+// run fn(i) for i in [0, n) on up to n_threads threads
+template <typename F>
+void tokenize_parallel_for(int n, int n_threads, F && fn) {
+    n_threads = std::min(n_threads, n);
+    if (n_threads <= 1) {
+        for (int i = 0; i < n; ++i) {
+            fn(i);
+        }
+        return;
+    }
+    auto job = std::make_shared<tokenize_job>();
+    job->fn = [&fn](int i) { fn(i); };
+    job->n = n;
+    tokenize_pool::get().submit(job, n_threads - 1);
+    job->run();
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->cv.wait(lock, [&]() { return job->n_done.load() == job->n; });
+}
+
+bool is_ascii_letter(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+// Cut positions (exclusive ends) splitting text into n_pieces roughly equal
+// pieces, each ending right before the space of a "<letter> <letter>"
+std::vector<size_t> word_boundary_cuts(const std::string &text, int n_pieces) {
+    std::vector<size_t> cuts;
+    const size_t target = text.size() / n_pieces;
+    size_t pos = target;
+    while ((int) cuts.size() + 1 < n_pieces && pos + 1 < text.size()) {
+        if (text[pos] == ' ' && is_ascii_letter(text[pos - 1]) && is_ascii_letter(text[pos + 1])) {
+            cuts.push_back(pos);
+            pos = std::max(pos + 1, (cuts.size() + 1) * target);
+        } else {
+            ++pos;
+        }
+    }
+    cuts.push_back(text.size());
+    return cuts;
 }
 
 } // namespace
 
+// A text can be cut before the space of "<letter> <letter>" only when the
+// pre-tokenizer regex never lets a word span a single space between letters
+// (all of these start a word with an optional leading space) and no special
+// token can match across such a cut or strip the whitespace next to it.
+bool vocab_splits_at_word_boundaries(const llama_vocab *vocab) {
+    if (vocab->get_type() != LLAMA_VOCAB_TYPE_BPE || vocab->get_tokenizer_model() != "gpt2") {
+        return false;
+    }
+    switch (vocab->get_pre_type()) {
+        case LLAMA_VOCAB_PRE_TYPE_DEFAULT:
+        case LLAMA_VOCAB_PRE_TYPE_LLAMA3:
+        case LLAMA_VOCAB_PRE_TYPE_DBRX:
+        case LLAMA_VOCAB_PRE_TYPE_SMAUG:
+        case LLAMA_VOCAB_PRE_TYPE_QWEN2:
+        case LLAMA_VOCAB_PRE_TYPE_QWEN35:
+        case LLAMA_VOCAB_PRE_TYPE_STABLELM2:
+        case LLAMA_VOCAB_PRE_TYPE_HUNYUAN:
+        case LLAMA_VOCAB_PRE_TYPE_GPT2:
+        case LLAMA_VOCAB_PRE_TYPE_MPT:
+        case LLAMA_VOCAB_PRE_TYPE_OLMO:
+        case LLAMA_VOCAB_PRE_TYPE_STARCODER:
+        case LLAMA_VOCAB_PRE_TYPE_REFACT:
+        case LLAMA_VOCAB_PRE_TYPE_COMMAND_R:
+        case LLAMA_VOCAB_PRE_TYPE_SMOLLM:
+        case LLAMA_VOCAB_PRE_TYPE_CODESHELL:
+        case LLAMA_VOCAB_PRE_TYPE_DEEPSEEK3_LLM:
+        case LLAMA_VOCAB_PRE_TYPE_DEEPSEEK_CODER:
+        case LLAMA_VOCAB_PRE_TYPE_CHATGLM4:
+        case LLAMA_VOCAB_PRE_TYPE_GPT4O:
+        case LLAMA_VOCAB_PRE_TYPE_TEKKEN:
+        case LLAMA_VOCAB_PRE_TYPE_SEED_CODER:
+        case LLAMA_VOCAB_PRE_TYPE_GROK_2:
+        case LLAMA_VOCAB_PRE_TYPE_MINICPM5:
+            break;
+        default:
+            return false;
+    }
+    const int32_t n_vocab = llama_vocab_n_tokens(vocab);
+    for (llama_token id = 0; id < n_vocab; ++id) {
+        const llama_token_attr attr = llama_vocab_get_attr(vocab, id);
+        if (!(attr & (LLAMA_TOKEN_ATTR_CONTROL | LLAMA_TOKEN_ATTR_USER_DEFINED | LLAMA_TOKEN_ATTR_UNKNOWN))) {
+            continue;
+        }
+        if (attr & (LLAMA_TOKEN_ATTR_LSTRIP | LLAMA_TOKEN_ATTR_RSTRIP)) {
+            return false;
+        }
+        if (strchr(llama_vocab_get_text(vocab, id), ' ') != nullptr) {
+            return false;
+        }
+    }
+    return true;
+}
+
 std::string get_backend_devices_info() {
     return backend_devices_info();
 }
@@ -163,6 +428,109 @@ bool model_uses_mrope(const llama_model *model) {
     return rope == LLAMA_ROPE_TYPE_MROPE || rope == LLAMA_ROPE_TYPE_IMROPE;
 }
 
+std::vector<std::vector<llama_token>> tokenize_rerank_inputs(llama_context *ctx, const std::string &query, const std::vector<std::string> &documents) {
+    const llama_model * model = llama_get_model(ctx);
+    const llama_vocab * vocab = llama_model_get_vocab(model);
+    const bool add_bos = llama_vocab_get_add_bos(vocab) || llama_model_has_encoder(model);
+
+    const std::vector<llama_token> query_tokens = common_tokenize(vocab, query, false, true);
+
+    std::vector<std::vector<llama_token>> inputs;
+    inputs.reserve(documents.size());
+    for (const std::string &doc : documents) {
+        std::vector<llama_token> doc_tokens = common_tokenize(vocab, doc, false, true);
+        std::vector<llama_token> rerank_tokens = format_rerank_tokens(vocab, query_tokens, doc_tokens);
+        // Convert tokens back to text and re-tokenize using context-aware settings
+        const std::string rerank_text = tokens_to_str(ctx, rerank_tokens.begin(), rerank_tokens.end());
+        inputs.push_back(common_tokenize(ctx, rerank_text, add_bos, true));
+    }
+    return inputs;
+}
+
+std::vector<llama_token> tokenize_parallel(const llama_vocab *vocab, const std::string &text, bool add_special, bool parse_special, int n_threads, bool word_local) {
+    const int n_pieces = (int) std::min<size_t>(std::max(n_threads, 1), text.size() / kParallelTokenizeMinPiece);
+    if (n_pieces <= 1 || !word_local) {
+        return common_tokenize(vocab, text, add_special, parse_special);
+    }
+    const std::vector<size_t> cuts = word_boundary_cuts(text, n_pieces);
+    if (cuts.size() <= 1) {
+        return common_tokenize(vocab, text, add_special, parse_special);
+    }
+
+    std::vector<std::vector<llama_token>> pieces(cuts.size());
+    tokenize_parallel_for((int) cuts.size(), n_threads, [&](int i) {
+        const size_t begin = i == 0 ? 0 : cuts[i - 1];
+        pieces[i] = common_tokenize(vocab, text.substr(begin, cuts[i] - begin), false, parse_special);
+    });
+
+    // Same BOS/EOS as llama_tokenize adds for a BPE vocab with add_special
+    const bool add_bos = add_special && llama_vocab_get_add_bos(vocab);
+    const bool add_eos = add_special && llama_vocab_get_add_eos(vocab);
+    size_t n_tokens = (size_t) add_bos + (size_t) add_eos;
+    for (const auto &piece : pieces) {
+        n_tokens += piece.size();
+    }
+    std::vector<llama_token> tokens;
+    tokens.reserve(n_tokens);
+    if (add_bos) {
+        tokens.push_back(llama_vocab_bos(vocab));
+    }
+    for (const auto &piece : pieces) {
+        tokens.insert(tokens.end(), piece.begin(), piece.end());
+    }
+    if (add_eos) {
+        tokens.push_back(llama_vocab_eos(vocab));
+    }
+    return tokens;
+}
+
+std::vector<std::vector<llama_token>> tokenize_batch(const llama_vocab *vocab, const std::vector<std::string> &texts, bool add_special, bool parse_special, int n_threads, bool word_local) {
+    std::vector<std::vector<llama_token>> results(texts.size());
+    if (texts.size() == 1) {
+        results[0] = tokenize_parallel(vocab, texts[0], add_special, parse_special, n_threads, word_local);
+        return results;
+    }
+    tokenize_parallel_for((int) texts.size(), n_threads, [&](int i) {
+        results[i] = common_tokenize(vocab, texts[i], add_special, parse_special);
+    });
+    return results;
+}
+
+std::vector<llama_token> sample_forced_tokens(common_sampler *smpl, const llama_vocab *vocab, int32_t max_tokens) {
+    std::vector<llama_token> forced;
+    std::vector<llama_token> prefix;
+    while ((int32_t) forced.size() < max_tokens) {
+        if (!common_sampler_forced_prefix(smpl, vocab, prefix)) {
+            break;
+        }
+        const size_t n_take = std::min(prefix.size(), (size_t) (max_tokens - (int32_t) forced.size()));
+        for (size_t i = 0; i < n_take; i++) {
+            common_sampler_accept(smpl, prefix[i], true);
+            forced.push_back(prefix[i]);
+        }
+        if (n_take > 0) {
+            continue;
+        }
+        // The held-back last token of the run: forced only if nothing can merge onto it
+        const llama_token tok = common_sampler_forced_token(smpl, vocab);
+        if (tok == LLAMA_TOKEN_NULL) {
+            break;
+        }
+        common_sampler_accept(smpl, tok, true);
+        forced.push_back(tok);
+    }
+    return forced;
+}
+
+bool model_rerank_shares_prefix(const llama_model *model) {
+    if (model == nullptr || !model->hparams.causal_attn ||
+        llama_model_is_recurrent(model) || llama_model_is_hybrid(model)) {
+        return false;
+    }
+    // Must match the last-token rank pooling in llama-graph.cpp
+    return model->arch == LLM_ARCH_QWEN3 || model->arch == LLM_ARCH_QWEN3VL;
+}
+
 static std::string state_meta_path(const std::string &state_path) {
     return state_path + ".meta";
 }
@@ -231,6 +599,28 @@ std::vector<std::string> read_state_meta(const std::string &state_path) {
     return hashes;
 }
 
+bool read_state_file_tokens(const std::string &state_path, std::vector<llama_token> &tokens) {
+    tokens.clear();
+    std::ifstream in(state_path, std::ios::binary | std::ios::ate);
+    if (!in.is_open()) {
+        return false;
+    }
+    const auto file_size = (uint64_t) in.tellg();
+    in.seekg(0);
+    uint32_t head[3];
+    if (!in.read(reinterpret_cast<char *>(head), sizeof(head)) ||
+        head[0] != LLAMA_STATE_SEQ_MAGIC || head[1] != LLAMA_STATE_SEQ_VERSION ||
+        sizeof(head) + (uint64_t) head[2] * sizeof(llama_token) > file_size) {
+        return false;
+    }
+    tokens.resize(head[2]);
+    if (!in.read(reinterpret_cast<char *>(tokens.data()), tokens.size() * sizeof(llama_token))) {
+        tokens.clear();
+        return false;
+    }
+    return true;
+}
+
 // Well-formed UTF-8 lead bytes and the range of their first continuation
 // byte (Unicode 15.0, table 3-7). The restricted first-continuation ranges
 // exclude overlong encodings, UTF-16 surrogates and values > U+10FFFF.
@@ -447,6 +837,11 @@ llama_rn_context::~llama_rn_context() {
     disableParallelMode();
 
     removeLoraAdapters();
+    {
+        std::lock_guard<std::mutex> lock(lora_registry_mutex);
+        lora_registry.clear();
+        lora_pending_free.clear();
+    }
     cleanupThreadpools();
 
     if (completion != nullptr) {
@@ -461,6 +856,12 @@ llama_rn_context::~llama_rn_context() {
 bool llama_rn_context::loadModel(common_params &params_)
 {
     removeLoraAdapters();
+    {
+        // adapters belong to the model being replaced
+        std::lock_guard<std::mutex> lock(lora_registry_mutex);
+        lora_registry.clear();
+        lora_pending_free.clear();
+    }
     draft_model.reset();
     params = params_;
 
@@ -473,7 +874,17 @@ bool llama_rn_context::loadModel(common_params &params_)
         LOG_INFO("Using n_parallel: %d (enables up to %d parallel slots)", params.n_parallel, params.n_parallel);
     }
 
-    llama_init = common_init_from_params(params);
+    {
+        std::string cache_prefix;
+        lm_ggml_cpu_repack_cache_model cache_model {};
+        if (!repack_cache_dir.empty() && !params.no_extra_bufts &&
+            repack_cache_model_id(params.model.path, cache_model)) {
+            cache_prefix = repack_cache_prefix(repack_cache_dir, params.model.path);
+            LOG_VERBOSE("Repacked weight cache: %s", cache_prefix.c_str());
+        }
+        repack_cache_scope repack_cache(cache_prefix, cache_model);
+        llama_init = common_init_from_params(params);
+    }
     model = llama_init != nullptr ? llama_init->model() : nullptr;
     ctx = llama_init != nullptr ? llama_init->context() : nullptr;
 
@@ -514,16 +925,33 @@ bool llama_rn_context::loadModel(common_params &params_)
     }
 
     templates = common_chat_templates_init(model, params.chat_template);
+    clearChatCaches();
     n_ctx = llama_n_ctx(ctx);
+    vocab_word_local = vocab_splits_at_word_boundaries(llama_model_get_vocab(model));
 
     // Init-time adapters are already loaded and applied by common_init_from_params().
     // Mirror the resulting adapter metadata so getLoadedLoraAdapters() reflects reality
     // without forcing a second load/apply pass in the JSI layer.
     lora = params.lora_adapters;
-    owned_lora.clear();
     for (auto &la : lora) {
         populate_lora_metadata(la);
     }
+    {
+        // Adopt them into the registry; a path listed twice keeps its second handle
+        // with common_init_result, which still owns it.
+        std::lock_guard<std::mutex> lock(lora_registry_mutex);
+        auto &init_lora = llama_init->lora();
+        for (size_t i = 0; i < init_lora.size() && i < lora.size(); ++i) {
+            lora_registry.try_emplace(lora[i].path).first->second.adapter = std::move(init_lora[i]);
+        }
+        // Held by the global list
+        for (const auto &la : lora) {
+            auto it = lora_registry.find(la.path);
+            if (it != lora_registry.end()) {
+                it->second.n_refs++;
+            }
+        }
+    }
 
     // Log the actual n_seq_max that was set
     uint32_t n_seq_max = llama_n_seq_max(ctx);
@@ -624,13 +1052,41 @@ common_chat_params llama_rn_context::getFormattedChatWithJinja(
     inputs.chat_template_kwargs = chat_template_kwargs;
     inputs.force_pure_content = force_pure_content;
 
-    // If chat_template is provided, create new one and use it (probably slow)
-    if (!chat_template.empty()) {
-        auto tmps = common_chat_templates_init(model, chat_template);
-        return common_chat_templates_apply(tmps.get(), inputs);
-    } else {
-        return common_chat_templates_apply(templates.get(), inputs);
+    auto tmpls = getChatTemplates(chat_template);
+
+    // Identical requests (a re-format before completion, a retried turn)
+    // reuse the previous result, unless the template reads the clock
+    const bool time_dependent = now_str.empty() &&
+        (common_chat_templates_source(tmpls.get()).find("strftime_now") != std::string::npos ||
+         common_chat_templates_source(tmpls.get(), "tool_use").find("strftime_now") != std::string::npos);
+    std::string key;
+    if (!time_dependent) {
+        const char sep = '\x1f';
+        key = messages + sep + chat_template + sep + json_schema + sep + tools + sep + tool_choice + sep +
+              reasoning_format + sep + now_str + sep +
+              (parallel_tool_calls ? '1' : '0') + (enable_thinking ? '1' : '0') +
+              (add_generation_prompt ? '1' : '0') + (force_pure_content ? '1' : '0');
+        for (const auto &kv : chat_template_kwargs) {
+            key += sep + kv.first + sep + kv.second;
+        }
+        std::lock_guard<std::mutex> lock(chat_cache_mutex);
+        for (auto it = chat_format_cache.begin(); it != chat_format_cache.end(); ++it) {
+            if (it->first == key) {
+                chat_format_cache.splice(chat_format_cache.begin(), chat_format_cache, it);
+                return it->second;
+            }
+        }
+    }
+
+    common_chat_params result = common_chat_templates_apply(tmpls.get(), inputs);
+    if (!time_dependent) {
+        std::lock_guard<std::mutex> lock(chat_cache_mutex);
+        chat_format_cache.emplace_front(std::move(key), result);
+        if (chat_format_cache.size() > kChatFormatCacheEntries) {
+            chat_format_cache.pop_back();
+        }
     }
+    return result;
 }
 
 std::string llama_rn_context::getFormattedChat(
@@ -641,13 +1097,42 @@ std::string llama_rn_context::getFormattedChat(
     inputs.messages = common_chat_msgs_parse_oaicompat(json::parse(messages));
     inputs.use_jinja = false;
 
-    // If chat_template is provided, create new one and use it (probably slow)
-    if (!chat_template.empty()) {
-        auto tmps = common_chat_templates_init(model, chat_template);
-        return common_chat_templates_apply(tmps.get(), inputs).prompt;
-    } else {
-        return common_chat_templates_apply(templates.get(), inputs).prompt;
+    return common_chat_templates_apply(getChatTemplates(chat_template).get(), inputs).prompt;
+}
+
+std::shared_ptr<const common_chat_templates> llama_rn_context::getChatTemplates(const std::string &chat_template) const {
+    if (chat_template.empty()) {
+        // Aliasing pointer: owned by the context, not by the returned handle
+        return std::shared_ptr<const common_chat_templates>(std::shared_ptr<void>(), templates.get());
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(chat_cache_mutex);
+        for (auto it = chat_template_cache.begin(); it != chat_template_cache.end(); ++it) {
+            if (it->first == chat_template) {
+                chat_template_cache.splice(chat_template_cache.begin(), chat_template_cache, it);
+                return it->second;
+            }
+        }
     }
+
+    // Parsed outside the lock; a concurrent miss on the same template just
+    // parses it twice
+    std::shared_ptr<common_chat_templates> tmpls(
+        common_chat_templates_init(model, chat_template).release(), common_chat_templates_deleter());
+
+    std::lock_guard<std::mutex> lock(chat_cache_mutex);
+    chat_template_cache.emplace_front(chat_template, tmpls);
+    if (chat_template_cache.size() > kChatTemplateCacheEntries) {
+        chat_template_cache.pop_back();
+    }
+    return tmpls;
+}
+
+void llama_rn_context::clearChatCaches() {
+    std::lock_guard<std::mutex> lock(chat_cache_mutex);
+    chat_template_cache.clear();
+    chat_format_cache.clear();
 }
 
 llama_rn_tokenize_result llama_rn_context::tokenize(const std::string &text, const std::vector<std::string> &media_paths) {
@@ -666,7 +1151,7 @@ llama_rn_tokenize_result llama_rn_context::tokenize(const std::string &text, con
       return tokenize_result;
   }
   std::vector<llama_token> text_tokens;
-  text_tokens = common_tokenize(ctx, text, /* add_special= */ false, /* parse_special= */ true);
+  text_tokens = tokenize_parallel(llama_model_get_vocab(model), text, /* add_special= */ false, /* parse_special= */ true, params.cpuparams.n_threads, vocab_word_local);
   llama_rn_tokenize_result tokenize_result;
   tokenize_result.tokens = text_tokens;
   tokenize_result.has_media = false;
@@ -676,32 +1161,152 @@ llama_rn_tokenize_result llama_rn_context::tokenize(const std::string &text, con
   return tokenize_result;
 }
 
+std::vector<std::vector<llama_token>> llama_rn_context::tokenizeBatch(const std::vector<std::string> &texts) {
+  return tokenize_batch(llama_model_get_vocab(model), texts, /* add_special= */ false, /* parse_special= */ true, params.cpuparams.n_threads, vocab_word_local);
+}
+
+// Resident adapters are returned under the registry lock alone; a cold load
+// reads the file without it, so lookups (the slot manager's, under
+// slots_mutex) never wait for one
+llama_adapter_lora * llama_rn_context::load_lora(const std::string &path, bool acquire) {
+    if (model == nullptr) {
+        throw std::runtime_error("Cannot load LoRA adapter: context is not initialized");
+    }
+
+    auto find_resident = [&]() -> llama_adapter_lora * {
+        auto it = lora_registry.find(path);
+        if (it == lora_registry.end() || it->second.adapter == nullptr) {
+            return nullptr;
+        }
+        it->second.last_used = ++lora_registry_clock;
+        if (acquire) {
+            it->second.n_refs++;
+        }
+        return it->second.adapter.get();
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(lora_registry_mutex);
+        if (llama_adapter_lora *adapter = find_resident()) {
+            return adapter;
+        }
+    }
+
+    std::lock_guard<std::mutex> load_lock(lora_load_mutex);
+    std::vector<llama_adapter_lora_ptr> pending_free;
+    {
+        // Another thread may have loaded it while this one waited
+        std::lock_guard<std::mutex> lock(lora_registry_mutex);
+        pending_free.swap(lora_pending_free);
+        if (llama_adapter_lora *adapter = find_resident()) {
+            return adapter;
+        }
+    }
+    pending_free.clear();
+
+    llama_adapter_lora_ptr adapter(llama_adapter_lora_init(model, path.c_str()));
+    if (adapter == nullptr) {
+        throw std::runtime_error(
+            "Failed to apply LoRA adapter '" + path +
+            "'. Check native logs for the detailed loader error. The adapter may not match the loaded base model."
+        );
+    }
+
+    std::lock_guard<std::mutex> lock(lora_registry_mutex);
+    lora_registry.try_emplace(path).first->second.adapter = std::move(adapter);
+    return find_resident();
+}
+
+std::vector<llama_adapter_lora_ptr> llama_rn_context::evict_idle_lora_locked() {
+    std::vector<llama_adapter_lora_ptr> evicted;
+    std::vector<std::map<std::string, lora_registry_entry>::iterator> idle;
+    for (auto it = lora_registry.begin(); it != lora_registry.end(); ++it) {
+        if (it->second.n_refs <= 0) {
+            idle.push_back(it);
+        }
+    }
+    if (idle.size() <= lora_registry_max_idle) {
+        return evicted;
+    }
+    std::sort(idle.begin(), idle.end(), [](const auto &a, const auto &b) {
+        return a->second.last_used < b->second.last_used;
+    });
+    for (size_t i = 0; i + lora_registry_max_idle < idle.size(); ++i) {
+        LOG_VERBOSE("Freeing idle LoRA adapter: %s", idle[i]->first.c_str());
+        evicted.push_back(std::move(idle[i]->second.adapter));
+        lora_registry.erase(idle[i]);
+    }
+    return evicted;
+}
+
+void llama_rn_context::free_lora_adapters(std::vector<llama_adapter_lora_ptr> adapters) {
+    if (adapters.empty()) {
+        return;
+    }
+    std::unique_lock<std::mutex> load_lock(lora_load_mutex, std::try_to_lock);
+    if (!load_lock.owns_lock()) {
+        std::lock_guard<std::mutex> lock(lora_registry_mutex);
+        for (auto &adapter : adapters) {
+            lora_pending_free.push_back(std::move(adapter));
+        }
+        return;
+    }
+    adapters.clear();
+}
+
+llama_adapter_lora * llama_rn_context::getLoraAdapter(const std::string &path) {
+    llama_adapter_lora *adapter = load_lora(path, false);
+    std::vector<llama_adapter_lora_ptr> evicted;
+    {
+        std::lock_guard<std::mutex> lock(lora_registry_mutex);
+        evicted = evict_idle_lora_locked();
+    }
+    free_lora_adapters(std::move(evicted));
+    return adapter;
+}
+
+llama_adapter_lora * llama_rn_context::acquireLoraAdapter(const std::string &path) {
+    return load_lora(path, true);
+}
+
+void llama_rn_context::releaseLoraAdapter(const std::string &path) {
+    std::vector<llama_adapter_lora_ptr> evicted;
+    {
+        std::lock_guard<std::mutex> lock(lora_registry_mutex);
+        auto it = lora_registry.find(path);
+        if (it == lora_registry.end()) {
+            return;
+        }
+        it->second.n_refs--;
+        evicted = evict_idle_lora_locked();
+    }
+    free_lora_adapters(std::move(evicted));
+}
+
 void llama_rn_context::applyLoraAdapters(std::vector<common_adapter_lora_info> lora) {
     if (model == nullptr || ctx == nullptr) {
         throw std::runtime_error("Cannot apply LoRA adapters: context is not initialized");
     }
 
-    std::vector<llama_adapter_lora_ptr> loaded_adapters;
-    loaded_adapters.reserve(lora.size());
-
-    for (auto &la : lora) {
-        llama_adapter_lora_ptr adapter(llama_adapter_lora_init(model, la.path.c_str()));
-        if (adapter == nullptr) {
-            throw std::runtime_error(
-                "Failed to apply LoRA adapter '" + la.path +
-                "'. Check native logs for the detailed loader error. The adapter may not match the loaded base model."
-            );
+    size_t n_acquired = 0;
+    try {
+        for (auto &la : lora) {
+            la.ptr = acquireLoraAdapter(la.path);
+            n_acquired++;
+            populate_lora_metadata(la);
         }
-
-        la.ptr = adapter.get();
-        populate_lora_metadata(la);
-        loaded_adapters.emplace_back(std::move(adapter));
+    } catch (...) {
+        for (size_t i = 0; i < n_acquired; ++i) {
+            releaseLoraAdapter(lora[i].path);
+        }
+        throw;
     }
 
     common_set_adapter_lora(ctx, lora);
-    this->lora = std::move(lora);
-    clear_init_lora_ownership(llama_init);
-    owned_lora = std::move(loaded_adapters);
+    std::swap(this->lora, lora);
+    for (const auto &la : lora) {
+        releaseLoraAdapter(la.path);
+    }
 }
 
 void llama_rn_context::removeLoraAdapters() {
@@ -710,18 +1315,27 @@ void llama_rn_context::removeLoraAdapters() {
         common_set_adapter_lora(ctx, empty_lora); // apply empty list
     }
 
+    // Adapters no slot is routed through become idle in lora_registry
+    for (const auto &la : this->lora) {
+        releaseLoraAdapter(la.path);
+    }
     this->lora.clear();
-    clear_init_lora_ownership(llama_init);
-    owned_lora.clear();
 }
 
 std::vector<common_adapter_lora_info> llama_rn_context::getLoadedLoraAdapters() {
     return this->lora;
 }
 
-bool llama_rn_context::initMultimodal(const std::string &mmproj_path, bool use_gpu, int image_min_tokens, int image_max_tokens) {
+bool llama_rn_context::initMultimodal(const std::string &mmproj_path, bool use_gpu, int image_min_tokens, int image_max_tokens,
+                                      int media_cache_mb, const std::string &media_cache_dir, int media_cache_disk_mb) {
     try {
         mtmd_wrapper = new llama_rn_context_mtmd(mmproj_path, use_gpu, model, ctx, params, has_multimodal, params, image_min_tokens, image_max_tokens);
+        mtmd_wrapper->embd_cache.configure(
+            (size_t) std::max(0, media_cache_mb) * 1024 * 1024,
+            media_cache_dir,
+            (size_t) std::max(0, media_cache_disk_mb) * 1024 * 1024);
+        LOG_INFO("Media embedding cache: %d MB%s%s", std::max(0, media_cache_mb),
+                 media_cache_dir.empty() ? "" : ", spill to ", media_cache_dir.c_str());
         return true;
     } catch (const std::exception& e) {
         LOG_ERROR("[DEBUG] Failed to initialize multimodal: %s", e.what());
@@ -743,6 +1357,10 @@ bool llama_rn_context::isMultimodalSupportAudio() const {
 
 void llama_rn_context::releaseMultimodal() {
     if (mtmd_wrapper != nullptr) {
+        // The slot manager's media worker may be encoding with it
+        if (slot_manager != nullptr) {
+            slot_manager->stop_media_worker();
+        }
         delete mtmd_wrapper;
         mtmd_wrapper = nullptr;
         has_multimodal = false;
@@ -786,7 +1404,9 @@ void llama_rn_context::releaseVocoder() {
 }
 
 // Enable parallel decoding mode
-void llama_rn_context::enableParallelMode(int32_t n_parallel, int32_t n_batch) {
+void llama_rn_context::enableParallelMode(int32_t n_parallel, int32_t n_batch,
+                                          int32_t prefill_policy, int32_t prefill_chunk,
+                                          int32_t prefill_decode_budget) {
     if (ctx == nullptr) {
         LOG_ERROR("Cannot enable parallel mode: context not initialized");
         throw std::runtime_error("Cannot enable parallel mode: context not initialized");
@@ -833,6 +1453,13 @@ void llama_rn_context::enableParallelMode(int32_t n_parallel, int32_t n_batch) {
         throw std::runtime_error(error_msg);
     }
 
+    slot_manager->prefill_policy = prefill_policy == PREFILL_POLICY_FAIR ? PREFILL_POLICY_FAIR : PREFILL_POLICY_FIFO;
+    slot_manager->prefill_chunk = std::max(0, prefill_chunk);
+    slot_manager->prefill_decode_budget = std::max(0, prefill_decode_budget);
+    LOG_INFO("Prefill scheduling: policy=%s, chunk=%d, decode budget=%d",
+             slot_manager->prefill_policy == PREFILL_POLICY_FAIR ? "fair" : "fifo",
+             slot_manager->prefill_chunk, slot_manager->prefill_decode_budget);
+
     parallel_mode_enabled = true;
 
     LOG_INFO("Parallel mode enabled successfully with %d slots", n_parallel);
@@ -3,6 +3,9 @@
 
 #include <sstream>
 #include <iostream>
+#include <list>
+#include <map>
+#include <mutex>
 #include <thread>
 #include <codecvt>
 #include "chat.h"
@@ -37,6 +40,37 @@ std::string tokens_to_str(llama_context *ctx, const std::vector<llama_token>::co
 // so the memory frontier legitimately lags the token count for media prefixes.
 bool model_uses_mrope(const llama_model *model);
 
+// Rerank inputs, one per document: the (query, document) pair in the rerank
+// format, re-tokenized the way this context tokenizes a prompt
+std::vector<std::vector<llama_token>> tokenize_rerank_inputs(llama_context *ctx, const std::string &query, const std::vector<std::string> &documents);
+
+// Whether no pre-token or special token of the vocab can span the space of a
+// "<letter> <letter>" pair. Scans the whole vocab: call once per model
+// (llama_rn_context::vocab_word_local) and pass the result along.
+bool vocab_splits_at_word_boundaries(const llama_vocab *vocab);
+
+// Same tokens as common_tokenize(vocab, ...). Long texts of word-local
+// vocabs (see vocab_splits_at_word_boundaries) are cut before the space of
+// "<letter> <letter>" pairs and the pieces tokenized on n_threads
+std::vector<llama_token> tokenize_parallel(const llama_vocab *vocab, const std::string &text, bool add_special, bool parse_special, int n_threads, bool word_local);
+
+// One token list per text, the texts spread over n_threads
+std::vector<std::vector<llama_token>> tokenize_batch(const llama_vocab *vocab, const std::vector<std::string> &texts, bool add_special, bool parse_special, int n_threads, bool word_local);
+
+// Jump-forward: the run of tokens the sampler's grammar forces after its last
+// accepted token (a JSON key, a closing brace, a fixed tool-call wrapper), at
+// most max_tokens. The pinned text is read from the grammar stack and
+// tokenized once; the vocab is scanned only for the run's last token. Each is
+// accepted into the sampler as it is found; the caller emits them right away
+// and decodes them with the next token batch.
+std::vector<llama_token> sample_forced_tokens(common_sampler *smpl, const llama_vocab *vocab, int32_t max_tokens);
+
+// Rank pooling that reads the last token of a causal, truncatable sequence
+// (Qwen3 rerankers). Every rerank input starts with the same query prefix and
+// a document's score doesn't depend on other sequences, so the prefix KV can
+// be computed once and reused for each document.
+bool model_rerank_shares_prefix(const llama_model *model);
+
 // State-file sidecar ("<state_path>.meta"): persists the media chunk identity
 // hashes alongside a saved sequence state. The state file's token list only
 // carries LLAMA_TOKEN_NULL placeholders for media positions, which are
@@ -46,6 +80,11 @@ bool model_uses_mrope(const llama_model *model);
 void write_state_meta(const std::string &state_path, const std::vector<std::string> &bitmap_hashes);
 std::vector<std::string> read_state_meta(const std::string &state_path);
 
+// Token list of a sequence state file (llama_state_seq_save_file layout), read
+// from its header without touching the state data behind it; false if the
+// file is missing or is not a sequence state file.
+bool read_state_file_tokens(const std::string &state_path, std::vector<llama_token> &tokens);
+
 // Token pieces are raw bytes (a multi-byte character can split across tokens;
 // malformed generations can emit stray bytes), while consumers of generated
 // text (chat parsers, JSON, JSI strings) require well-formed UTF-8. Text is
@@ -115,11 +154,27 @@ struct llama_rn_context {
     llama_context *ctx = nullptr;
     common_chat_templates_ptr templates;
     int n_ctx = 0;
+    // vocab_splits_at_word_boundaries(), computed once per loaded model
+    bool vocab_word_local = false;
+
+    // Chat formatting fast path: custom templates parsed by earlier requests
+    // and the last few formatted results, most recent first
+    mutable std::mutex chat_cache_mutex;
+    mutable std::list<std::pair<std::string, std::shared_ptr<common_chat_templates>>> chat_template_cache;
+    mutable std::list<std::pair<std::string, common_chat_params>> chat_format_cache;
 
     // Prompt state cache tuning (see rn-completion.h). Budget 0 disables it;
     // no-op on pure-attention models.
     size_t state_cache_budget_bytes = (size_t) 160 * 1024 * 1024; // 0 = disabled
     int32_t state_cache_max_checkpoints = 8;
+    // Share of the budget kept uncompressed (0 = half the budget); with a
+    // directory, snapshots past the budget spill there up to disk_bytes
+    size_t state_cache_hot_bytes = 0;
+    std::string state_cache_dir;
+    size_t state_cache_disk_bytes = 0;
+
+    // Directory for the sidecar cache of CPU-repacked weights; empty disables it.
+    std::string repack_cache_dir;
 
     // Completion context (DEPRECATED: Use slot_manager for parallel decoding)
     llama_rn_context_completion *completion = nullptr;
@@ -141,7 +196,11 @@ struct llama_rn_context {
     bool attachThreadpoolsIfAvailable();
 
     // Parallel decoding methods
-    void enableParallelMode(int32_t n_parallel, int32_t n_batch = 512);
+    // prefill_policy is a llama_rn_prefill_policy; the prefill knobs are
+    // described on llama_rn_slot_manager
+    void enableParallelMode(int32_t n_parallel, int32_t n_batch = 512,
+                            int32_t prefill_policy = 0, int32_t prefill_chunk = 0,
+                            int32_t prefill_decode_budget = 0);
     void disableParallelMode();
 
     // Model methods
@@ -164,13 +223,40 @@ struct llama_rn_context {
       const std::string &messages,
       const std::string &chat_template
     ) const;
+    // Parsed templates for chat_template, the model's own when it is empty
+    std::shared_ptr<const common_chat_templates> getChatTemplates(const std::string &chat_template) const;
+    void clearChatCaches();
     llama_rn_tokenize_result tokenize(const std::string &text, const std::vector<std::string> &media_paths);
+    std::vector<std::vector<llama_token>> tokenizeBatch(const std::vector<std::string> &texts);
 
     // Lora methods
     std::vector<common_adapter_lora_info> lora;
-    // Init-time adapters are owned by common_init_result. Runtime apply/remove
-    // operations load their own adapter handles and release them here.
-    std::vector<llama_adapter_lora_ptr> owned_lora;
+    // Adapters by path, each loaded once. The global list (applyLoraAdapters)
+    // and every slot routed through an adapter (set_slot_lora) hold a
+    // reference; unreferenced ones stay loaded for reuse, up to
+    // lora_registry_max_idle of them, least recently used freed first
+    struct lora_registry_entry {
+        llama_adapter_lora_ptr adapter;
+        int32_t n_refs = 0;
+        uint64_t last_used = 0;
+    };
+    std::mutex lora_registry_mutex;
+    std::map<std::string, lora_registry_entry> lora_registry;
+    size_t lora_registry_max_idle = 2;
+    uint64_t lora_registry_clock = 0;
+    // Adapter init and free both edit the model's adapter set, so they run
+    // under lora_load_mutex rather than the registry lock; frees that would
+    // wait for a running load are left in lora_pending_free for it
+    std::mutex lora_load_mutex;
+    std::vector<llama_adapter_lora_ptr> lora_pending_free;
+    // Loads the adapter at path on first use; throws if it does not fit the model
+    llama_adapter_lora * getLoraAdapter(const std::string &path);
+    // getLoraAdapter plus a reference, dropped again by releaseLoraAdapter
+    llama_adapter_lora * acquireLoraAdapter(const std::string &path);
+    void releaseLoraAdapter(const std::string &path);
+    llama_adapter_lora * load_lora(const std::string &path, bool acquire);
+    std::vector<llama_adapter_lora_ptr> evict_idle_lora_locked();
+    void free_lora_adapters(std::vector<llama_adapter_lora_ptr> adapters);
     void applyLoraAdapters(std::vector<common_adapter_lora_info> lora);
     void removeLoraAdapters();
     std::vector<common_adapter_lora_info> getLoadedLoraAdapters();
@@ -178,7 +264,11 @@ struct llama_rn_context {
     // Multimodal fields and methods
     llama_rn_context_mtmd *mtmd_wrapper = nullptr;
     bool has_multimodal = false;
-    bool initMultimodal(const std::string &mmproj_path, bool use_gpu, int image_min_tokens = -1, int image_max_tokens = -1);
+    // media_cache_mb bounds the in-memory cache of media encoder outputs (0
+    // disables it); with media_cache_dir set, evicted entries spill there,
+    // up to media_cache_disk_mb
+    bool initMultimodal(const std::string &mmproj_path, bool use_gpu, int image_min_tokens = -1, int image_max_tokens = -1,
+                        int media_cache_mb = 32, const std::string &media_cache_dir = "", int media_cache_disk_mb = 256);
     bool isMultimodalEnabled() const;
     bool isMultimodalSupportVision() const;
     bool isMultimodalSupportAudio() const;
@@ -0,0 +1,375 @@
+#include "rn-media-cache.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <iterator>
+#include <string>
+#include <system_error>
+
+namespace rnllama {
+
+namespace {
+
+const uint32_t SPILL_MAGIC = 0x454d4e52; // "RNME"
+const uint32_t SPILL_VERSION = 1;
+
+uint64_t fnv1a(const std::string & s) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (unsigned char c : s) {
+        h ^= c;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+std::string spill_file_path(const std::string & dir, const std::string & key) {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.embd", (unsigned long long) fnv1a(key));
+    return dir + "/" + name;
+}
+
+size_t spill_file_bytes(size_t key_size, size_t n_floats) {
+    return 3 * sizeof(uint32_t) + key_size + sizeof(uint64_t) + n_floats * sizeof(float);
+}
+
+// Size of an open file, or -1; leaves the position at the start
+long file_size(FILE * f) {
+    if (fseek(f, 0, SEEK_END) != 0) {
+        return -1;
+    }
+    const long size = ftell(f);
+    return fseek(f, 0, SEEK_SET) == 0 ? size : -1;
+}
+
+// Reads the header and key of a spill file. Lengths stored in the file are
+// checked against its size before anything is allocated for them
+bool read_spill_key(FILE * f, long size, std::string & key) {
+    uint32_t header[3] = {};
+    if (size < (long) spill_file_bytes(0, 0) ||
+        fread(header, sizeof(header), 1, f) != 1 ||
+        header[0] != SPILL_MAGIC || header[1] != SPILL_VERSION ||
+        header[2] > (uint64_t) size - spill_file_bytes(0, 0)) {
+        return false;
+    }
+    key.resize(header[2]);
+    return fread(&key[0], 1, key.size(), f) == key.size();
+}
+
+// Reads the embeddings stored under key from path; file_bytes gets the size
+bool read_spill_file(const std::string & path, const std::string & key, std::vector<float> & out, size_t & file_bytes) {
+    FILE * f = fopen(path.c_str(), "rb");
+    if (f == nullptr) {
+        return false;
+    }
+    // The file name is a hash of the key; the stored key settles collisions
+    const long size = file_size(f);
+    std::string stored_key;
+    uint64_t n = 0;
+    bool ok = size >= 0 && read_spill_key(f, size, stored_key) && stored_key == key &&
+              fread(&n, sizeof(n), 1, f) == 1;
+    // A truncated or corrupt file must not size the output: the float count
+    // has to account for exactly the rest of the file
+    ok = ok && n <= (uint64_t) size / sizeof(float) &&
+         spill_file_bytes(key.size(), (size_t) n) == (size_t) size;
+    if (ok) {
+        out.resize((size_t) n);
+        ok = fread(out.data(), sizeof(float), out.size(), f) == out.size();
+        file_bytes = (size_t) size;
+    }
+    fclose(f);
+    return ok;
+}
+
+// Writes data to path through a temporary file; returns the bytes written or 0
+size_t write_spill_file(const std::string & path, const std::string & key, const std::vector<float> & data) {
+    // Two evictions of the same key may write at once; each gets its own
+    // temporary file and the last rename wins
+    static std::atomic<uint64_t> seq{0};
+    const std::string tmp_path = path + "." + std::to_string(seq++) + ".tmp";
+    FILE * f = fopen(tmp_path.c_str(), "wb");
+    if (f == nullptr) {
+        return 0;
+    }
+    const uint32_t header[3] = { SPILL_MAGIC, SPILL_VERSION, (uint32_t) key.size() };
+    const uint64_t n = data.size();
+    bool ok = fwrite(header, sizeof(header), 1, f) == 1 &&
+              fwrite(key.data(), 1, key.size(), f) == key.size() &&
+              fwrite(&n, sizeof(n), 1, f) == 1 &&
+              fwrite(data.data(), sizeof(float), data.size(), f) == data.size();
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        remove(tmp_path.c_str());
+        return 0;
+    }
+    return spill_file_bytes(key.size(), data.size());
+}
+
+// Spill files in dir as (key, bytes), least recently modified first
+std::vector<std::pair<std::string, size_t>> scan_spill_dir(const std::string & dir) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    std::vector<std::pair<fs::file_time_type, std::pair<std::string, size_t>>> found;
+    for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+        const fs::path & path = it->path();
+        if (path.extension() != ".embd" || !it->is_regular_file(ec)) {
+            continue;
+        }
+        const fs::file_time_type mtime = it->last_write_time(ec);
+        if (ec) {
+            ec.clear();
+            continue;
+        }
+        FILE * f = fopen(path.string().c_str(), "rb");
+        if (f == nullptr) {
+            continue;
+        }
+        const long size = file_size(f);
+        std::string key;
+        const bool ok = size >= 0 && read_spill_key(f, size, key);
+        fclose(f);
+        if (ok && spill_file_path(dir, key) == path.string()) {
+            found.push_back({ mtime, { key, (size_t) size } });
+        }
+    }
+    std::sort(found.begin(), found.end(), [](const auto & a, const auto & b) { return a.first < b.first; });
+    std::vector<std::pair<std::string, size_t>> files;
+    files.reserve(found.size());
+    for (auto & f : found) {
+        files.push_back(std::move(f.second));
+    }
+    return files;
+}
+
+void remove_files(const std::vector<std::string> & paths) {
+    for (const auto & path : paths) {
+        remove(path.c_str());
+    }
+}
+
+} // namespace
+
+bool rn_media_embd_cache::enabled() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return max_bytes > 0;
+}
+
+void rn_media_embd_cache::configure(size_t max_bytes_, const std::string & spill_dir_, size_t max_disk_bytes_) {
+    std::string dir = spill_dir_;
+    while (!dir.empty() && dir.back() == '/') {
+        dir.pop_back();
+    }
+    bool dir_changed = false;
+    std::vector<std::string> to_remove;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        max_bytes = max_bytes_;
+        if (dir != spill_dir) {
+            // Files in the old directory are left alone, only forgotten
+            disk_lru.clear();
+            disk_index.clear();
+            n_disk_bytes = 0;
+            spill_dir = dir;
+            dir_changed = true;
+        }
+        max_disk_bytes = max_disk_bytes_;
+
+        // Shrink to the new budgets
+        while (n_bytes > max_bytes && !lru.empty()) {
+            n_bytes -= lru.back().second.size() * sizeof(float);
+            index.erase(lru.back().first);
+            lru.pop_back();
+        }
+        to_remove = evict_disk_locked();
+    }
+    remove_files(to_remove);
+    if (!dir_changed || dir.empty()) {
+        return;
+    }
+
+    // Files left by earlier sessions count against the disk budget from the
+    // start; the oldest modified become the first to go
+    const auto found = scan_spill_dir(dir);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (spill_dir != dir) {
+            return;
+        }
+        // Anything spilled while the directory was scanned is newer
+        for (auto it = found.rbegin(); it != found.rend(); ++it) {
+            if (disk_index.find(it->first) == disk_index.end()) {
+                disk_lru.emplace_back(it->first, it->second);
+                disk_index[it->first] = std::prev(disk_lru.end());
+                n_disk_bytes += it->second;
+            }
+        }
+        to_remove = evict_disk_locked();
+    }
+    remove_files(to_remove);
+}
+
+std::string rn_media_embd_cache::spill_path(const std::string & key) const {
+    return spill_file_path(spill_dir, key);
+}
+
+void rn_media_embd_cache::touch_disk(const std::string & key, size_t bytes) {
+    auto it = disk_index.find(key);
+    if (it != disk_index.end()) {
+        n_disk_bytes -= it->second->second;
+        disk_lru.erase(it->second);
+    }
+    disk_lru.emplace_front(key, bytes);
+    disk_index[key] = disk_lru.begin();
+    n_disk_bytes += bytes;
+}
+
+std::vector<std::string> rn_media_embd_cache::evict_disk_locked() {
+    std::vector<std::string> to_remove;
+    while (n_disk_bytes > max_disk_bytes && !disk_lru.empty()) {
+        const auto & victim = disk_lru.back();
+        to_remove.push_back(spill_path(victim.first));
+        n_disk_bytes -= victim.second;
+        disk_index.erase(victim.first);
+        disk_lru.pop_back();
+    }
+    return to_remove;
+}
+
+void rn_media_embd_cache::insert_locked(const std::string & key, std::vector<float> && data, std::vector<entry> & to_spill) {
+    const size_t bytes = data.size() * sizeof(float);
+    if (bytes > max_bytes) {
+        return;
+    }
+    auto it = index.find(key);
+    if (it != index.end()) {
+        n_bytes -= it->second->second.size() * sizeof(float);
+        lru.erase(it->second);
+        index.erase(it);
+    }
+    lru.emplace_front(key, std::move(data));
+    index[key] = lru.begin();
+    n_bytes += bytes;
+
+    while (n_bytes > max_bytes) {
+        entry & victim = lru.back();
+        n_bytes -= victim.second.size() * sizeof(float);
+        index.erase(victim.first);
+        if (!spill_dir.empty() && max_disk_bytes > 0 &&
+            disk_index.find(victim.first) == disk_index.end() &&
+            spill_file_bytes(victim.first.size(), victim.second.size()) <= max_disk_bytes) {
+            to_spill.push_back(std::move(victim));
+        }
+        lru.pop_back();
+    }
+}
+
+void rn_media_embd_cache::flush_spills(std::vector<entry> && to_spill, const std::string & dir, std::vector<std::string> && to_remove) {
+    remove_files(to_remove);
+    if (to_spill.empty()) {
+        return;
+    }
+    std::vector<std::pair<std::string, size_t>> written;
+    for (const entry & e : to_spill) {
+        const size_t bytes = write_spill_file(spill_file_path(dir, e.first), e.first, e.second);
+        if (bytes > 0) {
+            written.emplace_back(e.first, bytes);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (spill_dir != dir) {
+            // Reconfigured meanwhile: the files stay behind, unaccounted
+            return;
+        }
+        for (const auto & w : written) {
+            touch_disk(w.first, w.second);
+        }
+        to_remove = evict_disk_locked();
+    }
+    remove_files(to_remove);
+}
+
+bool rn_media_embd_cache::get(const std::string & key, std::vector<float> & out) {
+    std::string dir;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (max_bytes == 0) {
+            return false;
+        }
+        auto it = index.find(key);
+        if (it != index.end()) {
+            lru.splice(lru.begin(), lru, it->second);
+            out = it->second->second;
+            hits++;
+            return true;
+        }
+        if (spill_dir.empty()) {
+            misses++;
+            return false;
+        }
+        dir = spill_dir;
+    }
+
+    size_t file_bytes = 0;
+    const bool loaded = read_spill_file(spill_file_path(dir, key), key, out, file_bytes);
+
+    std::vector<entry> to_spill;
+    std::vector<std::string> to_remove;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!loaded) {
+            misses++;
+            return false;
+        }
+        disk_hits++;
+        if (spill_dir == dir) {
+            // A hit makes the file the most recently used one
+            touch_disk(key, file_bytes);
+            to_remove = evict_disk_locked();
+        }
+        if (max_bytes > 0) {
+            insert_locked(key, std::vector<float>(out), to_spill);
+        }
+    }
+    flush_spills(std::move(to_spill), dir, std::move(to_remove));
+    return true;
+}
+
+void rn_media_embd_cache::put(const std::string & key, const float * data, size_t n_floats) {
+    if (data == nullptr || n_floats == 0) {
+        return;
+    }
+    std::vector<entry> to_spill;
+    std::string dir;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (max_bytes == 0) {
+            return;
+        }
+        insert_locked(key, std::vector<float>(data, data + n_floats), to_spill);
+        dir = spill_dir;
+    }
+    flush_spills(std::move(to_spill), dir, {});
+}
+
+void rn_media_embd_cache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    lru.clear();
+    index.clear();
+    n_bytes = 0;
+}
+
+rn_media_embd_cache::stats rn_media_embd_cache::get_stats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    stats s;
+    s.n_entries = lru.size();
+    s.n_bytes = n_bytes;
+    s.n_disk_entries = disk_lru.size();
+    s.n_disk_bytes = n_disk_bytes;
+    s.hits = hits;
+    s.disk_hits = disk_hits;
+    s.misses = misses;
+    return s;
+}
+
+} // namespace rnllama
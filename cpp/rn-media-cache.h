@@ -0,0 +1,76 @@
+#ifndef RN_MEDIA_CACHE_H
+#define RN_MEDIA_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace rnllama {
+
+// Bounded LRU of media encoder outputs (vision/audio embeddings), keyed by
+// content: the projector identity plus the media chunk identity. One cache
+// serves every slot and turn of a multimodal context, so an image that comes
+// back (another slot, another conversation, a slot evicted in between) skips
+// the encoder. Entries pushed out of the memory budget spill to spill_dir
+// when one is set; a later hit reads them back. Thread-safe.
+struct rn_media_embd_cache {
+    struct stats {
+        size_t n_entries = 0;
+        size_t n_bytes = 0;
+        size_t n_disk_entries = 0;
+        size_t n_disk_bytes = 0;
+        int64_t hits = 0;
+        int64_t disk_hits = 0;
+        int64_t misses = 0;
+    };
+
+    // max_bytes == 0 disables the cache (spilled files are kept on disk)
+    void configure(size_t max_bytes, const std::string & spill_dir = "", size_t max_disk_bytes = 0);
+    bool enabled() const;
+
+    // Copies the embeddings stored under key into out; false on a miss
+    bool get(const std::string & key, std::vector<float> & out);
+    void put(const std::string & key, const float * data, size_t n_floats);
+
+    // Drops the in-memory entries; spilled files stay for later sessions
+    void clear();
+    stats get_stats();
+
+private:
+    using entry = std::pair<std::string, std::vector<float>>;
+
+    mutable std::mutex mutex;
+    size_t max_bytes = 0;
+    size_t max_disk_bytes = 0;
+    std::string spill_dir;
+
+    std::list<entry> lru;  // Most recently used first
+    std::unordered_map<std::string, std::list<entry>::iterator> index;
+    size_t n_bytes = 0;
+
+    // Files written by this cache, most recently used first (key, bytes)
+    std::list<std::pair<std::string, size_t>> disk_lru;
+    std::unordered_map<std::string, std::list<std::pair<std::string, size_t>>::iterator> disk_index;
+    size_t n_disk_bytes = 0;
+
+    int64_t hits = 0;
+    int64_t disk_hits = 0;
+    int64_t misses = 0;
+
+    // File reads and writes run without the mutex held: the *_locked helpers
+    // only decide what to spill or remove, and flush_spills() does the I/O
+    std::string spill_path(const std::string & key) const;
+    void touch_disk(const std::string & key, size_t bytes);
+    std::vector<std::string> evict_disk_locked();
+    void insert_locked(const std::string & key, std::vector<float> && data, std::vector<entry> & to_spill);
+    void flush_spills(std::vector<entry> && to_spill, const std::string & dir, std::vector<std::string> && to_remove);
+};
+
+} // namespace rnllama
+
+#endif /* RN_MEDIA_CACHE_H */
@@ -2,6 +2,7 @@
 
 #include "rn-llama.h"
 #include "rn-common.hpp"
+#include "rn-media-cache.h"
 #include "tools/mtmd/mtmd.h"
 #include "tools/mtmd/mtmd-helper.h"
 #include "tools/mtmd/clip.h"
@@ -10,6 +11,10 @@
 #include <vector>
 #include <cstdint>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <sys/stat.h>
 
 namespace rnllama {
 
@@ -25,10 +30,22 @@ using mtmd_state_capture_fn =
     std::function<void(const std::vector<llama_token> &, size_t)>;
 using mtmd_state_invalidate_fn = std::function<void(size_t)>;
 
+struct mtmd_prepared_media;
+struct mtmd_tokenize_result;
+
 // MTMD context structure
 struct llama_rn_context_mtmd {
     mtmd_context *mtmd_ctx = nullptr;
 
+    // mtmd_encode_chunk() writes one shared output buffer; held from an encode
+    // until its embeddings are copied or decoded
+    std::mutex encode_mutex;
+
+    // Encoder outputs by content, shared by every slot and turn. Keys start
+    // with projector_id (projector file and image token limits).
+    rn_media_embd_cache embd_cache;
+    std::string projector_id;
+
     // State fields
     std::vector<std::string> bitmap_past_hashes;
     // Number of prompt tokens reused from the cache on the last processMedia call
@@ -66,9 +83,30 @@ struct llama_rn_context_mtmd {
         int32_t seq_id,  // Sequence ID for parallel slots
         mtmd_state_recover_fn recover = nullptr,
         mtmd_state_capture_fn capture = nullptr,
-        mtmd_state_invalidate_fn invalidate = nullptr
+        mtmd_state_invalidate_fn invalidate = nullptr,
+        mtmd_prepared_media *prepared = nullptr  // From prepareMedia(); consumed
+    );
+
+    // Load, tokenize and encode the media of a prompt without touching the
+    // llama context, so it can run while other sequences decode. Media chunks
+    // inside the cached prefix (same identities) are left for processMedia to
+    // reuse; it encodes any chunk it still needs that has no embeddings here.
+    std::unique_ptr<mtmd_prepared_media> prepareMedia(
+        const std::string &prompt,
+        const std::vector<std::string> &media_paths,
+        const llama_model *model,
+        const std::vector<llama_token> &cached_tokens,
+        const std::vector<std::string> &cached_hashes
     );
 
+    // Embedding cache key per chunk (empty for text chunks and media that
+    // cannot be identified safely)
+    std::vector<std::string> chunkCacheKeys(const mtmd_tokenize_result &result) const;
+
+    // Embeddings of one media chunk, from embd_cache or the encoder
+    bool encodeChunk(const mtmd_input_chunk *chunk, const std::string &key, size_t n_embd,
+                     std::vector<float> &out);
+
     // Check if multimodal is enabled
     bool isEnabled(bool has_multimodal) const;
 
@@ -166,9 +204,35 @@ struct mtmd_tokenize_result {
     mtmd_input_chunks* chunks = nullptr;
 };
 
+// Output of llama_rn_context_mtmd::prepareMedia
+struct mtmd_prepared_media {
+    mtmd_tokenize_result result;                   // Owns result.chunks until processMedia takes them
+    std::vector<std::vector<float>> chunk_embd;    // Per chunk; empty = not encoded
+
+    mtmd_prepared_media() = default;
+    mtmd_prepared_media(const mtmd_prepared_media &) = delete;
+    mtmd_prepared_media &operator=(const mtmd_prepared_media &) = delete;
+    ~mtmd_prepared_media() {
+        if (result.chunks != nullptr) {
+            mtmd_input_chunks_free(result.chunks);
+        }
+    }
+};
+
 // Forward declaration for llama_rn_context
 struct llama_rn_context;
 
+// Append the default media marker when the prompt has none
+inline std::string with_media_marker(const std::string &prompt) {
+    std::string full_prompt = prompt;
+    auto default_media_marker = mtmd_default_marker();
+    if (full_prompt.find(default_media_marker) == std::string::npos) {
+        full_prompt += " ";
+        full_prompt += default_media_marker;
+    }
+    return full_prompt;
+}
+
 // Tokenize text with media function
 inline mtmd_tokenize_result tokenizeWithMedia(llama_rn_context_mtmd *mtmd_wrapper, const std::string &prompt, const std::vector<std::string> &media_paths) {
     mtmd_tokenize_result result;
@@ -428,22 +492,25 @@ inline void llama_rn_context_mtmd::processMedia(
     int32_t seq_id,  // Sequence ID for parallel slots
     mtmd_state_recover_fn recover,
     mtmd_state_capture_fn capture,
-    mtmd_state_invalidate_fn invalidate
+    mtmd_state_invalidate_fn invalidate,
+    mtmd_prepared_media *prepared
 ) {
     // Multimodal path
-    std::string full_prompt = prompt;
-    auto default_media_marker = mtmd_default_marker();
-    // Add media marker if it doesn't already exist
-    if (full_prompt.find(default_media_marker) == std::string::npos) {
-        full_prompt += " ";
-        full_prompt += default_media_marker;
-    }
+    std::string full_prompt = with_media_marker(prompt);
 
     LOG_INFO("[DEBUG] Processing message with role=user, content=%s", full_prompt.c_str());
     LOG_INFO("[DEBUG] Processing %zu media with prompt: %s", media_paths.size(), prompt.c_str());
     LOG_INFO("[DEBUG] Current context state: n_past=%d, n_ctx=%d", n_past, n_ctx);
 
-    auto result = tokenizeWithMedia(this, full_prompt, media_paths);
+    mtmd_tokenize_result result;
+    std::vector<std::vector<float>> chunk_embd;
+    if (prepared != nullptr) {
+        result = std::move(prepared->result);
+        prepared->result.chunks = nullptr;
+        chunk_embd = std::move(prepared->chunk_embd);
+    } else {
+        result = tokenizeWithMedia(this, full_prompt, media_paths);
+    }
 
     auto all_tokens = result.tokens;
     auto chunks = result.chunks;
@@ -636,6 +703,8 @@ inline void llama_rn_context_mtmd::processMedia(
     }
 
     size_t num_chunks = mtmd_input_chunks_size(chunks);
+    const size_t n_embd = (size_t) llama_model_n_embd_inp(llama_get_model(ctx));
+    std::vector<std::string> chunk_keys;
 
     for (size_t i = 0; i < chunk_pos.size(); i++) {
 
@@ -646,16 +715,31 @@ inline void llama_rn_context_mtmd::processMedia(
             bool chunk_logits_last = (i == num_chunks - 1);
             auto chunk = mtmd_input_chunks_get(chunks, i);
 
-            int32_t res = mtmd_helper_eval_chunk_single(
+            // Media not encoded ahead by prepareMedia goes through the cache
+            // and the encoder now
+            chunk_embd.resize(num_chunks);
+            if (mtmd_input_chunk_get_type(chunk) != MTMD_INPUT_CHUNK_TYPE_TEXT && chunk_embd[i].empty()) {
+                if (chunk_keys.empty()) {
+                    chunk_keys = chunkCacheKeys(result);
+                }
+                if (!encodeChunk(chunk, chunk_keys[i], n_embd, chunk_embd[i])) {
+                    mtmd_input_chunks_free(chunks);
+                    throw std::runtime_error("Failed to evaluate chunks");
+                }
+            }
+
+            int32_t res = mtmd_helper_eval_chunk_encoded(
                 this->mtmd_ctx,
                 ctx,
                 chunk,
+                chunk_embd[i].empty() ? nullptr : chunk_embd[i].data(),
                 n_past,
                 seq_id,
                 n_batch,
                 chunk_logits_last,
                 &new_n_past
             );
+            std::vector<float>().swap(chunk_embd[i]);
             if (res != 0) {
                 mtmd_input_chunks_free(chunks);
                 throw std::runtime_error("Failed to evaluate chunks");
@@ -693,6 +777,121 @@ inline void llama_rn_context_mtmd::processMedia(
     mtmd_input_chunks_free(chunks);
 }
 
+inline std::unique_ptr<mtmd_prepared_media> llama_rn_context_mtmd::prepareMedia(
+    const std::string &prompt,
+    const std::vector<std::string> &media_paths,
+    const llama_model *model,
+    const std::vector<llama_token> &cached_tokens,
+    const std::vector<std::string> &cached_hashes
+) {
+    auto prepared = std::make_unique<mtmd_prepared_media>();
+    prepared->result = tokenizeWithMedia(this, with_media_marker(prompt), media_paths);
+    const mtmd_tokenize_result &result = prepared->result;
+
+    // Same identity rule as processMedia: any unknown or changed media means
+    // nothing past the first media chunk is reusable
+    size_t n_reusable = 0;
+    if (!result.bitmap_hashes.empty() && result.bitmap_hashes == cached_hashes &&
+        std::none_of(result.bitmap_hashes.begin(), result.bitmap_hashes.end(),
+                     [](const std::string &id) { return id.empty(); })) {
+        n_reusable = find_common_prefix_length(cached_tokens, result.tokens);
+    }
+
+    const size_t n_embd = (size_t) llama_model_n_embd_inp(model);
+    const size_t num_chunks = mtmd_input_chunks_size(result.chunks);
+    const std::vector<std::string> chunk_keys = chunkCacheKeys(result);
+    prepared->chunk_embd.resize(num_chunks);
+    for (size_t i = 0; i < num_chunks; i++) {
+        const mtmd_input_chunk *chunk = mtmd_input_chunks_get(result.chunks, i);
+        if (mtmd_input_chunk_get_type(chunk) == MTMD_INPUT_CHUNK_TYPE_TEXT) {
+            continue;
+        }
+        // The last chunk is always encoded: an exact prompt replay decodes it again
+        const size_t chunk_end = i + 1 < num_chunks ? result.chunk_pos[i + 1] : result.tokens.size();
+        if (i + 1 < num_chunks && chunk_end <= n_reusable) {
+            continue;
+        }
+
+        if (!encodeChunk(chunk, chunk_keys[i], n_embd, prepared->chunk_embd[i])) {
+            throw std::runtime_error("Failed to encode media");
+        }
+    }
+    return prepared;
+}
+
+inline std::vector<std::string> llama_rn_context_mtmd::chunkCacheKeys(const mtmd_tokenize_result &result) const {
+    const size_t num_chunks = mtmd_input_chunks_size(result.chunks);
+    std::vector<std::string> keys(num_chunks);
+    if (!embd_cache.enabled()) {
+        return keys;
+    }
+
+    // bitmap_hashes holds one entry per input source, then one per media chunk
+    std::vector<std::string> chunk_ids;
+    for (size_t i = 0; i < num_chunks; i++) {
+        const mtmd_input_chunk *chunk = mtmd_input_chunks_get(result.chunks, i);
+        if (mtmd_input_chunk_get_type(chunk) != MTMD_INPUT_CHUNK_TYPE_TEXT) {
+            const char *id = mtmd_input_chunk_get_id(chunk);
+            chunk_ids.push_back(id != nullptr ? id : "");
+        }
+    }
+    if (result.bitmap_hashes.size() < chunk_ids.size()) {
+        return keys;
+    }
+    // A chunk id only names the first source of a merged chunk: every source
+    // must name a chunk of its own, or a key could stand for other content
+    const size_t n_sources = result.bitmap_hashes.size() - chunk_ids.size();
+    for (size_t i = 0; i < n_sources; i++) {
+        const std::string &source = result.bitmap_hashes[i];
+        if (source.compare(0, 7, "source:") != 0 ||
+            std::find(chunk_ids.begin(), chunk_ids.end(), source.substr(7)) == chunk_ids.end()) {
+            return keys;
+        }
+    }
+
+    // Images sliced into several chunks share one id; the ordinal tells them apart
+    std::unordered_map<std::string, int> n_seen;
+    for (size_t i = 0; i < num_chunks; i++) {
+        const mtmd_input_chunk *chunk = mtmd_input_chunks_get(result.chunks, i);
+        const mtmd_input_chunk_type type = mtmd_input_chunk_get_type(chunk);
+        if (type == MTMD_INPUT_CHUNK_TYPE_TEXT) {
+            continue;
+        }
+        const char *id = mtmd_input_chunk_get_id(chunk);
+        if (id == nullptr || id[0] == '\0') {
+            continue;
+        }
+        keys[i] = projector_id + ":" + std::to_string((int) type) + ":" +
+            std::to_string(mtmd_input_chunk_get_n_tokens(chunk)) + ":" +
+            std::to_string(mtmd_input_chunk_get_n_pos(chunk)) + ":" + id + "#" +
+            std::to_string(n_seen[id]++);
+    }
+    return keys;
+}
+
+inline bool llama_rn_context_mtmd::encodeChunk(
+    const mtmd_input_chunk *chunk,
+    const std::string &key,
+    size_t n_embd,
+    std::vector<float> &out
+) {
+    if (!key.empty() && embd_cache.get(key, out)) {
+        LOG_VERBOSE("[DEBUG] Media embeddings served from cache (%zu floats)", out.size());
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(encode_mutex);
+    if (mtmd_encode_chunk(mtmd_ctx, chunk) != 0) {
+        return false;
+    }
+    const float *embd = mtmd_get_output_embd(mtmd_ctx);
+    out.assign(embd, embd + n_embd * mtmd_input_chunk_get_n_tokens(chunk));
+    if (!key.empty()) {
+        embd_cache.put(key, out.data(), out.size());
+    }
+    return true;
+}
+
 inline llama_rn_context_mtmd::llama_rn_context_mtmd(
     const std::string &mmproj_path,
     bool use_gpu,
@@ -733,6 +932,17 @@ inline llama_rn_context_mtmd::llama_rn_context_mtmd(
     }
     this->mtmd_ctx = mtmd_ctx;
 
+    // Replacing the projector file (or the image token limits) changes the
+    // encoder output, so it is part of every embedding cache key
+    std::string projector_desc = mmproj_path + "|" + std::to_string(image_min_tokens) + "|" +
+        std::to_string(image_max_tokens);
+    struct stat st;
+    if (stat(mmproj_path.c_str(), &st) == 0) {
+        projector_desc += "|" + std::to_string((long long) st.st_size) + "|" +
+            std::to_string((long long) st.st_mtime);
+    }
+    projector_id = fnv_hash((const uint8_t *) projector_desc.data(), projector_desc.size());
+
     has_multimodal = true;
 
     // Check if the model uses M-RoPE or non-causal attention
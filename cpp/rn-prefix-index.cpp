@@ -0,0 +1,246 @@
+#include "rn-prefix-index.h"
+#include <algorithm>
+
+namespace rnllama {
+
+struct rn_prefix_index::node {
+    std::vector<llama_token> edge;     // Tokens on the edge from the parent
+    size_t depth = 0;                  // Tokens from the root to the end of edge
+    node * parent = nullptr;
+    std::unordered_map<llama_token, std::unique_ptr<node>> children; // Keyed by edge[0]
+    std::vector<entry_id> entries;     // Sequences ending exactly here
+    std::array<uint32_t, RN_PREFIX_KIND_COUNT> n_subtree{}; // Entries at or below, per kind
+
+    bool has_entry(int32_t kind) const {
+        for (const auto & e : entries) {
+            if (e.first == kind) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+rn_prefix_index::rn_prefix_index() : root(new node()) {
+}
+
+rn_prefix_index::~rn_prefix_index() = default;
+
+void rn_prefix_index::add_count(node * n, rn_prefix_kind kind, int32_t delta) {
+    for (; n != nullptr; n = n->parent) {
+        n->n_subtree[kind] += delta;
+    }
+}
+
+void rn_prefix_index::insert(rn_prefix_kind kind, int32_t key, const llama_token * tokens, size_t n_tokens) {
+    remove(kind, key);
+
+    node * cur = root.get();
+    size_t i = 0;
+    while (i < n_tokens) {
+        auto it = cur->children.find(tokens[i]);
+        if (it == cur->children.end()) {
+            auto child = std::make_unique<node>();
+            child->edge.assign(tokens + i, tokens + n_tokens);
+            child->depth = n_tokens;
+            child->parent = cur;
+            node * next = child.get();
+            cur->children.emplace(tokens[i], std::move(child));
+            cur = next;
+            i = n_tokens;
+            break;
+        }
+
+        node * child = it->second.get();
+        size_t j = 0;
+        while (j < child->edge.size() && i + j < n_tokens && child->edge[j] == tokens[i + j]) {
+            j++;
+        }
+        if (j == child->edge.size()) {
+            cur = child;
+            i += j;
+            continue;
+        }
+
+        // Split the edge at j: cur -> mid -> child
+        auto mid = std::make_unique<node>();
+        mid->edge.assign(child->edge.begin(), child->edge.begin() + j);
+        mid->depth = cur->depth + j;
+        mid->parent = cur;
+        mid->n_subtree = child->n_subtree;
+
+        std::unique_ptr<node> owned = std::move(it->second);
+        owned->edge.erase(owned->edge.begin(), owned->edge.begin() + j);
+        owned->parent = mid.get();
+        mid->children.emplace(owned->edge.front(), std::move(owned));
+
+        node * next = mid.get();
+        it->second = std::move(mid);
+        cur = next;
+        i += j;
+    }
+
+    cur->entries.emplace_back(kind, key);
+    add_count(cur, kind, 1);
+    terminals[entry_id(kind, key)] = cur;
+}
+
+void rn_prefix_index::remove(rn_prefix_kind kind, int32_t key) {
+    auto it = terminals.find(entry_id(kind, key));
+    if (it == terminals.end()) {
+        return;
+    }
+    node * n = it->second;
+    terminals.erase(it);
+
+    n->entries.erase(std::remove(n->entries.begin(), n->entries.end(), entry_id(kind, key)),
+                     n->entries.end());
+    add_count(n, kind, -1);
+    prune(n);
+}
+
+// Drop nodes that no longer lead to an entry and merge pass-through nodes
+// back into their single child, keeping the tree compressed
+void rn_prefix_index::prune(node * n) {
+    while (n != root.get() && n->entries.empty() && n->children.empty()) {
+        node * parent = n->parent;
+        parent->children.erase(n->edge.front());
+        n = parent;
+    }
+    if (n == root.get() || !n->entries.empty() || n->children.size() != 1) {
+        return;
+    }
+
+    std::unique_ptr<node> child = std::move(n->children.begin()->second);
+    n->children.clear();
+    n->edge.insert(n->edge.end(), child->edge.begin(), child->edge.end());
+    n->depth = child->depth;
+    n->entries = std::move(child->entries);
+    n->children = std::move(child->children);
+    for (auto & kv : n->children) {
+        kv.second->parent = n;
+    }
+    for (const auto & e : n->entries) {
+        terminals[e] = n;
+    }
+}
+
+void rn_prefix_index::clear(rn_prefix_kind kind) {
+    std::vector<int32_t> keys;
+    for (const auto & t : terminals) {
+        if (t.first.first == kind) {
+            keys.push_back(t.first.second);
+        }
+    }
+    for (int32_t key : keys) {
+        remove(kind, key);
+    }
+}
+
+void rn_prefix_index::clear() {
+    terminals.clear();
+    root.reset(new node());
+}
+
+bool rn_prefix_index::contains(rn_prefix_kind kind, int32_t key) const {
+    return terminals.count(entry_id(kind, key)) > 0;
+}
+
+size_t rn_prefix_index::size(rn_prefix_kind kind) const {
+    return root->n_subtree[kind];
+}
+
+rn_prefix_match rn_prefix_index::find_longest_entry(
+    rn_prefix_kind kind,
+    const std::vector<llama_token> & query,
+    size_t max_len
+) const {
+    rn_prefix_match best;
+    max_len = std::min(max_len, query.size());
+
+    const node * cur = root.get();
+    size_t i = 0;
+    while (i < max_len && cur->n_subtree[kind] > 0) {
+        auto it = cur->children.find(query[i]);
+        if (it == cur->children.end()) {
+            break;
+        }
+        const node * child = it->second.get();
+        if (child->depth > max_len ||
+            !std::equal(child->edge.begin(), child->edge.end(), query.begin() + i)) {
+            break;
+        }
+        cur = child;
+        i = cur->depth;
+        for (const auto & e : cur->entries) {
+            if (e.first == kind) {
+                best.key = e.second;
+                best.n_match = cur->depth;
+                best.n_tokens = cur->depth;
+                break;
+            }
+        }
+    }
+    return best;
+}
+
+rn_prefix_match rn_prefix_index::find_longest_shared(
+    rn_prefix_kind kind,
+    const std::vector<llama_token> & query,
+    size_t max_len
+) const {
+    rn_prefix_match best;
+    max_len = std::min(max_len, query.size());
+
+    const node * cur = root.get();
+    const node * reached = nullptr;
+    size_t i = 0;
+    while (i < max_len) {
+        auto it = cur->children.find(query[i]);
+        if (it == cur->children.end() || it->second->n_subtree[kind] == 0) {
+            break;
+        }
+        const node * child = it->second.get();
+        size_t j = 0;
+        while (j < child->edge.size() && i + j < max_len && child->edge[j] == query[i + j]) {
+            j++;
+        }
+        i += j;
+        reached = child;
+        if (j < child->edge.size()) {
+            break;
+        }
+        cur = child;
+    }
+    if (reached == nullptr) {
+        return best;
+    }
+
+    // Any entry below the deepest reached node shares the walked prefix;
+    // descend to the nearest one
+    const node * n = reached;
+    while (!n->has_entry(kind)) {
+        const node * next = nullptr;
+        for (const auto & kv : n->children) {
+            if (kv.second->n_subtree[kind] > 0) {
+                next = kv.second.get();
+                break;
+            }
+        }
+        if (next == nullptr) {
+            return best;
+        }
+        n = next;
+    }
+    for (const auto & e : n->entries) {
+        if (e.first == kind) {
+            best.key = e.second;
+            break;
+        }
+    }
+    best.n_match = i;
+    best.n_tokens = n->depth;
+    return best;
+}
+
+} // namespace rnllama
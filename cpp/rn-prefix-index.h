@@ -0,0 +1,79 @@
+#ifndef RN_PREFIX_INDEX_H
+#define RN_PREFIX_INDEX_H
+
+#include "llama.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace rnllama {
+
+// What a cached token sequence is backed by
+enum rn_prefix_kind {
+    RN_PREFIX_SLOT = 0,        // Resident sequence of an idle parallel slot
+    RN_PREFIX_CHECKPOINT,      // In-memory prompt state checkpoint
+    RN_PREFIX_STATE_FILE,      // Saved state file on disk
+    RN_PREFIX_KIND_COUNT,
+};
+
+struct rn_prefix_match {
+    int32_t key = -1;       // Entry key (slot id, checkpoint id, file id); -1 = no match
+    size_t n_match = 0;     // Tokens shared with the query
+    size_t n_tokens = 0;    // Length of the matched entry's sequence
+};
+
+// Radix tree (compressed token trie) over cached token sequences. Lookups walk
+// the query once, so "longest cached prefix for this prompt" costs O(prompt
+// length) no matter how many sequences are indexed. Sequences that share a
+// prefix share its nodes.
+struct rn_prefix_index {
+    rn_prefix_index();
+    ~rn_prefix_index();
+
+    rn_prefix_index(const rn_prefix_index &) = delete;
+    rn_prefix_index & operator=(const rn_prefix_index &) = delete;
+
+    // Register (or replace) the sequence stored under (kind, key)
+    void insert(rn_prefix_kind kind, int32_t key, const llama_token * tokens, size_t n_tokens);
+    void insert(rn_prefix_kind kind, int32_t key, const std::vector<llama_token> & tokens) {
+        insert(kind, key, tokens.data(), tokens.size());
+    }
+    void remove(rn_prefix_kind kind, int32_t key);
+    void clear(rn_prefix_kind kind);
+    void clear();
+
+    bool contains(rn_prefix_kind kind, int32_t key) const;
+    size_t size(rn_prefix_kind kind) const;
+
+    // Longest entry whose whole sequence is a prefix of query[0, max_len).
+    // For snapshots that can only be restored exactly (checkpoints, recurrent
+    // state files).
+    rn_prefix_match find_longest_entry(rn_prefix_kind kind,
+                                       const std::vector<llama_token> & query,
+                                       size_t max_len) const;
+
+    // Longest prefix of query[0, max_len) shared with any entry. For memories
+    // that can be truncated to the shared prefix (KV sequences).
+    rn_prefix_match find_longest_shared(rn_prefix_kind kind,
+                                        const std::vector<llama_token> & query,
+                                        size_t max_len) const;
+
+private:
+    struct node;
+    using entry_id = std::pair<int32_t, int32_t>; // (kind, key)
+
+    std::unique_ptr<node> root;
+    std::map<entry_id, node *> terminals;
+
+    void add_count(node * n, rn_prefix_kind kind, int32_t delta);
+    void prune(node * n);
+};
+
+} // namespace rnllama
+
+#endif /* RN_PREFIX_INDEX_H */
@@ -7,10 +7,91 @@
 #include <algorithm>
 #include <chrono>
 #include <cstring>
+#include <iterator>
+#include <memory>
 #include <stdexcept>
 
 namespace rnllama {
 
+llama_rn_sampling_pool::~llama_rn_sampling_pool() {
+    stop();
+}
+
+void llama_rn_sampling_pool::start(int32_t n_workers) {
+    stop();
+    stopping = false;
+    for (int32_t i = 0; i < n_workers; i++) {
+        workers.emplace_back([this]() { worker_loop(); });
+    }
+}
+
+void llama_rn_sampling_pool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv_work.notify_all();
+    for (auto& worker : workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    workers.clear();
+}
+
+void llama_rn_sampling_pool::worker_loop() {
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        cv_work.wait(lock, [&]() { return stopping || generation != seen; });
+        if (stopping) {
+            return;
+        }
+        seen = generation;
+        const auto* fn = job;
+        const int32_t n = n_job_tasks;
+        n_busy++;
+        lock.unlock();
+
+        for (int32_t i = next_task.fetch_add(1); i < n; i = next_task.fetch_add(1)) {
+            (*fn)(i);
+        }
+
+        lock.lock();
+        if (--n_busy == 0) {
+            cv_done.notify_all();
+        }
+    }
+}
+
+void llama_rn_sampling_pool::run(int32_t n_tasks, const std::function<void(int32_t)>& fn) {
+    if (workers.empty() || n_tasks <= 1) {
+        for (int32_t i = 0; i < n_tasks; i++) {
+            fn(i);
+        }
+        return;
+    }
+
+    {
+        // A worker still draining the previous job must not see the counter reset
+        std::unique_lock<std::mutex> lock(mutex);
+        cv_done.wait(lock, [&]() { return n_busy == 0; });
+        job = &fn;
+        n_job_tasks = n_tasks;
+        next_task.store(0);
+        generation++;
+    }
+    cv_work.notify_all();
+
+    for (int32_t i = next_task.fetch_add(1); i < n_tasks; i = next_task.fetch_add(1)) {
+        fn(i);
+    }
+
+    // Every index is claimed; wait for the ones still running on workers
+    std::unique_lock<std::mutex> lock(mutex);
+    cv_done.wait(lock, [&]() { return n_busy == 0; });
+}
+
 // Constructor
 llama_rn_slot_manager::llama_rn_slot_manager(llama_rn_context* ctx) :
     parent_ctx(ctx),
@@ -29,9 +110,30 @@ llama_rn_slot_manager::llama_rn_slot_manager(llama_rn_context* ctx) :
 llama_rn_slot_manager::~llama_rn_slot_manager() {
     // Stop processing loop if active
     stop_processing_loop();
+    stop_media_worker();
+    sampling_pool.stop();
+    // Every accepted save lands before the manager goes away
+    state_writer.stop();
 
     reset_mtp_speculative();
 
+    // The context outlives the slots; its sequences must not keep their adapters
+    if (parent_ctx != nullptr && parent_ctx->ctx != nullptr) {
+        for (const auto& slot : slots) {
+            if (!slot.lora.empty()) {
+                llama_set_adapters_lora_seq(parent_ctx->ctx, slot.id, nullptr, 0, nullptr);
+            }
+        }
+    }
+    if (parent_ctx != nullptr) {
+        for (auto& slot : slots) {
+            for (const auto& la : slot.lora) {
+                parent_ctx->releaseLoraAdapter(la.path);
+            }
+            slot.lora.clear();
+        }
+    }
+
     // Free batch
     if (batch.token != nullptr) {
         llama_batch_free(batch);
@@ -68,6 +170,17 @@ bool llama_rn_slot_manager::init(int32_t n_parallel_, int32_t n_batch_, int32_t
         return false;
     }
 
+    // Sampling is CPU-bound per slot; the decode threads are idle meanwhile
+    int32_t n_threads = parent_ctx != nullptr ? parent_ctx->params.cpuparams.n_threads : 0;
+    if (n_threads <= 0) {
+        n_threads = (int32_t) std::max(1u, std::thread::hardware_concurrency());
+    }
+    const int32_t n_workers = std::max(0, std::min(n_parallel, n_threads) - 1);
+    sampling_pool.start(n_workers);
+    if (n_workers > 0) {
+        LOG_INFO("Sampling fans out over %d worker thread(s)", n_workers);
+    }
+
     LOG_INFO("Slot manager initialized successfully");
     return true;
 }
@@ -190,7 +303,13 @@ int32_t llama_rn_slot_manager::queue_request(
     int32_t save_state_size,
     std::function<void(const completion_token_output&)> on_token,
     std::function<void(llama_rn_slot*)> on_complete,
-    int32_t request_id
+    int32_t request_id,
+    const std::vector<std::string>& media_hashes,
+    int32_t priority,
+    const std::vector<common_adapter_lora_info>& lora,
+    bool reuse_state_files,
+    llama_rn_audio_chunk_cb on_audio_chunk,
+    const llama_rn_audio_stream_options& audio_stream_options
 ) {
     if (request_id == -1) {
         request_id = reserve_request_id();
@@ -212,6 +331,7 @@ int32_t llama_rn_slot_manager::queue_request(
     request.prompt_tokens = prompt;
     request.media_paths = media_paths;
     request.prompt_text = prompt_text;
+    request.media_hashes = media_hashes;
     request.chat_format = chat_format;
     request.reasoning_format = reasoning_format;
     request.generation_prompt = generation_prompt;
@@ -222,13 +342,18 @@ int32_t llama_rn_slot_manager::queue_request(
     request.save_prompt_state_path = save_prompt_state_path;
     request.load_state_size = load_state_size;
     request.save_state_size = save_state_size;
+    request.reuse_state_files = reuse_state_files;
     request.on_token = on_token;
     request.on_complete = on_complete;
+    request.on_audio_chunk = std::move(on_audio_chunk);
+    request.audio_stream_options = audio_stream_options;
+    request.priority = priority;
+    request.lora = lora;
 
     // Add to queue
     {
         std::lock_guard<std::mutex> lock(slots_mutex);
-        queue_requests.emplace_back(std::move(request));
+        enqueue_request(std::move(request));
     }
 
     // Notify processing thread that new work is available
@@ -282,7 +407,7 @@ int32_t llama_rn_slot_manager::queue_embedding_request(
 
     {
         std::lock_guard<std::mutex> lock(slots_mutex);
-        queue_requests.emplace_back(std::move(request));
+        enqueue_request(std::move(request));
     }
 
     slots_cv.notify_one();
@@ -300,12 +425,54 @@ int32_t llama_rn_slot_manager::queue_embedding_request(
     return request_id;
 }
 
+// Queue a batch of embedding inputs for parallel processing. Like rerank,
+// the inputs are split across slots and gathered into a single result buffer
+// (queue_request_group).
+int32_t llama_rn_slot_manager::queue_embedding_batch_request(
+    const std::vector<std::vector<llama_token>>& inputs,
+    int embd_normalize,
+    std::function<void(int32_t, const std::vector<float>&, bool)> on_results,
+    int32_t request_id
+) {
+    if (parent_ctx == nullptr || parent_ctx->model == nullptr || parent_ctx->ctx == nullptr) {
+        LOG_ERROR("Cannot queue embedding batch: context not initialized");
+        return -1;
+    }
+
+    if (request_id == -1) {
+        request_id = reserve_request_id();
+    }
+
+    const int n_embd = llama_model_n_embd(parent_ctx->model);
+    if (!parent_ctx->params.embedding || inputs.empty()) {
+        if (!parent_ctx->params.embedding) {
+            LOG_WARNING("Embedding disabled in model parameters; returning zero vectors");
+        }
+        if (on_results) {
+            on_results(request_id, std::vector<float>(inputs.size() * n_embd, 0.0f), false);
+        }
+        return request_id;
+    }
+
+    queue_request_group(request_id, inputs.size(), n_embd, 0.0f,
+        [&](llama_rn_queued_request& part, size_t begin, size_t end, request_part_result_cb on_part) {
+            part.task_type = SLOT_TASK_TYPE_EMBEDDING;
+            part.embd_normalize = embd_normalize;
+            part.embedding_inputs.assign(inputs.begin() + begin, inputs.begin() + end);
+            part.prompt_tokens = part.embedding_inputs.front();
+            part.on_embedding_batch = std::move(on_part);
+        },
+        on_results);
+
+    return request_id;
+}
+
 // Queue a rerank task for parallel processing
 int32_t llama_rn_slot_manager::queue_rerank_request(
     const std::string& query,
     const std::vector<std::string>& documents,
     int normalize,
-    std::function<void(int32_t, const std::vector<float>&)> on_results,
+    std::function<void(int32_t, const std::vector<float>&, bool)> on_results,
     int32_t request_id
 ) {
     if (parent_ctx == nullptr || parent_ctx->model == nullptr || parent_ctx->ctx == nullptr) {
@@ -322,7 +489,7 @@ int32_t llama_rn_slot_manager::queue_rerank_request(
         LOG_ERROR("Reranking not supported by current model (pooling_type=%d)", pooling_type);
         if (on_results) {
             std::vector<float> scores(documents.size(), -1e6f);
-            on_results(request_id, scores);
+            on_results(request_id, scores, false);
         }
         return request_id;
     }
@@ -331,7 +498,7 @@ int32_t llama_rn_slot_manager::queue_rerank_request(
         LOG_ERROR("Embedding disabled but required for reranking");
         if (on_results) {
             std::vector<float> scores(documents.size(), -1e6f);
-            on_results(request_id, scores);
+            on_results(request_id, scores, false);
         }
         return request_id;
     }
@@ -341,63 +508,115 @@ int32_t llama_rn_slot_manager::queue_rerank_request(
         LOG_ERROR("Failed to get vocabulary for rerank task");
         if (on_results) {
             std::vector<float> scores(documents.size(), -1e6f);
-            on_results(request_id, scores);
+            on_results(request_id, scores, false);
         }
         return request_id;
     }
 
-    llama_rn_queued_request request;
-    request.request_id = request_id;
-    request.task_type = SLOT_TASK_TYPE_RERANK;
-    request.embd_normalize = normalize;
-    request.on_rerank = on_results;
-
+    std::vector<std::vector<llama_token>> rerank_inputs;
     try {
-        std::vector<llama_token> query_tokens = common_tokenize(vocab, query, false, true);
-        request.rerank_prompt_tokens.reserve(documents.size());
-
-        const bool add_bos = llama_vocab_get_add_bos(vocab);
-        const bool is_enc_dec = llama_model_has_encoder(parent_ctx->model);
-
-        for (const std::string& doc : documents) {
-            std::vector<llama_token> doc_tokens = common_tokenize(vocab, doc, false, true);
-            std::vector<llama_token> rerank_tokens = format_rerank_tokens(vocab, query_tokens, doc_tokens);
-
-            // Convert tokens back to text and re-tokenize using context-aware settings
-            std::string rerank_text = tokens_to_str(parent_ctx->ctx, rerank_tokens.begin(), rerank_tokens.end());
-            std::vector<llama_token> prompt_tokens = common_tokenize(
-                parent_ctx->ctx,
-                rerank_text,
-                add_bos || is_enc_dec,
-                true
-            );
-
-            request.rerank_prompt_tokens.push_back(std::move(prompt_tokens));
-        }
-
-        if (!request.rerank_prompt_tokens.empty()) {
-            request.prompt_tokens = request.rerank_prompt_tokens.front();
-        }
+        rerank_inputs = tokenize_rerank_inputs(parent_ctx->ctx, query, documents);
     } catch (const std::exception& e) {
         LOG_ERROR("Failed to tokenize rerank inputs: %s", e.what());
         if (on_results) {
             std::vector<float> scores(documents.size(), -1e6f);
-            on_results(request_id, scores);
+            on_results(request_id, scores, false);
         }
         return request_id;
     }
 
-    if (request.rerank_prompt_tokens.empty()) {
+    if (rerank_inputs.empty()) {
         LOG_INFO("Rerank request %d has no documents; returning empty result", request_id);
         if (on_results) {
-            on_results(request_id, {});
+            on_results(request_id, {}, false);
         }
         return request_id;
     }
 
+    // One part per slot, so build_batch packs several documents into each decode
+    queue_request_group(request_id, rerank_inputs.size(), 1, -1e6f,
+        [&](llama_rn_queued_request& part, size_t begin, size_t end, request_part_result_cb on_part) {
+            part.task_type = SLOT_TASK_TYPE_RERANK;
+            part.embd_normalize = normalize;
+            part.rerank_prompt_tokens.assign(
+                std::make_move_iterator(rerank_inputs.begin() + begin),
+                std::make_move_iterator(rerank_inputs.begin() + end)
+            );
+            part.prompt_tokens = part.rerank_prompt_tokens.front();
+            part.on_rerank = std::move(on_part);
+        },
+        on_results);
+
+    return request_id;
+}
+
+// Parts after the first run under internal request ids. Part callbacks run on
+// the processing thread under slots_mutex, as does the cancel callback.
+void llama_rn_slot_manager::queue_request_group(
+    int32_t request_id,
+    size_t n_inputs,
+    size_t item_width,
+    float fill,
+    const std::function<void(llama_rn_queued_request&, size_t, size_t, request_part_result_cb)>& make_part,
+    std::function<void(int32_t, const std::vector<float>&, bool)> on_results
+) {
+    struct request_group_state {
+        std::vector<float> results;
+        size_t n_pending = 0;
+        bool delivered = false;
+    };
+    const size_t n_parts = std::max<size_t>(1, std::min(n_inputs, slots.size()));
+    const size_t part_size = (n_inputs + n_parts - 1) / n_parts;
+
+    auto group = std::make_shared<request_group_state>();
+    group->results.assign(n_inputs * item_width, fill);
+
+    std::vector<llama_rn_queued_request> parts;
+    for (size_t begin = 0; begin < n_inputs; begin += part_size) {
+        const size_t end = std::min(n_inputs, begin + part_size);
+
+        llama_rn_queued_request request;
+        request.request_id = parts.empty() ? request_id : reserve_request_id();
+        make_part(request, begin, end, [this, group, begin, item_width, request_id, on_results](int32_t, const std::vector<float>& part_results) {
+            if (group->delivered) {
+                return;
+            }
+            const size_t offset = begin * item_width;
+            std::copy_n(part_results.begin(),
+                        std::min(part_results.size(), group->results.size() - offset),
+                        group->results.begin() + offset);
+            if (--group->n_pending > 0) {
+                return;
+            }
+            group->delivered = true;
+            erase_request_group(request_id);
+            if (on_results) {
+                on_results(request_id, group->results, false);
+            }
+        });
+        parts.push_back(std::move(request));
+    }
+    group->n_pending = parts.size();
+
     {
         std::lock_guard<std::mutex> lock(slots_mutex);
-        queue_requests.emplace_back(std::move(request));
+        llama_rn_request_group& request_group = request_parts[request_id];
+        for (size_t i = 1; i < parts.size(); ++i) {
+            request_group.part_ids.push_back(parts[i].request_id);
+            part_parents[parts[i].request_id] = request_id;
+        }
+        request_group.on_cancel = [group, request_id, on_results]() {
+            if (group->delivered) {
+                return;
+            }
+            group->delivered = true;
+            if (on_results) {
+                on_results(request_id, group->results, true);
+            }
+        };
+        for (auto& part : parts) {
+            enqueue_request(std::move(part));
+        }
     }
 
     slots_cv.notify_one();
@@ -411,27 +630,85 @@ int32_t llama_rn_slot_manager::queue_rerank_request(
     if (has_subscribers) {
         notify_status_change();
     }
-
-    return request_id;
 }
 
-// Get available slot (LRU strategy for now, similarity matching in Phase 3)
-llama_rn_slot* llama_rn_slot_manager::get_available_slot(const std::vector<llama_token>& prompt) {
-    llama_rn_slot* best_slot = nullptr;
+// Get available slot. Prefers the idle slot whose resident sequence shares
+// the longest reusable prefix with the prompt; below slot_prompt_similarity
+// (or for tasks that clear the sequence anyway) falls back to LRU.
+// Text prompts are looked up in the prefix index; media prompts need the
+// per-slot identity check of get_reusable_prefix and scan the slots.
+llama_rn_slot* llama_rn_slot_manager::get_available_slot(
+    const std::vector<llama_token>& prompt,
+    const std::vector<std::string>& media_hashes,
+    bool prefer_cached_prefix,
+    const std::vector<common_adapter_lora_info>& lora
+) {
+    llama_rn_slot* lru_slot = nullptr;
     int64_t oldest_time = INT64_MAX;
 
-    // Find idle or done slot with oldest t_last_used (LRU)
+    llama_rn_slot* prefix_slot = nullptr;
+    size_t best_prefix = 0;
+
+    const bool scan_prefix = prefer_cached_prefix && !prompt.empty() && !media_hashes.empty();
+
     for (auto& slot : slots) {
-        if (slot.state == SLOT_STATE_IDLE || slot.state == SLOT_STATE_DONE) {
-            if (slot.t_last_used < oldest_time) {
-                oldest_time = slot.t_last_used;
-                best_slot = &slot;
+        if (slot.state != SLOT_STATE_IDLE && slot.state != SLOT_STATE_DONE) {
+            continue;
+        }
+
+        // Find idle or done slot with oldest t_last_used (LRU)
+        if (slot.t_last_used < oldest_time) {
+            oldest_time = slot.t_last_used;
+            lru_slot = &slot;
+        }
+
+        if (!scan_prefix) {
+            continue;
+        }
+
+        const size_t n_prefix = get_reusable_prefix(slot, prompt, media_hashes, lora);
+        if (n_prefix > best_prefix) {
+            best_prefix = n_prefix;
+            prefix_slot = &slot;
+        }
+    }
+
+    if (prefer_cached_prefix && !prompt.empty() && media_hashes.empty()) {
+        // Without media identities a prefix stops at the first placeholder
+        const size_t max_len = static_cast<size_t>(
+            std::find(prompt.begin(), prompt.end(), LLAMA_TOKEN_NULL) - prompt.begin());
+        const rn_prefix_match match = prefix_index.find_longest_shared(RN_PREFIX_SLOT, prompt, max_len);
+        if (match.key >= 0 && match.key < (int32_t) slots.size()) {
+            llama_rn_slot& slot = slots[match.key];
+            if (slot.state == SLOT_STATE_IDLE || slot.state == SLOT_STATE_DONE) {
+                best_prefix = get_reusable_prefix(slot, prompt, media_hashes, lora);
+                prefix_slot = best_prefix > 0 ? &slot : nullptr;
             }
         }
     }
 
+    llama_rn_slot* best_slot = lru_slot;
+    bool by_prefix = false;
+    if (prefix_slot != nullptr) {
+        const float similarity = static_cast<float>(best_prefix) / static_cast<float>(prompt.size());
+        if (similarity >= slot_prompt_similarity) {
+            best_slot = prefix_slot;
+            by_prefix = true;
+        } else {
+            LOG_VERBOSE("Best cached prefix %zu/%zu (%.2f) below similarity threshold %.2f, using LRU",
+                       best_prefix, prompt.size(), similarity, slot_prompt_similarity);
+        }
+    }
+
     if (best_slot != nullptr) {
-        LOG_VERBOSE("Selected slot %d (LRU)", best_slot->id);
+        best_slot->routed_by_prefix = by_prefix;
+        best_slot->routed_prefix_n = by_prefix ? best_prefix : 0;
+        if (by_prefix) {
+            LOG_VERBOSE("Selected slot %d (prefix, %zu/%zu tokens reusable)",
+                       best_slot->id, best_prefix, prompt.size());
+        } else {
+            LOG_VERBOSE("Selected slot %d (LRU)", best_slot->id);
+        }
     } else {
         LOG_VERBOSE("No available slots");
     }
@@ -457,6 +734,19 @@ void llama_rn_slot_manager::release_slot(llama_rn_slot* slot) {
 
     // Reset slot (cache_tokens is preserved by reset() for potential reuse)
     slot->reset();
+
+    // An idle sequence needs no adapters; keeping them would cost every batch
+    // their delta. slot->lora still names what the cache was decoded with.
+    if (!slot->lora.empty() && parent_ctx != nullptr && parent_ctx->ctx != nullptr) {
+        llama_set_adapters_lora_seq(parent_ctx->ctx, slot->id, nullptr, 0, nullptr);
+    }
+
+    // Publish the resident sequence for prefix routing
+    if (slot->cache_tokens.empty()) {
+        prefix_index.remove(RN_PREFIX_SLOT, slot->id);
+    } else {
+        prefix_index.insert(RN_PREFIX_SLOT, slot->id, slot->cache_tokens);
+    }
 }
 
 // Cancel request
@@ -467,32 +757,55 @@ llama_rn_cancel_result llama_rn_slot_manager::cancel_request(int32_t request_id)
     {
         std::lock_guard<std::mutex> lock(slots_mutex);
 
-        auto active_it = active_requests.find(request_id);
-        if (active_it != active_requests.end() &&
-            (active_it->second->state == SLOT_STATE_PROCESSING_PROMPT ||
-             active_it->second->state == SLOT_STATE_GENERATING)) {
-            // The processing thread owns terminalization and slot release.
-            active_it->second->is_interrupted = true;
-            LOG_INFO(
-                "Request %d cancellation requested (active in slot %d)",
-                request_id,
-                active_it->second->id
-            );
-            result = llama_rn_cancel_result::ACTIVE;
-        } else {
+        // A request split across slots is cancelled as a whole; its gathered
+        // callback fires once, marked incomplete, and the parts leave the
+        // status report
+        std::vector<int32_t> request_ids = {request_id};
+        std::function<void()> on_group_cancel;
+        auto parts_it = request_parts.find(request_id);
+        if (parts_it != request_parts.end()) {
+            request_ids.insert(request_ids.end(), parts_it->second.part_ids.begin(), parts_it->second.part_ids.end());
+            on_group_cancel = std::move(parts_it->second.on_cancel);
+            erase_request_group(request_id);
+        }
+
+        for (int32_t id : request_ids) {
+            auto active_it = active_requests.find(id);
+            if (active_it != active_requests.end() &&
+                (active_it->second->state == SLOT_STATE_PROCESSING_PROMPT ||
+                 active_it->second->state == SLOT_STATE_GENERATING)) {
+                // The processing thread owns terminalization and slot release.
+                active_it->second->is_interrupted = true;
+                LOG_INFO(
+                    "Request %d cancellation requested (active in slot %d)",
+                    id,
+                    active_it->second->id
+                );
+                result = llama_rn_cancel_result::ACTIVE;
+                continue;
+            }
+
             auto queued_it = std::find_if(
                 queue_requests.begin(),
                 queue_requests.end(),
-                [request_id](const llama_rn_queued_request& request) {
-                    return request.request_id == request_id;
+                [id](const llama_rn_queued_request& request) {
+                    return request.request_id == id;
                 }
             );
             if (queued_it != queue_requests.end()) {
                 queue_requests.erase(queued_it);
-                LOG_INFO("Request %d cancelled (was in pending queue)", request_id);
-                result = llama_rn_cancel_result::QUEUED;
+                LOG_INFO("Request %d cancelled (was in pending queue)", id);
+                if (result == llama_rn_cancel_result::NOT_FOUND) {
+                    result = llama_rn_cancel_result::QUEUED;
+                }
             }
         }
+
+        // Part callbacks run under slots_mutex on the processing thread; this
+        // one does too, so exactly one of them delivers the results
+        if (on_group_cancel) {
+            on_group_cancel();
+        }
     }
 
     if (result == llama_rn_cancel_result::NOT_FOUND) {
@@ -501,8 +814,9 @@ llama_rn_cancel_result llama_rn_slot_manager::cancel_request(int32_t request_id)
     }
 
     // Wake the processing thread after releasing slots_mutex. Active requests
-    // still need worker-owned completion; queued removals may leave it idle.
-    slots_cv.notify_one();
+    // still need worker-owned completion (a slot waiting on media is only
+    // released once the loop sees the flag); queued removals may leave it idle.
+    slots_cv.notify_all();
 
     // Notify subscribers of status change
     bool has_subscribers = false;
@@ -517,7 +831,7 @@ llama_rn_cancel_result llama_rn_slot_manager::cancel_request(int32_t request_id)
     return result;
 }
 
-// Compute similarity between two token sequences (stub for Phase 3)
+// Compute similarity between two token sequences
 float llama_rn_slot_manager::compute_similarity(
     const std::vector<llama_token>& a,
     const std::vector<llama_token>& b
@@ -539,6 +853,282 @@ float llama_rn_slot_manager::compute_similarity(
     return static_cast<float>(common_prefix) / static_cast<float>(std::max(a.size(), b.size()));
 }
 
+static bool same_lora(const std::vector<common_adapter_lora_info>& a,
+                      const std::vector<common_adapter_lora_info>& b) {
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+        [](const common_adapter_lora_info& x, const common_adapter_lora_info& y) {
+            // By path: a slot's adapters stay loaded while it holds them,
+            // so one path names one adapter for as long as this matters
+            return x.path == y.path && x.scale == y.scale;
+        });
+}
+
+// Number of leading prompt tokens the slot's resident sequence can serve.
+// Media placeholders (LLAMA_TOKEN_NULL) are identical for every image, so a
+// prefix may only span them when the request's media identities match what
+// the slot last ingested - the same rule processMedia applies on reuse.
+// A sequence decoded under other LoRA adapters serves nothing.
+size_t llama_rn_slot_manager::get_reusable_prefix(
+    const llama_rn_slot& slot,
+    const std::vector<llama_token>& prompt,
+    const std::vector<std::string>& media_hashes,
+    const std::vector<common_adapter_lora_info>& lora
+) {
+    if (!same_lora(slot.lora, lora)) {
+        return 0;
+    }
+
+    size_t n_prefix = find_common_prefix_length(slot.cache_tokens, prompt);
+
+    const bool media_identity_stable =
+        !media_hashes.empty() &&
+        std::none_of(media_hashes.begin(), media_hashes.end(),
+                     [](const std::string& id) { return id.empty(); }) &&
+        media_hashes == slot.bitmap_past_hashes;
+    if (!media_identity_stable) {
+        const auto first_media = std::find(prompt.begin(), prompt.begin() + n_prefix, LLAMA_TOKEN_NULL);
+        n_prefix = static_cast<size_t>(first_media - prompt.begin());
+    }
+
+    return n_prefix;
+}
+
+// Seed a freshly loaded prompt from another slot whose sequence already holds
+// a longer prefix of it (typically a shared system prompt / tool schema), so
+// only the tail gets prefilled. In a unified KV cache llama_memory_seq_cp just
+// tags the donor's cells with this slot's sequence - no tensor data moves.
+bool llama_rn_slot_manager::share_prompt_prefix(llama_rn_slot& slot) {
+    if (parent_ctx == nullptr || parent_ctx->ctx == nullptr || !parent_ctx->params.kv_unified) {
+        return false;
+    }
+
+    // Recurrent states cannot be copied by range, and SWA donors may already
+    // have pruned the window the destination needs
+    const llama_model * mdl = llama_get_model(parent_ctx->ctx);
+    if (llama_model_is_recurrent(mdl) || llama_model_is_hybrid(mdl)) {
+        return false;
+    }
+    if (!parent_ctx->params.swa_full && llama_model_n_swa(mdl) > 0) {
+        return false;
+    }
+
+    const std::vector<llama_token>& prompt = slot.prompt_tokens;
+    if (prompt.size() < 2) {
+        return false;
+    }
+
+    auto * kv = llama_get_memory(parent_ctx->ctx);
+    const size_t n_own = (size_t) std::max<llama_pos>(0, slot.n_past);
+
+    llama_rn_slot* donor = nullptr;
+    size_t n_shared = n_own;
+    for (auto& other : slots) {
+        if (&other == &slot || other.cache_tokens.empty()) {
+            continue;
+        }
+        // Only what the donor has actually decoded is shareable (a slot
+        // mid-prompt or with an undecoded last sample holds less)
+        if (llama_memory_seq_pos_min(kv, other.id) != 0) {
+            continue;
+        }
+        const llama_pos mem_len = llama_memory_seq_pos_max(kv, other.id) + 1;
+        const size_t n = std::min(
+            get_reusable_prefix(other, prompt, {}, slot.lora),
+            (size_t) std::max<llama_pos>(0, mem_len));
+        if (n > n_shared) {
+            n_shared = n;
+            donor = &other;
+        }
+    }
+
+    // Keep the last prompt token for fresh logits
+    n_shared = std::min(n_shared, prompt.size() - 1);
+    if (donor == nullptr || n_shared <= n_own) {
+        return false;
+    }
+
+    llama_memory_seq_rm(kv, slot.id, 0, -1);
+    llama_memory_seq_cp(kv, donor->id, slot.id, 0, (llama_pos) n_shared);
+
+    slot.n_past = (llama_pos) n_shared;
+    slot.n_prompt_tokens_cache = (int32_t) n_shared;
+
+    shared_prefix_hits++;
+    shared_prefix_tokens += (int64_t) (n_shared - n_own);
+
+    LOG_INFO("Slot %d (req=%d): Shared %zu prompt tokens from slot %d (own cache %zu, prompt %zu)",
+             slot.id, slot.request_id, n_shared, donor->id, n_own, prompt.size());
+    return true;
+}
+
+// Index a state file a slot just wrote so later prompts can resume from it.
+// Files holding media placeholders are dropped: their reuse depends on media
+// identities the token index can't see.
+void llama_rn_slot_manager::register_state_file(
+    const std::string& path,
+    const llama_token* tokens,
+    size_t n_tokens
+) {
+    forget_state_file(path);
+    if (path.empty() || n_tokens == 0 ||
+        std::find(tokens, tokens + n_tokens, LLAMA_TOKEN_NULL) != tokens + n_tokens) {
+        return;
+    }
+
+    const int32_t key = next_state_file_key++;
+    state_file_paths[key] = path;
+    prefix_index.insert(RN_PREFIX_STATE_FILE, key, tokens, n_tokens);
+    LOG_VERBOSE("Indexed state file %s (%zu tokens)", path.c_str(), n_tokens);
+}
+
+void llama_rn_slot_manager::forget_state_file(const std::string& path) {
+    for (auto it = state_file_paths.begin(); it != state_file_paths.end(); ++it) {
+        if (it->second == path) {
+            prefix_index.remove(RN_PREFIX_STATE_FILE, it->first);
+            state_file_paths.erase(it);
+            return;
+        }
+    }
+}
+
+// Saved state file whose whole token list prefixes the prompt and covers more
+// of it than the slot's resident sequence; empty if none does. Files are
+// matched exactly so recurrent states never need truncation.
+std::string llama_rn_slot_manager::find_state_file(
+    const llama_rn_slot& slot,
+    const std::vector<llama_token>& prompt
+) {
+    // Indexed files hold base-model states
+    if (prefix_index.size(RN_PREFIX_STATE_FILE) == 0 || prompt.empty() || !slot.lora.empty()) {
+        return "";
+    }
+
+    const rn_prefix_match match = prefix_index.find_longest_entry(RN_PREFIX_STATE_FILE, prompt, prompt.size());
+    if (match.key < 0) {
+        return "";
+    }
+
+    size_t n_resident = get_reusable_prefix(slot, prompt, {}, slot.lora);
+    if (parent_ctx != nullptr && parent_ctx->ctx != nullptr) {
+        auto * kv = llama_get_memory(parent_ctx->ctx);
+        const llama_pos mem_len = llama_memory_seq_pos_max(kv, slot.id) + 1;
+        n_resident = std::min(n_resident, (size_t) std::max<llama_pos>(0, mem_len));
+    }
+    if (match.n_match <= n_resident) {
+        return "";
+    }
+
+    auto it = state_file_paths.find(match.key);
+    return it != state_file_paths.end() ? it->second : "";
+}
+
+bool llama_rn_slot_manager::set_slot_lora(llama_rn_slot& slot, std::vector<common_adapter_lora_info> lora) {
+    // The slot holds a registry reference on every adapter its sequence is
+    // routed through; the request's handles are re-resolved by path, since an
+    // idle adapter may have been freed while the request sat in the queue
+    if (parent_ctx != nullptr && parent_ctx->model != nullptr) {
+        size_t n_acquired = 0;
+        try {
+            for (auto& la : lora) {
+                la.ptr = parent_ctx->acquireLoraAdapter(la.path);
+                n_acquired++;
+            }
+        } catch (const std::exception& e) {
+            LOG_ERROR("Slot %d: %s", slot.id, e.what());
+            for (size_t i = 0; i < n_acquired; ++i) {
+                parent_ctx->releaseLoraAdapter(lora[i].path);
+            }
+            return false;
+        }
+    }
+
+    if (!same_lora(slot.lora, lora)) {
+        slot.cache_tokens.clear();
+        slot.bitmap_past_hashes.clear();
+        if (parent_ctx != nullptr && parent_ctx->ctx != nullptr) {
+            llama_memory_seq_rm(llama_get_memory(parent_ctx->ctx), slot.id, 0, -1);
+        }
+    }
+    std::swap(slot.lora, lora);
+
+    if (parent_ctx != nullptr && parent_ctx->ctx != nullptr) {
+        std::vector<llama_adapter_lora *> adapters;
+        std::vector<float> scales;
+        for (const auto& la : slot.lora) {
+            adapters.push_back(la.ptr);
+            scales.push_back(la.scale);
+        }
+        llama_set_adapters_lora_seq(parent_ctx->ctx, slot.id, adapters.data(), adapters.size(), scales.data());
+    }
+
+    // Only now is the sequence off the old adapters
+    if (parent_ctx != nullptr && parent_ctx->model != nullptr) {
+        for (const auto& la : lora) {
+            parent_ctx->releaseLoraAdapter(la.path);
+        }
+    }
+    return true;
+}
+
+std::vector<std::string> llama_rn_slot_manager::prefetch_queued_lora() {
+    std::vector<std::string> paths;
+    {
+        std::lock_guard<std::mutex> lock(slots_mutex);
+        size_t n_free = 0;
+        for (const auto& slot : slots) {
+            if (slot.state == SLOT_STATE_IDLE || slot.state == SLOT_STATE_DONE) {
+                n_free++;
+            }
+        }
+        for (size_t i = 0; i < queue_requests.size() && i < n_free; ++i) {
+            for (const auto& la : queue_requests[i].lora) {
+                if (std::find(paths.begin(), paths.end(), la.path) == paths.end()) {
+                    paths.push_back(la.path);
+                }
+            }
+        }
+    }
+    if (paths.empty() || parent_ctx == nullptr || parent_ctx->model == nullptr) {
+        return {};
+    }
+
+    std::vector<std::string> held;
+    for (const auto& path : paths) {
+        try {
+            parent_ctx->acquireLoraAdapter(path);
+            held.push_back(path);
+        } catch (const std::exception&) {
+            // set_slot_lora fails the request with the loader error
+        }
+    }
+    return held;
+}
+
+void llama_rn_slot_manager::release_prefetched_lora(const std::vector<std::string>& paths) {
+    for (const auto& path : paths) {
+        parent_ctx->releaseLoraAdapter(path);
+    }
+}
+
+void llama_rn_slot_manager::enqueue_request(llama_rn_queued_request&& request) {
+    // Stable: equal priorities keep arrival order, so all-default requests
+    // stay FIFO
+    auto it = std::find_if(queue_requests.begin(), queue_requests.end(),
+        [&](const llama_rn_queued_request& queued) { return queued.priority < request.priority; });
+    queue_requests.insert(it, std::move(request));
+}
+
+void llama_rn_slot_manager::erase_request_group(int32_t request_id) {
+    auto it = request_parts.find(request_id);
+    if (it == request_parts.end()) {
+        return;
+    }
+    for (int32_t part_id : it->second.part_ids) {
+        part_parents.erase(part_id);
+    }
+    request_parts.erase(it);
+}
+
 // Process pending queue
 void llama_rn_slot_manager::process_pending_queue() {
     while (!queue_requests.empty()) {
@@ -559,7 +1149,14 @@ void llama_rn_slot_manager::process_pending_queue() {
             prompt_view = &empty_prompt;
         }
 
-        llama_rn_slot* slot = get_available_slot(*prompt_view);
+        // Embedding and rerank tasks rebuild the sequence from scratch, so
+        // they take the LRU slot rather than evicting a reusable prefix
+        llama_rn_slot* slot = get_available_slot(
+            *prompt_view,
+            request.media_hashes,
+            request.task_type == SLOT_TASK_TYPE_COMPLETION,
+            request.lora
+        );
         if (slot == nullptr) {
             LOG_VERBOSE(
                 "No available slots, stopping queue processing (request %d at front)",
@@ -568,12 +1165,16 @@ void llama_rn_slot_manager::process_pending_queue() {
             break;
         }
 
-        // Assign request to slot
+        // Assign request to slot; its sequence is about to change, so it
+        // leaves the prefix index until released again
+        prefix_index.remove(RN_PREFIX_SLOT, slot->id);
+
         // A cancelled slot can be reassigned before release_slot() has reset
         // it; generation state must not leak into the new request
         slot->clear_generation_state();
         slot->request_id = request.request_id;
         slot->task_type = request.task_type;
+        slot->priority = request.priority;
         slot->is_interrupted = false;
 
         // Reset callbacks from previous usage
@@ -589,6 +1190,17 @@ void llama_rn_slot_manager::process_pending_queue() {
             slot->ctx_sampling = nullptr;
         }
 
+        if (!set_slot_lora(*slot, request.lora)) {
+            slot->state = SLOT_STATE_DONE;
+            slot->incomplete = true;
+            slot->error_message = "Failed to load LoRA adapters";
+            if (request.on_complete) {
+                request.on_complete(slot);
+            }
+            queue_requests.pop_front();
+            continue;
+        }
+
         switch (request.task_type) {
             case SLOT_TASK_TYPE_COMPLETION: {
                 slot->params_storage = request.params;
@@ -602,9 +1214,40 @@ void llama_rn_slot_manager::process_pending_queue() {
                 slot->load_state_size = request.load_state_size;
                 slot->save_state_size = request.save_state_size;
 
-                // Load state if provided
-                if (!slot->load_state_path.empty()) {
-                    if (!slot->load_state()) {
+                // Without an explicit state, an opted-in request resumes from
+                // the indexed state file holding the longest prefix of the prompt
+                bool auto_state = false;
+                if (request.reuse_state_files && slot->load_state_path.empty() && request.media_paths.empty()) {
+                    slot->load_state_path = find_state_file(*slot, request.prompt_tokens);
+                    if (!slot->load_state_path.empty()) {
+                        auto_state = true;
+                        slot->load_state_size = -1;
+                        LOG_INFO("Slot %d (req=%d): Resuming from indexed state file %s",
+                                 slot->id, request.request_id, slot->load_state_path.c_str());
+                    }
+                }
+
+                // Load state if provided; text prompts only read in the
+                // prefix they share with the file
+                const std::vector<llama_token> no_prompt;
+                const auto& load_prompt_tokens = request.media_paths.empty() ? request.prompt_tokens : no_prompt;
+                std::vector<llama_token> state_file_tokens;
+                if (auto_state && !slot->load_state(load_prompt_tokens)) {
+                    // The file may have been removed since it was indexed;
+                    // fall back to prompt processing instead of failing
+                    LOG_WARNING("Slot %d: Indexed state file %s is unusable, processing prompt instead",
+                               slot->id, slot->load_state_path.c_str());
+                    forget_state_file(slot->load_state_path);
+                    slot->load_state_path.clear();
+                    slot->cache_tokens.clear();
+                    slot->bitmap_past_hashes.clear();
+                    if (parent_ctx->ctx != nullptr) {
+                        llama_memory_seq_rm(llama_get_memory(parent_ctx->ctx), slot->id, 0, -1);
+                    }
+                } else if (auto_state) {
+                    slot->state_reused = true;
+                } else if (!slot->load_state_path.empty()) {
+                    if (!slot->load_state(load_prompt_tokens, &state_file_tokens)) {
                         LOG_ERROR("Failed to load state for slot %d, request %d",
                                   slot->id, request.request_id);
                         // Mark slot as done with error
@@ -617,6 +1260,10 @@ void llama_rn_slot_manager::process_pending_queue() {
                         queue_requests.pop_front();
                         continue;
                     }
+                    // Whole files are indexed for later requests too
+                    if (slot->load_state_size <= 0 && slot->lora.empty()) {
+                        register_state_file(slot->load_state_path, state_file_tokens.data(), state_file_tokens.size());
+                    }
                 }
 
                 // Start timing AFTER state loading completes
@@ -636,6 +1283,9 @@ void llama_rn_slot_manager::process_pending_queue() {
                     slot->prompt_text.clear();
                     slot->media_processed = true;
                     slot->load_prompt(request.prompt_tokens);
+                    if (slot->load_state_path.empty()) {
+                        share_prompt_prefix(*slot);
+                    }
                 }
                 slot->i_batch = -1;
 
@@ -648,6 +1298,10 @@ void llama_rn_slot_manager::process_pending_queue() {
                 slot->prefill_text = request.prefill_text;
                 slot->n_remaining = request.params.n_predict;
                 slot->stop_words = request.params.antiprompt;
+                if (request.on_audio_chunk && parent_ctx->isVocoderEnabled()) {
+                    parent_ctx->tts_wrapper->startSlotAudioStream(
+                        parent_ctx, slot->audio_stream, request.audio_stream_options, request.on_audio_chunk);
+                }
                 break;
             }
 
@@ -662,6 +1316,13 @@ void llama_rn_slot_manager::process_pending_queue() {
                 slot->media_processed = true;
                 slot->embd_normalize = request.embd_normalize;
                 slot->on_embedding_callback = request.on_embedding;
+                slot->on_embedding_batch_callback = request.on_embedding_batch;
+                slot->embedding_inputs = std::move(request.embedding_inputs);
+                slot->embedding_current_index = 0;
+                if (!slot->embedding_inputs.empty()) {
+                    slot->embedding_results.assign(
+                        slot->embedding_inputs.size() * llama_model_n_embd(parent_ctx->model), 0.0f);
+                }
                 slot->n_remaining = -1;
                 slot->stop_words.clear();
                 slot->load_prompt(request.prompt_tokens);
@@ -696,6 +1357,7 @@ void llama_rn_slot_manager::process_pending_queue() {
                 slot->rerank_prompt_tokens = std::move(request.rerank_prompt_tokens);
                 slot->rerank_scores.assign(slot->rerank_prompt_tokens.size(), 0.0f);
                 slot->rerank_current_index = 0;
+                slot->rerank_reuse_prefix = model_rerank_shares_prefix(parent_ctx->model);
                 slot->n_remaining = -1;
                 slot->stop_words.clear();
                 slot->load_prompt(slot->rerank_prompt_tokens[0]);
@@ -721,35 +1383,88 @@ void llama_rn_slot_manager::process_pending_queue() {
 void llama_rn_slot_manager::build_batch() {
     // Clear the batch
     batch.n_tokens = 0;
+    n_batch_mtp = 0;
+    mtp_process_failed = false;
+
+    auto is_mtp_slot = [](const llama_rn_slot& slot) {
+        return slot.task_type == SLOT_TASK_TYPE_COMPLETION && slot.should_use_mtp();
+    };
 
-    // First pass: Add tokens from GENERATING slots (previously sampled tokens)
+    // First pass: MTP slots verify id_last plus a fresh draft. Every drafting
+    // slot runs through the shared MTP head in one draft step, and the verify
+    // rows lead the batch so the head can catch up on them as a prefix (see
+    // process_batch). Drafts only take the room the plain slots leave over.
+    int32_t mtp_room = n_batch;
+    for (const auto& slot : slots) {
+        if (slot.state == SLOT_STATE_GENERATING && !is_mtp_slot(slot) && !slot.generated_tokens.empty()) {
+            mtp_room -= 1 + slot.jump_forward_pending;
+        }
+    }
+    // Only the slots armed below draft this step: a sequence left armed by an
+    // earlier one (slot finished, out of batch room) would draft from stale
+    // params into a buffer nobody verifies
+    if (mtp_spec != nullptr) {
+        const llama_seq_id n_seq = std::max<int32_t>(1, n_parallel);
+        for (llama_seq_id seq_id = 0; seq_id < n_seq; ++seq_id) {
+            common_speculative_get_draft_params(mtp_spec, seq_id).drafting = false;
+        }
+    }
+    std::vector<llama_rn_slot*> verifying;
+    bool any_drafting = false;
+    for (auto& slot : slots) {
+        slot.spec_i_batch = -1;
+        if (slot.state != SLOT_STATE_GENERATING || slot.is_interrupted || !is_mtp_slot(slot) ||
+            slot.spec == nullptr || mtp_room < 1) {
+            continue;
+        }
+        if (slot.begin_mtp_draft(mtp_room)) {
+            verifying.push_back(&slot);
+            mtp_room -= 1 + slot.spec_n_draft_max;
+            any_drafting = any_drafting || slot.spec_n_draft_max > 0;
+        }
+    }
+    if (any_drafting && mtp_spec != nullptr) {
+        common_speculative_draft(mtp_spec);
+    }
+    for (auto* slot : verifying) {
+        slot->add_mtp_verify_tokens(batch);
+        LOG_VERBOSE("Slot %d: Verifying %zu draft token(s) at pos %d",
+                   slot->id, slot->spec_draft.size(), slot->spec_n_past);
+    }
+    n_batch_mtp = batch.n_tokens;
+
+    // Then the plain GENERATING slots (previously sampled tokens)
     for (auto& slot : slots) {
         if (slot.state == SLOT_STATE_GENERATING) {
-            if (slot.task_type == SLOT_TASK_TYPE_COMPLETION && slot.should_use_mtp()) {
+            if (is_mtp_slot(slot)) {
                 continue;
             }
             // Only add if we have generated tokens (skip first iteration after prompt)
             if (!slot.generated_tokens.empty()) {
-                // Get the last generated token
-                llama_token token = slot.generated_tokens.back();
-
-                // Add to batch with this slot's sequence ID
-                llama_batch_add(&batch, token, slot.n_past, {slot.id}, true);
+                // The last sampled token plus any grammar-forced run emitted
+                // behind it (jump-forward); only the final one needs logits
+                const int32_t n_add = 1 + slot.jump_forward_pending;
+                const size_t first = slot.generated_tokens.size() - n_add;
+                for (int32_t i = 0; i < n_add; ++i) {
+                    llama_batch_add(&batch, slot.generated_tokens[first + i], slot.n_past, {slot.id}, i == n_add - 1);
+                    slot.n_past++; // Increment for next token
+                }
+                slot.jump_forward_pending = 0;
 
                 // Mark position in batch for this slot
                 slot.i_batch = batch.n_tokens - 1;
 
-                slot.n_past++; // Increment for next token
-
-                LOG_VERBOSE("Slot %d: Added generated token %d at pos %d", slot.id, token, slot.n_past - 1);
+                LOG_VERBOSE("Slot %d: Added %d generated token(s) ending at pos %d", slot.id, n_add, slot.n_past - 1);
             }
         }
     }
 
-    // Second pass: Add prompt tokens from PROCESSING_PROMPT slots
+    // Second pass: media ingest and MTP hand-off for PROCESSING_PROMPT slots,
+    // collecting the ones left with prompt tokens to decode
+    std::vector<llama_rn_slot*> prefilling;
     for (auto& slot : slots) {
         if (slot.state == SLOT_STATE_PROCESSING_PROMPT) {
-            if (slot.task_type == SLOT_TASK_TYPE_COMPLETION && slot.should_use_mtp()) {
+            if (is_mtp_slot(slot)) {
                 if (!slot.media_paths.empty()) {
                     LOG_ERROR("Slot %d: MTP speculative decoding does not support media inputs", slot.id);
                     slot.incomplete = true;
@@ -758,6 +1473,18 @@ void llama_rn_slot_manager::build_batch() {
                     continue;
                 }
 
+                // Prompt eval feeds the target and the draft head; the first
+                // verify step joins the shared batch on the next update
+                try {
+                    slot.init_mtp();
+                } catch (const std::exception& e) {
+                    LOG_ERROR("Slot %d: MTP speculative decoding failed: %s", slot.id, e.what());
+                    slot.incomplete = true;
+                    slot.error_message = e.what();
+                    complete_slot(slot);
+                    continue;
+                }
+
                 slot.state = SLOT_STATE_GENERATING;
                 slot.i_batch = -1;
                 LOG_INFO("Slot %d: Transitioned to GENERATING state with MTP speculative decoding", slot.id);
@@ -766,9 +1493,26 @@ void llama_rn_slot_manager::build_batch() {
 
             // Check if we need to process media first (deferred processing)
             if (!slot.media_processed && !slot.media_paths.empty()) {
+                // Media is loaded and encoded on the media worker first; the
+                // slot sits out of the batch until its embeddings are ready
+                auto job_it = media_jobs.find(slot.id);
+                if (job_it == media_jobs.end() || job_it->second->request_id != slot.request_id) {
+                    submit_media_job(slot);
+                    continue;
+                }
+                if (!job_it->second->done.load()) {
+                    continue;
+                }
+                std::shared_ptr<llama_rn_media_job> media_job = std::move(job_it->second);
+                media_jobs.erase(job_it);
+
                 LOG_INFO("Slot %d: Processing media before prompt tokens", slot.id);
 
                 try {
+                    if (!media_job->error.empty()) {
+                        throw std::runtime_error(media_job->error);
+                    }
+
                     // Seed the media evaluator with the cached history (loaded
                     // state or a previous turn on this slot) so it can reuse
                     // the sequence memory; processMedia reconciles or clears
@@ -852,7 +1596,8 @@ void llama_rn_slot_manager::build_batch() {
                         slot.id,  // Use slot ID as sequence ID for parallel processing
                         /*recover*/ nullptr,
                         capture,
-                        /*invalidate*/ nullptr
+                        /*invalidate*/ nullptr,
+                        media_job->prepared.get()
                     );
 
                     if (context_full) {
@@ -940,61 +1685,143 @@ void llama_rn_slot_manager::build_batch() {
                 }
             }
 
-            // Process tokens up to n_batch limit (only for non-media slots)
-            size_t prompt_end = slot.num_prompt_tokens;
-            if (slot.save_prompt_state_pending && slot.save_prompt_state_tokens >= 0 &&
-                slot.n_past <= slot.save_prompt_state_tokens) {
-                prompt_end = std::min(prompt_end, (size_t)slot.save_prompt_state_tokens);
-            }
-
-            while (slot.n_past < (llama_pos)prompt_end && batch.n_tokens < n_batch) {
-                llama_token token = slot.prompt_tokens[slot.n_past];
+            // Prompt tokens are handed out below, once every slot's media
+            // ingest is done and the scheduler can see all of them
+            prefilling.push_back(&slot);
+        }
+    }
 
-                // Skip LLAMA_TOKEN_NULL - these are media placeholders already in KV cache
-                if (token == LLAMA_TOKEN_NULL) {
-                    LOG_VERBOSE("Slot %d: Skipping NULL token at pos %d (media chunk)", slot.id, slot.n_past);
-                    slot.n_past++;
-                    continue;
+    // Third pass: hand out prompt tokens. Embedding and rerank prompts are
+    // never split by the scheduler (pooling wants the whole sequence in one
+    // decode): they go in whole and are charged to the same room, or wait for
+    // a later step if other prefill already took it. Only completion prefill
+    // is chunked.
+    int32_t prefill_room = n_batch - batch.n_tokens;
+    if (prefill_decode_budget > 0) {
+        const bool any_generating = std::any_of(slots.begin(), slots.end(),
+            [](const llama_rn_slot& s) { return s.state == SLOT_STATE_GENERATING; });
+        if (any_generating) {
+            prefill_room = std::min(prefill_room, prefill_decode_budget);
+        }
+    }
+    const int32_t prefill_room_start = prefill_room;
+
+    if (prefill_policy == PREFILL_POLICY_FAIR && prefilling.size() > 1) {
+        // Higher priority first; equal priorities rotate so no slot always
+        // leads the batch
+        const int32_t cursor = prefill_cursor;
+        const int32_t n_slots = (int32_t) slots.size();
+        std::stable_sort(prefilling.begin(), prefilling.end(),
+            [cursor, n_slots](const llama_rn_slot* a, const llama_rn_slot* b) {
+                if (a->priority != b->priority) {
+                    return a->priority > b->priority;
                 }
+                return (a->id - cursor + n_slots) % n_slots < (b->id - cursor + n_slots) % n_slots;
+            });
+        prefill_cursor = (prefill_cursor + 1) % n_slots;
+    }
 
-                // Request logits for all tokens when embeddings/rerank are needed
-                bool need_logits = true;
-                if (slot.task_type == SLOT_TASK_TYPE_COMPLETION) {
-                    need_logits = (slot.n_past == (llama_pos)(slot.num_prompt_tokens - 1));
-                }
+    int32_t n_completion_prefilling = 0;
+    for (auto* slot : prefilling) {
+        if (slot->task_type == SLOT_TASK_TYPE_COMPLETION) {
+            n_completion_prefilling++;
+        }
+    }
+    int32_t chunk = prefill_chunk;
+    if (chunk <= 0 && prefill_policy == PREFILL_POLICY_FAIR && n_completion_prefilling > 0) {
+        chunk = std::max(1, (prefill_room + n_completion_prefilling - 1) / n_completion_prefilling);
+    }
 
-                // Add to batch with this slot's sequence ID
-                llama_batch_add(&batch, token, slot.n_past, {slot.id}, need_logits);
+    // Add up to max_tokens prompt tokens of one slot, returns how many
+    auto add_prompt_tokens = [this](llama_rn_slot& slot, int32_t max_tokens) -> int32_t {
+        size_t prompt_end = slot.num_prompt_tokens;
+        if (slot.save_prompt_state_pending && slot.save_prompt_state_tokens >= 0 &&
+            slot.n_past <= slot.save_prompt_state_tokens) {
+            prompt_end = std::min(prompt_end, (size_t)slot.save_prompt_state_tokens);
+        }
 
-                // Mark position in batch for this slot (will be overwritten each iteration)
-                slot.i_batch = batch.n_tokens - 1;
+        int32_t n_added = 0;
+        while (slot.n_past < (llama_pos)prompt_end && n_added < max_tokens && batch.n_tokens < n_batch) {
+            llama_token token = slot.prompt_tokens[slot.n_past];
 
+            // Skip LLAMA_TOKEN_NULL - these are media placeholders already in KV cache
+            if (token == LLAMA_TOKEN_NULL) {
+                LOG_VERBOSE("Slot %d: Skipping NULL token at pos %d (media chunk)", slot.id, slot.n_past);
                 slot.n_past++;
+                continue;
             }
 
-            // If we've processed all prompt tokens, transition based on task type
-            if (slot.n_past >= (llama_pos)slot.num_prompt_tokens) {
-                slot.state = SLOT_STATE_GENERATING;
+            // Request logits for all tokens when embeddings/rerank are needed
+            bool need_logits = true;
+            if (slot.task_type == SLOT_TASK_TYPE_COMPLETION) {
+                need_logits = (slot.n_past == (llama_pos)(slot.num_prompt_tokens - 1));
+            }
+
+            // Add to batch with this slot's sequence ID
+            llama_batch_add(&batch, token, slot.n_past, {slot.id}, need_logits);
 
-                // Mark that prompt processing just finished - timing will be calculated after decode
-                slot.prompt_processing_finished = true;
-                slot.n_prompt_tokens_processed = slot.num_prompt_tokens - slot.n_prompt_tokens_cache;
-
-                if (slot.task_type == SLOT_TASK_TYPE_COMPLETION) {
-                    LOG_INFO("Slot %d: Transitioned to GENERATING state", slot.id);
-                } else if (slot.task_type == SLOT_TASK_TYPE_EMBEDDING) {
-                    LOG_INFO("Slot %d: Prompt processed for embedding task", slot.id);
-                } else if (slot.task_type == SLOT_TASK_TYPE_RERANK) {
-                    LOG_INFO("Slot %d: Prompt processed for rerank task (doc %zu/%zu)",
-                             slot.id,
-                             slot.rerank_current_index + 1,
-                             slot.rerank_prompt_tokens.size());
+            // Mark position in batch for this slot (will be overwritten each iteration)
+            slot.i_batch = batch.n_tokens - 1;
+
+            slot.n_past++;
+            n_added++;
+        }
+        return n_added;
+    };
+
+    // Capped round first, then whatever room is left goes out again in the
+    // same order, so the cap shares the batch without leaving it idle
+    for (int round = 0; round < 2; round++) {
+        if (round == 1 && chunk <= 0) {
+            break;
+        }
+        for (auto* slot : prefilling) {
+            if (slot->task_type != SLOT_TASK_TYPE_COMPLETION) {
+                if (round == 0) {
+                    // A prompt larger than the whole room still goes out when
+                    // it is first in line, so it cannot starve
+                    const int32_t n_remaining = (int32_t) slot->num_prompt_tokens - slot->n_past;
+                    if (n_remaining <= prefill_room || prefill_room == prefill_room_start) {
+                        prefill_room -= add_prompt_tokens(*slot, n_batch);
+                        prefill_room = std::max(prefill_room, 0);
+                    }
                 }
+                continue;
+            }
+            int32_t max_tokens = prefill_room;
+            if (round == 0 && chunk > 0) {
+                max_tokens = std::min(max_tokens, chunk);
             }
+            if (max_tokens > 0) {
+                prefill_room -= add_prompt_tokens(*slot, max_tokens);
+            }
+        }
+    }
 
-            LOG_VERBOSE("Slot %d: Processed prompt tokens, n_past=%d/%zu",
-                       slot.id, slot.n_past, slot.num_prompt_tokens);
+    for (auto* slot_ptr : prefilling) {
+        auto& slot = *slot_ptr;
+        // If we've processed all prompt tokens, transition based on task type
+        if (slot.n_past >= (llama_pos)slot.num_prompt_tokens) {
+            slot.state = SLOT_STATE_GENERATING;
+
+            // Mark that prompt processing just finished - timing will be calculated after decode
+            slot.prompt_processing_finished = true;
+            slot.n_prompt_tokens_processed = slot.num_prompt_tokens - slot.n_prompt_tokens_cache;
+
+            if (slot.task_type == SLOT_TASK_TYPE_COMPLETION) {
+                LOG_INFO("Slot %d: Transitioned to GENERATING state", slot.id);
+            } else if (slot.task_type == SLOT_TASK_TYPE_EMBEDDING) {
+                LOG_INFO("Slot %d: Prompt processed for embedding task", slot.id);
+            } else if (slot.task_type == SLOT_TASK_TYPE_RERANK) {
+                LOG_INFO("Slot %d: Prompt processed for rerank task (doc %zu/%zu)",
+                         slot.id,
+                         slot.rerank_current_index + 1,
+                         slot.rerank_prompt_tokens.size());
+            }
         }
+
+        LOG_VERBOSE("Slot %d: Processed prompt tokens, n_past=%d/%zu",
+                   slot.id, slot.n_past, slot.num_prompt_tokens);
     }
 
     LOG_VERBOSE("Batch built with %d tokens", batch.n_tokens);
@@ -1035,12 +1862,38 @@ bool llama_rn_slot_manager::process_batch() {
     // This is critical for accurate performance metrics when using Metal/GPU
     llama_synchronize(parent_ctx->ctx);
 
+    // One draft-head decode catches every MTP slot up on its verify rows; a
+    // failure only ends those slots (see sample_and_callback)
+    if (n_batch_mtp > 0 && mtp_spec != nullptr) {
+        llama_batch mtp_view = batch;
+        mtp_view.n_tokens = n_batch_mtp;
+        if (!common_speculative_process(mtp_spec, mtp_view)) {
+            LOG_ERROR("Failed to process MTP verify rows (%d tokens)", n_batch_mtp);
+            mtp_process_failed = true;
+        }
+    }
+
     LOG_VERBOSE("Batch processed successfully");
     return true;
 }
 
+void llama_rn_slot_manager::pump_audio_stream(llama_rn_slot & slot, llama_token tok) {
+    if (slot.audio_stream.active && parent_ctx->isVocoderEnabled()) {
+        parent_ctx->tts_wrapper->pumpSlotAudioStream(parent_ctx, slot.audio_stream, tok);
+    }
+}
+
 void llama_rn_slot_manager::complete_slot(llama_rn_slot & slot) {
+    drop_media_job(slot.id);
     slot.generated_text += slot.utf8_gate.finish();
+    if (slot.audio_stream.on_chunk && parent_ctx->isVocoderEnabled()) {
+        // Cancelled or failed requests end their stream without decoding the rest
+        if (slot.is_interrupted || !slot.error_message.empty()) {
+            parent_ctx->tts_wrapper->abortSlotAudioStream(slot.audio_stream);
+        } else {
+            parent_ctx->tts_wrapper->finishSlotAudioStream(parent_ctx, slot.audio_stream);
+        }
+    }
     slot.state = SLOT_STATE_DONE;
     auto on_complete = std::move(slot.on_complete_callback);
     slot.on_complete_callback = nullptr;
@@ -1049,6 +1902,107 @@ void llama_rn_slot_manager::complete_slot(llama_rn_slot & slot) {
     }
 }
 
+void llama_rn_slot_manager::submit_media_job(llama_rn_slot & slot) {
+    auto job = std::make_shared<llama_rn_media_job>();
+    job->slot_id = slot.id;
+    job->request_id = slot.request_id;
+    job->prompt_text = slot.prompt_text;
+    job->media_paths = slot.media_paths;
+    job->cached_tokens = slot.cache_tokens;
+    job->cached_hashes = slot.bitmap_past_hashes;
+
+    drop_media_job(slot.id);
+    media_jobs[slot.id] = job;
+    {
+        std::lock_guard<std::mutex> lock(media_mutex);
+        if (!media_thread.joinable()) {
+            media_stopping = false;
+            media_thread = std::thread([this]() { media_worker_loop(); });
+        }
+        media_queue.push_back(job);
+    }
+    media_cv.notify_one();
+    LOG_INFO("Slot %d: Queued %zu media for encoding", slot.id, slot.media_paths.size());
+}
+
+void llama_rn_slot_manager::drop_media_job(int32_t slot_id) {
+    auto it = media_jobs.find(slot_id);
+    if (it == media_jobs.end()) {
+        return;
+    }
+    // A running encode finishes on the worker and is discarded there
+    it->second->cancelled.store(true);
+    media_jobs.erase(it);
+}
+
+bool llama_rn_slot_manager::is_waiting_for_media(const llama_rn_slot & slot) const {
+    auto it = media_jobs.find(slot.id);
+    return it != media_jobs.end() && !it->second->done.load();
+}
+
+void llama_rn_slot_manager::media_worker_loop() {
+    bool stopping = false;
+    while (!stopping) {
+        std::shared_ptr<llama_rn_media_job> job;
+        {
+            std::unique_lock<std::mutex> lock(media_mutex);
+            media_cv.wait(lock, [this]() { return media_stopping || !media_queue.empty(); });
+            if (media_stopping) {
+                for (auto& pending : media_queue) {
+                    pending->error = "Media encoding stopped";
+                    pending->done.store(true);
+                }
+                media_queue.clear();
+                stopping = true;
+            } else {
+                job = std::move(media_queue.front());
+                media_queue.pop_front();
+            }
+        }
+
+        if (job && !job->cancelled.load()) {
+            const int64_t t_start = lm_ggml_time_us();
+            try {
+                if (parent_ctx->mtmd_wrapper == nullptr) {
+                    throw std::runtime_error("Multimodal is not initialized");
+                }
+                job->prepared = parent_ctx->mtmd_wrapper->prepareMedia(
+                    job->prompt_text,
+                    job->media_paths,
+                    parent_ctx->model,
+                    job->cached_tokens,
+                    job->cached_hashes
+                );
+                LOG_INFO("Slot %d: Media encoded in %.2f ms",
+                         job->slot_id, (lm_ggml_time_us() - t_start) / 1000.0);
+            } catch (const std::exception& e) {
+                LOG_ERROR("Slot %d: Failed to prepare media: %s", job->slot_id, e.what());
+                job->error = e.what();
+            }
+        }
+        if (job) {
+            job->done.store(true);
+        }
+
+        // Taking the lock orders this wake-up after the loop's wait predicate
+        { std::lock_guard<std::mutex> lock(slots_mutex); }
+        slots_cv.notify_all();
+    }
+}
+
+void llama_rn_slot_manager::stop_media_worker() {
+    {
+        // Jobs that never ran fail their slots (on the worker's way out)
+        // instead of leaving them waiting
+        std::lock_guard<std::mutex> lock(media_mutex);
+        media_stopping = true;
+    }
+    media_cv.notify_all();
+    if (media_thread.joinable()) {
+        media_thread.join();
+    }
+}
+
 void llama_rn_slot_manager::sample_and_callback() {
     if (parent_ctx == nullptr || parent_ctx->ctx == nullptr) {
         return;
@@ -1056,6 +2010,7 @@ void llama_rn_slot_manager::sample_and_callback() {
 
     const llama_vocab* vocab = llama_model_get_vocab(parent_ctx->model);
     const int n_embd = llama_model_n_embd(parent_ctx->model);
+    const int n_vocab = llama_vocab_n_tokens(llama_model_get_vocab(parent_ctx->model));
 
     auto get_embedding_ptr = [&](llama_rn_slot& slot) -> const float* {
         const float* data = llama_get_embeddings_seq(parent_ctx->ctx, slot.id);
@@ -1074,6 +2029,73 @@ void llama_rn_slot_manager::sample_and_callback() {
         return data;
     };
 
+    // Sample every plain completion slot up front, fanned out over the
+    // sampling pool: each slot owns its sampler, and the shared logits are
+    // only read. Emission, stop checks and callbacks stay serial below, in
+    // slot order, so callback ordering doesn't depend on thread timing.
+    struct sampled_token {
+        bool ready = false;
+        llama_token tok = LLAMA_TOKEN_NULL;
+        std::vector<completion_token_output::token_prob> probs;
+        std::string error;
+    };
+    std::vector<sampled_token> sampled(slots.size());
+
+    // logits, when set, were fetched up front and are sampled without touching
+    // the context (which is not safe to synchronize from several threads)
+    auto sample_slot = [&](llama_rn_slot& slot, int idx, sampled_token& out, const float* logits = nullptr) {
+        try {
+            out.tok = logits != nullptr
+                ? common_sampler_sample_logits(slot.ctx_sampling, logits, n_vocab)
+                : common_sampler_sample(slot.ctx_sampling, parent_ctx->ctx, idx);
+            common_sampler_accept(slot.ctx_sampling, out.tok, true);
+
+            const int32_t n_probs = slot.params->sampling.n_probs;
+            if (n_probs > 0) {
+                llama_token_data_array cur_p = *common_sampler_get_candidates(slot.ctx_sampling, true);
+                for (size_t i = 0; i < std::min(cur_p.size, (size_t)n_probs); ++i) {
+                    out.probs.push_back({cur_p.data[i].id, cur_p.data[i].p});
+                }
+            }
+        } catch (const std::exception& e) {
+            out.error = e.what();
+        }
+        out.ready = true;
+    };
+
+    std::vector<llama_rn_slot*> to_sample;
+    for (auto& slot : slots) {
+        if (slot.state == SLOT_STATE_GENERATING && !slot.is_interrupted &&
+            slot.task_type == SLOT_TASK_TYPE_COMPLETION && slot.ctx_sampling != nullptr &&
+            !slot.should_use_mtp() && slot.i_batch >= 0 && slot.i_batch < batch.n_tokens) {
+            to_sample.push_back(&slot);
+        }
+    }
+    if (to_sample.size() > 1 && sampling_pool.size() > 0) {
+        // Synchronize and fetch every slot's logits serially; the workers then
+        // only read them. Slots whose token came from a backend sampler are
+        // left to the serial path below.
+        llama_synchronize(parent_ctx->ctx);
+        std::vector<const float*> slot_logits;
+        std::vector<llama_rn_slot*> fan_out;
+        for (llama_rn_slot* slot : to_sample) {
+            if (llama_get_sampled_token_ith(parent_ctx->ctx, slot->i_batch) != LLAMA_TOKEN_NULL ||
+                llama_get_sampled_logits_ith(parent_ctx->ctx, slot->i_batch) != nullptr ||
+                llama_get_sampled_probs_ith(parent_ctx->ctx, slot->i_batch) != nullptr) {
+                continue;
+            }
+            const float* logits = llama_get_logits_ith(parent_ctx->ctx, slot->i_batch);
+            if (logits != nullptr) {
+                fan_out.push_back(slot);
+                slot_logits.push_back(logits);
+            }
+        }
+        sampling_pool.run((int32_t) fan_out.size(), [&](int32_t i) {
+            llama_rn_slot& slot = *fan_out[i];
+            sample_slot(slot, slot.i_batch, sampled[slot.id], slot_logits[i]);
+        });
+    }
+
     // Process each slot in GENERATING state
     for (auto& slot : slots) {
         if (slot.state != SLOT_STATE_GENERATING) {
@@ -1117,6 +2139,7 @@ void llama_rn_slot_manager::sample_and_callback() {
                         slot.generated_tokens.push_back(token_output.tok);
                         slot.n_decoded++;
                         slot.cache_tokens.push_back(token_output.tok);
+                        pump_audio_stream(slot, token_output.tok);
 
                         // still emit an empty delta when it carries requested probs
                         if (slot.on_token_callback && (!token_output.text.empty() || !token_output.probs.empty())) {
@@ -1163,22 +2186,37 @@ void llama_rn_slot_manager::sample_and_callback() {
                     };
 
                     try {
-                        bool should_stop = false;
+                        const bool verified = slot.spec_i_batch >= 0;
+                        if (verified) {
+                            if (mtp_process_failed) {
+                                throw std::runtime_error("failed to process MTP target batch");
+                            }
+                            slot.accept_mtp_verify();
+                        }
 
-                        completion_token_output token_output = slot.next_token_mtp();
-                        const bool emitted = token_output.tok != -1;
-                        if (emitted) {
+                        // Everything the target accepted goes out in this
+                        // step, so a slot's speedup holds while other slots
+                        // keep the batch busy
+                        bool should_stop = false;
+                        bool emitted = false;
+                        while (!should_stop && !slot.spec_pending_tokens.empty()) {
+                            completion_token_output token_output;
+                            token_output.tok = slot.spec_pending_tokens.front();
+                            slot.spec_pending_tokens.pop_front();
+                            slot.num_tokens_predicted++;
                             should_stop = emit_token(std::move(token_output));
+                            emitted = true;
                         }
+                        slot.spec_pending_tokens.clear();
 
                         const bool done = should_stop ||
                             slot.stopped_limit ||
                             slot.context_full ||
-                            (slot.stopped_eos && slot.spec_pending_tokens.empty());
+                            slot.stopped_eos;
 
                         if (done) {
                             finish_slot();
-                        } else if (!emitted) {
+                        } else if (verified && !emitted) {
                             slot.incomplete = true;
                             slot.error_message = "MTP speculative decoding did not produce a token";
                             finish_slot();
@@ -1200,16 +2238,32 @@ void llama_rn_slot_manager::sample_and_callback() {
                     continue;
                 }
 
-                llama_token new_token_id;
+                sampled_token& step = sampled[slot.id];
                 if (slot.i_batch == -1 && slot.media_pending_token != LLAMA_TOKEN_NULL) {
                     // Pre-sampled right after media ingest (see build_batch);
                     // the context logits no longer belong to this slot here
-                    new_token_id = slot.media_pending_token;
+                    step.tok = slot.media_pending_token;
                     slot.media_pending_token = LLAMA_TOKEN_NULL;
-                } else {
-                    new_token_id = common_sampler_sample(slot.ctx_sampling, parent_ctx->ctx, slot.i_batch);
+                    common_sampler_accept(slot.ctx_sampling, step.tok, true);
+                    const int32_t n_probs = slot.params->sampling.n_probs;
+                    if (n_probs > 0) {
+                        llama_token_data_array cur_p = *common_sampler_get_candidates(slot.ctx_sampling, true);
+                        for (size_t i = 0; i < std::min(cur_p.size, (size_t)n_probs); ++i) {
+                            step.probs.push_back({cur_p.data[i].id, cur_p.data[i].p});
+                        }
+                    }
+                } else if (!step.ready) {
+                    sample_slot(slot, slot.i_batch, step);
+                }
+
+                if (!step.error.empty()) {
+                    LOG_ERROR("Slot %d: Sampling failed: %s", slot.id, step.error.c_str());
+                    slot.incomplete = true;
+                    slot.error_message = step.error;
+                    complete_slot(slot);
+                    continue;
                 }
-                common_sampler_accept(slot.ctx_sampling, new_token_id, true);
+                const llama_token new_token_id = step.tok;
 
                 if (llama_vocab_is_eog(vocab, new_token_id)) {
                     slot.stopped_eos = true;
@@ -1224,73 +2278,97 @@ void llama_rn_slot_manager::sample_and_callback() {
                     continue;
                 }
 
-                std::string token_text = common_token_to_piece(parent_ctx->ctx, new_token_id);
-                token_text = slot.utf8_gate.feed(token_text);
-                slot.generated_text += token_text;
-
-                // Update token generation timing
-                const int64_t t_current = lm_ggml_time_us();
-                slot.t_token_generation = (t_current - slot.t_start_generation) / 1e6;
-
-                completion_token_output token_output;
-                token_output.tok = new_token_id;
-                token_output.text = token_text;
-                token_output.request_id = slot.request_id;
-
-                const int32_t n_probs = slot.params->sampling.n_probs;
-                if (n_probs > 0) {
-                  llama_token_data_array cur_p = *common_sampler_get_candidates(slot.ctx_sampling, true);
-                  for (size_t i = 0; i < std::min(cur_p.size, (size_t)n_probs); ++i)
-                  {
-                      token_output.probs.push_back({cur_p.data[i].id, cur_p.data[i].p});
-                  }
-                }
-
-                slot.generated_tokens.push_back(new_token_id);
-                slot.n_decoded++;
-                slot.num_tokens_predicted++;
-
-                // Update cache_tokens to keep track of all processed tokens
-                // This is needed for state saving
-                slot.cache_tokens.push_back(new_token_id);
+                // Emit one token to the client and check the stop conditions
+                auto emit_token = [&](llama_token tok, std::vector<completion_token_output::token_prob> probs) -> bool {
+                    std::string token_text = common_token_to_piece(parent_ctx->ctx, tok);
+                    token_text = slot.utf8_gate.feed(token_text);
+                    slot.generated_text += token_text;
+
+                    // Update token generation timing
+                    const int64_t t_current = lm_ggml_time_us();
+                    slot.t_token_generation = (t_current - slot.t_start_generation) / 1e6;
+
+                    completion_token_output token_output;
+                    token_output.tok = tok;
+                    token_output.text = token_text;
+                    token_output.request_id = slot.request_id;
+                    token_output.probs = std::move(probs);
+
+                    slot.generated_tokens.push_back(tok);
+                    slot.n_decoded++;
+                    slot.num_tokens_predicted++;
+
+                    // Update cache_tokens to keep track of all processed tokens
+                    // This is needed for state saving
+                    slot.cache_tokens.push_back(tok);
+                    pump_audio_stream(slot, tok);
+
+                    // still emit an empty delta when it carries requested probs
+                    if (slot.on_token_callback && (!token_output.text.empty() || !token_output.probs.empty())) {
+                        slot.on_token_callback(token_output);
+                    }
 
-                // still emit an empty delta when it carries requested probs
-                if (slot.on_token_callback && (!token_output.text.empty() || !token_output.probs.empty())) {
-                    slot.on_token_callback(token_output);
-                }
+                    bool should_stop = false;
 
-                bool should_stop = false;
+                    if (slot.n_remaining > 0) {
+                        slot.n_remaining--;
+                        if (slot.n_remaining == 0) {
+                            slot.stopped_limit = true;
+                            should_stop = true;
+                            LOG_INFO("Slot %d: Stopped on token limit", slot.id);
+                        }
+                    }
 
-                if (slot.n_remaining > 0) {
-                    slot.n_remaining--;
-                    if (slot.n_remaining == 0) {
-                        slot.stopped_limit = true;
+                    if (slot.n_past >= slot.n_ctx) {
+                        slot.context_full = true;
                         should_stop = true;
-                        LOG_INFO("Slot %d: Stopped on token limit", slot.id);
+                        LOG_WARNING("Slot %d: Context full", slot.id);
                     }
-                }
 
-                if (slot.n_past >= slot.n_ctx) {
-                    slot.context_full = true;
-                    should_stop = true;
-                    LOG_WARNING("Slot %d: Context full", slot.id);
-                }
+                    if (!slot.stop_words.empty() && !slot.generated_text.empty()) {
+                        const std::string& text = slot.generated_text;
+                        const size_t last_token_size = token_text.size();
 
-                if (!slot.stop_words.empty() && !slot.generated_text.empty()) {
-                    const std::string& text = slot.generated_text;
-                    const size_t last_token_size = token_text.size();
+                        for (const std::string& word : slot.stop_words) {
+                            const size_t search_start = text.size() > word.size() + last_token_size
+                                ? text.size() - word.size() - last_token_size
+                                : 0;
+                            size_t pos = text.find(word, search_start);
 
-                    for (const std::string& word : slot.stop_words) {
-                        const size_t search_start = text.size() > word.size() + last_token_size
-                            ? text.size() - word.size() - last_token_size
-                            : 0;
-                        size_t pos = text.find(word, search_start);
+                            if (pos != std::string::npos) {
+                                slot.stopped_word = true;
+                                slot.stopping_word = word;
+                                should_stop = true;
+                                LOG_INFO("Slot %d: Stopped on word '%s'", slot.id, word.c_str());
+                                break;
+                            }
+                        }
+                    }
 
-                        if (pos != std::string::npos) {
-                            slot.stopped_word = true;
-                            slot.stopping_word = word;
+                    LOG_VERBOSE("Slot %d: Generated token %d ('%s'), n_past=%d, n_decoded=%d",
+                               slot.id, tok, token_text.c_str(), slot.n_past, slot.n_decoded);
+                    return should_stop;
+                };
+
+                bool should_stop = emit_token(new_token_id, std::move(step.probs));
+
+                // Jump-forward: emit the run the grammar forces next right away
+                // and queue it to decode with the sampled token in one batch.
+                // Each slot keeps to its share of the batch and its context.
+                if (!should_stop && slot.params->sampling.jump_forward) {
+                    int32_t max_forced = std::min(n_batch / n_parallel - 1, slot.n_ctx - (int32_t) slot.n_past - 2);
+                    if (slot.n_remaining > 0) {
+                        max_forced = std::min(max_forced, slot.n_remaining);
+                    }
+                    const bool with_probs = slot.params->sampling.n_probs > 0;
+                    for (const llama_token tok : sample_forced_tokens(slot.ctx_sampling, vocab, max_forced)) {
+                        std::vector<completion_token_output::token_prob> probs;
+                        if (with_probs) {
+                            probs.push_back({tok, 1.0f});
+                        }
+                        slot.jump_forward_pending++;
+                        if (emit_token(tok, std::move(probs))) {
                             should_stop = true;
-                            LOG_INFO("Slot %d: Stopped on word '%s'", slot.id, word.c_str());
                             break;
                         }
                     }
@@ -1304,9 +2382,6 @@ void llama_rn_slot_manager::sample_and_callback() {
 
                     complete_slot(slot);
                 }
-
-                LOG_VERBOSE("Slot %d: Generated token %d ('%s'), n_past=%d, n_decoded=%d",
-                           slot.id, new_token_id, token_text.c_str(), slot.n_past, slot.n_decoded);
                 break;
             }
 
@@ -1320,17 +2395,32 @@ void llama_rn_slot_manager::sample_and_callback() {
 
                 std::vector<float> normalized(n_embd, 0.0f);
                 if (n_embd >= 4) {
-                    LOG_INFO("Embedding data: 0: %f 1: %f 2: %f 3: %f",
+                    LOG_VERBOSE("Embedding data: 0: %f 1: %f 2: %f 3: %f",
                              embedding[0], embedding[1], embedding[2], embedding[3]);
                 }
-                LOG_INFO("Normalizing embedding with normalize=%d", slot.embd_normalize);
+                LOG_VERBOSE("Normalizing embedding with normalize=%d", slot.embd_normalize);
                 common_embd_normalize(embedding.data(), normalized.data(), n_embd, slot.embd_normalize);
                 if (n_embd >= 4) {
-                    LOG_INFO("Normalized embedding data: 0: %f 1: %f 2: %f 3: %f",
+                    LOG_VERBOSE("Normalized embedding data: 0: %f 1: %f 2: %f 3: %f",
                              normalized[0], normalized[1], normalized[2], normalized[3]);
                 }
 
-                if (slot.on_embedding_callback) {
+                if (!slot.embedding_inputs.empty()) {
+                    std::copy(normalized.begin(), normalized.end(),
+                              slot.embedding_results.begin() + slot.embedding_current_index * n_embd);
+                    slot.embedding_current_index++;
+
+                    if (slot.embedding_current_index < slot.embedding_inputs.size()) {
+                        slot.load_prompt(slot.embedding_inputs[slot.embedding_current_index]);
+                        slot.state = SLOT_STATE_PROCESSING_PROMPT;
+                        slot.i_batch = -1;
+                        continue;
+                    }
+
+                    if (slot.on_embedding_batch_callback) {
+                        slot.on_embedding_batch_callback(slot.request_id, slot.embedding_results);
+                    }
+                } else if (slot.on_embedding_callback) {
                     slot.on_embedding_callback(slot.request_id, normalized);
                 }
 
@@ -1351,7 +2441,10 @@ void llama_rn_slot_manager::sample_and_callback() {
                 slot.rerank_current_index++;
 
                 if (slot.rerank_current_index < slot.rerank_prompt_tokens.size()) {
-                    if (parent_ctx && parent_ctx->ctx) {
+                    // load_prompt trims the sequence back to the prefix the
+                    // next document shares with this one (the query) when
+                    // the model allows it; otherwise start it over.
+                    if (!slot.rerank_reuse_prefix && parent_ctx && parent_ctx->ctx) {
                         // Only this slot's sequence - a global clear would
                         // corrupt other slots' in-flight sequences
                         llama_memory_seq_rm(llama_get_memory(parent_ctx->ctx), slot.id, 0, -1);
@@ -1369,6 +2462,10 @@ void llama_rn_slot_manager::sample_and_callback() {
                 if (parent_ctx && parent_ctx->ctx) {
                     llama_memory_seq_rm(llama_get_memory(parent_ctx->ctx), slot.id, 0, -1);
                 }
+                // Nothing left to reuse; keep the history from attracting
+                // prefix-routed requests
+                slot.cache_tokens.clear();
+                slot.bitmap_past_hashes.clear();
 
                 slot.state = SLOT_STATE_DONE;
                 continue;
@@ -1402,6 +2499,7 @@ void llama_rn_slot_manager::release_completed_slots() {
 void llama_rn_slot_manager::update_slots() {
     // Step 1: Terminalize cancellations and process pending queue (with mutex)
     bool completed_interrupted = false;
+    std::vector<std::string> prefetched_lora = prefetch_queued_lora();
     {
         std::lock_guard<std::mutex> lock(slots_mutex);
         for (auto& slot : slots) {
@@ -1422,6 +2520,7 @@ void llama_rn_slot_manager::update_slots() {
         // the slot in this update rather than waiting for another worker turn.
         process_pending_queue();
     }
+    release_prefetched_lora(prefetched_lora);
 
     // Step 2: Check if any slots are active (with mutex)
     bool has_active = false;
@@ -1458,8 +2557,11 @@ void llama_rn_slot_manager::update_slots() {
     }
 
     // Step 4: Process batch if we have tokens (NO mutex - llama_decode is thread-safe)
+    const int64_t t_decode_start = lm_ggml_time_us();
+    double t_decode_ms = 0.0;
     if (batch.n_tokens > 0) {
         bool success = process_batch();
+        t_decode_ms = (lm_ggml_time_us() - t_decode_start) / 1000.0;
         if (!success) {
             LOG_ERROR("Batch processing failed");
             // Mark all active slots as done with error (with mutex)
@@ -1529,7 +2631,16 @@ void llama_rn_slot_manager::update_slots() {
                 complete_slot(slot);
             }
         }
+
+        const int64_t t_sample_start = lm_ggml_time_us();
         sample_and_callback();
+        const double t_sample_ms = (lm_ggml_time_us() - t_sample_start) / 1000.0;
+
+        n_steps++;
+        t_decode_total_ms += t_decode_ms;
+        t_sample_total_ms += t_sample_ms;
+        LOG_VERBOSE("Step %lld: decode %.3f ms (%d tokens), sample %.3f ms",
+                   (long long) n_steps, t_decode_ms, batch.n_tokens, t_sample_ms);
     }
 
     // Step 6: Release completed slots (with mutex)
@@ -1539,10 +2650,12 @@ void llama_rn_slot_manager::update_slots() {
     }
 
     // Step 7: Process pending queue again - assign requests to newly freed slots (with mutex)
+    prefetched_lora = prefetch_queued_lora();
     {
         std::lock_guard<std::mutex> lock(slots_mutex);
         process_pending_queue();
     }
+    release_prefetched_lora(prefetched_lora);
 
     // Step 8: Notify subscribers of status change (outside of slots_mutex)
     // Check if there are subscribers before calling notify
@@ -1579,10 +2692,14 @@ void llama_rn_slot_manager::start_processing_loop() {
             std::unique_lock<std::mutex> lock(slots_mutex);
 
             // Check if we have any active work or pending requests
+            // (slots waiting on the media worker have nothing to decode yet,
+            // unless they were cancelled and need terminalizing)
             bool has_work = !queue_requests.empty();
             if (!has_work) {
                 for (const auto& slot : slots) {
-                    if (slot.state == SLOT_STATE_PROCESSING_PROMPT || slot.state == SLOT_STATE_GENERATING) {
+                    if ((slot.state == SLOT_STATE_PROCESSING_PROMPT &&
+                         (!is_waiting_for_media(slot) || slot.is_interrupted)) ||
+                        slot.state == SLOT_STATE_GENERATING) {
                         has_work = true;
                         break;
                     }
@@ -1592,8 +2709,23 @@ void llama_rn_slot_manager::start_processing_loop() {
             // If no work, wait for notification
             if (!has_work && processing_active.load()) {
                 slots_cv.wait(lock, [this]() {
-                    // Wake up if: there are pending requests, or processing should stop
-                    return !queue_requests.empty() || !processing_active.load();
+                    // Wake up if: there are pending requests, media finished
+                    // encoding, a slot waiting on media was cancelled, or
+                    // processing should stop
+                    if (!queue_requests.empty() || !processing_active.load()) {
+                        return true;
+                    }
+                    for (const auto& entry : media_jobs) {
+                        if (entry.second->done.load()) {
+                            return true;
+                        }
+                    }
+                    for (const auto& slot : slots) {
+                        if (slot.is_interrupted && slot.state == SLOT_STATE_PROCESSING_PROMPT) {
+                            return true;
+                        }
+                    }
+                    return false;
                 });
             } else if (has_work) {
                 lock.unlock();
@@ -1633,14 +2765,25 @@ llama_rn_parallel_status llama_rn_slot_manager::get_status() {
     status.n_parallel = n_parallel;
     status.active_slots = 0;
     status.queued_requests = static_cast<int32_t>(queue_requests.size());
+    status.shared_prefix_hits = shared_prefix_hits;
+    status.shared_prefix_tokens = shared_prefix_tokens;
+    status.n_steps = n_steps;
+    status.decode_ms = t_decode_total_ms;
+    status.sample_ms = t_sample_total_ms;
 
     // Add active slot requests
     for (const auto& slot : slots) {
         if (slot.state != SLOT_STATE_IDLE && slot.state != SLOT_STATE_DONE) {
+            // Cancelled parts of a split request only wait for the processing
+            // thread to release them; their results were already delivered
+            if (slot.is_interrupted && (slot.on_rerank_callback || slot.on_embedding_batch_callback)) {
+                continue;
+            }
             status.active_slots++;
 
             llama_rn_request_status req_status;
-            req_status.request_id = slot.request_id;
+            auto parent_it = part_parents.find(slot.request_id);
+            req_status.request_id = parent_it != part_parents.end() ? parent_it->second : slot.request_id;
 
             // Map task type to string
             switch (slot.task_type) {
@@ -1663,6 +2806,9 @@ llama_rn_parallel_status llama_rn_slot_manager::get_status() {
             req_status.generation_ms = slot.t_token_generation * 1e3;
             req_status.tokens_per_second = (slot.n_decoded > 0 && slot.t_token_generation > 0.0)
                 ? slot.n_decoded / slot.t_token_generation : 0.0;
+            req_status.slot_id = slot.id;
+            req_status.slot_selection = slot.routed_by_prefix ? "prefix" : "lru";
+            req_status.cache_n = slot.n_prompt_tokens_cache;
 
             status.requests.push_back(req_status);
         }
@@ -1685,6 +2831,8 @@ llama_rn_parallel_status llama_rn_slot_manager::get_status() {
         req_status.prompt_ms = 0.0;
         req_status.generation_ms = 0.0;
         req_status.tokens_per_second = 0.0;
+        req_status.slot_id = -1;
+        req_status.cache_n = 0;
 
         status.requests.push_back(req_status);
     }
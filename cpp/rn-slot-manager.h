@@ -2,6 +2,8 @@
 #define RN_SLOT_MANAGER_H
 
 #include "rn-slot.h"
+#include "rn-prefix-index.h"
+#include "rn-state-store.h"
 #include "common.h"
 #include "llama.h"
 #include <vector>
@@ -12,12 +14,14 @@
 #include <thread>
 #include <atomic>
 #include <condition_variable>
+#include <memory>
 
 namespace rnllama {
 
 // Forward declarations
 struct llama_rn_context;
 struct completion_token_output;
+struct mtmd_prepared_media;
 
 // Status structures for exposing slot manager state to JS
 struct llama_rn_request_status {
@@ -29,15 +33,29 @@ struct llama_rn_request_status {
     double prompt_ms;
     double generation_ms;
     double tokens_per_second;
+    int32_t slot_id;            // Assigned slot (-1 while queued)
+    std::string slot_selection; // "prefix" (cached prefix reuse), "lru", or "" while queued
+    int32_t cache_n;            // Prompt tokens served from the slot's cache
 };
 
 struct llama_rn_parallel_status {
     int32_t n_parallel;
     int32_t active_slots;
     int32_t queued_requests;
+    int32_t shared_prefix_hits;      // Prompts seeded from another slot's sequence
+    int64_t shared_prefix_tokens;    // Prefill tokens saved by those copies
+    int64_t n_steps;                 // Decode/sample steps run so far
+    double decode_ms;                // Total time in llama_decode
+    double sample_ms;                // Total time sampling and running callbacks
     std::vector<llama_rn_request_status> requests;
 };
 
+// How build_batch spreads prompt tokens over slots still prefilling
+enum llama_rn_prefill_policy {
+    PREFILL_POLICY_FIFO = 0,  // Slot order; each slot fills the batch as far as it can
+    PREFILL_POLICY_FAIR,      // Priority order, round-robin among equal priorities, per-slot chunk cap
+};
+
 enum class llama_rn_cancel_result {
     ACTIVE,
     QUEUED,
@@ -48,14 +66,23 @@ enum class llama_rn_cancel_result {
 struct llama_rn_queued_request {
     int32_t request_id;
     llama_rn_slot_task_type task_type;
+    int32_t priority;  // Higher priority leaves the queue (and prefills) first
     common_params params;
     std::vector<llama_token> prompt_tokens;
     std::function<void(const completion_token_output&)> on_token;
     std::function<void(llama_rn_slot*)> on_complete;
 
+    // Streaming TTS decode (vocoder contexts): PCM chunks while generating
+    llama_rn_audio_chunk_cb on_audio_chunk;
+    llama_rn_audio_stream_options audio_stream_options;
+
     // Media paths for multimodal
     std::vector<std::string> media_paths;
     std::string prompt_text;  // Original prompt text (needed for media processing)
+    std::vector<std::string> media_hashes;  // Bitmap identities, used for prefix-aware slot routing
+
+    // LoRA adapters (registry handles) applied to this request's sequence only
+    std::vector<common_adapter_lora_info> lora;
 
     // Chat format parameters
     int chat_format;
@@ -70,6 +97,10 @@ struct llama_rn_queued_request {
     int embd_normalize;
     std::function<void(int32_t, const std::vector<float>&)> on_embedding;
 
+    // Embedding batch parameters (several inputs, one result buffer)
+    std::vector<std::vector<llama_token>> embedding_inputs;
+    std::function<void(int32_t, const std::vector<float>&)> on_embedding_batch;
+
     // Rerank parameters
     std::vector<std::vector<llama_token>> rerank_prompt_tokens;
     std::function<void(int32_t, const std::vector<float>&)> on_rerank;
@@ -80,18 +111,61 @@ struct llama_rn_queued_request {
     std::string save_prompt_state_path; // File path to save prompt state to after prompt processing
     int32_t load_state_size;           // Number of tokens to load (0 or -1 = all tokens)
     int32_t save_state_size;           // Number of tokens to save (0 or -1 = all tokens)
+    bool reuse_state_files;            // Without load_state_path, resume from the longest indexed state file
 
     llama_rn_queued_request() :
         request_id(-1),
         task_type(SLOT_TASK_TYPE_COMPLETION),
+        priority(0),
         chat_format(0),
         reasoning_format(COMMON_REASONING_FORMAT_NONE),
         embd_normalize(-1),
         load_state_size(-1),
-        save_state_size(-1)
+        save_state_size(-1),
+        reuse_state_files(false)
     {}
 };
 
+// Media of one slot's prompt, loaded and encoded by the media worker while
+// the decode loop keeps running. Written by the worker until done is set.
+struct llama_rn_media_job {
+    int32_t slot_id = -1;
+    int32_t request_id = -1;
+    std::string prompt_text;
+    std::vector<std::string> media_paths;
+    std::vector<llama_token> cached_tokens;   // Slot history, to skip reusable media
+    std::vector<std::string> cached_hashes;
+    std::shared_ptr<mtmd_prepared_media> prepared;
+    std::string error;
+    std::atomic<bool> done{false};
+    std::atomic<bool> cancelled{false};
+};
+
+// Fork-join workers for per-slot sampling. run() spreads task indices over
+// the workers and the calling thread and returns once all of them are done.
+struct llama_rn_sampling_pool {
+    ~llama_rn_sampling_pool();
+
+    void start(int32_t n_workers);
+    void stop();
+    int32_t size() const { return (int32_t) workers.size(); }
+    void run(int32_t n_tasks, const std::function<void(int32_t)>& fn);
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable cv_work;
+    std::condition_variable cv_done;
+    const std::function<void(int32_t)>* job = nullptr;
+    int32_t n_job_tasks = 0;
+    std::atomic<int32_t> next_task{0};
+    int32_t n_busy = 0;
+    uint64_t generation = 0;
+    bool stopping = false;
+
+    void worker_loop();
+};
+
 // Slot manager for parallel decoding
 struct llama_rn_slot_manager {
     // Parent context reference
@@ -124,11 +198,74 @@ struct llama_rn_slot_manager {
     int32_t mtp_spec_n_gpu_layers = -1;
     lm_ggml_type mtp_spec_cache_type_k = LM_GGML_TYPE_F16;
     lm_ggml_type mtp_spec_cache_type_v = LM_GGML_TYPE_F16;
+    // MTP slots put their verify rows (id_last + draft) at the head of the
+    // batch, so the draft head catches up on all of them from one prefix view
+    int32_t n_batch_mtp = 0;
+    bool mtp_process_failed = false;
 
     // Configuration
     float slot_prompt_similarity;          // Threshold for cache reuse (0.0-1.0)
     bool continuous_batching;              // Allow mixing prompt/generation
 
+    // Prefill scheduling: under the fair policy a slot takes at most
+    // prefill_chunk prompt tokens per step (0 = an even share of the batch)
+    // before leftover room is handed out again in the same order. While any
+    // slot is generating, a step carries at most prefill_decode_budget prompt
+    // tokens (0 = no limit) so long prompts cannot stall token latency.
+    // Embedding and rerank prompts count too; being unsplittable, one that
+    // does not fit waits unless it is first in line.
+    llama_rn_prefill_policy prefill_policy = PREFILL_POLICY_FIFO;
+    int32_t prefill_chunk = 0;
+    int32_t prefill_decode_budget = 0;
+    int32_t prefill_cursor = 0;            // Round-robin start among prefilling slots
+
+    // Shared-prefix reuse across slots (unified KV cache only): the live slot
+    // sequences act as the registry of ingested prefixes
+    int32_t shared_prefix_hits = 0;
+    int64_t shared_prefix_tokens = 0;
+
+    // Per-slot sampling runs on these workers when several slots generate
+    llama_rn_sampling_pool sampling_pool;
+
+    // Per-step timing (decode vs. sample), for checking where a step goes
+    int64_t n_steps = 0;
+    double t_decode_total_ms = 0.0;
+    double t_sample_total_ms = 0.0;
+
+    // Radix index over reusable prefixes: idle slot sequences (keyed by slot
+    // id, refreshed on release) and text-only state files saved by slots
+    rn_prefix_index prefix_index;
+    std::map<int32_t, std::string> state_file_paths;  // RN_PREFIX_STATE_FILE key -> path
+    int32_t next_state_file_key = 0;
+
+    // Multi-input requests (rerank, embedding batches) split across slots:
+    // request id -> ids of its other parts, so cancelling the request cancels
+    // all of them, and the callback delivering the gathered results as
+    // incomplete. part_parents maps the internal part ids back to the request
+    // id for status reports.
+    struct llama_rn_request_group {
+        std::vector<int32_t> part_ids;
+        std::function<void()> on_cancel;
+    };
+    std::map<int32_t, llama_rn_request_group> request_parts;
+    std::map<int32_t, int32_t> part_parents;
+
+    // Media encoding stage: a slot with unprocessed media hands its prompt to
+    // media_thread and sits out of the batch until the embeddings are ready,
+    // so image decode and vision encoding never hold slots_mutex
+    std::map<int32_t, std::shared_ptr<llama_rn_media_job>> media_jobs;  // slot id -> job (slots_mutex)
+    std::deque<std::shared_ptr<llama_rn_media_job>> media_queue;        // media_mutex
+    std::mutex media_mutex;
+    std::condition_variable media_cv;
+    std::thread media_thread;
+    bool media_stopping = false;
+
+    // Slot state saves (save_state_path, save_prompt_state_path) are copied
+    // out on the processing thread and written to disk here, so a large KV
+    // write never stalls the other slots. Loads wait for pending saves to
+    // the same path.
+    rn_state_writer state_writer;
+
     // Processing loop control
     std::mutex slots_mutex;                // Mutex for thread-safe access to slots
     std::condition_variable slots_cv;      // Condition variable for efficient waiting
@@ -169,7 +306,13 @@ struct llama_rn_slot_manager {
         int32_t save_state_size,
         std::function<void(const completion_token_output&)> on_token,
         std::function<void(llama_rn_slot*)> on_complete,
-        int32_t request_id = -1
+        int32_t request_id = -1,
+        const std::vector<std::string>& media_hashes = {},
+        int32_t priority = 0,
+        const std::vector<common_adapter_lora_info>& lora = {},
+        bool reuse_state_files = false,
+        llama_rn_audio_chunk_cb on_audio_chunk = nullptr,
+        const llama_rn_audio_stream_options& audio_stream_options = {}
     );
 
     int32_t queue_embedding_request(
@@ -179,16 +322,33 @@ struct llama_rn_slot_manager {
         int32_t request_id = -1
     );
 
+    // Embeds several inputs; on_results gets n_embd normalized floats per
+    // input, contiguous in input order. A cancelled request still gets
+    // on_results once, with incomplete set and zeros for unfinished inputs.
+    int32_t queue_embedding_batch_request(
+        const std::vector<std::vector<llama_token>>& inputs,
+        int embd_normalize,
+        std::function<void(int32_t, const std::vector<float>&, bool incomplete)> on_results,
+        int32_t request_id = -1
+    );
+
+    // Scores documents against query in input order; like embedding batches,
+    // a cancelled request gets on_results with incomplete set
     int32_t queue_rerank_request(
         const std::string& query,
         const std::vector<std::string>& documents,
         int normalize,
-        std::function<void(int32_t, const std::vector<float>&)> on_results,
+        std::function<void(int32_t, const std::vector<float>&, bool incomplete)> on_results,
         int32_t request_id = -1
     );
 
     // Slot management
-    llama_rn_slot* get_available_slot(const std::vector<llama_token>& prompt);
+    llama_rn_slot* get_available_slot(
+        const std::vector<llama_token>& prompt,
+        const std::vector<std::string>& media_hashes = {},
+        bool prefer_cached_prefix = true,
+        const std::vector<common_adapter_lora_info>& lora = {}
+    );
     llama_rn_slot* get_slot_by_request_id(int32_t request_id);
     void release_slot(llama_rn_slot* slot);
     llama_rn_cancel_result cancel_request(int32_t request_id);
@@ -203,16 +363,66 @@ struct llama_rn_slot_manager {
     // Helper methods
     float compute_similarity(const std::vector<llama_token>& a,
                             const std::vector<llama_token>& b);
+    size_t get_reusable_prefix(const llama_rn_slot& slot,
+                               const std::vector<llama_token>& prompt,
+                               const std::vector<std::string>& media_hashes,
+                               const std::vector<common_adapter_lora_info>& lora = {});
+    // Route the slot's sequence through lora, dropping its cache if that was
+    // decoded with other adapters. The slot holds a registry reference on each
+    // adapter until it is routed elsewhere; false if one fails to load
+    bool set_slot_lora(llama_rn_slot& slot, std::vector<common_adapter_lora_info> lora);
+    bool share_prompt_prefix(llama_rn_slot& slot);
+    void register_state_file(const std::string& path, const llama_token* tokens, size_t n_tokens);
+    void forget_state_file(const std::string& path);
+    std::string find_state_file(const llama_rn_slot& slot, const std::vector<llama_token>& prompt);
     void build_batch();
     bool process_batch();
     void sample_and_callback();
 
-    // Finish a slot's generation: flush the UTF-8 gate, mark done, notify
+    // Finish a slot's generation: flush the UTF-8 gate and audio stream,
+    // mark done, notify
     void complete_slot(llama_rn_slot & slot);
+    // Feed a generated token to the slot's streaming TTS decode, if any
+    void pump_audio_stream(llama_rn_slot & slot, llama_token tok);
+
+    // Media worker (see media_jobs)
+    void submit_media_job(llama_rn_slot & slot);
+    void drop_media_job(int32_t slot_id);
+    bool is_waiting_for_media(const llama_rn_slot & slot) const;
+    void media_worker_loop();
+    void stop_media_worker();
     common_speculative* ensure_mtp_speculative(common_params& params);
     llama_context* get_mtp_draft_context() const;
     void reset_mtp_speculative();
 
+    // Insert a request behind every queued request of equal or higher priority
+    void enqueue_request(llama_rn_queued_request&& request);
+
+    // Split a multi-input request into one contiguous part per slot and queue
+    // the parts. make_part fills the task fields of the part covering inputs
+    // [begin, end) and installs on_part as its result callback; each part
+    // returns item_width floats per input. Results are gathered in input
+    // order (fill where missing) and delivered once every part is done, or
+    // early and incomplete when the request is cancelled.
+    using request_part_result_cb = std::function<void(int32_t, const std::vector<float>&)>;
+    void queue_request_group(
+        int32_t request_id,
+        size_t n_inputs,
+        size_t item_width,
+        float fill,
+        const std::function<void(llama_rn_queued_request&, size_t, size_t, request_part_result_cb)>& make_part,
+        std::function<void(int32_t, const std::vector<float>&, bool)> on_results
+    );
+
+    // Forget a split request's parts once its results are delivered
+    void erase_request_group(int32_t request_id);
+
+    // Load the adapters of the requests that can be scheduled now before
+    // slots_mutex is taken, so set_slot_lora only takes references; returns
+    // the paths holding a reference until release_prefetched_lora
+    std::vector<std::string> prefetch_queued_lora();
+    void release_prefetched_lora(const std::vector<std::string>& paths);
+
     // Process pending queue
     void process_pending_queue();
 
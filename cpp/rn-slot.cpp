@@ -6,8 +6,8 @@
 #include "chat.h"
 #include <algorithm>
 #include <cstring>
-#include <limits>
 #include <mutex>
+#include <numeric>
 #include <stdexcept>
 
 namespace rnllama {
@@ -41,6 +41,8 @@ llama_rn_slot::llama_rn_slot() :
     t_start_process(0),
     t_start_generation(0),
     t_last_used(0),
+    routed_by_prefix(false),
+    routed_prefix_n(0),
     n_prompt_tokens_cache(0),
     n_prompt_tokens_processed(0),
     t_prompt_processing(0.0),
@@ -48,11 +50,14 @@ llama_rn_slot::llama_rn_slot() :
     is_interrupted(false),
     prompt_processing_finished(false),
     media_processed(false),
+    embedding_current_index(0),
     rerank_current_index(0),
+    rerank_reuse_prefix(false),
     load_state_size(-1),
     save_state_size(-1),
     save_prompt_state_pending(false),
     save_prompt_state_tokens(-1),
+    state_reused(false),
     num_draft_tokens(0),
     num_draft_tokens_accepted(0)
 {
@@ -71,10 +76,12 @@ llama_rn_slot::~llama_rn_slot() {
 void llama_rn_slot::reset() {
     state = SLOT_STATE_IDLE;
     request_id = -1;
+    priority = 0;
     n_past = 0;
     n_decoded = 0;
     n_remaining = -1;
     i_batch = -1;
+    jump_forward_pending = 0;
     params = nullptr;
 
     // Clear token vectors
@@ -128,15 +135,24 @@ void llama_rn_slot::reset() {
     // Clear callbacks
     on_token_callback = nullptr;
     on_complete_callback = nullptr;
+    if (audio_stream.on_chunk && parent_ctx != nullptr && parent_ctx->isVocoderEnabled()) {
+        parent_ctx->tts_wrapper->abortSlotAudioStream(audio_stream);
+    }
+    audio_stream = llama_rn_slot_audio_stream();
     on_embedding_callback = nullptr;
+    on_embedding_batch_callback = nullptr;
     on_rerank_callback = nullptr;
 
     // Reset task-specific data
     task_type = SLOT_TASK_TYPE_COMPLETION;
     embd_normalize = -1;
+    embedding_inputs.clear();
+    embedding_results.clear();
+    embedding_current_index = 0;
     rerank_prompt_tokens.clear();
     rerank_scores.clear();
     rerank_current_index = 0;
+    rerank_reuse_prefix = false;
 
     // Reset state management
     if (!load_state_path.empty() || !save_state_path.empty() || !save_prompt_state_path.empty()) {
@@ -153,6 +169,7 @@ void llama_rn_slot::reset() {
     save_state_size = -1;
     save_prompt_state_pending = false;
     save_prompt_state_tokens = -1;
+    state_reused = false;
 
     // Reset timing fields
     t_start_process = 0;
@@ -161,6 +178,8 @@ void llama_rn_slot::reset() {
     n_prompt_tokens_processed = 0;
     t_prompt_processing = 0.0;
     t_token_generation = 0.0;
+    routed_by_prefix = false;
+    routed_prefix_n = 0;
 
     // Note: Keep cache_tokens for potential reuse
     // Note: Keep t_last_used for LRU tracking
@@ -189,26 +208,40 @@ void llama_rn_slot::load_prompt(const std::vector<llama_token>& tokens) {
         n_prompt_tokens_cache = 0;
         LOG_VERBOSE("Slot %d (req=%d): Media prompt, deferring memory reuse to processMedia (%zu cached tokens)",
                    id, request_id, cache_tokens.size());
-    } else if (!load_state_path.empty() && !cache_tokens.empty()) {
-        // Find how many tokens match between cached state and new prompt
+    } else if (!cache_tokens.empty() &&
+               (!load_state_path.empty() || task_type == SLOT_TASK_TYPE_COMPLETION ||
+                (task_type == SLOT_TASK_TYPE_RERANK && rerank_reuse_prefix))) {
+        // Find how many tokens match between cached state (loaded file, or the
+        // slot's resident sequence from its previous request) and new prompt
         size_t n_matching = find_common_prefix_length(cache_tokens, tokens);
 
+        // A resident history ends with the last sampled token, which is never
+        // decoded; only the prefix the sequence memory backs is reusable
+        size_t n_cached = cache_tokens.size();
+        if (load_state_path.empty() && parent_ctx && parent_ctx->ctx) {
+            auto * kv = llama_get_memory(parent_ctx->ctx);
+            const llama_pos mem_len = llama_memory_seq_pos_max(kv, id) + 1;
+            n_cached = std::min(n_cached, (size_t) std::max<llama_pos>(0, mem_len));
+            n_matching = std::min(n_matching, n_cached);
+        }
+
         // For recurrent/hybrid models, we can only reuse state if:
         // 1. The cached tokens exactly match the prompt (all prompt tokens are prefix of cached)
         // 2. We don't need to truncate the recurrent state
         // If cached tokens exceed the prompt, we must clear and reprocess because
         // recurrent state cannot be truncated.
         bool can_reuse_state = (n_matching > 0);
-        if (is_recurrent_or_hybrid && n_matching < cache_tokens.size()) {
+        if (is_recurrent_or_hybrid && n_matching < n_cached) {
             // Cached tokens extend beyond the prompt - can't truncate recurrent state
             LOG_WARNING("Slot %d (req=%d): Cannot reuse recurrent state (cached %zu > matching %zu), clearing",
-                       id, request_id, cache_tokens.size(), n_matching);
+                       id, request_id, n_cached, n_matching);
             can_reuse_state = false;
         }
 
         if (can_reuse_state) {
-            LOG_INFO("Slot %d (req=%d): Reusing loaded state (%zu matching tokens from %zu cached, %zu prompt tokens)",
-                     id, request_id, n_matching, cache_tokens.size(), tokens.size());
+            LOG_INFO("Slot %d (req=%d): Reusing %s state (%zu matching tokens from %zu cached, %zu prompt tokens)",
+                     id, request_id, load_state_path.empty() ? "resident" : "loaded",
+                     n_matching, cache_tokens.size(), tokens.size());
 
             // If ALL prompt tokens match, we need to re-evaluate the last token
             // to get fresh logits for sampling. Set n_past to n_matching - 1 so
@@ -236,8 +269,10 @@ void llama_rn_slot::load_prompt(const std::vector<llama_token>& tokens) {
             bitmap_past_hashes.clear();
         } else {
             // No matching tokens, start fresh
-            LOG_WARNING("Slot %d (req=%d): Loaded state doesn't match prompt (0 matching tokens), clearing cache",
-                       id, request_id);
+            if (!load_state_path.empty()) {
+                LOG_WARNING("Slot %d (req=%d): Loaded state doesn't match prompt (0 matching tokens), clearing cache",
+                           id, request_id);
+            }
 
             n_past = 0;
             n_prompt_tokens_cache = 0;
@@ -362,6 +397,8 @@ void llama_rn_slot::reset_speculative() {
     spec_id_last = LLAMA_TOKEN_NULL;
     spec_n_past = 0;
     spec_draft.clear();
+    spec_n_draft_max = 0;
+    spec_i_batch = -1;
     spec_pending_tokens.clear();
 }
 
@@ -477,8 +514,23 @@ void llama_rn_slot::eval_mtp_prompt() {
     common_speculative_begin(spec, seq_id, spec_prompt);
 }
 
-bool llama_rn_slot::refill_mtp_tokens() {
-    const llama_seq_id seq_id = id;
+int32_t llama_rn_slot::mtp_draft_limit(int32_t n_room) const {
+    const int32_t n_max = params->speculative.draft.n_max;
+    // The verify row for id_last always fits; the draft gets what is left
+    const int32_t n_draft_remaining = n_remaining < 0
+        ? n_max
+        : std::max<int32_t>(0, n_remaining - 1);
+    const int32_t n_draft_ctx = std::max<int32_t>(0, n_ctx - (int32_t) spec_n_past - 1);
+    const int32_t n_draft_room = std::max<int32_t>(0, n_room - 1);
+    return std::min<int32_t>(
+        n_max,
+        std::min<int32_t>(n_draft_remaining, std::min<int32_t>(n_draft_ctx, n_draft_room)));
+}
+
+bool llama_rn_slot::begin_mtp_draft(int32_t n_room) {
+    spec_draft.clear();
+    spec_n_draft_max = 0;
+    spec_i_batch = -1;
 
     if (spec_id_last == LLAMA_TOKEN_NULL || stopped_eos || stopped_limit || context_full) {
         return false;
@@ -487,65 +539,52 @@ bool llama_rn_slot::refill_mtp_tokens() {
         stopped_limit = true;
         return false;
     }
-
     if (spec_n_past + 1 >= n_ctx) {
         context_full = true;
         return false;
     }
 
-    spec_draft.clear();
-
-    const int32_t remaining = n_remaining < 0
-        ? std::numeric_limits<int32_t>::max()
-        : n_remaining;
-    const int32_t n_draft_remaining = remaining == std::numeric_limits<int32_t>::max()
-        ? params->speculative.draft.n_max
-        : std::max<int32_t>(0, remaining - 1);
-    const int32_t n_draft_ctx = std::max<int32_t>(0, n_ctx - (int32_t) spec_n_past - 1);
-    const int32_t n_draft_batch = std::max<int32_t>(0, llama_n_batch(parent_ctx->ctx) - 1);
-    const int32_t n_draft_limit = std::min<int32_t>(
-        params->speculative.draft.n_max,
-        std::min<int32_t>(n_draft_remaining, std::min<int32_t>(n_draft_ctx, n_draft_batch)));
-
-    if (n_draft_limit > 0) {
-        common_speculative_get_draft_params(spec, seq_id) = {
-            /* .drafting = */ true,
-            /* .n_max    = */ n_draft_limit,
-            /* .n_past   = */ spec_n_past,
-            /* .id_last  = */ spec_id_last,
-            /* .prompt   = */ &spec_prompt,
-            /* .result   = */ &spec_draft,
-        };
-        common_speculative_draft(spec);
-
-        if ((int32_t) spec_draft.size() > n_draft_limit) {
-            spec_draft.resize(n_draft_limit);
-        }
+    spec_n_draft_max = mtp_draft_limit(n_room);
+    common_speculative_get_draft_params(spec, id) = {
+        /* .drafting = */ spec_n_draft_max > 0,
+        /* .n_max    = */ spec_n_draft_max,
+        /* .n_past   = */ spec_n_past,
+        /* .id_last  = */ spec_id_last,
+        /* .prompt   = */ &spec_prompt,
+        /* .result   = */ &spec_draft,
+    };
+    return true;
+}
 
+void llama_rn_slot::add_mtp_verify_tokens(llama_batch& batch) {
+    if ((int32_t) spec_draft.size() > spec_n_draft_max) {
+        spec_draft.resize(spec_n_draft_max);
+    }
+    if (spec_n_draft_max > 0) {
+        // The draft pass wrote its own positions past spec_n_past
         common_memory memory;
         memory.init(spec_ctx);
-        memory.seq_rm(seq_id, spec_n_past, -1);
+        memory.seq_rm(id, spec_n_past, -1);
     }
 
-    const size_t n_draft = spec_draft.size();
-    num_draft_tokens += n_draft;
+    num_draft_tokens += spec_draft.size();
 
-    common_batch_clear(spec_batch);
-    common_batch_add(spec_batch, spec_id_last, spec_n_past, { seq_id }, true);
-    for (size_t i = 0; i < n_draft; ++i) {
-        common_batch_add(spec_batch, spec_draft[i],
-                         spec_n_past + (llama_pos) i + 1, { seq_id }, true);
+    spec_i_batch = batch.n_tokens;
+    common_batch_add(batch, spec_id_last, spec_n_past, { id }, true);
+    for (size_t i = 0; i < spec_draft.size(); ++i) {
+        common_batch_add(batch, spec_draft[i], spec_n_past + (llama_pos) i + 1, { id }, true);
     }
+}
 
-    const int ret = llama_decode(parent_ctx->ctx, spec_batch);
-    if (ret != 0) {
-        throw std::runtime_error("failed to evaluate MTP target batch, ret=" + std::to_string(ret));
-    }
-    if (!common_speculative_process(spec, spec_batch)) {
-        throw std::runtime_error("failed to process MTP target batch");
-    }
+bool llama_rn_slot::accept_mtp_verify() {
+    const llama_seq_id seq_id = id;
+    const size_t n_draft = spec_draft.size();
 
-    auto accepted = common_sampler_sample_and_accept_n(ctx_sampling, parent_ctx->ctx, spec_draft);
+    std::vector<int> idxs(n_draft + 1);
+    std::iota(idxs.begin(), idxs.end(), spec_i_batch);
+    spec_i_batch = -1;
+
+    auto accepted = common_sampler_sample_and_accept_n(ctx_sampling, parent_ctx->ctx, idxs, spec_draft);
     if (accepted.empty()) {
         return false;
     }
@@ -591,51 +630,11 @@ bool llama_rn_slot::refill_mtp_tokens() {
     return !spec_pending_tokens.empty();
 }
 
-completion_token_output llama_rn_slot::next_token_mtp() {
-    completion_token_output result;
-    result.tok = -1;
-    result.request_id = request_id;
-
-    if (spec == nullptr) {
-        init_mtp();
-    }
-
-    if (spec_pending_tokens.empty() && !refill_mtp_tokens()) {
-        return result;
-    }
-
-    result.tok = spec_pending_tokens.front();
-    result.text = common_token_to_piece(parent_ctx->ctx, result.tok);
-    spec_pending_tokens.pop_front();
-    result.request_id = request_id;
-    num_tokens_predicted++;
-    return result;
-}
-
 // Parse chat output (tool calls, reasoning content, etc.)
 completion_chat_output llama_rn_slot::parseChatOutput(bool is_partial) {
-    common_chat_parser_params syntax;
-    syntax.format = static_cast<common_chat_format>(current_chat_format);
-    syntax.reasoning_format = current_reasoning_format;
-    syntax.generation_prompt = current_generation_prompt;
-    syntax.parse_tool_calls = true;
-
-    // Load the PEG parser if available (required for COMMON_CHAT_FORMAT_PEG_* formats)
-    if (!current_chat_parser.empty()) {
-        syntax.parser.load(current_chat_parser);
-    }
-
-    std::string full_text = prefill_text + generated_text;
-
-    common_chat_msg parsed_msg = common_chat_parse(full_text, is_partial, syntax);
-
-    completion_chat_output result;
-    result.content = parsed_msg.content;
-    result.reasoning_content = parsed_msg.reasoning_content;
-    result.accumulated_text = full_text;
-    result.tool_calls = parsed_msg.tool_calls;
-
-    return result;
+    return chat_parse_state.parse(prefill_text + generated_text, is_partial,
+                                  current_chat_format, current_reasoning_format,
+                                  current_generation_prompt, current_chat_parser);
 }
 
 // Get timing information for this slot
@@ -744,7 +743,7 @@ llama_pos llama_rn_slot::reconcile_memory_to(llama_pos n_keep, bool tokens_have_
 }
 
 // Load state into this slot's sequence
-bool llama_rn_slot::load_state() {
+bool llama_rn_slot::load_state(const std::vector<llama_token>& prompt, std::vector<llama_token>* file_tokens) {
     if (!parent_ctx || !parent_ctx->ctx) {
         LOG_ERROR("Slot %d: Cannot load state - context not initialized", id);
         return false;
@@ -781,20 +780,48 @@ bool llama_rn_slot::load_state() {
 
     LOG_INFO("Slot %d: Loading state from: %s", id, load_state_path.c_str());
 
+    // A save to this path may still be on its way to disk
+    if (parent_ctx->slot_manager != nullptr &&
+        !parent_ctx->slot_manager->state_writer.wait(load_state_path)) {
+        LOG_WARNING("Slot %d: Last save to %s failed, loading the file as it is on disk",
+                   id, load_state_path.c_str());
+    }
+
     // Start timing
     const int64_t t_load_start = lm_ggml_time_us();
 
     const llama_model * model = llama_get_model(parent_ctx->ctx);
     const bool is_recurrent_or_hybrid = llama_model_is_recurrent(model) || llama_model_is_hybrid(model);
 
+    // Check the file's token list against the prompt before any bulk I/O:
+    // only the prefix the prompt can reuse is restored and the rest of the
+    // file is never read. Media placeholders are matched later (processMedia)
+    // and recurrent state cannot be cut, so those files are restored whole.
+    int32_t n_restore = -1;
+    std::vector<llama_token> header_tokens;
+    if (!prompt.empty() && !is_recurrent_or_hybrid) {
+        if (!read_state_file_tokens(load_state_path, header_tokens)) {
+            cache_tokens.clear();
+            LOG_ERROR("Slot %d: Not a sequence state file: %s", id, load_state_path.c_str());
+            return false;
+        }
+        if (std::find(header_tokens.begin(), header_tokens.end(), LLAMA_TOKEN_NULL) == header_tokens.end()) {
+            n_restore = (int32_t) find_common_prefix_length(header_tokens, prompt);
+            if (load_state_size > 0) {
+                n_restore = std::min(n_restore, load_state_size);
+            }
+        }
+    }
+
     // Get size needed for token output buffer
     std::vector<llama_token> state_tokens(n_ctx);
     size_t n_token_count_out = 0;
 
-    size_t nread = llama_state_seq_load_file(
+    size_t nread = llama_state_seq_load_file_prefix(
         parent_ctx->ctx,
         load_state_path.c_str(),
         id,
+        n_restore,
         state_tokens.data(),
         state_tokens.size(),
         &n_token_count_out
@@ -806,6 +833,12 @@ bool llama_rn_slot::load_state() {
         return false;
     }
 
+    const size_t n_file_tokens = n_restore >= 0 ? header_tokens.size() : n_token_count_out;
+    if (file_tokens != nullptr) {
+        *file_tokens = n_restore >= 0
+            ? std::move(header_tokens)
+            : std::vector<llama_token>(state_tokens.begin(), state_tokens.begin() + n_token_count_out);
+    }
     state_tokens.resize(n_token_count_out);
 
     // Apply load_state_size limit if specified (not supported for recurrent/hybrid models)
@@ -834,6 +867,9 @@ bool llama_rn_slot::load_state() {
     if (usable < (llama_pos) state_tokens.size()) {
         LOG_WARNING("Slot %d: Loaded state is not resumable, prompt will be reprocessed from scratch", id);
         state_tokens.clear();
+        if (file_tokens != nullptr) {
+            file_tokens->clear();  // Not worth indexing
+        }
     }
 
     // Media identity for placeholder positions; absent for text-only or
@@ -849,8 +885,13 @@ bool llama_rn_slot::load_state() {
     const int64_t t_load_end = lm_ggml_time_us();
     const double t_load_ms = (t_load_end - t_load_start) / 1000.0;
 
-    LOG_INFO("Slot %d: Loaded %zu tokens (%.2f ms, %.2f KB)",
-             id, cache_tokens.size(), t_load_ms, nread / 1024.0);
+    if (n_restore >= 0) {
+        LOG_INFO("Slot %d: Loaded %zu of %zu tokens shared with the prompt (%.2f ms)",
+                 id, cache_tokens.size(), n_file_tokens, t_load_ms);
+    } else {
+        LOG_INFO("Slot %d: Loaded %zu tokens (%.2f ms, %.2f KB)",
+                 id, cache_tokens.size(), t_load_ms, nread / 1024.0);
+    }
 
     return true;
 }
@@ -943,23 +984,6 @@ bool llama_rn_slot::save_prompt_state_checkpoint() {
              cache_k,
              cache_v);
 
-    // Drop any previous sidecar before overwriting the state file so a
-    // failure in between can never pair stale hashes with the new file
-    write_state_meta(save_prompt_state_path, {});
-
-    size_t nwrite = llama_state_seq_save_file(
-        parent_ctx->ctx,
-        save_prompt_state_path.c_str(),
-        id,
-        state_tokens.data(),
-        actual_save_size
-    );
-
-    if (nwrite == 0) {
-        LOG_ERROR("Slot %d: Failed to save prompt checkpoint to file: %s", id, save_prompt_state_path.c_str());
-        return false;
-    }
-
     // Persist media identity only when the saved prefix actually holds media
     // and no media position was cut off; anything else cannot be verified on
     // reload (and hashes without placeholders would be stale)
@@ -968,10 +992,20 @@ bool llama_rn_slot::save_prompt_state_checkpoint() {
                   LLAMA_TOKEN_NULL) != state_tokens.end() &&
         std::find(cache_tokens.begin() + actual_save_size, cache_tokens.end(),
                   LLAMA_TOKEN_NULL) == cache_tokens.end();
-    write_state_meta(save_prompt_state_path,
-                     media_retained ? bitmap_past_hashes : std::vector<std::string>{});
 
-    LOG_INFO("Slot %d: Saved prompt checkpoint for %zu tokens (full state, %.2f KB)",
+    const size_t nwrite = stage_state_file(save_prompt_state_path, state_tokens.data(), actual_save_size,
+                                           media_retained ? bitmap_past_hashes : std::vector<std::string>{});
+    if (nwrite == 0) {
+        LOG_ERROR("Slot %d: Failed to save prompt checkpoint to file: %s", id, save_prompt_state_path.c_str());
+        return false;
+    }
+
+    if (parent_ctx->slot_manager != nullptr) {
+        // Only base-model states are indexed; an adapter state just drops the stale entry
+        parent_ctx->slot_manager->register_state_file(save_prompt_state_path, state_tokens.data(), lora.empty() ? actual_save_size : 0);
+    }
+
+    LOG_INFO("Slot %d: Staged prompt checkpoint for %zu tokens (full state, %.2f KB)",
              id, actual_save_size, nwrite / 1024.0);
 
     return true;
@@ -1081,17 +1115,17 @@ bool llama_rn_slot::save_state() {
         }
     }
 
-    // Drop any previous sidecar before overwriting the state file so a
-    // failure in between can never pair stale hashes with the new file
-    write_state_meta(save_state_path, {});
+    // Persist media identity only when the saved prefix actually holds media
+    // and no media position was cut off; anything else cannot be verified on
+    // reload (and hashes without placeholders would be stale)
+    const bool media_retained =
+        std::find(state_tokens.begin(), state_tokens.begin() + actual_save_size,
+                  LLAMA_TOKEN_NULL) != state_tokens.begin() + actual_save_size &&
+        std::find(state_tokens.begin() + actual_save_size, state_tokens.end(),
+                  LLAMA_TOKEN_NULL) == state_tokens.end();
 
-    size_t nwrite = llama_state_seq_save_file(
-        parent_ctx->ctx,
-        save_state_path.c_str(),
-        id,
-        state_tokens.data(),
-        actual_save_size
-    );
+    const size_t nwrite = stage_state_file(save_state_path, state_tokens.data(), actual_save_size,
+                                           media_retained ? bitmap_past_hashes : std::vector<std::string>{});
 
     const char * cache_k = lm_ggml_type_name(parent_ctx->params.cache_type_k);
     const char * cache_v = lm_ggml_type_name(parent_ctx->params.cache_type_v);
@@ -1122,25 +1156,86 @@ bool llama_rn_slot::save_state() {
         return false;
     }
 
-    // Persist media identity only when the saved prefix actually holds media
-    // and no media position was cut off; anything else cannot be verified on
-    // reload (and hashes without placeholders would be stale)
-    const bool media_retained =
-        std::find(state_tokens.begin(), state_tokens.begin() + actual_save_size,
-                  LLAMA_TOKEN_NULL) != state_tokens.begin() + actual_save_size &&
-        std::find(state_tokens.begin() + actual_save_size, state_tokens.end(),
-                  LLAMA_TOKEN_NULL) == state_tokens.end();
-    write_state_meta(save_state_path,
-                     media_retained ? bitmap_past_hashes : std::vector<std::string>{});
+    if (parent_ctx->slot_manager != nullptr) {
+        // Only base-model states are indexed; an adapter state just drops the stale entry
+        parent_ctx->slot_manager->register_state_file(save_state_path, state_tokens.data(), lora.empty() ? actual_save_size : 0);
+    }
 
     // Calculate elapsed time
     const int64_t t_save_end = lm_ggml_time_us();
     const double t_save_ms = (t_save_end - t_save_start) / 1000.0;
 
-    LOG_INFO("Slot %d: Saved %zu tokens (%.2f ms, %.2f KB)",
+    LOG_INFO("Slot %d: Staged %zu tokens for saving (%.2f ms, %.2f KB)",
              id, actual_save_size, t_save_ms, nwrite / 1024.0);
 
     return true;
 }
 
+// Snapshot this sequence into a file in the llama_state_seq_save_file layout
+// and hand it to the slot manager's writer, so decoding continues while it
+// is written. The sidecar is replaced once the state file is durable.
+// Returns the staged size, 0 on failure.
+size_t llama_rn_slot::stage_state_file(
+    const std::string& path,
+    const llama_token* tokens,
+    size_t n_tokens,
+    std::vector<std::string> meta_hashes
+) {
+    // llama_state_seq_get_data prefixes the sequence state with its magic and
+    // seq id, which the file layout does not have
+    const size_t n_prefix = sizeof(uint32_t) + sizeof(llama_seq_id);
+    const size_t n_state = llama_state_seq_get_size(parent_ctx->ctx, id);
+    if (n_state <= n_prefix) {
+        return 0;
+    }
+
+    rn_state_save_job job;
+    job.path = path;
+    try {
+        job.blob.resize(n_state);
+        job.header.resize(3 * sizeof(uint32_t) + n_tokens * sizeof(llama_token));
+    } catch (const std::bad_alloc &) {
+        LOG_ERROR("Slot %d: Cannot stage %zu bytes of state", id, n_state);
+        return 0;
+    }
+    if (llama_state_seq_get_data(parent_ctx->ctx, job.blob.data(), n_state, id) != n_state) {
+        return 0;
+    }
+    llama_seq_id blob_seq_id = -1;
+    memcpy(&blob_seq_id, job.blob.data() + sizeof(uint32_t), sizeof(blob_seq_id));
+    if (blob_seq_id != id) {
+        return 0;
+    }
+    job.blob_offset = n_prefix;
+
+    const uint32_t head[3] = { LLAMA_STATE_SEQ_MAGIC, LLAMA_STATE_SEQ_VERSION, (uint32_t) n_tokens };
+    memcpy(job.header.data(), head, sizeof(head));
+    if (n_tokens > 0) {
+        memcpy(job.header.data() + sizeof(head), tokens, n_tokens * sizeof(llama_token));
+    }
+    const size_t n_bytes = job.size_bytes();
+
+    // Drop any previous sidecar before the new state file replaces the old
+    // one so a crash in between can never pair stale hashes with it
+    job.before_commit = [path]() { write_state_meta(path, {}); };
+    job.on_done = [path, meta_hashes = std::move(meta_hashes)](bool ok) {
+        if (!ok) {
+            LOG_ERROR("Failed to write state file: %s", path.c_str());
+            return;
+        }
+        if (!meta_hashes.empty()) {
+            write_state_meta(path, meta_hashes);
+        }
+        LOG_VERBOSE("State file is durable: %s", path.c_str());
+    };
+
+    if (parent_ctx->slot_manager != nullptr) {
+        parent_ctx->slot_manager->state_writer.submit(std::move(job));
+        return n_bytes;
+    }
+    const bool ok = rn_write_state_file(job);
+    job.on_done(ok);
+    return ok ? n_bytes : 0;
+}
+
 } // namespace rnllama
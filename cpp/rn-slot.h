@@ -4,6 +4,7 @@
 #include "common.h"
 #include "llama.h"
 #include "rn-llama.h"
+#include "rn-completion.h"
 #include "sampling.h"
 #include "speculative.h"
 #include <deque>
@@ -15,8 +16,6 @@ namespace rnllama {
 
 // Forward declarations
 struct llama_rn_context;
-struct completion_token_output;
-struct completion_chat_output;
 
 // Slot timings result
 struct slot_timings {
@@ -55,6 +54,7 @@ struct llama_rn_slot {
     int32_t request_id;            // Unique request identifier
     llama_rn_slot_state state;
     llama_rn_slot_task_type task_type; // Current task type assigned to slot
+    int32_t priority = 0;          // Request priority (higher prefills first under the fair policy)
 
     // Context management
     llama_rn_context* parent_ctx;  // Parent context reference
@@ -63,6 +63,7 @@ struct llama_rn_slot {
     int32_t n_decoded;             // Tokens generated so far
     int32_t n_remaining;           // Tokens left to generate (-1 = unlimited)
     int32_t i_batch;               // Position in current batch
+    int32_t jump_forward_pending = 0; // Grammar-forced tokens queued behind the last sampled one
 
     // Token management
     std::vector<llama_token> prompt_tokens;
@@ -71,14 +72,16 @@ struct llama_rn_slot {
     std::string generated_text;
     utf8_stream_gate utf8_gate;
 
-    // Clear per-request generation text state (gate + accumulated text)
+    // Clear per-request generation text state (gate, accumulated text, parse memo)
     void clear_generation_state() {
         utf8_gate.reset();
         generated_text.clear();
+        chat_parse_state.reset();
     }
 
     // Multimodal state (per-slot)
     std::vector<std::string> bitmap_past_hashes;  // For multimodal KV cache reuse
+    std::vector<common_adapter_lora_info> lora;   // Adapters cache_tokens were decoded with
     std::vector<std::string> media_paths;         // Media paths for deferred processing
     std::string prompt_text;                      // Original prompt text for media processing
     bool media_processed;                         // Flag indicating if media has been processed
@@ -108,6 +111,7 @@ struct llama_rn_slot {
     common_reasoning_format current_reasoning_format;
     std::string current_generation_prompt;
     std::string current_chat_parser;  // Serialized PEG parser for chat output parsing
+    rn_chat_parse_state chat_parse_state;
 
     // Sampling context (per-slot)
     common_params params_storage;
@@ -124,6 +128,8 @@ struct llama_rn_slot {
     llama_token spec_id_last = LLAMA_TOKEN_NULL;
     llama_pos spec_n_past = 0;
     llama_tokens spec_draft;
+    int32_t spec_n_draft_max = 0;          // Draft cap armed for the current step
+    int32_t spec_i_batch = -1;             // First verify row in the shared batch (-1: none this step)
     std::deque<llama_token> spec_pending_tokens;
     size_t num_draft_tokens;
     size_t num_draft_tokens_accepted;
@@ -133,6 +139,10 @@ struct llama_rn_slot {
     int64_t t_start_generation;    // Start time for generation (us)
     int64_t t_last_used;           // Last time slot was used (us)
 
+    // Routing decision for the current request
+    bool routed_by_prefix;         // Chosen for its cached prefix (false = LRU)
+    size_t routed_prefix_n;        // Prefix length expected to be reused at routing time
+
     // Timing metrics
     int32_t n_prompt_tokens_cache;     // Number of prompt tokens from cache
     int32_t n_prompt_tokens_processed; // Number of prompt tokens processed
@@ -151,15 +161,25 @@ struct llama_rn_slot {
     // Completion callback (per-slot)
     std::function<void(llama_rn_slot*)> on_complete_callback;
 
+    // Streaming TTS decode of the generated audio codes (per-slot)
+    llama_rn_slot_audio_stream audio_stream;
+
     // Embedding task state
     int embd_normalize;
     std::function<void(int32_t, const std::vector<float>&)> on_embedding_callback;
 
+    // Embedding batch state: inputs run one after another in this slot
+    std::function<void(int32_t, const std::vector<float>&)> on_embedding_batch_callback;
+    std::vector<std::vector<llama_token>> embedding_inputs;
+    std::vector<float> embedding_results;  // n_embd floats per input
+    size_t embedding_current_index;
+
     // Rerank task state
     std::function<void(int32_t, const std::vector<float>&)> on_rerank_callback;
     std::vector<std::vector<llama_token>> rerank_prompt_tokens;
     std::vector<float> rerank_scores;
     size_t rerank_current_index;
+    bool rerank_reuse_prefix;  // Keep the shared query prefix in memory between documents
 
     // State management (per-slot)
     std::string load_state_path;      // Path to load state from before processing
@@ -169,6 +189,7 @@ struct llama_rn_slot {
     int32_t save_state_size;          // Number of tokens to save (0 or -1 = all tokens)
     bool save_prompt_state_pending;   // Save prompt checkpoint before generation
     llama_pos save_prompt_state_tokens; // Prompt token count to save
+    bool state_reused;                // KV was restored from an indexed state file
 
     // Constructor
     llama_rn_slot();
@@ -186,17 +207,30 @@ struct llama_rn_slot {
     void reset_speculative();
     void init_mtp();
     void eval_mtp_prompt();
-    bool refill_mtp_tokens();
-    completion_token_output next_token_mtp();
+    // Batched MTP step, driven by the slot manager: arm this sequence for the
+    // shared draft pass, append id_last + draft to the target batch, then
+    // accept the verified prefix into spec_pending_tokens after the decode
+    int32_t mtp_draft_limit(int32_t n_room) const;
+    bool begin_mtp_draft(int32_t n_room);
+    void add_mtp_verify_tokens(llama_batch& batch);
+    bool accept_mtp_verify();
 
     // Timing methods
     slot_timings get_timings() const;      // Get timing information for this slot
 
     // State methods
-    bool load_state();             // Load state into this slot's sequence
+    // Load state into this slot's sequence. With a prompt, only the prefix
+    // it shares with the file's token list is read in; file_tokens receives
+    // the file's whole token list.
+    bool load_state(const std::vector<llama_token>& prompt = {}, std::vector<llama_token>* file_tokens = nullptr);
     bool save_state();             // Save state from this slot's sequence
     bool save_prompt_state_checkpoint();  // Save prompt checkpoint
 
+    // Copy the sequence state into a staged file for the background writer
+    // (see save_state); returns the staged size, 0 on failure
+    size_t stage_state_file(const std::string& path, const llama_token* tokens, size_t n_tokens,
+                            std::vector<std::string> meta_hashes);
+
     // Trim this slot's sequence memory to [0, n_keep) so decoding can resume
     // at position n_keep. Falls back to a full sequence clear when the memory
     // cannot be rolled back (recurrent/hybrid beyond the rollback ring) or
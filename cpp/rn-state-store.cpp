@@ -0,0 +1,544 @@
+#include "rn-state-store.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <system_error>
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace rnllama {
+
+namespace {
+
+const size_t LZ_MIN_MATCH = 4;
+const size_t LZ_MAX_OFFSET = 65535;
+const int LZ_HASH_BITS = 14;
+
+inline uint32_t read32(const uint8_t * p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t lz_hash(uint32_t v) {
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+// Lengths of 15 and up continue in extra bytes, 255 meaning "more follows"
+void put_length(std::vector<uint8_t> & dst, size_t len) {
+    len -= 15;
+    while (len >= 255) {
+        dst.push_back(255);
+        len -= 255;
+    }
+    dst.push_back((uint8_t) len);
+}
+
+// match_len == 0 marks the last sequence, which carries literals only
+void put_sequence(std::vector<uint8_t> & dst, const uint8_t * lit, size_t n_lit, size_t offset, size_t match_len) {
+    const size_t ml = match_len > 0 ? match_len - LZ_MIN_MATCH : 0;
+    dst.push_back((uint8_t) ((std::min<size_t>(n_lit, 15) << 4) | std::min<size_t>(ml, 15)));
+    if (n_lit >= 15) {
+        put_length(dst, n_lit);
+    }
+    dst.insert(dst.end(), lit, lit + n_lit);
+    if (match_len == 0) {
+        return;
+    }
+    dst.push_back((uint8_t) (offset & 0xff));
+    dst.push_back((uint8_t) (offset >> 8));
+    if (ml >= 15) {
+        put_length(dst, ml);
+    }
+}
+
+#if !defined(_WIN32)
+bool write_all(int f, const uint8_t * p, size_t n) {
+    size_t off = 0;
+    while (off < n) {
+        const ssize_t written = ::write(f, p + off, n - off);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        off += (size_t) written;
+    }
+    return true;
+}
+
+std::string parent_dir(const std::string & path) {
+    const size_t pos = path.rfind('/');
+    if (pos == std::string::npos) {
+        return ".";
+    }
+    return pos == 0 ? "/" : path.substr(0, pos);
+}
+#endif
+
+bool get_length(const uint8_t * src, size_t n, size_t & ip, size_t & len) {
+    if (len != 15) {
+        return true;
+    }
+    uint8_t b;
+    do {
+        if (ip >= n) {
+            return false;
+        }
+        b = src[ip++];
+        len += b;
+    } while (b == 255);
+    return true;
+}
+
+} // namespace
+
+void rn_lz_compress(const uint8_t * src, size_t n, std::vector<uint8_t> & dst) {
+    dst.clear();
+    dst.reserve(n / 2 + 16);
+    if (n >= UINT32_MAX) {
+        put_sequence(dst, src, n, 0, 0);
+        return;
+    }
+
+    // Last position + 1 seen for each hash of four bytes (0 = none)
+    std::vector<uint32_t> table((size_t) 1 << LZ_HASH_BITS, 0);
+    size_t anchor = 0;
+    size_t i = 0;
+    size_t misses = 0;
+    while (i + LZ_MIN_MATCH <= n) {
+        const uint32_t v = read32(src + i);
+        const uint32_t h = lz_hash(v);
+        const size_t cand = table[h];
+        table[h] = (uint32_t) (i + 1);
+        if (cand > 0 && i - (cand - 1) <= LZ_MAX_OFFSET && read32(src + cand - 1) == v) {
+            const size_t ref = cand - 1;
+            size_t len = LZ_MIN_MATCH;
+            while (i + len < n && src[ref + len] == src[i + len]) {
+                len++;
+            }
+            put_sequence(dst, src + anchor, i - anchor, i - ref, len);
+            i += len;
+            anchor = i;
+            misses = 0;
+        } else {
+            i += 1 + (misses++ >> 6);
+        }
+    }
+    put_sequence(dst, src + anchor, n - anchor, 0, 0);
+}
+
+bool rn_lz_decompress(const uint8_t * src, size_t n, uint8_t * dst, size_t n_dst) {
+    size_t ip = 0;
+    size_t op = 0;
+    while (ip < n) {
+        const uint8_t token = src[ip++];
+        size_t n_lit = token >> 4;
+        if (!get_length(src, n, ip, n_lit) || n_lit > n - ip || n_lit > n_dst - op) {
+            return false;
+        }
+        memcpy(dst + op, src + ip, n_lit);
+        ip += n_lit;
+        op += n_lit;
+        if (ip == n) {
+            break;
+        }
+
+        if (n - ip < 2) {
+            return false;
+        }
+        const size_t offset = (size_t) src[ip] | ((size_t) src[ip + 1] << 8);
+        ip += 2;
+        size_t ml = token & 15;
+        if (!get_length(src, n, ip, ml)) {
+            return false;
+        }
+        ml += LZ_MIN_MATCH;
+        if (offset == 0 || offset > op || ml > n_dst - op) {
+            return false;
+        }
+        if (offset >= ml) {
+            memcpy(dst + op, dst + op - offset, ml);
+        } else {
+            // Overlapping match: a repeating pattern
+            for (size_t k = 0; k < ml; k++) {
+                dst[op + k] = dst[op - offset + k];
+            }
+        }
+        op += ml;
+    }
+    return op == n_dst;
+}
+
+rn_state_checkpoint::rn_state_checkpoint(rn_state_checkpoint && other) noexcept {
+    *this = std::move(other);
+}
+
+rn_state_checkpoint & rn_state_checkpoint::operator=(rn_state_checkpoint && other) noexcept {
+    if (this != &other) {
+        // A pack in flight still reads the blob about to be freed
+        if (pending.valid()) {
+            pending.wait();
+        }
+        release_disk();
+        n = other.n;
+        tier = other.tier;
+        data = std::move(other.data);
+        raw_size = other.raw_size;
+        packed = other.packed;
+        incompressible = other.incompressible;
+        fd = other.fd;
+        disk_size = other.disk_size;
+        pending = std::move(other.pending);
+        other.fd = -1;
+    }
+    return *this;
+}
+
+rn_state_checkpoint::~rn_state_checkpoint() {
+    if (pending.valid()) {
+        pending.wait();
+    }
+    release_disk();
+}
+
+void rn_state_checkpoint::release_disk() {
+#if !defined(_WIN32)
+    if (fd >= 0) {
+        ::close(fd);
+    }
+#endif
+    fd = -1;
+}
+
+rn_state_checkpoint::pack_result rn_state_checkpoint::pack(const uint8_t * src, size_t n) {
+    pack_result r;
+    try {
+        rn_lz_compress(src, n, r.out);
+    } catch (const std::bad_alloc &) {
+        r.alloc_failed = true;
+        return r;
+    }
+    // Not worth an unpack on every restore unless it frees an eighth
+    r.worth = r.out.size() <= n - n / 8;
+    if (r.worth) {
+        r.out.shrink_to_fit();
+    } else {
+        std::vector<uint8_t>().swap(r.out);
+    }
+    return r;
+}
+
+void rn_state_checkpoint::apply_pack(pack_result && r) {
+    if (!r.worth) {
+        incompressible = incompressible || !r.alloc_failed;
+        return;
+    }
+    raw_size = data.size();
+    data = std::move(r.out);
+    packed = true;
+    tier = RN_STATE_TIER_COMPRESSED;
+}
+
+bool rn_state_checkpoint::compress() {
+    if (tier != RN_STATE_TIER_HOT || incompressible || data.empty()) {
+        return false;
+    }
+    if (pending.valid()) {
+        return finish_compress(true);
+    }
+    apply_pack(pack(data.data(), data.size()));
+    return packed;
+}
+
+bool rn_state_checkpoint::compress_async() {
+    if (tier != RN_STATE_TIER_HOT || incompressible || data.empty() || pending.valid()) {
+        return false;
+    }
+    const uint8_t * src = data.data();
+    const size_t n_src = data.size();
+    try {
+        pending = std::async(std::launch::async, [src, n_src]() { return pack(src, n_src); });
+    } catch (const std::system_error &) {
+        // No thread to spare: pack in place
+        apply_pack(pack(src, n_src));
+    }
+    return true;
+}
+
+bool rn_state_checkpoint::finish_compress(bool wait) {
+    if (!pending.valid()) {
+        return false;
+    }
+    if (!wait && pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return false;
+    }
+    apply_pack(pending.get());
+    return packed;
+}
+
+bool rn_state_checkpoint::spill(const std::string & dir) {
+#if defined(_WIN32)
+    (void) dir;
+    return false;
+#else
+    if (tier == RN_STATE_TIER_DISK || dir.empty() || data.empty()) {
+        return false;
+    }
+    // Spill the packed form if a pack is on its way
+    finish_compress(true);
+
+    static std::atomic<uint64_t> n_spilled{0};
+    char name[64];
+    snprintf(name, sizeof(name), "/rn-ckpt-%d-%llu.bin", (int) getpid(), (unsigned long long) n_spilled++);
+    const std::string path = dir + name;
+    const int f = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (f < 0) {
+        return false;
+    }
+    // The open descriptor keeps the data alive
+    ::unlink(path.c_str());
+
+    if (!write_all(f, data.data(), data.size())) {
+        ::close(f);
+        return false;
+    }
+
+    fd = f;
+    disk_size = data.size();
+    std::vector<uint8_t>().swap(data);
+    tier = RN_STATE_TIER_DISK;
+    return true;
+#endif
+}
+
+rn_state_reader::~rn_state_reader() {
+    close();
+}
+
+void rn_state_reader::close() {
+#if !defined(_WIN32)
+    if (map != nullptr) {
+        munmap(map, map_size);
+    }
+#endif
+    map = nullptr;
+    map_size = 0;
+    ptr = nullptr;
+    n = 0;
+}
+
+bool rn_state_reader::open(const rn_state_checkpoint & c) {
+    close();
+
+    const uint8_t * src = c.data.data();
+    size_t n_src = c.data.size();
+    if (c.tier == RN_STATE_TIER_DISK) {
+#if defined(_WIN32)
+        return false;
+#else
+        if (c.fd < 0 || c.disk_size == 0) {
+            return false;
+        }
+        void * m = mmap(nullptr, c.disk_size, PROT_READ, MAP_PRIVATE, c.fd, 0);
+        if (m == MAP_FAILED) {
+            return false;
+        }
+        map = m;
+        map_size = c.disk_size;
+        src = (const uint8_t *) m;
+        n_src = c.disk_size;
+#endif
+    }
+
+    if (!c.packed) {
+        ptr = src;
+        n = n_src;
+        return true;
+    }
+
+    bool ok = false;
+    try {
+        scratch.resize(c.raw_size);
+        ok = rn_lz_decompress(src, n_src, scratch.data(), scratch.size());
+    } catch (const std::bad_alloc &) {
+        ok = false;
+    }
+    close();
+    if (!ok) {
+        return false;
+    }
+    ptr = scratch.data();
+    n = scratch.size();
+    return true;
+}
+
+bool rn_write_state_file(const rn_state_save_job & job) {
+    if (job.path.empty() || job.blob_offset > job.blob.size()) {
+        return false;
+    }
+    const std::string tmp_path = job.path + ".tmp";
+    const uint8_t * body = job.blob.data() + job.blob_offset;
+    const size_t n_body = job.blob.size() - job.blob_offset;
+
+#if defined(_WIN32)
+    FILE * f = fopen(tmp_path.c_str(), "wb");
+    if (f == nullptr) {
+        return false;
+    }
+    bool ok = fwrite(job.header.data(), 1, job.header.size(), f) == job.header.size() &&
+              fwrite(body, 1, n_body, f) == n_body &&
+              fflush(f) == 0 &&
+              _commit(_fileno(f)) == 0;
+    ok = fclose(f) == 0 && ok;
+    if (!ok) {
+        remove(tmp_path.c_str());
+        return false;
+    }
+    if (job.before_commit) {
+        job.before_commit();
+    }
+    // Replaces the old file in one step, so a crash leaves either version
+    if (!MoveFileExA(tmp_path.c_str(), job.path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+#else
+    const int f = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (f < 0) {
+        return false;
+    }
+    bool ok = write_all(f, job.header.data(), job.header.size()) &&
+              write_all(f, body, n_body) &&
+              ::fsync(f) == 0;
+    ok = ::close(f) == 0 && ok;
+    if (!ok) {
+        ::unlink(tmp_path.c_str());
+        return false;
+    }
+    if (job.before_commit) {
+        job.before_commit();
+    }
+    if (::rename(tmp_path.c_str(), job.path.c_str()) != 0) {
+        ::unlink(tmp_path.c_str());
+        return false;
+    }
+    // The rename is only durable once the directory entry is
+    const int d = ::open(parent_dir(job.path).c_str(), O_RDONLY);
+    if (d >= 0) {
+        ::fsync(d);
+        ::close(d);
+    }
+    return true;
+#endif
+}
+
+rn_state_writer::rn_state_writer(size_t max_pending_bytes) : max_pending_bytes(max_pending_bytes) {}
+
+rn_state_writer::~rn_state_writer() {
+    stop();
+}
+
+void rn_state_writer::submit(rn_state_save_job job) {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        const size_t n = job.size_bytes();
+        // Back-pressure: a single oversized job still goes through on its own
+        done_cv.wait(lock, [&]() { return pending_bytes == 0 || pending_bytes + n <= max_pending_bytes; });
+        if (!thread.joinable()) {
+            stopping = false;
+            thread = std::thread([this]() { worker_loop(); });
+        }
+        pending_bytes += n;
+        pending_paths[job.path]++;
+        queue.push_back(std::move(job));
+    }
+    cv.notify_one();
+}
+
+bool rn_state_writer::wait(const std::string & path) {
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cv.wait(lock, [&]() { return pending_paths.find(path) == pending_paths.end(); });
+    return failed_paths.find(path) == failed_paths.end();
+}
+
+bool rn_state_writer::flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cv.wait(lock, [this]() { return queue.empty() && n_running == 0; });
+    const bool ok = n_failed == 0;
+    n_failed = 0;
+    return ok;
+}
+
+void rn_state_writer::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_all();
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+size_t rn_state_writer::n_pending() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return queue.size() + n_running;
+}
+
+void rn_state_writer::worker_loop() {
+    while (true) {
+        rn_state_save_job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this]() { return stopping || !queue.empty(); });
+            // Stopping drains the queue first: every accepted save lands
+            if (queue.empty()) {
+                return;
+            }
+            job = std::move(queue.front());
+            queue.pop_front();
+            n_running++;
+        }
+
+        const bool ok = rn_write_state_file(job);
+        if (job.on_done) {
+            job.on_done(ok);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            n_running--;
+            pending_bytes -= job.size_bytes();
+            auto it = pending_paths.find(job.path);
+            if (it != pending_paths.end() && --it->second == 0) {
+                pending_paths.erase(it);
+            }
+            if (ok) {
+                failed_paths.erase(job.path);
+            } else {
+                failed_paths.insert(job.path);
+                n_failed++;
+            }
+        }
+        done_cv.notify_all();
+    }
+}
+
+} // namespace rnllama
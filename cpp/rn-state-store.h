@@ -0,0 +1,165 @@
+#ifndef RN_STATE_STORE_H
+#define RN_STATE_STORE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace rnllama {
+
+// LZ77 block codec using the LZ4 sequence format (4-byte minimum match, 64 KiB
+// window), cheap enough to run on every snapshot demotion. Incompressible runs
+// are skipped with a growing stride. rn_lz_decompress fails on malformed input
+// or when the output does not fill exactly n_dst bytes.
+void rn_lz_compress(const uint8_t * src, size_t n, std::vector<uint8_t> & dst);
+bool rn_lz_decompress(const uint8_t * src, size_t n, uint8_t * dst, size_t n_dst);
+
+enum rn_state_tier {
+    RN_STATE_TIER_HOT,        // Raw blob in RAM, restored in place
+    RN_STATE_TIER_COMPRESSED, // LZ-packed blob in RAM
+    RN_STATE_TIER_DISK,       // Spilled to an unlinked file, mapped back on restore
+};
+
+// A snapshot of the non-rollbackable memory state (recurrent/SWA cells,
+// PARTIAL_ONLY) at a token boundary. The tokens it represents live in the
+// owner's radix index, where snapshots of one conversation share their prefix.
+struct rn_state_checkpoint {
+    size_t n = 0;                 // Memory positions [0, n)
+    rn_state_tier tier = RN_STATE_TIER_HOT;
+    std::vector<uint8_t> data;    // Raw blob (hot) or packed blob (compressed)
+    size_t raw_size = 0;          // Blob size once unpacked
+    bool packed = false;          // data, or the spill file, holds the LZ form
+    bool incompressible = false;  // Packing saved too little; the blob stays raw
+    int fd = -1;                  // Disk tier: the spill file, already unlinked
+    size_t disk_size = 0;
+
+    rn_state_checkpoint() = default;
+    rn_state_checkpoint(rn_state_checkpoint && other) noexcept;
+    rn_state_checkpoint & operator=(rn_state_checkpoint && other) noexcept;
+    rn_state_checkpoint(const rn_state_checkpoint &) = delete;
+    rn_state_checkpoint & operator=(const rn_state_checkpoint &) = delete;
+    ~rn_state_checkpoint();
+
+    size_t n_tokens() const { return n; }
+    // RAM held by the blob (0 once spilled)
+    size_t size_bytes() const { return data.size(); }
+
+    // Hot -> compressed; false if not hot or the blob packs too poorly
+    bool compress();
+    // Starts packing on a background thread; the snapshot stays hot and
+    // readable until finish_compress() swaps the packed blob in
+    bool compress_async();
+    // Applies a finished background pack, waiting for it when wait is set;
+    // true if the snapshot is now compressed
+    bool finish_compress(bool wait);
+    bool compress_pending() const { return pending.valid(); }
+    // RAM -> disk, keeping the packed form if it has one; the file is
+    // unlinked right away, so nothing outlives the snapshot (or a crash)
+    bool spill(const std::string & dir);
+
+private:
+    struct pack_result {
+        std::vector<uint8_t> out;
+        bool worth = false;         // Frees at least an eighth of the blob
+        bool alloc_failed = false;  // Worth retrying later
+    };
+    static pack_result pack(const uint8_t * src, size_t n);
+    void apply_pack(pack_result && r);
+    void release_disk();
+
+    // Reads data's heap buffer, which moves along with the snapshot
+    std::future<pack_result> pending;
+};
+
+// Raw view of a snapshot's blob from whichever tier holds it: in place when
+// hot, unpacked into a scratch buffer when compressed, mapped when on disk.
+class rn_state_reader {
+public:
+    rn_state_reader() = default;
+    rn_state_reader(const rn_state_reader &) = delete;
+    rn_state_reader & operator=(const rn_state_reader &) = delete;
+    ~rn_state_reader();
+
+    bool open(const rn_state_checkpoint & c);
+    const uint8_t * data() const { return ptr; }
+    size_t size() const { return n; }
+
+private:
+    void close();
+
+    std::vector<uint8_t> scratch;
+    void * map = nullptr;
+    size_t map_size = 0;
+    const uint8_t * ptr = nullptr;
+    size_t n = 0;
+};
+
+// A state file staged in RAM: header, then blob[blob_offset:]. The blob is a
+// copy of the sequence state taken on the decode thread, so the memory it came
+// from can move on while the file is written.
+struct rn_state_save_job {
+    std::string path;
+    std::vector<uint8_t> header;
+    std::vector<uint8_t> blob;
+    size_t blob_offset = 0;
+    std::function<void()> before_commit;  // Writer thread, after fsync, before the rename
+    std::function<void(bool)> on_done;    // Writer thread, once durable (or failed)
+
+    size_t size_bytes() const { return header.size() + blob.size() - blob_offset; }
+};
+
+// Writes the job through "<path>.tmp": fsync, rename over path, fsync the
+// directory. A crash leaves either the previous file or the new one, never a
+// torn mix. Runs on the calling thread; calls before_commit but not on_done.
+bool rn_write_state_file(const rn_state_save_job & job);
+
+// Background writer for staged state files. Jobs run in submit order on one
+// thread, so saves to the same path land in the order they were made.
+class rn_state_writer {
+public:
+    explicit rn_state_writer(size_t max_pending_bytes = 512u << 20);
+    rn_state_writer(const rn_state_writer &) = delete;
+    rn_state_writer & operator=(const rn_state_writer &) = delete;
+    ~rn_state_writer();
+
+    // Queues the job; blocks only while more than max_pending_bytes of staged
+    // state is already waiting for the disk
+    void submit(rn_state_save_job job);
+    // Waits for pending saves to path; false if the last one failed
+    bool wait(const std::string & path);
+    // Waits for every queued save; false if any failed since the last flush
+    bool flush();
+    // Flushes, then joins the thread
+    void stop();
+
+    size_t n_pending() const;
+
+private:
+    void worker_loop();
+
+    size_t max_pending_bytes;
+    mutable std::mutex mutex;
+    std::condition_variable cv;       // New jobs, stop
+    std::condition_variable done_cv;  // Job finished
+    std::deque<rn_state_save_job> queue;
+    std::map<std::string, int> pending_paths;  // Queued or running jobs per path
+    std::set<std::string> failed_paths;        // Last save to the path failed
+    size_t pending_bytes = 0;
+    size_t n_running = 0;
+    size_t n_failed = 0;
+    bool stopping = false;
+    std::thread thread;
+};
+
+} // namespace rnllama
+
+#endif /* RN_STATE_STORE_H */
@@ -494,6 +494,7 @@ llama_rn_context_tts::~llama_rn_context_tts() {
 void llama_rn_context_tts::reset() {
     audio_tokens.clear();
     pending_codebook1 = -1;
+    stopAudioStream();
     if (codec_lm_state != nullptr) {
         codec_lm_state_reset(codec_lm_state);
     }
@@ -3028,15 +3029,20 @@ bool llama_rn_context_tts::isAudioToken(llama_rn_context* main_ctx, llama_token
     return is_token_in_ranges(ranges, profile.audio.n_codebook, token, nullptr);
 }
 
-bool llama_rn_context_tts::tryAddAudioToken(llama_rn_context* main_ctx, llama_token token, const std::string &token_text) {
-    (void) token_text;
+// Appends the codec value of an audio token to `codes`; the first code of a
+// two-codebook pair waits in `pending_codebook1` for the second.
+static bool add_audio_token(
+    llama_rn_context_tts * tts,
+    llama_rn_context * main_ctx,
+    llama_token token,
+    int & pending_codebook1,
+    std::vector<llama_token> & codes) {
     if (token < 0) {
         return false;
     }
 
-    const tts_type tts_type = getTTSType(main_ctx);
-    const tts_model_profile &profile = profile_for_type(tts_type);
-    const auto & ranges = ensure_resolved_ranges(this, main_ctx, profile);
+    const tts_model_profile &profile = profile_for_type(tts->getTTSType(main_ctx));
+    const auto & ranges = ensure_resolved_ranges(tts, main_ctx, profile);
 
     parsed_audio_token parsed = {-1, 0};
     if (profile.audio.n_codebook == 2) {
@@ -3050,8 +3056,8 @@ bool llama_rn_context_tts::tryAddAudioToken(llama_rn_context* main_ctx, llama_to
         if (pending_codebook1 < 0) {
             return true;
         }
-        audio_tokens.push_back(pending_codebook1);
-        audio_tokens.push_back(parsed.codec_value);
+        codes.push_back(pending_codebook1);
+        codes.push_back(parsed.codec_value);
         pending_codebook1 = -1;
         return true;
     }
@@ -3060,10 +3066,15 @@ bool llama_rn_context_tts::tryAddAudioToken(llama_rn_context* main_ctx, llama_to
     if (!is_token_in_ranges(ranges, profile.audio.n_codebook, token, &codec_value)) {
         return false;
     }
-    audio_tokens.push_back(codec_value);
+    codes.push_back(codec_value);
     return true;
 }
 
+bool llama_rn_context_tts::tryAddAudioToken(llama_rn_context* main_ctx, llama_token token, const std::string &token_text) {
+    (void) token_text;
+    return add_audio_token(this, main_ctx, token, pending_codebook1, audio_tokens);
+}
+
 bool llama_rn_context_tts::shouldCaptureAudioEmbeddings(llama_rn_context* main_ctx) {
     const tts_type tts_type = getTTSType(main_ctx);
     return profile_for_type(tts_type).decode_kind == tts_decode_kind::HIDDEN_STATES;
@@ -3342,6 +3353,270 @@ std::vector<float> llama_rn_context_tts::decodeAudioEmbeddings(llama_rn_context*
     return audio;
 }
 
+// ── Streaming decode ────────────────────────────────────────────────────────
+
+// Causal codecs decode the varying stream windows through shape-bucketed
+// graphs; whole-utterance decodes keep exact shapes once no stream is open.
+static void open_stream_buckets(llama_rn_context_tts &tts, const llama_rn_audio_stream_options &options) {
+    if (tts.audio_streams_open++ == 0) {
+        codec_set_graph_bucket_frames(tts.codec_ctx, options.graph_bucket_frames);
+    }
+}
+
+static void close_stream_buckets(llama_rn_context_tts &tts) {
+    if (tts.audio_streams_open > 0 && --tts.audio_streams_open == 0) {
+        codec_set_graph_bucket_frames(tts.codec_ctx, 0);
+    }
+}
+
+static llama_rn_audio_stream_options clamp_stream_options(const llama_rn_audio_stream_options &options) {
+    llama_rn_audio_stream_options out = options;
+    out.first_chunk_frames = std::max(1, options.first_chunk_frames);
+    out.chunk_frames       = std::max(1, options.chunk_frames);
+    out.context_frames     = std::max(0, options.context_frames);
+    out.lookahead_frames   = std::max(0, options.lookahead_frames);
+    out.crossfade_samples  = std::max(0, options.crossfade_samples);
+    return out;
+}
+
+// Ends a stream without decoding: the held crossfade tail goes out as the
+// final chunk unless the stream already sent one.
+static void flush_stream_tail(bool active, const llama_rn_audio_chunk_cb &on_chunk, std::vector<float> &tail) {
+    if (active && on_chunk) {
+        std::vector<float> out;
+        out.swap(tail);
+        on_chunk(out, true);
+    }
+}
+
+bool llama_rn_context_tts::startAudioStream(
+    llama_rn_context* main_ctx,
+    const llama_rn_audio_stream_options &options,
+    llama_rn_audio_chunk_cb on_chunk) {
+    stopAudioStream();
+    if (codec_ctx == nullptr || codec_model == nullptr || !on_chunk) {
+        return false;
+    }
+
+    const tts_model_profile &profile = profile_for_type(getTTSType(main_ctx));
+    if (profile.decode_kind == tts_decode_kind::CODEC_CODES) {
+        audio_stream_latent = false;
+    } else if (profile.decode_kind == tts_decode_kind::HIDDEN_STATES) {
+        audio_stream_latent = true;
+    } else {
+        LOG_WARNING("startAudioStream: streaming decode is not supported for this TTS model; decode after completion instead");
+        return false;
+    }
+
+    audio_stream_options = clamp_stream_options(options);
+    audio_stream_on_chunk = std::move(on_chunk);
+    audio_stream_frames_done = 0;
+    audio_stream_tail.clear();
+    audio_stream_active = true;
+    open_stream_buckets(*this, audio_stream_options);
+    return true;
+}
+
+// Decodes codec frames [begin, end) of the running completion.
+static std::vector<float> decode_stream_window(
+    llama_rn_context_tts &tts, llama_rn_context *main_ctx, size_t n_cb, size_t begin, size_t end) {
+    if (tts.audio_stream_latent) {
+        const auto *completion = main_ctx->completion;
+        const size_t dim = (size_t) completion->embedding_dim;
+        const std::vector<float> rows(
+            completion->embeddings.begin() + (int64_t) (begin * dim),
+            completion->embeddings.begin() + (int64_t) (end * dim));
+        return tts.decodeAudioEmbeddings(main_ctx, rows, (int) dim);
+    }
+    const std::vector<llama_token> codes(
+        tts.audio_tokens.begin() + (int64_t) (begin * n_cb),
+        tts.audio_tokens.begin() + (int64_t) (end * n_cb));
+    return tts.decodeAudioTokens(main_ctx, codes);
+}
+
+bool llama_rn_audio_stream_step(
+    const llama_rn_audio_stream_options &opts, size_t n_frames, bool is_final, int32_t hop_size,
+    const llama_rn_audio_window_decode_fn &decode, const llama_rn_audio_chunk_cb &on_chunk,
+    size_t &frames_done, std::vector<float> &tail) {
+    const size_t done = frames_done;
+    size_t end = n_frames;
+    if (!is_final) {
+        const size_t need = (size_t) (done == 0 ? opts.first_chunk_frames : opts.chunk_frames);
+        if (n_frames < done + need + (size_t) opts.lookahead_frames) {
+            return true;
+        }
+        end = n_frames - (size_t) opts.lookahead_frames;
+    }
+
+    std::vector<float> out;
+    if (end <= done) {
+        // Nothing new since the last chunk: release the held tail
+        out.swap(tail);
+        on_chunk(out, true);
+        return true;
+    }
+
+    // Left context re-creates the conv / ISTFT history of the first new frame;
+    // the held-back lookahead frames give the last one its right context
+    const size_t begin = done > (size_t) opts.context_frames ? done - (size_t) opts.context_frames : 0;
+    const std::vector<float> pcm = decode(begin, n_frames);
+    if (pcm.empty()) {
+        LOG_WARNING("Streaming decode failed for frames [%zu, %zu); streaming stopped", begin, n_frames);
+        out.swap(tail);
+        on_chunk(out, true);
+        return false;
+    }
+
+    const size_t hop = hop_size > 0 ? (size_t) hop_size : pcm.size() / (n_frames - begin);
+    const size_t s_begin = std::min(pcm.size(), (done - begin) * hop);
+    const size_t s_end = is_final ? pcm.size() : std::max(s_begin, std::min(pcm.size(), (end - begin) * hop));
+
+    // Overlap-add the held tail onto the samples that precede s_begin in
+    // this window; tail samples without a counterpart go out as they are
+    const size_t n_fade = std::min(tail.size(), s_begin);
+    out.assign(tail.begin(), tail.end() - (int64_t) n_fade);
+    for (size_t i = 0; i < n_fade; ++i) {
+        const float w = ((float) i + 0.5f) / (float) n_fade;
+        out.push_back(tail[tail.size() - n_fade + i] * (1.0f - w) + pcm[s_begin - n_fade + i] * w);
+    }
+    const size_t n_hold = is_final ? 0 : std::min((size_t) opts.crossfade_samples, s_end - s_begin);
+    out.insert(out.end(), pcm.begin() + (int64_t) s_begin, pcm.begin() + (int64_t) (s_end - n_hold));
+    tail.assign(pcm.begin() + (int64_t) (s_end - n_hold), pcm.begin() + (int64_t) s_end);
+
+    frames_done = end;
+    on_chunk(out, is_final);
+    return true;
+}
+
+// Counts the frames the completion produced so far and runs one stream step
+// over them.
+static void audio_stream_step(llama_rn_context_tts &tts, llama_rn_context *main_ctx, bool is_final) {
+    size_t n_cb = 1;
+    size_t n_frames = 0;
+    if (tts.audio_stream_latent) {
+        const auto *completion = main_ctx->completion;
+        if (completion != nullptr && completion->embedding_dim > 0) {
+            n_frames = completion->embeddings.size() / (size_t) completion->embedding_dim;
+        }
+    } else {
+        const tts_model_profile &profile = profile_for_type(tts.getTTSType(main_ctx));
+        n_cb = (size_t) std::max(1, profile.audio.n_codebook);
+        n_frames = tts.audio_tokens.size() / n_cb;
+    }
+
+    const auto decode = [&](size_t begin, size_t end) {
+        return decode_stream_window(tts, main_ctx, n_cb, begin, end);
+    };
+    if (!llama_rn_audio_stream_step(tts.audio_stream_options, n_frames, is_final,
+                                    codec_model_hop_size(tts.codec_model), decode,
+                                    tts.audio_stream_on_chunk, tts.audio_stream_frames_done,
+                                    tts.audio_stream_tail)) {
+        tts.audio_stream_active = false;
+    }
+}
+
+void llama_rn_context_tts::pumpAudioStream(llama_rn_context* main_ctx) {
+    if (!audio_stream_active) {
+        return;
+    }
+    audio_stream_step(*this, main_ctx, false);
+}
+
+void llama_rn_context_tts::finishAudioStream(llama_rn_context* main_ctx) {
+    if (audio_stream_active) {
+        audio_stream_step(*this, main_ctx, true);
+    }
+    stopAudioStream();
+}
+
+void llama_rn_context_tts::abortAudioStream() {
+    flush_stream_tail(audio_stream_active, audio_stream_on_chunk, audio_stream_tail);
+    stopAudioStream();
+}
+
+void llama_rn_context_tts::stopAudioStream() {
+    if (audio_stream_on_chunk) {
+        close_stream_buckets(*this);
+    }
+    audio_stream_active = false;
+    audio_stream_on_chunk = nullptr;
+    audio_stream_frames_done = 0;
+    audio_stream_tail.clear();
+}
+
+bool llama_rn_context_tts::startSlotAudioStream(
+    llama_rn_context* main_ctx,
+    llama_rn_slot_audio_stream &stream,
+    const llama_rn_audio_stream_options &options,
+    llama_rn_audio_chunk_cb on_chunk) {
+    abortSlotAudioStream(stream);
+    if (codec_ctx == nullptr || codec_model == nullptr || !on_chunk) {
+        return false;
+    }
+    if (profile_for_type(getTTSType(main_ctx)).decode_kind != tts_decode_kind::CODEC_CODES) {
+        LOG_WARNING("startSlotAudioStream: parallel streaming decode needs a codec-code TTS model; decode after completion instead");
+        return false;
+    }
+
+    stream.options = clamp_stream_options(options);
+    stream.on_chunk = std::move(on_chunk);
+    stream.audio_tokens.clear();
+    stream.pending_codebook1 = -1;
+    stream.frames_done = 0;
+    stream.tail.clear();
+    stream.active = true;
+    open_stream_buckets(*this, stream.options);
+    return true;
+}
+
+static void slot_audio_stream_step(
+    llama_rn_context_tts &tts, llama_rn_context *main_ctx, llama_rn_slot_audio_stream &stream, bool is_final) {
+    const tts_model_profile &profile = profile_for_type(tts.getTTSType(main_ctx));
+    const size_t n_cb = (size_t) std::max(1, profile.audio.n_codebook);
+    const size_t n_frames = stream.audio_tokens.size() / n_cb;
+
+    const auto decode = [&](size_t begin, size_t end) {
+        const std::vector<llama_token> codes(
+            stream.audio_tokens.begin() + (int64_t) (begin * n_cb),
+            stream.audio_tokens.begin() + (int64_t) (end * n_cb));
+        return tts.decodeAudioTokens(main_ctx, codes);
+    };
+    if (!llama_rn_audio_stream_step(stream.options, n_frames, is_final,
+                                    codec_model_hop_size(tts.codec_model), decode,
+                                    stream.on_chunk, stream.frames_done, stream.tail)) {
+        stream.active = false;
+    }
+}
+
+void llama_rn_context_tts::pumpSlotAudioStream(
+    llama_rn_context* main_ctx, llama_rn_slot_audio_stream &stream, llama_token token) {
+    if (!stream.active || !add_audio_token(this, main_ctx, token, stream.pending_codebook1, stream.audio_tokens)) {
+        return;
+    }
+    slot_audio_stream_step(*this, main_ctx, stream, false);
+}
+
+void llama_rn_context_tts::finishSlotAudioStream(llama_rn_context* main_ctx, llama_rn_slot_audio_stream &stream) {
+    if (stream.active) {
+        slot_audio_stream_step(*this, main_ctx, stream, true);
+        stream.active = false;
+    }
+    abortSlotAudioStream(stream);
+}
+
+void llama_rn_context_tts::abortSlotAudioStream(llama_rn_slot_audio_stream &stream) {
+    flush_stream_tail(stream.active, stream.on_chunk, stream.tail);
+    if (stream.on_chunk) {
+        close_stream_buckets(*this);
+    }
+    stream.active = false;
+    stream.on_chunk = nullptr;
+    stream.audio_tokens.clear();
+    stream.pending_codebook1 = -1;
+    stream.frames_done = 0;
+    stream.tail.clear();
+}
+
 // ── encodeInto: shared codec_lm_speaker_encode helper ───────────────────────
 // Fills spk.emb / rows / hidden_dim / baked.  `ref_codes` is the output of
 // a prior codec_encode call and is only forwarded when the speaker section
@@ -85,6 +85,50 @@ struct llama_rn_audio_codes_options {
 using llama_rn_audio_codes_progress_cb =
     std::function<bool(int step, const std::vector<int32_t> &codes)>;
 
+// Incremental codec decode while tokens are still being generated (see
+// startAudioStream).  Frames are codec frames: one group of n_codebook codes,
+// or one latent / hidden-state row for embedding-decoded models.
+struct llama_rn_audio_stream_options {
+    int first_chunk_frames = 4;   // frames before the first chunk (time to first audio)
+    int chunk_frames = 16;        // new frames per later chunk
+    int context_frames = 16;      // already-emitted frames re-decoded as left context
+    int lookahead_frames = 2;     // newest frames held back until more arrive
+    int crossfade_samples = 256;  // overlap-add length between consecutive chunks
+    int graph_bucket_frames = 16; // codec graph shape bucket while streaming (0 = exact, -1 = pow2)
+};
+
+// Receives each PCM chunk in order; is_final marks the last one.
+using llama_rn_audio_chunk_cb =
+    std::function<void(const std::vector<float> &pcm, bool is_final)>;
+
+// Decodes frames [begin, end) of the stream to PCM; empty on failure.
+using llama_rn_audio_window_decode_fn =
+    std::function<std::vector<float>(size_t begin, size_t end)>;
+
+// One streaming step over the n_frames frames available so far.  Once enough
+// new frames arrived (or on is_final) it decodes a window of them plus left
+// context, sends the samples not yet emitted to on_chunk and keeps the
+// crossfade tail; frames_done and tail carry the stream between steps.
+// hop_size <= 0 derives samples per frame from the window.  Returns false if
+// decode failed, after flushing the tail as the final chunk.
+bool llama_rn_audio_stream_step(
+    const llama_rn_audio_stream_options &opts, size_t n_frames, bool is_final, int32_t hop_size,
+    const llama_rn_audio_window_decode_fn &decode, const llama_rn_audio_chunk_cb &on_chunk,
+    size_t &frames_done, std::vector<float> &tail);
+
+// Streaming decode of one parallel slot's completion.  Slots cannot share the
+// context-wide stream (audio_tokens, audio_stream_*), so each one keeps its
+// parsed codes and stream position here.
+struct llama_rn_slot_audio_stream {
+    llama_rn_audio_stream_options options;
+    llama_rn_audio_chunk_cb on_chunk;
+    std::vector<llama_token> audio_tokens;
+    int pending_codebook1 = -1;
+    size_t frames_done = 0;
+    std::vector<float> tail;
+    bool active = false;
+};
+
 struct llama_rn_audio_codes_result {
     std::vector<int32_t> codes;   // (n_frames * n_codebook) interleaved
     int n_codebook = 0;
@@ -146,6 +190,16 @@ struct llama_rn_context_tts {
     std::vector<llama_token> audio_tokens;
     int pending_codebook1 = -1;
 
+    // Streaming decode state (startAudioStream).  frames_done counts frames
+    // whose audio has been emitted, except for the held crossfade tail.
+    bool audio_stream_active = false;
+    bool audio_stream_latent = false;   // frames are completion embedding rows
+    llama_rn_audio_stream_options audio_stream_options;
+    llama_rn_audio_chunk_cb audio_stream_on_chunk;
+    size_t audio_stream_frames_done = 0;
+    std::vector<float> audio_stream_tail;
+    int audio_streams_open = 0;         // context + slot streams holding graph buckets
+
     // Codec runtime handles
     ::codec_model *codec_model = nullptr;
     ::codec_context *codec_ctx = nullptr;
@@ -487,6 +541,34 @@ struct llama_rn_context_tts {
     void releaseSpeaker(int id);
     std::vector<float> decodeAudioTokens(llama_rn_context* main_ctx, const std::vector<llama_token> &tokens);
     std::vector<float> decodeAudioEmbeddings(llama_rn_context* main_ctx, const std::vector<float> &embeddings, int embedding_dim);
+
+    // ── Streaming decode ─────────────────────────────────────────────────
+    // Decodes audio while the completion runs: each pump decodes a window of
+    // the newest frames plus context_frames of history (which stands in for
+    // the causal conv / ISTFT state the codec API does not expose), emits the
+    // part not yet sent, and overlap-adds it onto the previous chunk's tail.
+    // Supported for codec-code models (OuteTTS / NeuTTS) and embedding
+    // decoded models (Soprano / BlueMagpie); codec_lm-AR models decode
+    // through the audio_lm accumulator and return false (use the final
+    // decodeAudioTokens).  The completion loop pumps after every token;
+    // finishAudioStream flushes the remainder and fires the final chunk;
+    // abortAudioStream ends the stream without decoding (on errors), still
+    // sending the held tail as the final chunk.  Codec graphs are bucketed
+    // (options.graph_bucket_frames) only while a stream is open.
+    bool startAudioStream(llama_rn_context* main_ctx, const llama_rn_audio_stream_options &options,
+                          llama_rn_audio_chunk_cb on_chunk);
+    void pumpAudioStream(llama_rn_context* main_ctx);
+    void finishAudioStream(llama_rn_context* main_ctx);
+    void abortAudioStream();
+    void stopAudioStream();
+    // Same for a parallel slot: the slot manager pumps every generated token
+    // of the slot.  Codec-code models only.
+    bool startSlotAudioStream(llama_rn_context* main_ctx, llama_rn_slot_audio_stream &stream,
+                              const llama_rn_audio_stream_options &options, llama_rn_audio_chunk_cb on_chunk);
+    void pumpSlotAudioStream(llama_rn_context* main_ctx, llama_rn_slot_audio_stream &stream, llama_token token);
+    void finishSlotAudioStream(llama_rn_context* main_ctx, llama_rn_slot_audio_stream &stream);
+    void abortSlotAudioStream(llama_rn_slot_audio_stream &stream);
+    bool isAudioStreamActive() const { return audio_stream_active; }
     int getAudioSampleRate() const;
     bool isAudioToken(llama_rn_context* main_ctx, llama_token token, const std::string &token_text = "");
     bool tryAddAudioToken(llama_rn_context* main_ctx, llama_token token, const std::string &token_text = "");
@@ -594,6 +594,32 @@ struct clip_image_f32 {
         }
     }
 
+    // from_u8() followed by normalize() in a single pass, through a per-channel
+    // lookup table that holds exactly the values the two-step path computes
+    void from_u8_normalized(const clip_image_u8 & img, const float mean[3], const float std[3]) {
+        auto size = img.get_size();
+        nx_ = size.width;
+        ny_ = size.height;
+        if (img.is_placeholder()) {
+            buf.clear();
+            return; // no-op
+        }
+        float lut[3][256];
+        for (int c = 0; c < 3; ++c) {
+            for (int v = 0; v < 256; ++v) {
+                lut[c][v] = ((float) v / 255.0f - mean[c]) / std[c];
+            }
+        }
+        buf.resize(img.n_elements());
+        const uint8_t * src = img.get_ro_buf().data();
+        float * dst = buf.data();
+        for (size_t i = 0; i < n_pixels(); ++i) {
+            dst[i * 3 + 0] = lut[0][src[i * 3 + 0]];
+            dst[i * 3 + 1] = lut[1][src[i * 3 + 1]];
+            dst[i * 3 + 2] = lut[2][src[i * 3 + 2]];
+        }
+    }
+
     size_t n_elements() const {
         return n_pixels() * 3;
     }
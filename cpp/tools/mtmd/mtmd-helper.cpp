@@ -443,6 +443,28 @@ int32_t mtmd_helper_eval_chunk_single(mtmd_context * ctx,
     return 0;
 }
 
+int32_t mtmd_helper_eval_chunk_encoded(mtmd_context * ctx,
+        struct llama_context * lctx,
+        const mtmd_input_chunk * chunk,
+        float * encoded_embd,
+        llama_pos n_past,
+        llama_seq_id seq_id,
+        int32_t n_batch,
+        bool logits_last,
+        llama_pos * new_n_past) {
+    auto chunk_type = mtmd_input_chunk_get_type(chunk);
+    if (chunk_type == MTMD_INPUT_CHUNK_TYPE_TEXT) {
+        return mtmd_helper_eval_chunk_single(ctx, lctx, chunk, n_past, seq_id, n_batch, logits_last, new_n_past);
+    }
+    if (encoded_embd == nullptr) {
+        LOG_ERR("%s: missing embeddings for media chunk\n", __func__);
+        return 1;
+    }
+    return mtmd_helper_decode_image_chunk_impl(
+        ctx, lctx, chunk, encoded_embd, n_past, seq_id, n_batch,
+        logits_last, new_n_past, nullptr, nullptr);
+}
+
 int32_t mtmd_helper_eval_chunks(mtmd_context * ctx,
                                 struct llama_context * lctx,
                                 const mtmd_input_chunks * chunks,
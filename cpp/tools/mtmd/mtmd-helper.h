@@ -91,6 +91,20 @@ MTMD_API int32_t mtmd_helper_eval_chunk_single(mtmd_context * ctx,
                                                bool logits_last,
                                                llama_pos * new_n_past);
 
+// works like mtmd_helper_eval_chunk_single(), but a media chunk is decoded from
+// embeddings computed beforehand (mtmd_encode_chunk() + mtmd_get_output_embd()),
+// so encoding can run elsewhere; encoded_embd is ignored for text chunks
+// this function is NOT thread-safe
+MTMD_API int32_t mtmd_helper_eval_chunk_encoded(mtmd_context * ctx,
+                                                struct llama_context * lctx,
+                                                const mtmd_input_chunk * chunk,
+                                                float * encoded_embd,
+                                                llama_pos n_past,
+                                                llama_seq_id seq_id,
+                                                int32_t n_batch,
+                                                bool logits_last,
+                                                llama_pos * new_n_past);
+
 typedef int32_t (*mtmd_helper_post_decode_callback)(struct llama_batch batch, void * user_data);
 
 // helper function to decode an image whose embeddings have already been calculated
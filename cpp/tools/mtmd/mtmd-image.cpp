@@ -1,22 +1,170 @@
 #include "mtmd-image.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
 #include <vector>
 
+//
+// threading
+//
+
+static thread_local int g_preproc_n_threads = 1;
+
+mtmd_image_threads_scope::mtmd_image_threads_scope(int n_threads) : prev_n_threads(g_preproc_n_threads) {
+    g_preproc_n_threads = std::max(1, n_threads);
+}
+
+mtmd_image_threads_scope::~mtmd_image_threads_scope() {
+    g_preproc_n_threads = prev_n_threads;
+}
+
+// one preproc_parallel_for call: its ranges are claimed one at a time by the
+// calling thread and by any pool worker that picks up one of its tickets
+struct preproc_job {
+    std::function<void(int, int)> fn;
+    int n = 0;
+    int chunk = 0;
+    int n_chunks = 0;
+    std::atomic<int> next{0};
+    std::atomic<int> n_done{0};
+    std::mutex mutex;
+    std::condition_variable cv;
+
+    void run() {
+        for (int c = next++; c < n_chunks; c = next++) {
+            fn(c * chunk, std::min(n, (c + 1) * chunk));
+            if (++n_done == n_chunks) {
+                std::lock_guard<std::mutex> lock(mutex);
+                cv.notify_all();
+            }
+        }
+    }
+};
+
+// workers shared by every preprocess call in the process: started on first
+// use, grown to the largest thread count asked for, joined at exit. Images
+// are preprocessed once per media chunk, so thread start-up would otherwise
+// be paid for every resize, crop and normalize pass
+class preproc_pool {
+public:
+    static preproc_pool & get() {
+        static preproc_pool pool;
+        return pool;
+    }
+
+    // queue n_tickets helpers for job; the caller runs it too, so the job
+    // finishes even if no worker is free (or none could be started)
+    void submit(const std::shared_ptr<preproc_job> & job, int n_tickets) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            try {
+                while ((int) workers.size() < n_tickets) {
+                    workers.emplace_back([this]() { worker_loop(); });
+                }
+            } catch (const std::system_error &) {
+                // run with the workers we have
+            }
+            for (int i = 0; i < n_tickets; ++i) {
+                tickets.push_back(job);
+            }
+        }
+        cv.notify_all();
+    }
+
+    ~preproc_pool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (auto & w : workers) {
+            w.join();
+        }
+    }
+
+private:
+    void worker_loop() {
+        while (true) {
+            std::shared_ptr<preproc_job> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this]() { return stopping || !tickets.empty(); });
+                if (tickets.empty()) {
+                    return;
+                }
+                job = std::move(tickets.front());
+                tickets.pop_front();
+            }
+            // a ticket for a job the caller already finished claims nothing
+            job->run();
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::shared_ptr<preproc_job>> tickets;
+    std::vector<std::thread> workers;
+    bool stopping = false;
+};
+
+// run fn(begin, end) over [0, n) split into contiguous ranges, one per thread;
+// work_per_item is a rough per-item cost (in pixels) used to skip threading
+// for small jobs, where handing out work would cost more than it saves. The
+// ranges do not depend on which thread runs them, so neither does the output
+template <typename F>
+static void preproc_parallel_for(int n, size_t work_per_item, F && fn) {
+    const size_t min_work_per_thread = 64 * 1024;
+    int n_threads = std::min(g_preproc_n_threads, n);
+    if (work_per_item > 0) {
+        n_threads = std::min<size_t>(n_threads, std::max<size_t>(1, n * work_per_item / min_work_per_thread));
+    }
+    if (n_threads <= 1) {
+        fn(0, n);
+        return;
+    }
+    auto job = std::make_shared<preproc_job>();
+    job->fn = [&fn](int begin, int end) { fn(begin, end); };
+    job->n = n;
+    job->chunk = (n + n_threads - 1) / n_threads;
+    job->n_chunks = (n + job->chunk - 1) / job->chunk;
+    preproc_pool::get().submit(job, job->n_chunks - 1);
+    job->run();
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->cv.wait(lock, [&]() { return job->n_done.load() == job->n_chunks; });
+}
+
 void mtmd_image_preproc_out::append(const clip_hparams & hparams, const clip_image_u8 & img, bool normalized) {
     clip_image_f32 dst;
-    dst.from_u8(img);
     if (normalized) {
-        dst.normalize(hparams.image_mean, hparams.image_std);
+        dst.from_u8_normalized(img, hparams.image_mean, hparams.image_std);
+    } else {
+        dst.from_u8(img);
     }
     entries.push_back(std::move(dst));
 }
 
 void mtmd_image_preproc_out::append(const clip_hparams & hparams, const std::vector<clip_image_u8> & imgs, bool normalized) {
-    for (const auto & img : imgs) {
-        append(hparams, img, normalized);
-    }
+    // tiles are independent: convert them in parallel, in place
+    const size_t base = entries.size();
+    entries.resize(base + imgs.size());
+    const size_t tile_pixels = imgs.empty() ? 0 : (size_t) imgs[0].get_size().width * imgs[0].get_size().height;
+    preproc_parallel_for((int) imgs.size(), tile_pixels, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            if (normalized) {
+                entries[base + i].from_u8_normalized(imgs[i], hparams.image_mean, hparams.image_std);
+            } else {
+                entries[base + i].from_u8(imgs[i]);
+            }
+        }
+    });
 }
 
 void mtmd_image_preproc_out::append(const clip_hparams & hparams, clip_image_f32 & img, bool normalized) {
@@ -27,9 +175,10 @@ void mtmd_image_preproc_out::append(const clip_hparams & hparams, clip_image_f32
 }
 
 void mtmd_image_preproc_out::append_overview(const clip_hparams & hparams, const clip_image_u8 & img, bool normalized) {
-    overview.from_u8(img);
     if (normalized) {
-        overview.normalize(hparams.image_mean, hparams.image_std);
+        overview.from_u8_normalized(img, hparams.image_mean, hparams.image_std);
+    } else {
+        overview.from_u8(img);
     }
 }
 
@@ -245,33 +394,36 @@ private:
         float x_ratio = target_width  > 1 ? static_cast<float>(src_size.width  - 1) / (target_width  - 1) : 0.0f;
         float y_ratio = target_height > 1 ? static_cast<float>(src_size.height - 1) / (target_height - 1) : 0.0f;
 
-        for (int y = 0; y < target_height; ++y) {
-            for (int x = 0; x < target_width; ++x) {
-                float px = x * x_ratio;
-                float py = y * y_ratio;
-
-                int x0 = std::min(static_cast<int>(px), src_size.width  - 1);
-                int y0 = std::min(static_cast<int>(py), src_size.height - 1);
-                int x1 = std::min(x0 + 1, src_size.width  - 1);
-                int y1 = std::min(y0 + 1, src_size.height - 1);
-
-                float xf = px - x0;
-                float yf = py - y0;
-
-                const auto p00 = src.get_pixel(x0, y0);
-                const auto p10 = src.get_pixel(x1, y0);
-                const auto p01 = src.get_pixel(x0, y1);
-                const auto p11 = src.get_pixel(x1, y1);
-
-                std::array<uint8_t, 3> pixel;
-                for (int c = 0; c < 3; ++c) {
-                    float top    = lerp(static_cast<float>(p00[c]), static_cast<float>(p10[c]), xf);
-                    float bottom = lerp(static_cast<float>(p01[c]), static_cast<float>(p11[c]), xf);
-                    pixel[c] = static_cast<uint8_t>(lerp(top, bottom, yf));
+        // rows are independent; each worker writes only its own rows of dst
+        preproc_parallel_for(target_height, target_width, [&](int y_begin, int y_end) {
+            for (int y = y_begin; y < y_end; ++y) {
+                for (int x = 0; x < target_width; ++x) {
+                    float px = x * x_ratio;
+                    float py = y * y_ratio;
+
+                    int x0 = std::min(static_cast<int>(px), src_size.width  - 1);
+                    int y0 = std::min(static_cast<int>(py), src_size.height - 1);
+                    int x1 = std::min(x0 + 1, src_size.width  - 1);
+                    int y1 = std::min(y0 + 1, src_size.height - 1);
+
+                    float xf = px - x0;
+                    float yf = py - y0;
+
+                    const auto p00 = src.get_pixel(x0, y0);
+                    const auto p10 = src.get_pixel(x1, y0);
+                    const auto p01 = src.get_pixel(x0, y1);
+                    const auto p11 = src.get_pixel(x1, y1);
+
+                    std::array<uint8_t, 3> pixel;
+                    for (int c = 0; c < 3; ++c) {
+                        float top    = lerp(static_cast<float>(p00[c]), static_cast<float>(p10[c]), xf);
+                        float bottom = lerp(static_cast<float>(p01[c]), static_cast<float>(p11[c]), xf);
+                        pixel[c] = static_cast<uint8_t>(lerp(top, bottom, yf));
+                    }
+                    dst.set_pixel(x, y, pixel);
                 }
-                dst.set_pixel(x, y, pixel);
             }
-        }
+        });
     }
 
     // Bicubic resize function
@@ -288,59 +440,60 @@ private:
             return;
         }
 
-        float Cc;
-        float C[5] = {};
-        float d0, d2, d3, a0, a1, a2, a3;
-        int i, j, k, jj;
-        int x, y;
-        float dx, dy;
-        float tx, ty;
-
-        tx = (float)nx / (float)target_width;
-        ty = (float)ny / (float)target_height;
+        const float tx = (float)nx / (float)target_width;
+        const float ty = (float)ny / (float)target_height;
 
         // Bicubic interpolation; adapted from ViT.cpp, inspired from :
         //    -> https://github.com/yglukhov/bicubic-interpolation-image-processing/blob/master/libimage.c#L36
         //    -> https://en.wikipedia.org/wiki/Bicubic_interpolation
 
-        for (i = 0; i < target_height; i++) {
-            for (j = 0; j < target_width; j++) {
-                x = (int)(tx * j);
-                y = (int)(ty * i);
-
-                dx = tx * j - x;
-                dy = ty * i - y;
-
-                std::array<uint8_t, 3> pixel;
-                for (k = 0; k < 3; k++) {
-                    for (jj = 0; jj <= 3; jj++) {
-                        d0 = img.get_pixel(clip(x - 1, 0, nx - 1), clip(y - 1 + jj, 0, ny - 1))[k] - img.get_pixel(clip(x, 0, nx - 1), clip(y - 1 + jj, 0, ny - 1))[k];
-                        d2 = img.get_pixel(clip(x + 1, 0, nx - 1), clip(y - 1 + jj, 0, ny - 1))[k] - img.get_pixel(clip(x, 0, nx - 1), clip(y - 1 + jj, 0, ny - 1))[k];
-                        d3 = img.get_pixel(clip(x + 2, 0, nx - 1), clip(y - 1 + jj, 0, ny - 1))[k] - img.get_pixel(clip(x, 0, nx - 1), clip(y - 1 + jj, 0, ny - 1))[k];
-                        a0 = img.get_pixel(clip(x, 0, nx - 1), clip(y - 1 + jj, 0, ny - 1))[k];
-
-                        a1 = -1.0 / 3 * d0 + d2 - 1.0 / 6 * d3;
-                        a2 =  1.0 / 2 * d0 +      1.0 / 2 * d2;
-                        a3 = -1.0 / 6 * d0 -      1.0 / 2 * d2 + 1.0 / 6 * d3;
-
-                        C[jj] = a0 + a1 * dx + a2 * dx * dx + a3 * dx * dx * dx;
-
-                        d0 = C[0] - C[1];
-                        d2 = C[2] - C[1];
-                        d3 = C[3] - C[1];
-                        a0 = C[1];
-                        a1 = -1.0 / 3 * d0 + d2 - 1.0 / 6 * d3;
-                        a2 =  1.0 / 2 * d0 +      1.0 / 2 * d2;
-                        a3 = -1.0 / 6 * d0 -      1.0 / 2 * d2 + 1.0 / 6 * d3;
-                        Cc = a0 + a1 * dy + a2 * dy * dy + a3 * dy * dy * dy;
-
-                        const uint8_t Cc2 = std::min(std::max(std::round(Cc), 0.0f), 255.0f);
-                        pixel[k] = Cc2;
+        preproc_parallel_for(target_height, (size_t) target_width * 16, [&](int i_begin, int i_end) {
+            float Cc;
+            float C[5] = {};
+            float d0, d2, d3, a0, a1, a2, a3;
+            int i, j, k, jj;
+            int x, y;
+            float dx, dy;
+
+            for (i = i_begin; i < i_end; i++) {
+                for (j = 0; j < target_width; j++) {
+                    x = (int)(tx * j);
+                    y = (int)(ty * i);
+
+                    dx = tx * j - x;
+                    dy = ty * i - y;
+
+                    std::array<uint8_t, 3> pixel;
+                    for (k = 0; k < 3; k++) {
+                        for (jj = 0; jj <= 3; jj++) {
+                            d0 = img.get_pixel(clip(x - 1, 0, nx - 1), clip(y - 1 + jj, 0, ny - 1))[k] - img.get_pixel(clip(x, 0, nx - 1), clip(y - 1 + jj, 0, ny - 1))[k];
+                            d2 = img.get_pixel(clip(x + 1, 0, nx - 1), clip(y - 1 + jj, 0, ny - 1))[k] - img.get_pixel(clip(x, 0, nx - 1), clip(y - 1 + jj, 0, ny - 1))[k];
+                            d3 = img.get_pixel(clip(x + 2, 0, nx - 1), clip(y - 1 + jj, 0, ny - 1))[k] - img.get_pixel(clip(x, 0, nx - 1), clip(y - 1 + jj, 0, ny - 1))[k];
+                            a0 = img.get_pixel(clip(x, 0, nx - 1), clip(y - 1 + jj, 0, ny - 1))[k];
+
+                            a1 = -1.0 / 3 * d0 + d2 - 1.0 / 6 * d3;
+                            a2 =  1.0 / 2 * d0 +      1.0 / 2 * d2;
+                            a3 = -1.0 / 6 * d0 -      1.0 / 2 * d2 + 1.0 / 6 * d3;
+
+                            C[jj] = a0 + a1 * dx + a2 * dx * dx + a3 * dx * dx * dx;
+
+                            d0 = C[0] - C[1];
+                            d2 = C[2] - C[1];
+                            d3 = C[3] - C[1];
+                            a0 = C[1];
+                            a1 = -1.0 / 3 * d0 + d2 - 1.0 / 6 * d3;
+                            a2 =  1.0 / 2 * d0 +      1.0 / 2 * d2;
+                            a3 = -1.0 / 6 * d0 -      1.0 / 2 * d2 + 1.0 / 6 * d3;
+                            Cc = a0 + a1 * dy + a2 * dy * dy + a3 * dy * dy * dy;
+
+                            const uint8_t Cc2 = std::min(std::max(std::round(Cc), 0.0f), 255.0f);
+                            pixel[k] = Cc2;
+                        }
                     }
+                    dst.set_pixel(j, i, pixel);
                 }
-                dst.set_pixel(j, i, pixel);
             }
-        }
+        });
     }
 
     // Pillow-compatible separable resampling (Bicubic and Lanczos)
@@ -527,33 +680,35 @@ private:
             const int in_ny = imIn.get_size().height;
             imOut.set_size({out_nx, in_ny}, false);
 
-            // Process each row independently
-            for (int yy = 0; yy < in_ny; yy++) {
-                // For each output pixel in this row
-                for (int xx = 0; xx < out_nx; xx++) {
-                    // Get the range of input pixels and filter coefficients
-                    int xmin = bounds[xx * 2 + 0];  // First input pixel index
-                    int xcnt = bounds[xx * 2 + 1];  // Number of input pixels
-
-                    // Initialize accumulators for RGB channels with rounding bias (0.5 in fixed-point)
-                    int32_t ss0 = 1 << (PRECISION_BITS - 1);
-                    int32_t ss1 = 1 << (PRECISION_BITS - 1);
-                    int32_t ss2 = 1 << (PRECISION_BITS - 1);
-
-                    // Convolve: sum weighted input pixels
-                    for (int x = 0; x < xcnt; x++) {
-                        const auto src_px = imIn.get_pixel(x + xmin, yy);
-                        ss0 += src_px[0] * weights[xx * ksize + x];  // R channel
-                        ss1 += src_px[1] * weights[xx * ksize + x];  // G channel
-                        ss2 += src_px[2] * weights[xx * ksize + x];  // B channel
-                    }
+            // Process each row independently (rows are split across threads)
+            preproc_parallel_for(in_ny, (size_t) out_nx * ksize, [&](int y_begin, int y_end) {
+                for (int yy = y_begin; yy < y_end; yy++) {
+                    // For each output pixel in this row
+                    for (int xx = 0; xx < out_nx; xx++) {
+                        // Get the range of input pixels and filter coefficients
+                        int xmin = bounds[xx * 2 + 0];  // First input pixel index
+                        int xcnt = bounds[xx * 2 + 1];  // Number of input pixels
+
+                        // Initialize accumulators for RGB channels with rounding bias (0.5 in fixed-point)
+                        int32_t ss0 = 1 << (PRECISION_BITS - 1);
+                        int32_t ss1 = 1 << (PRECISION_BITS - 1);
+                        int32_t ss2 = 1 << (PRECISION_BITS - 1);
+
+                        // Convolve: sum weighted input pixels
+                        for (int x = 0; x < xcnt; x++) {
+                            const auto src_px = imIn.get_pixel(x + xmin, yy);
+                            ss0 += src_px[0] * weights[xx * ksize + x];  // R channel
+                            ss1 += src_px[1] * weights[xx * ksize + x];  // G channel
+                            ss2 += src_px[2] * weights[xx * ksize + x];  // B channel
+                        }
 
-                    // Convert back from fixed-point (divide by 2^PRECISION_BITS) and clamp to [0,255]
-                    imOut.set_pixel(xx, yy, {clip8(ss0 >> PRECISION_BITS),
-                                             clip8(ss1 >> PRECISION_BITS),
-                                             clip8(ss2 >> PRECISION_BITS)});
+                        // Convert back from fixed-point (divide by 2^PRECISION_BITS) and clamp to [0,255]
+                        imOut.set_pixel(xx, yy, {clip8(ss0 >> PRECISION_BITS),
+                                                 clip8(ss1 >> PRECISION_BITS),
+                                                 clip8(ss2 >> PRECISION_BITS)});
+                    }
                 }
-            }
+            });
         };
 
         // Vertical resampling pass
@@ -564,33 +719,35 @@ private:
             const int in_nx = imIn.get_size().width;
             imOut.set_size({in_nx, out_ny}, false);
 
-            // For each output row
-            for (int yy = 0; yy < out_ny; yy++) {
-                // Get the range of input rows and filter coefficients
-                int ymin = bounds[yy * 2 + 0];  // First input row index
-                int ycnt = bounds[yy * 2 + 1];  // Number of input rows
-
-                // Process each column in this output row
-                for (int xx = 0; xx < in_nx; xx++) {
-                    // Initialize accumulators for RGB channels with rounding bias
-                    int32_t ss0 = 1 << (PRECISION_BITS - 1);
-                    int32_t ss1 = 1 << (PRECISION_BITS - 1);
-                    int32_t ss2 = 1 << (PRECISION_BITS - 1);
-
-                    // Convolve: sum weighted input pixels vertically
-                    for (int y = 0; y < ycnt; y++) {
-                        const auto src_px = imIn.get_pixel(xx, y + ymin);
-                        ss0 += src_px[0] * weight[yy * ksize + y];  // R channel
-                        ss1 += src_px[1] * weight[yy * ksize + y];  // G channel
-                        ss2 += src_px[2] * weight[yy * ksize + y];  // B channel
-                    }
+            // For each output row (rows are split across threads)
+            preproc_parallel_for(out_ny, (size_t) in_nx * ksize, [&](int y_begin, int y_end) {
+                for (int yy = y_begin; yy < y_end; yy++) {
+                    // Get the range of input rows and filter coefficients
+                    int ymin = bounds[yy * 2 + 0];  // First input row index
+                    int ycnt = bounds[yy * 2 + 1];  // Number of input rows
+
+                    // Process each column in this output row
+                    for (int xx = 0; xx < in_nx; xx++) {
+                        // Initialize accumulators for RGB channels with rounding bias
+                        int32_t ss0 = 1 << (PRECISION_BITS - 1);
+                        int32_t ss1 = 1 << (PRECISION_BITS - 1);
+                        int32_t ss2 = 1 << (PRECISION_BITS - 1);
+
+                        // Convolve: sum weighted input pixels vertically
+                        for (int y = 0; y < ycnt; y++) {
+                            const auto src_px = imIn.get_pixel(xx, y + ymin);
+                            ss0 += src_px[0] * weight[yy * ksize + y];  // R channel
+                            ss1 += src_px[1] * weight[yy * ksize + y];  // G channel
+                            ss2 += src_px[2] * weight[yy * ksize + y];  // B channel
+                        }
 
-                    // Convert back from fixed-point and clamp to [0,255]
-                    imOut.set_pixel(xx, yy, {clip8(ss0 >> PRECISION_BITS),
-                                             clip8(ss1 >> PRECISION_BITS),
-                                             clip8(ss2 >> PRECISION_BITS)});
+                        // Convert back from fixed-point and clamp to [0,255]
+                        imOut.set_pixel(xx, yy, {clip8(ss0 >> PRECISION_BITS),
+                                                 clip8(ss1 >> PRECISION_BITS),
+                                                 clip8(ss2 >> PRECISION_BITS)});
+                    }
                 }
-            }
+            });
         };
 
         // Main resampling logic using separable two-pass approach
@@ -787,17 +944,15 @@ mtmd_image_preprocessor_llava_uhd::slice_output mtmd_image_preprocessor_llava_uh
     img_tool::resize(img, refined_img, inst.refined_size, hparams.image_resize_algo_rf,
                         hparams.image_pad_rf, hparams.image_pad_color_rf);
 
-    // create slices
-    for (const auto & slice : inst.slices) {
-        int x = slice.x;
-        int y = slice.y;
-        int w = slice.size.width;
-        int h = slice.size.height;
-
-        clip_image_u8 img_slice;
-        img_tool::crop(refined_img, img_slice, x, y, w, h);
-        output.slices.push_back(std::move(img_slice));
-    }
+    // create slices, one tile per worker
+    output.slices.resize(inst.slices.size());
+    const size_t tile_pixels = inst.slices.empty() ? 0 : (size_t) inst.slices[0].size.width * inst.slices[0].size.height;
+    preproc_parallel_for((int) inst.slices.size(), tile_pixels, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            const auto & slice = inst.slices[i];
+            img_tool::crop(refined_img, output.slices[i], slice.x, slice.y, slice.size.width, slice.size.height);
+        }
+    });
 
     return output;
 }
@@ -1298,8 +1453,7 @@ void mtmd_image_preprocessor_step3vl::img_u8_resize_bilinear_to_f32(
         const float std[3]) {
     const auto src_size = src.get_size();
     if (src_size.width == target_width && src_size.height == target_height) {
-        dst.from_u8(src);
-        dst.normalize(mean, std);
+        dst.from_u8_normalized(src, mean, std);
         return;
     }
 
@@ -1315,38 +1469,49 @@ void mtmd_image_preprocessor_step3vl::img_u8_resize_bilinear_to_f32(
 
     std::vector<float> local_buf(3 * target_width * target_height);
 
-    for (int y = 0; y < target_height; ++y) {
-        const float src_y = (static_cast<float>(y) + 0.5f) * scale_y - 0.5f;
-        const int y0_floor = static_cast<int>(std::floor(src_y));
-        const int y0 = std::max(0, std::min(y0_floor,     src_size.height - 1));
-        const int y1 = std::max(0, std::min(y0_floor + 1, src_size.height - 1));
-        const float ly = src_y - y0_floor;
-
-        for (int x = 0; x < target_width; ++x) {
-            const float src_x = (static_cast<float>(x) + 0.5f) * scale_x - 0.5f;
-            const int x0_floor = static_cast<int>(std::floor(src_x));
-            const int x0 = std::max(0, std::min(x0_floor,     src_size.width - 1));
-            const int x1 = std::max(0, std::min(x0_floor + 1, src_size.width - 1));
-            const float lx = src_x - x0_floor;
-
-            const auto p00 = src.get_pixel(x0, y0);
-            const auto p01 = src.get_pixel(x1, y0);
-            const auto p10 = src.get_pixel(x0, y1);
-            const auto p11 = src.get_pixel(x1, y1);
-
-            const size_t idx_dst = 3 * (y * target_width + x);
-            for (int c = 0; c < 3; ++c) {
-                const float v00 = (static_cast<float>(p00[c]) / 255.0f - mean[c]) / std[c];
-                const float v01 = (static_cast<float>(p01[c]) / 255.0f - mean[c]) / std[c];
-                const float v10 = (static_cast<float>(p10[c]) / 255.0f - mean[c]) / std[c];
-                const float v11 = (static_cast<float>(p11[c]) / 255.0f - mean[c]) / std[c];
-
-                const float top = v00 + (v01 - v00) * lx;
-                const float bot = v10 + (v11 - v10) * lx;
-                local_buf[idx_dst + c] = top + (bot - top) * ly;
-            }
+    // normalized value of every u8 level, per channel (4 samples per output
+    // pixel would otherwise redo the divisions)
+    float lut[3][256];
+    for (int c = 0; c < 3; ++c) {
+        for (int v = 0; v < 256; ++v) {
+            lut[c][v] = (static_cast<float>(v) / 255.0f - mean[c]) / std[c];
         }
     }
+
+    preproc_parallel_for(target_height, target_width, [&](int y_begin, int y_end) {
+        for (int y = y_begin; y < y_end; ++y) {
+            const float src_y = (static_cast<float>(y) + 0.5f) * scale_y - 0.5f;
+            const int y0_floor = static_cast<int>(std::floor(src_y));
+            const int y0 = std::max(0, std::min(y0_floor,     src_size.height - 1));
+            const int y1 = std::max(0, std::min(y0_floor + 1, src_size.height - 1));
+            const float ly = src_y - y0_floor;
+
+            for (int x = 0; x < target_width; ++x) {
+                const float src_x = (static_cast<float>(x) + 0.5f) * scale_x - 0.5f;
+                const int x0_floor = static_cast<int>(std::floor(src_x));
+                const int x0 = std::max(0, std::min(x0_floor,     src_size.width - 1));
+                const int x1 = std::max(0, std::min(x0_floor + 1, src_size.width - 1));
+                const float lx = src_x - x0_floor;
+
+                const auto p00 = src.get_pixel(x0, y0);
+                const auto p01 = src.get_pixel(x1, y0);
+                const auto p10 = src.get_pixel(x0, y1);
+                const auto p11 = src.get_pixel(x1, y1);
+
+                const size_t idx_dst = 3 * (y * target_width + x);
+                for (int c = 0; c < 3; ++c) {
+                    const float v00 = lut[c][p00[c]];
+                    const float v01 = lut[c][p01[c]];
+                    const float v10 = lut[c][p10[c]];
+                    const float v11 = lut[c][p11[c]];
+
+                    const float top = v00 + (v01 - v00) * lx;
+                    const float bot = v10 + (v11 - v10) * lx;
+                    local_buf[idx_dst + c] = top + (bot - top) * ly;
+                }
+            }
+        }
+    });
     dst.cpy_buf(local_buf);
 }
 
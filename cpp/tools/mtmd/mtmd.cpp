@@ -1100,6 +1100,7 @@ struct mtmd_tokenizer {
                 img_u8.cpy_buf(bmp->get_ro_buf());
 
                 // preprocess image
+                mtmd_image_threads_scope threads_scope(ctx->n_threads);
                 mtmd_image_preproc_out tmp_preproc_out = ctx->image_preproc->preprocess(img_u8);
 
                 // move entries and grid dimensions to the "global" preproc_out
@@ -2109,6 +2110,7 @@ void mtmd_debug_preprocess_image(mtmd_context * ctx, const std::vector<uint8_t>
     img_u8.set_size({nx, ny}, false);
     img_u8.cpy_buf(rgb_values);
     LM_GGML_ASSERT(ctx->image_preproc != nullptr);
+    mtmd_image_threads_scope threads_scope(ctx->n_threads);
     mtmd_image_preproc_out preproc_out = ctx->image_preproc->preprocess(img_u8);
 
     clip_image_f32_batch batch_f32;
@@ -193,22 +193,17 @@ static std::unordered_map<std::string, uint8_t> unicode_utf8_to_byte_map() {
     return map;
 }
 
-static std::vector<std::string> unicode_byte_encoding_process(const std::vector<std::string> & bpe_words) {
-    std::vector<std::string> bpe_encoded_words;
-    for (const auto & word : bpe_words) {
-        std::string text_utf;
-        auto utf_word =  unicode_cpts_from_utf8(word);
-        for (size_t i = 0; i < utf_word.size(); ++i) {
-            text_utf += unicode_cpt_to_utf8(utf_word[i]);
+// byte -> GPT-2 byte-level representation, as a flat table for the per-byte hot loop
+static const std::vector<std::string> & unicode_byte_to_utf8_table() {
+    static const std::vector<std::string> table = [] {
+        const auto map = unicode_byte_to_utf8_map();
+        std::vector<std::string> result(256);
+        for (int ch = 0; ch < 256; ++ch) {
+            result[ch] = map.at(ch);
         }
-
-        std::string encoded_token;
-        for (char & c : text_utf) {
-            encoded_token += unicode_byte_to_utf8(c);
-        }
-        bpe_encoded_words.emplace_back(encoded_token);
-    }
-    return bpe_encoded_words;
+        return result;
+    }();
+    return table;
 }
 
 // GPT2 system regex:  's|'t|'re|'ve|'m|'ll|'d| ?\p{L}+| ?\p{N}+| ?[^\s\p{L}\p{N}]+|\s+(?!\S)|\s+
@@ -1047,6 +1042,41 @@ static std::vector<size_t> unicode_regex_split_custom_newlines(const std::string
     return bpe_offsets;
 }
 
+// regex: \p{N} | \p{N}{1,3} | \p{N}+
+// isolates runs of at most max_len number codepoints (0: unbounded); the text between runs is kept whole
+static std::vector<size_t> unicode_regex_split_custom_numbers(const std::string & text, const std::vector<size_t> & offsets, size_t max_len) {
+    std::vector<size_t> bpe_offsets;
+    bpe_offsets.reserve(offsets.size());
+
+    const auto cpts = unicode_cpts_from_utf8(text);
+
+    size_t start = 0;
+    for (auto offset : offsets) {
+        const size_t offset_ini = start;
+        const size_t offset_end = start + offset;
+        assert(offset_end <= cpts.size());
+        start = offset_end;
+
+        size_t pos = offset_ini;
+        while (pos < offset_end) {
+            const size_t run_start = pos;
+            if (unicode_cpt_flags_from_cpt(cpts[pos]).is_number) {
+                while (pos < offset_end && (max_len == 0 || pos - run_start < max_len) &&
+                       unicode_cpt_flags_from_cpt(cpts[pos]).is_number) {
+                    pos++;
+                }
+            } else {
+                while (pos < offset_end && !unicode_cpt_flags_from_cpt(cpts[pos]).is_number) {
+                    pos++;
+                }
+            }
+            bpe_offsets.push_back(pos - run_start);
+        }
+    }
+
+    return bpe_offsets;
+}
+
 static std::vector<size_t> unicode_regex_split_custom(const std::string & text, const std::string & regex_expr, const std::vector<size_t> & offsets) {
     std::vector<size_t> bpe_offsets;
 
@@ -1070,6 +1100,12 @@ static std::vector<size_t> unicode_regex_split_custom(const std::string & text,
         bpe_offsets = unicode_regex_split_custom_afmoe(text, offsets);
     } else if (regex_expr == "[^\\n]+|[\\n]+") {
         bpe_offsets = unicode_regex_split_custom_newlines(text, offsets);
+    } else if (regex_expr == "\\p{N}") {
+        bpe_offsets = unicode_regex_split_custom_numbers(text, offsets, 1);
+    } else if (regex_expr == "\\p{N}{1,3}") {
+        bpe_offsets = unicode_regex_split_custom_numbers(text, offsets, 3);
+    } else if (regex_expr == "\\p{N}+") {
+        bpe_offsets = unicode_regex_split_custom_numbers(text, offsets, 0);
     } else if (regex_expr == "\\d{1,3}(?=(?:\\d{3})*\\b)") {
         // tiny_aya digit grouping pattern from tokenizer.json:
         //   {"type": "Split", "pattern": {"Regex": "\\d{1,3}(?=(?:\\d{3})*\\b)"}, "behavior": "Isolated"}
@@ -1244,24 +1280,19 @@ std::vector<std::string> unicode_regex_split(const std::string & text, const std
         { unicode_cpt_flags::SYMBOL,      "\\\x24\\\x2B\x3C-\x3E\x5E\x60\\\x7C" }, // $+<=>^`|
     };
 
-    // compute collapsed codepoints only if needed by at least one regex
-    bool need_collapse = false;
-    for (const auto & regex_expr : regex_exprs) {
-        // search for unicode categories
-        for (const auto & ucat : k_ucat_enum) {
-            if (std::string::npos != regex_expr.find(ucat.first)) {
-                need_collapse = true;
-                break;
-            }
-        }
-    }
-
     const auto cpts = unicode_cpts_from_utf8(text);
 
     // generate a "collapsed" representation of the text, where all codepoints are replaced by a single byte
     // ref: https://github.com/ggml-org/llama.cpp/pull/6920#issuecomment-2081479935
+    // computed lazily: only std::regex fallbacks that use unicode categories need it
     std::string text_collapsed;
-    if (need_collapse) {
+    bool collapsed = false;
+    auto collapse_text = [&]() {
+        if (collapsed) {
+            return;
+        }
+        collapsed = true;
+
         // collapse all unicode categories
         text_collapsed.resize(cpts.size());
 
@@ -1284,7 +1315,7 @@ std::vector<std::string> unicode_regex_split(const std::string & text, const std
                 text_collapsed[i] = (char) 0xD0; // fallback
             }
         }
-    }
+    };
 
     std::vector<size_t> bpe_offsets = { cpts.size() };
 
@@ -1362,6 +1393,8 @@ std::vector<std::string> unicode_regex_split(const std::string & text, const std
                     regex_expr_collapsed += regex_expr[i];
                 }
 
+                collapse_text();
+
                 //printf("text_collapsed: %s\n", text_collapsed.c_str());
                 //printf("regex_expr_collapsed: %s\n", regex_expr_collapsed.c_str());
                 bpe_offsets = unicode_regex_split_stl(text_collapsed, regex_expr_collapsed, bpe_offsets);
@@ -1391,18 +1424,25 @@ std::vector<std::string> unicode_regex_split(const std::string & text, const std
     std::vector<std::string> bpe_words;
     bpe_words.reserve(bpe_offsets.size()); // reserve memory for the approximate size
 
+    const auto & byte_table = unicode_byte_to_utf8_table();
+
     size_t start = 0;
     for (size_t & offset : bpe_offsets) {
         bpe_words.emplace_back();
+        std::string & word = bpe_words.back();
         for (size_t i = start; i < start + offset; ++i) {
-            bpe_words.back() += unicode_cpt_to_utf8(cpts[i]);
+            const std::string utf8 = unicode_cpt_to_utf8(cpts[i]);
+            if (byte_encode) {
+                // GPT-2 byte-level encoding of each UTF-8 byte
+                for (const char c : utf8) {
+                    word += byte_table[(uint8_t) c];
+                }
+            } else {
+                word += utf8;
+            }
         }
         start += offset;
     }
 
-    if (byte_encode) {
-        return unicode_byte_encoding_process(bpe_words);
-    }
-
     return bpe_words;
 }
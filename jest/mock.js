@@ -214,6 +214,10 @@ if (!NativeModules.RNLlama) {
         chunk_pos_media: [],
       })),
     )
+    setGlobal(
+      'llamaTokenizeBatch',
+      jest.fn(async (_ctx, texts) => (texts || []).map(() => [])),
+    )
     setGlobal(
       'llamaDetokenize',
       jest.fn(async () => ''),
@@ -229,7 +233,21 @@ if (!NativeModules.RNLlama) {
     )
     setGlobal(
       'llamaEmbedding',
-      jest.fn(async () => ({ embedding: demoEmbedding })),
+      jest.fn(async (_ctx, _text, params) => ({
+        embedding: params?.typed_array
+          ? new Float32Array(demoEmbedding)
+          : demoEmbedding,
+      })),
+    )
+    setGlobal(
+      'llamaEmbeddingBatch',
+      jest.fn(async (_ctx, texts) => ({
+        embeddings: new Float32Array(
+          (texts || []).length * demoEmbedding.length,
+        ).fill(0.01).buffer,
+        n_embd: demoEmbedding.length,
+        count: (texts || []).length,
+      })),
     )
     setGlobal(
       'llamaRerank',
@@ -321,7 +339,9 @@ if (!NativeModules.RNLlama) {
     )
     setGlobal(
       'llamaDecodeAudioTokens',
-      jest.fn(async () => []),
+      jest.fn(async (_ctx, _tokens, typedArray) =>
+        typedArray ? new Float32Array(0) : [],
+      ),
     )
     setGlobal(
       'llamaGenerateAudioCodes',
@@ -347,7 +367,9 @@ if (!NativeModules.RNLlama) {
     )
     setGlobal(
       'llamaDecodeAudioEmbeddings',
-      jest.fn(async () => []),
+      jest.fn(async (_ctx, _embeddings, _dim, typedArray) =>
+        typedArray ? new Float32Array(0) : [],
+      ),
     )
     setGlobal('llamaGetAudioSampleRate', jest.fn(async () => 24000))
     setGlobal(
@@ -395,6 +417,22 @@ if (!NativeModules.RNLlama) {
         return { requestId: reqId }
       }),
     )
+    setGlobal(
+      'llamaQueueEmbeddingBatch',
+      jest.fn(async (_ctx, texts, _params, onResult) => {
+        const reqId = getNextRequestId()
+        if (typeof onResult === 'function') {
+          onResult({
+            embeddings: new Float32Array(
+              (texts || []).length * demoEmbedding.length,
+            ).fill(0.01).buffer,
+            n_embd: demoEmbedding.length,
+            count: (texts || []).length,
+          })
+        }
+        return { requestId: reqId }
+      }),
+    )
     setGlobal(
       'llamaQueueRerank',
       jest.fn(async (_ctx, _query, documents, _params, onResult) => {
@@ -416,6 +454,10 @@ if (!NativeModules.RNLlama) {
         requests: [],
       })),
     )
+    setGlobal(
+      'llamaFlushStateSaves',
+      jest.fn(async () => true),
+    )
     let statusSubscriberId = 0
     setGlobal(
       'llamaSubscribeParallelStatus',
@@ -520,6 +520,50 @@ test('Parallel APIs - multiple embeddings', async () => {
   await context.release()
 })
 
+test('Parallel APIs - embedding batch', async () => {
+  const context = await initLlama({
+    model: 'test.gguf',
+  })
+
+  const { requestId, promise } = await context.parallel.embeddingBatch([
+    'First text',
+    'Second text',
+    'Third text',
+  ])
+
+  expect(typeof requestId).toBe('number')
+
+  const result = await promise
+  expect(result.embeddings).toBeInstanceOf(Float32Array)
+  expect(result.count).toBe(3)
+  expect(result.n_embd).toBe(768)
+  expect(result.embeddings.length).toBe(3 * 768)
+
+  const direct = await context.embeddingBatch(['Only text'])
+  expect(direct.count).toBe(1)
+  expect(direct.embeddings.length).toBe(768)
+
+  await context.release()
+})
+
+test('Typed array results', async () => {
+  const context = await initLlama({
+    model: 'test.gguf',
+  })
+
+  const { embedding } = await context.embeddingTyped('Hello')
+  expect(embedding).toBeInstanceOf(Float32Array)
+  expect(embedding.length).toBe(768)
+
+  const plain = await context.embedding('Hello')
+  expect(Array.isArray(plain.embedding)).toBe(true)
+
+  const audio = await context.decodeAudioTokensTyped(new Int32Array([1, 2]))
+  expect(audio).toBeInstanceOf(Float32Array)
+
+  await context.release()
+})
+
 test('Parallel APIs - rerank', async () => {
   const context = await initLlama({
     model: 'test.gguf',
@@ -570,6 +614,14 @@ test('Parallel APIs - configure and disable', async () => {
   // Reconfigure with different settings
   await context.parallel.configure({ n_parallel: 6 })
 
+  // Fair prefill scheduling with a decode-latency budget
+  await context.parallel.configure({
+    n_parallel: 4,
+    prefill_policy: 'fair',
+    prefill_chunk: 64,
+    prefill_decode_budget: 128,
+  })
+
   // Disable parallel mode
   await context.parallel.disable()
 
@@ -10,6 +10,8 @@ import type {
   NativeCompletionResult,
   NativeTokenizeResult,
   NativeEmbeddingResult,
+  NativeEmbeddingTypedResult,
+  NativeEmbeddingBatchResult,
   NativeSessionLoadResult,
   NativeEmbeddingParams,
   NativeRerankParams,
@@ -26,6 +28,7 @@ import type {
   NativeSpeculativeType,
   ParallelStatus,
   ParallelRequestStatus,
+  ParallelModeConfig,
 } from './types'
 import { BUILD_NUMBER, BUILD_COMMIT } from './version'
 import type { SpeakerPayload } from './tts-voices'
@@ -58,6 +61,8 @@ export type {
   NativeCompletionResult,
   NativeTokenizeResult,
   NativeEmbeddingResult,
+  NativeEmbeddingTypedResult,
+  NativeEmbeddingBatchResult,
   NativeSessionLoadResult,
   NativeEmbeddingParams,
   NativeRerankParams,
@@ -73,6 +78,7 @@ export type {
   NativeSpeculativeType,
   ParallelStatus,
   ParallelRequestStatus,
+  ParallelModeConfig,
 }
 
 export const RNLLAMA_MTMD_DEFAULT_MEDIA_MARKER = '<__media__>'
@@ -104,9 +110,11 @@ const jsiBindingKeys = [
   'llamaLoadSession',
   'llamaSaveSession',
   'llamaTokenize',
+  'llamaTokenizeBatch',
   'llamaDetokenize',
   'llamaGetFormattedChat',
   'llamaEmbedding',
+  'llamaEmbeddingBatch',
   'llamaRerank',
   'llamaBench',
   'llamaToggleNativeLog',
@@ -137,8 +145,10 @@ const jsiBindingKeys = [
   'llamaQueueCompletion',
   'llamaCancelRequest',
   'llamaQueueEmbedding',
+  'llamaQueueEmbeddingBatch',
   'llamaQueueRerank',
   'llamaGetParallelStatus',
+  'llamaFlushStateSaves',
   'llamaSubscribeParallelStatus',
   'llamaUnsubscribeParallelStatus',
 ] as const
@@ -208,9 +218,23 @@ export type TokenData = {
   reasoning_content?: string
   tool_calls?: Array<ToolCall>
   accumulated_text?: string
+  // Change in content / reasoning_content since the previous token
+  content_delta?: string
+  reasoning_content_delta?: string
+  // Set when the parser revised earlier output: the delta is then the whole
+  // field and replaces the accumulated value instead of extending it
+  content_replaced?: boolean
+  reasoning_content_replaced?: boolean
   requestId?: number
 }
 
+export type AudioChunkData = {
+  /** PCM samples at the vocoder sample rate, continuing the previous chunk */
+  audio: Float32Array
+  /** True for the last chunk of the completion */
+  is_final: boolean
+}
+
 export type ContextParams = Omit<
   NativeContextParams,
   'flash_attn_type' | 'cache_type_k' | 'cache_type_v' | 'pooling_type'
@@ -251,6 +275,23 @@ const validCacheTypes = [
 
 export type EmbeddingParams = NativeEmbeddingParams
 
+export type EmbeddingBatchResult = {
+  /**
+   * Row i (n_embd values) is the embedding of input i
+   */
+  embeddings: Float32Array
+  n_embd: number
+  count: number
+}
+
+const toEmbeddingBatchResult = (
+  result: NativeEmbeddingBatchResult,
+): EmbeddingBatchResult => ({
+  embeddings: new Float32Array(result.embeddings),
+  n_embd: result.n_embd,
+  count: result.count,
+})
+
 export type RerankParams = {
   normalize?: number
 }
@@ -284,6 +325,13 @@ export type CompletionBaseParams = {
   response_format?: CompletionResponseFormat
   media_paths?: string | string[]
   add_generation_prompt?: boolean
+  /**
+   * TTS only: receive PCM chunks decoded while the audio codes are generated,
+   * instead of decoding everything after the completion.
+   * Supported by `completion()` for codec-code and hidden-state TTS models,
+   * and by `parallel.completion()` for codec-code TTS models.
+   */
+  onAudioChunk?: (chunk: AudioChunkData) => void
   /*
    * Timestamp in seconds since epoch to apply to chat template's strftime_now
    */
@@ -427,8 +475,9 @@ export class LlamaContext {
       stop: () => Promise<void>
     }> => {
       const { llamaQueueCompletion, llamaCancelRequest } = getJsi()
+      const { onAudioChunk, ...completionParams } = params
       const nativeParams: NativeParallelCompletionRequestParams = {
-        ...params,
+        ...completionParams,
         prompt: params.prompt || '',
         emit_partial_completion: true, // Always emit for queued requests
       }
@@ -532,6 +581,7 @@ export class LlamaContext {
                 resolveResult(result)
               }
             },
+            onAudioChunk,
           )
 
           resolveOuter({
@@ -586,12 +636,60 @@ export class LlamaContext {
         }
       }),
 
+    /**
+     * Queue a batch of texts for embedding (non-blocking). The texts are
+     * spread across the parallel slots.
+     * @param texts Texts to embed
+     * @param params Optional embedding parameters
+     * @returns Promise resolving to object with requestId and promise (resolves to all embeddings, rejects if the request is cancelled)
+     */
+    embeddingBatch: async (
+      texts: string[],
+      params?: EmbeddingParams,
+    ): Promise<{
+      requestId: number
+      promise: Promise<EmbeddingBatchResult>
+    }> =>
+      new Promise(async (resolveOuter, rejectOuter) => {
+        const { llamaQueueEmbeddingBatch } = getJsi()
+        try {
+          let resolveResult: (value: EmbeddingBatchResult) => void
+          let rejectResult: (reason?: any) => void
+          const resultPromise = new Promise<EmbeddingBatchResult>(
+            (res, rej) => {
+              resolveResult = res
+              rejectResult = rej
+            },
+          )
+
+          const { requestId } = await llamaQueueEmbeddingBatch(
+            this.id,
+            texts,
+            params || {},
+            (result) => {
+              if (result.incomplete) {
+                rejectResult(new Error('Embedding batch request cancelled'))
+              } else {
+                resolveResult(toEmbeddingBatchResult(result))
+              }
+            },
+          )
+
+          resolveOuter({
+            requestId,
+            promise: resultPromise,
+          })
+        } catch (e) {
+          rejectOuter(e)
+        }
+      }),
+
     /**
      * Queue rerank requests for parallel processing (non-blocking)
      * @param query The query text to rank documents against
      * @param documents Array of document texts to rank
      * @param params Optional reranking parameters
-     * @returns Promise resolving to object with requestId and promise (resolves to rerank results)
+     * @returns Promise resolving to object with requestId and promise (resolves to rerank results, rejects if the request is cancelled)
      */
     rerank: async (
       query: string,
@@ -605,8 +703,10 @@ export class LlamaContext {
         const { llamaQueueRerank } = getJsi()
         try {
           let resolveResult: (value: RerankResult[]) => void
-          const resultPromise = new Promise<RerankResult[]>((res) => {
+          let rejectResult: (reason?: any) => void
+          const resultPromise = new Promise<RerankResult[]>((res, rej) => {
             resolveResult = res
+            rejectResult = rej
           })
 
           const { requestId } = await llamaQueueRerank(
@@ -614,7 +714,11 @@ export class LlamaContext {
             query,
             documents,
             params || {},
-            (results) => {
+            (results, incomplete) => {
+              if (incomplete) {
+                rejectResult(new Error('Rerank request cancelled'))
+                return
+              }
               const sortedResults = results
                 .map((result: NativeRerankResult) => ({
                   ...result,
@@ -634,13 +738,13 @@ export class LlamaContext {
         }
       }),
 
-    enable: (config?: { n_parallel?: number; n_batch?: number }) =>
+    enable: (config?: ParallelModeConfig) =>
       getJsi().llamaEnableParallelMode(this.id, { enabled: true, ...config }),
 
     disable: () =>
       getJsi().llamaEnableParallelMode(this.id, { enabled: false }),
 
-    configure: (config: { n_parallel?: number; n_batch?: number }) =>
+    configure: (config: ParallelModeConfig) =>
       getJsi().llamaEnableParallelMode(this.id, { enabled: true, ...config }),
 
     /**
@@ -652,6 +756,17 @@ export class LlamaContext {
       return llamaGetParallelStatus(this.id)
     },
 
+    /**
+     * Wait until every state file queued so far by `save_state_path` or
+     * `save_prompt_state_path` is durably on disk. Slot states are written in
+     * the background, so a completion can finish before its file lands.
+     * @returns Promise resolving to false if any save failed since the last flush
+     */
+    flushStateSaves: async (): Promise<boolean> => {
+      const { llamaFlushStateSaves } = getJsi()
+      return llamaFlushStateSaves(this.id)
+    },
+
     /**
      * Subscribe to parallel processing status changes
      * @param callback Called whenever parallel status changes
@@ -840,10 +955,11 @@ export class LlamaContext {
     params: CompletionParams & { speaker?: LlamaSpeaker },
     callback?: (data: TokenData) => void,
   ): Promise<NativeCompletionResult> {
+    const { onAudioChunk, ...completionParams } = params
     const nativeParams: NativeCompletionRequestParams & {
       speakerId?: number
     } = {
-      ...params,
+      ...completionParams,
       prompt: params.prompt || '',
       emit_partial_completion: !!callback,
       ...(params.speaker !== undefined
@@ -928,7 +1044,7 @@ export class LlamaContext {
       throw new Error('Prompt is required')
 
     const { llamaCompletion } = getJsi()
-    return llamaCompletion(this.id, nativeParams, callback)
+    return llamaCompletion(this.id, nativeParams, callback, onAudioChunk)
   }
 
   stopCompletion(): Promise<void> {
@@ -948,6 +1064,15 @@ export class LlamaContext {
     return llamaTokenize(this.id, text, mediaPaths)
   }
 
+  /**
+   * Tokenize several texts in one call, spread across the context's threads.
+   * Tokens match calling tokenize() on each text.
+   */
+  tokenizeBatch(texts: string[]): Promise<number[][]> {
+    const { llamaTokenizeBatch } = getJsi()
+    return llamaTokenizeBatch(this.id, texts)
+  }
+
   detokenize(tokens: number[]): Promise<string> {
     const { llamaDetokenize } = getJsi()
     return llamaDetokenize(this.id, tokens)
@@ -958,7 +1083,38 @@ export class LlamaContext {
     params?: EmbeddingParams,
   ): Promise<NativeEmbeddingResult> {
     const { llamaEmbedding } = getJsi()
-    return llamaEmbedding(this.id, text, params || {})
+    return llamaEmbedding(this.id, text, params || {}) as Promise<
+      NativeEmbeddingResult
+    >
+  }
+
+  /**
+   * Same as embedding(), but the vector is a Float32Array that wraps the
+   * native buffer instead of a number[] built element by element.
+   */
+  embeddingTyped(
+    text: string,
+    params?: EmbeddingParams,
+  ): Promise<NativeEmbeddingTypedResult> {
+    const { llamaEmbedding } = getJsi()
+    return llamaEmbedding(this.id, text, {
+      ...params,
+      typed_array: true,
+    }) as Promise<NativeEmbeddingTypedResult>
+  }
+
+  /**
+   * Embed several texts in one call. Inputs are packed into shared batches,
+   * so this is much faster than calling embedding() per text.
+   */
+  async embeddingBatch(
+    texts: string[],
+    params?: EmbeddingParams,
+  ): Promise<EmbeddingBatchResult> {
+    const { llamaEmbeddingBatch } = getJsi()
+    return toEmbeddingBatchResult(
+      await llamaEmbeddingBatch(this.id, texts, params || {}),
+    )
   }
 
   async rerank(
@@ -1036,25 +1192,38 @@ export class LlamaContext {
    * @param image_max_tokens - Maximum number of tokens for image input (for dynamic resolution models).
    *                           Lower values reduce memory usage and improve speed for high-resolution images.
    *                           Recommended: 256-512 for faster inference, up to 4096 for maximum detail.
+   * @param media_cache_mb - Memory budget for cached image/audio embeddings shared by all slots (default: 32, 0 disables)
+   * @param media_cache_dir - Directory for embeddings evicted from memory, reused across sessions (default: none)
+   * @param media_cache_disk_mb - Disk budget for media_cache_dir (default: 256)
    */
   async initMultimodal({
     path,
     use_gpu: useGpu,
     image_min_tokens: imageMinTokens,
     image_max_tokens: imageMaxTokens,
+    media_cache_mb: mediaCacheMb,
+    media_cache_dir: mediaCacheDir,
+    media_cache_disk_mb: mediaCacheDiskMb,
   }: {
     path: string
     use_gpu?: boolean
     image_min_tokens?: number
     image_max_tokens?: number
+    media_cache_mb?: number
+    media_cache_dir?: string
+    media_cache_disk_mb?: number
   }): Promise<boolean> {
     const { llamaInitMultimodal } = getJsi()
     if (path.startsWith('file://')) path = path.slice(7)
+    if (mediaCacheDir?.startsWith('file://')) mediaCacheDir = mediaCacheDir.slice(7)
     return llamaInitMultimodal(this.id, {
       path,
       use_gpu: useGpu ?? true,
       image_min_tokens: imageMinTokens,
       image_max_tokens: imageMaxTokens,
+      media_cache_mb: mediaCacheMb,
+      media_cache_dir: mediaCacheDir,
+      media_cache_disk_mb: mediaCacheDiskMb,
     })
   }
 
@@ -1220,9 +1389,22 @@ export class LlamaContext {
     return llamaGetFormattedAudioCompletion(this.id, speakerStr, inputText)
   }
 
-  async decodeAudioTokens(tokens: number[]): Promise<Array<number>> {
+  async decodeAudioTokens(
+    tokens: number[] | Int32Array,
+  ): Promise<Array<number>> {
+    const { llamaDecodeAudioTokens } = getJsi()
+    return (await llamaDecodeAudioTokens(this.id, tokens)) as Array<number>
+  }
+
+  /**
+   * Same as decodeAudioTokens(), but returns the PCM samples as a
+   * Float32Array backed by native memory. Prefer this for long audio.
+   */
+  async decodeAudioTokensTyped(
+    tokens: number[] | Int32Array,
+  ): Promise<Float32Array> {
     const { llamaDecodeAudioTokens } = getJsi()
-    return await llamaDecodeAudioTokens(this.id, tokens)
+    return (await llamaDecodeAudioTokens(this.id, tokens, true)) as Float32Array
   }
 
   /**
@@ -1290,11 +1472,31 @@ export class LlamaContext {
   }
 
   async decodeAudioEmbeddings(
-    embeddings: number[],
+    embeddings: number[] | Float32Array,
     embeddingDim: number,
   ): Promise<Array<number>> {
     const { llamaDecodeAudioEmbeddings } = getJsi()
-    return await llamaDecodeAudioEmbeddings(this.id, embeddings, embeddingDim)
+    return (await llamaDecodeAudioEmbeddings(
+      this.id,
+      embeddings,
+      embeddingDim,
+    )) as Array<number>
+  }
+
+  /**
+   * Same as decodeAudioEmbeddings(), returning a native-backed Float32Array.
+   */
+  async decodeAudioEmbeddingsTyped(
+    embeddings: number[] | Float32Array,
+    embeddingDim: number,
+  ): Promise<Float32Array> {
+    const { llamaDecodeAudioEmbeddings } = getJsi()
+    return (await llamaDecodeAudioEmbeddings(
+      this.id,
+      embeddings,
+      embeddingDim,
+      true,
+    )) as Float32Array
   }
 
   async getAudioSampleRate(): Promise<number> {
@@ -6,10 +6,13 @@ import type {
   NativeCompletionResult,
   NativeTokenizeResult,
   NativeEmbeddingResult,
+  NativeEmbeddingTypedResult,
+  NativeEmbeddingBatchResult,
   NativeSessionLoadResult,
   NativeRerankResult,
   JinjaFormattedChatResult,
   ParallelStatus,
+  ParallelModeConfig,
 } from './types'
 
 declare global {
@@ -36,6 +39,10 @@ declare global {
     text: string,
     mediaPaths?: string[],
   ) => Promise<NativeTokenizeResult>
+  var llamaTokenizeBatch: (
+    contextId: number,
+    texts: string[],
+  ) => Promise<number[][]>
   var llamaDetokenize: (contextId: number, tokens: number[]) => Promise<string>
   var llamaGetFormattedChat: (
     contextId: number,
@@ -47,7 +54,12 @@ declare global {
     contextId: number,
     text: string,
     params: object,
-  ) => Promise<NativeEmbeddingResult>
+  ) => Promise<NativeEmbeddingResult | NativeEmbeddingTypedResult>
+  var llamaEmbeddingBatch: (
+    contextId: number,
+    texts: string[],
+    params: object,
+  ) => Promise<NativeEmbeddingBatchResult>
   var llamaRerank: (
     contextId: number,
     query: string,
@@ -70,6 +82,7 @@ declare global {
     contextId: number,
     params: NativeCompletionParams,
     onToken?: (token: any) => void,
+    onAudioChunk?: (chunk: { audio: Float32Array; is_final: boolean }) => void,
   ) => Promise<NativeCompletionResult>
   var llamaStopCompletion: (contextId: number) => Promise<void>
   var llamaApplyLoraAdapters: (
@@ -87,6 +100,9 @@ declare global {
       use_gpu?: boolean
       image_min_tokens?: number
       image_max_tokens?: number
+      media_cache_mb?: number
+      media_cache_dir?: string
+      media_cache_disk_mb?: number
     },
   ) => Promise<boolean>
   var llamaIsMultimodalEnabled: (contextId: number) => Promise<boolean>
@@ -153,8 +169,9 @@ declare global {
   }>
   var llamaDecodeAudioTokens: (
     contextId: number,
-    tokens: number[],
-  ) => Promise<number[]>
+    tokens: number[] | Int32Array,
+    typedArray?: boolean,
+  ) => Promise<number[] | Float32Array>
   var llamaGenerateAudioCodes: (
     contextId: number,
     optsJson: string,
@@ -177,9 +194,10 @@ declare global {
   var llamaReleaseSpeaker: (contextId: number, speakerId: number) => Promise<void>
   var llamaDecodeAudioEmbeddings: (
     contextId: number,
-    embeddings: number[],
+    embeddings: number[] | Float32Array,
     embeddingDim: number,
-  ) => Promise<number[]>
+    typedArray?: boolean,
+  ) => Promise<number[] | Float32Array>
   var llamaGetAudioSampleRate: (contextId: number) => Promise<number>
   var llamaReleaseVocoder: (contextId: number) => Promise<void>
   var llamaClearCache: (contextId: number, clearData: boolean) => Promise<void>
@@ -187,13 +205,14 @@ declare global {
   // Parallel decoding
   var llamaEnableParallelMode: (
     contextId: number,
-    params: { enabled: boolean; n_parallel?: number; n_batch?: number },
+    params: { enabled: boolean } & ParallelModeConfig,
   ) => Promise<boolean>
   var llamaQueueCompletion: (
     contextId: number,
     params: NativeParallelCompletionParams,
     onToken: (token: any, requestId: number) => void,
     onComplete: (result: any) => void,
+    onAudioChunk?: (chunk: { audio: Float32Array; is_final: boolean }) => void,
   ) => Promise<{ requestId: number }>
   var llamaCancelRequest: (
     contextId: number,
@@ -205,14 +224,21 @@ declare global {
     params: object,
     onResult: (result: number[]) => void,
   ) => Promise<{ requestId: number }>
+  var llamaQueueEmbeddingBatch: (
+    contextId: number,
+    texts: string[],
+    params: object,
+    onResult: (result: NativeEmbeddingBatchResult) => void,
+  ) => Promise<{ requestId: number }>
   var llamaQueueRerank: (
     contextId: number,
     query: string,
     documents: string[],
     params: object,
-    onResult: (result: NativeRerankResult[]) => void,
+    onResult: (result: NativeRerankResult[], incomplete: boolean) => void,
   ) => Promise<{ requestId: number }>
   var llamaGetParallelStatus: (contextId: number) => Promise<ParallelStatus>
+  var llamaFlushStateSaves: (contextId: number) => Promise<boolean>
   var llamaSubscribeParallelStatus: (
     contextId: number,
     onStatus: (status: ParallelStatus) => void,
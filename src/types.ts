@@ -133,6 +133,15 @@ export type NativeContextParams = {
    */
   no_extra_bufts?: boolean
 
+  /**
+   * Directory for a sidecar cache of CPU-repacked weights (e.g. the app cache dir).
+   * The first load writes the repacked tensors there; later loads of the same
+   * model file on the same CPU mmap them instead of repacking again.
+   * A model file replaced at the same path is detected and its cache rebuilt.
+   * The cache can be as large as the CPU-resident weights. Default: disabled
+   */
+  repack_cache_dir?: string
+
   /**
    * Single LoRA adapter path
    */
@@ -199,6 +208,23 @@ export type NativeContextParams = {
    */
   state_cache_max_checkpoints?: number
 
+  /**
+   * Part of the state cache budget (MiB) kept uncompressed; older snapshots
+   * are LZ-compressed in memory. 0 = half the budget. Default 0.
+   */
+  state_cache_hot_mb?: number
+
+  /**
+   * Directory that snapshots past the memory budget spill to instead of being
+   * dropped. Unset = no disk tier. Spill files never outlive the context.
+   */
+  state_cache_dir?: string
+
+  /**
+   * Disk budget (MiB) for `state_cache_dir`. Default 512.
+   */
+  state_cache_disk_mb?: number
+
   // Embedding params
   embedding?: boolean
   embd_normalize?: number
@@ -224,6 +250,12 @@ export type NativeCompletionParams = {
    * Lazy grammar sampling, trigger by grammar_triggers. Default: false
    */
   grammar_lazy?: boolean
+  /**
+   * Jump-forward decoding: when the grammar allows only one continuation
+   * (JSON keys, punctuation, tool-call wrappers), emit those tokens at once
+   * and decode them in a single batch instead of sampling each. Default: false
+   */
+  jump_forward?: boolean
   /**
    * Enable thinking if jinja is enabled. Default: true
    */
@@ -401,6 +433,35 @@ export type NativeCompletionParams = {
    */
   embedding?: boolean
 
+  /**
+   * Streaming TTS decode (used with `onAudioChunk`): codec frames in the first
+   * PCM chunk, kept small for time-to-first-audio. Default: `4`
+   */
+  audio_first_chunk_frames?: number
+  /**
+   * Streaming TTS decode: codec frames per following PCM chunk. Default: `16`
+   */
+  audio_chunk_frames?: number
+  /**
+   * Streaming TTS decode: already emitted frames re-decoded as left context
+   * of each chunk. Default: `16`
+   */
+  audio_context_frames?: number
+  /**
+   * Streaming TTS decode: newest frames held back as right context until the
+   * next chunk (or the end of generation). Default: `2`
+   */
+  audio_lookahead_frames?: number
+  /**
+   * Streaming TTS decode: samples cross-faded across chunk boundaries. Default: `256`
+   */
+  audio_crossfade_samples?: number
+  /**
+   * Streaming TTS decode: codec graph shape bucket in frames while a stream is
+   * open (`0` = exact shapes, `-1` = next power of two). Default: `16`
+   */
+  audio_graph_bucket_frames?: number
+
   emit_partial_completion: boolean
 }
 
@@ -421,6 +482,9 @@ export type NativeParallelCompletionParams = NativeCompletionParams & {
    * File path to save state to after completion.
    * The state will be saved to this file path when the completion finishes.
    * You can then pass this path to `load_state_path` in a subsequent request to resume.
+   * The file is written in the background (temp file, fsync, rename); requests on
+   * this context that load it wait for the write, other readers should await
+   * `context.parallel.flushStateSaves()` first.
    * For multimodal conversations a `<path>.meta` sidecar file is written next
    * to the state file (media identity); keep the two files together.
    * Example: `'/path/to/state.bin'` or `'file:///path/to/state.bin'`
@@ -449,6 +513,27 @@ export type NativeParallelCompletionParams = NativeCompletionParams & {
    * Example: `512` to save only the last 512 tokens
    */
   save_state_size?: number
+
+  /**
+   * Without `load_state_path`, resume from the saved state file (saved or
+   * loaded earlier on this context) holding the longest prefix of the prompt,
+   * when it covers more than the slot already has cached. Text prompts only.
+   * Defaults to false; the result's `state_reused` reports whether it happened.
+   */
+  reuse_state?: boolean
+
+  /**
+   * Scheduling priority (default 0). Higher-priority requests leave the queue
+   * first and, with the `'fair'` prefill policy, are prefilled first.
+   */
+  priority?: number
+
+  /**
+   * LoRA adapters for this request only (parallel mode), applied on top of the
+   * context-wide ones. Each adapter is loaded once and stays resident, and
+   * requests with different adapters still decode in the same batch.
+   */
+  lora_list?: Array<{ path: string; scaled?: number }>
 }
 
 export type NativeCompletionTokenProbItem = {
@@ -511,6 +596,11 @@ export type NativeCompletionResult = {
   stopping_word: string
   context_full: boolean
   interrupted: boolean
+  /**
+   * Parallel mode: whether KV state was restored from an indexed state file
+   * (requested with `reuse_state`)
+   */
+  state_reused?: boolean
   tokens_cached: number
   timings: NativeCompletionResultTimings
 
@@ -544,6 +634,26 @@ export type NativeEmbeddingResult = {
   embedding: Array<number>
 }
 
+export type NativeEmbeddingTypedResult = {
+  /**
+   * Backed by native memory, no per-element copy into JS
+   */
+  embedding: Float32Array
+}
+
+export type NativeEmbeddingBatchResult = {
+  /**
+   * Float32 data, n_embd values per input, in input order
+   */
+  embeddings: ArrayBuffer
+  n_embd: number
+  count: number
+  /**
+   * Set when the request was cancelled; unfinished rows are zero
+   */
+  incomplete?: boolean
+}
+
 export type NativeLlamaContext = {
   contextId: number
   model: {
@@ -656,6 +766,26 @@ export type NativeBackendDeviceInfo = {
   metadata?: Record<string, any>
 }
 
+export type ParallelModeConfig = {
+  n_parallel?: number
+  n_batch?: number
+  /**
+   * How prompt tokens are spread over slots that are still prefilling:
+   * - `'fifo'` (default): slot order, each slot fills the batch as far as it can
+   * - `'fair'`: priority order, round-robin among equal priorities, each slot
+   *   capped at `prefill_chunk` tokens per step before leftover room is shared
+   */
+  prefill_policy?: 'fifo' | 'fair'
+  /** Max prompt tokens per slot per step (0 = an even share of the batch under `'fair'`) */
+  prefill_chunk?: number
+  /**
+   * Max prompt tokens per step while any slot is generating (0 = no limit).
+   * Bounds how long a long prompt can delay the next generated token.
+   * Embedding and rerank prompts are never split.
+   */
+  prefill_decode_budget?: number
+}
+
 export type ParallelRequestStatus = {
   request_id: number
   type: 'completion' | 'embedding' | 'rerank'
@@ -665,11 +795,27 @@ export type ParallelRequestStatus = {
   prompt_ms: number
   generation_ms: number
   tokens_per_second: number
+  /** Slot serving the request (-1 while queued) */
+  slot_id: number
+  /** Why the slot was chosen: 'prefix' (longest reusable cached prefix) or 'lru'; empty while queued */
+  slot_selection: 'prefix' | 'lru' | ''
+  /** Prompt tokens served from the slot's cache */
+  cache_n: number
 }
 
 export type ParallelStatus = {
   n_parallel: number
   active_slots: number
   queued_requests: number
+  /** Prompts seeded from another slot's cached prefix (requires kv_unified) */
+  shared_prefix_hits: number
+  /** Prefill tokens saved by cross-slot prefix sharing */
+  shared_prefix_tokens: number
+  /** Decode/sample steps run by the processing loop */
+  n_steps: number
+  /** Total time spent in llama_decode (ms) */
+  decode_ms: number
+  /** Total time spent sampling and running token callbacks (ms) */
+  sample_ms: number
   requests: ParallelRequestStatus[]
 }
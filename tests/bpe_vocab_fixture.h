@@ -0,0 +1,97 @@
+#ifndef RN_TESTS_BPE_VOCAB_FIXTURE_H
+#define RN_TESTS_BPE_VOCAB_FIXTURE_H
+
+// Vocab-only GGUF fixture shared by the tokenizer, grammar and chat tests:
+// a byte-level BPE trained on a few texts, written as a "gpt2" tokenizer
+// that llama_model_load_from_file can load with vocab_only.
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gguf.h"
+#include "llama.h"
+#include "unicode.h"
+
+inline std::vector<llama_token> tokenize_vocab(const llama_vocab * vocab, const std::string & text) {
+    std::vector<llama_token> tokens(text.size() + 8);
+    const int n = llama_tokenize(vocab, text.c_str(), (int32_t) text.size(), tokens.data(), (int32_t) tokens.size(), false, false);
+    tokens.resize(n < 0 ? 0 : n);
+    return tokens;
+}
+
+// Train a small byte-level BPE on the texts (most frequent pair first);
+// fills vocab_tokens with the 256 byte tokens plus one token per merge
+inline std::vector<std::string> train_bpe_vocab(const std::vector<std::string> & texts, int n_merges, std::vector<std::string> & vocab_tokens) {
+    std::string corpus;
+    for (const auto & text : texts) corpus += text + " ";
+    const std::string gpt2_expr = "'s|'t|'re|'ve|'m|'ll|'d| ?\\p{L}+| ?\\p{N}+| ?[^\\s\\p{L}\\p{N}]+|\\s+(?!\\S)";
+    std::vector<std::vector<std::string>> words;
+    for (const auto & word : unicode_regex_split(corpus, { gpt2_expr }, true)) {
+        std::vector<std::string> syms;
+        for (size_t off = 0; off < word.size(); ) {
+            const size_t len = std::min(word.size() - off, (size_t) unicode_len_utf8(word[off]));
+            syms.push_back(word.substr(off, len));
+            off += len;
+        }
+        words.push_back(syms);
+    }
+    vocab_tokens.clear();
+    for (int b = 0; b < 256; b++) vocab_tokens.push_back(unicode_byte_to_utf8((uint8_t) b));
+    std::vector<std::string> merges;
+    for (int m = 0; m < n_merges; m++) {
+        std::map<std::pair<std::string, std::string>, int> counts;
+        for (const auto & syms : words) {
+            for (size_t i = 1; i < syms.size(); i++) counts[{ syms[i - 1], syms[i] }]++;
+        }
+        auto best = counts.end();
+        for (auto it = counts.begin(); it != counts.end(); ++it) {
+            if (best == counts.end() || it->second > best->second) best = it;
+        }
+        if (best == counts.end()) break;
+        const auto pair = best->first;
+        merges.push_back(pair.first + " " + pair.second);
+        vocab_tokens.push_back(pair.first + pair.second);
+        for (auto & syms : words) {
+            std::vector<std::string> merged;
+            for (size_t i = 0; i < syms.size(); i++) {
+                if (i + 1 < syms.size() && syms[i] == pair.first && syms[i + 1] == pair.second) {
+                    merged.push_back(pair.first + pair.second);
+                    i++;
+                } else {
+                    merged.push_back(syms[i]);
+                }
+            }
+            syms = merged;
+        }
+    }
+    return merges;
+}
+
+inline bool write_bpe_vocab(const std::string & path, const char * pre, const std::vector<std::string> & vocab_tokens,
+                           const std::vector<int32_t> & token_types, const std::vector<std::string> & merges,
+                           int32_t bos_eos_id = -1) {
+    std::vector<const char *> token_ptrs, merge_ptrs;
+    for (const auto & t : vocab_tokens) token_ptrs.push_back(t.c_str());
+    for (const auto & m : merges) merge_ptrs.push_back(m.c_str());
+    lm_gguf_context * gctx = lm_gguf_init_empty();
+    lm_gguf_set_val_str(gctx, "general.architecture", "llama");
+    lm_gguf_set_val_str(gctx, "tokenizer.ggml.model", "gpt2");
+    lm_gguf_set_val_str(gctx, "tokenizer.ggml.pre", pre);
+    lm_gguf_set_arr_str(gctx, "tokenizer.ggml.tokens", token_ptrs.data(), token_ptrs.size());
+    lm_gguf_set_arr_data(gctx, "tokenizer.ggml.token_type", LM_GGUF_TYPE_INT32, token_types.data(), token_types.size());
+    lm_gguf_set_arr_str(gctx, "tokenizer.ggml.merges", merge_ptrs.data(), merge_ptrs.size());
+    if (bos_eos_id >= 0) {
+        lm_gguf_set_val_u32(gctx, "tokenizer.ggml.bos_token_id", (uint32_t) bos_eos_id);
+        lm_gguf_set_val_u32(gctx, "tokenizer.ggml.eos_token_id", (uint32_t) bos_eos_id);
+        lm_gguf_set_val_bool(gctx, "tokenizer.ggml.add_bos_token", true);
+        lm_gguf_set_val_bool(gctx, "tokenizer.ggml.add_eos_token", true);
+    }
+    const bool written = lm_gguf_write_to_file(gctx, path.c_str(), false);
+    lm_gguf_free(gctx);
+    return written;
+}
+
+#endif // RN_TESTS_BPE_VOCAB_FIXTURE_H
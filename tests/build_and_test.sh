@@ -50,6 +50,22 @@ if [ ! -f "chat_parse_utf8_test" ]; then
 fi
 echo "✓ chat_parse_utf8_test built successfully"
 
+echo "Building tokenizer_test..."
+make tokenizer_test -j4
+if [ ! -f "tokenizer_test" ]; then
+    echo "Error: Failed to build tokenizer_test"
+    exit 1
+fi
+echo "✓ tokenizer_test built successfully"
+
+echo "Building tts_codec_test..."
+make tts_codec_test -j4
+if [ ! -f "tts_codec_test" ]; then
+    echo "Error: Failed to build tts_codec_test"
+    exit 1
+fi
+echo "✓ tts_codec_test built successfully"
+
 echo ""
 echo "=== Build Successful ==="
 echo ""
@@ -57,13 +73,17 @@ echo "Built executables:"
 echo "  - rnllama_tests (basic integration tests)"
 echo "  - parallel_decoding_test (parallel decoding tests)"
 echo "  - chat_parse_utf8_test (chat parse UTF-8 robustness tests)"
+echo "  - tokenizer_test (tokenizer and grammar tests)"
+echo "  - tts_codec_test (TTS codec runtime tests)"
 echo ""
 echo "To run the tests:"
 echo "  cd tests/build"
 echo "  ./rnllama_tests           # Run basic tests"
 echo "  ./parallel_decoding_test  # Run parallel decoding tests"
 echo "  ./chat_parse_utf8_test    # Run chat parse UTF-8 tests"
+echo "  ./tokenizer_test          # Run tokenizer and grammar tests"
+echo "  ./tts_codec_test          # Run TTS codec runtime tests"
 echo ""
 echo "Or run all:"
-echo "  ./rnllama_tests && ./parallel_decoding_test && ./chat_parse_utf8_test"
+echo "  ./rnllama_tests && ./parallel_decoding_test && ./chat_parse_utf8_test && ./tokenizer_test && ./tts_codec_test"
 echo ""
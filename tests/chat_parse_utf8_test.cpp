@@ -516,6 +516,51 @@ static bool test_slot_toolcall_invalid_utf8(const std::string & parser) {
     }
 }
 
+// Streaming parses reuse the loaded parser and scan positions and report
+// per-call deltas; every step and the final parse match a from-scratch parse.
+static bool test_streaming_parse_deltas(const std::string & parser) {
+    try {
+        llama_rn_slot slot;
+        slot.current_chat_format = COMMON_CHAT_FORMAT_PEG_GEMMA4;
+        slot.current_reasoning_format = COMMON_REASONING_FORMAT_NONE;
+        slot.current_chat_parser = parser;
+        const std::string raw = std::string("Checking the weather.") +
+            "<|tool_call>call:get_weather{city:<|\"|>Paris<|\"|>}<tool_call|>";
+
+        std::string content;
+        for (size_t i = 0; i < raw.size(); i += 4) {
+            slot.generated_text += slot.utf8_gate.feed(raw.substr(i, 4));
+            auto out = slot.parseChatOutput(true);
+            // A revision (held-back marker text dropped) is flagged and resends the field
+            content = out.content_replaced ? out.content_delta : content + out.content_delta;
+            if (content != out.content) {
+                std::cout << "[deltas '" << content << "' != content '" << out.content << "'] ";
+                return false;
+            }
+            // Resumed scans agree with a from-scratch parse of the same prefix
+            auto fresh_partial = run_completion_parse(
+                slot.generated_text, COMMON_CHAT_FORMAT_PEG_GEMMA4, parser, true);
+            if (fresh_partial.content != out.content ||
+                fresh_partial.tool_calls.size() != out.tool_calls.size()) {
+                std::cout << "[memoized parse diverged at " << slot.generated_text.size() << "] ";
+                return false;
+            }
+            // Same text again: memoized, nothing new
+            auto again = slot.parseChatOutput(true);
+            if (!again.content_delta.empty() || again.content != out.content) return false;
+        }
+
+        auto final_out = slot.parseChatOutput(false);
+        auto fresh = run_completion_parse(raw, COMMON_CHAT_FORMAT_PEG_GEMMA4, parser, false);
+        return final_out.content == fresh.content &&
+               final_out.tool_calls.size() == 1 && fresh.tool_calls.size() == 1 &&
+               final_out.tool_calls[0].arguments == fresh.tool_calls[0].arguments;
+    } catch (const std::exception & e) {
+        std::cout << "[threw: " << e.what() << "] ";
+        return false;
+    }
+}
+
 int main() {
     std::cout << "=== chat parse UTF-8 robustness tests ===" << std::endl;
 
@@ -543,6 +588,7 @@ int main() {
     results.run_test("token display text is always well-formed", test_token_piece_display_text());
     results.run_test("slot reuse clears generation state", test_slot_clear_generation_state());
     results.run_test("slot parseChatOutput with invalid UTF-8 byte", test_slot_toolcall_invalid_utf8(parser));
+    results.run_test("streaming parse reuses parser and reports deltas", test_streaming_parse_deltas(parser));
 
     results.print_summary();
     return results.passed_tests == results.total_tests ? 0 : 1;
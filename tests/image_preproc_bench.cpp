@@ -0,0 +1,248 @@
+// Image preprocessing micro-benchmark: times mtmd_tokenize (resize, slice and
+// normalize; no encoder pass) on a synthetic photo-sized bitmap, serially and
+// with the row/tile-parallel path, for each vision model found in MODELS_DIR.
+// Before timing, it checks (without any model) that every resize algorithm,
+// the tile-parallel normalize and its lookup table give byte-identical output
+// for any thread count; a mismatch fails the run.
+//
+//   CHECK,<case>,<threads>,ok|MISMATCH
+//   BENCH,<model>,<threads>,<width>x<height>,<ms_per_image>,<n_tokens>
+//
+// Env: MODELS_DIR, BENCH_WIDTH (default 4032), BENCH_HEIGHT (default 3024),
+//      BENCH_THREADS (default: hardware concurrency), BENCH_REPEAT (default 5).
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "llama.h"
+#include "tools/mtmd/clip-impl.h"
+#include "tools/mtmd/mtmd-image.h"
+#include "tools/mtmd/mtmd.h"
+
+namespace {
+
+int env_i(const char *k, int d) {
+    const char *v = std::getenv(k);
+    return v ? std::atoi(v) : d;
+}
+
+// Smooth gradients plus noise, so resampling filters do real work
+std::vector<unsigned char> make_photo(int nx, int ny) {
+    std::vector<unsigned char> rgb((size_t) nx * ny * 3);
+    uint32_t seed = 42;
+    for (int y = 0; y < ny; y++) {
+        for (int x = 0; x < nx; x++) {
+            seed = seed * 1664525u + 1013904223u;
+            const size_t i = ((size_t) y * nx + x) * 3;
+            rgb[i + 0] = (unsigned char) ((x * 255) / nx);
+            rgb[i + 1] = (unsigned char) ((y * 255) / ny);
+            rgb[i + 2] = (unsigned char) (seed >> 24);
+        }
+    }
+    return rgb;
+}
+
+std::string find_mmproj(const std::filesystem::path &dir, const std::string &key) {
+    if (!std::filesystem::exists(dir)) return "";
+    for (const auto &e : std::filesystem::directory_iterator(dir)) {
+        const std::string fn = e.path().filename().string();
+        if (fn.rfind(key + ".mmproj", 0) == 0) return e.path().string();
+    }
+    return "";
+}
+
+clip_image_u8 make_u8(const std::vector<unsigned char> &rgb, int nx, int ny) {
+    clip_image_u8 img;
+    img.set_size({ nx, ny }, false);
+    img.cpy_buf(std::vector<uint8_t>(rgb.begin(), rgb.end()));
+    return img;
+}
+
+bool same_f32(const clip_image_f32 &a, const clip_image_f32 &b) {
+    if (a.nx() != b.nx() || a.ny() != b.ny() || a.is_placeholder() != b.is_placeholder()) return false;
+    if (a.is_placeholder()) return true;
+    const auto &x = a.get_ro_buf();
+    const auto &y = b.get_ro_buf();
+    return x.size() == y.size() && memcmp(x.data(), y.data(), x.size() * sizeof(float)) == 0;
+}
+
+bool same_output(const mtmd_image_preproc_out &a, const mtmd_image_preproc_out &b) {
+    if (a.entries.size() != b.entries.size() || a.grid_x != b.grid_x || a.grid_y != b.grid_y) return false;
+    if (a.has_overview() != b.has_overview() || (a.has_overview() && !same_f32(a.overview, b.overview))) return false;
+    for (size_t i = 0; i < a.entries.size(); i++) {
+        if (!same_f32(a.entries[i], b.entries[i])) return false;
+    }
+    return true;
+}
+
+const float kMean[3] = { 0.48145466f, 0.4578275f, 0.40821073f };
+const float kStd[3]  = { 0.26862954f, 0.26130258f, 0.27577711f };
+
+// The lookup-table normalize must match from_u8() + normalize() byte for byte
+bool check_normalize_lut(const std::vector<unsigned char> &rgb, int nx, int ny) {
+    const clip_image_u8 img = make_u8(rgb, nx, ny);
+    clip_image_f32 lut, ref;
+    lut.from_u8_normalized(img, kMean, kStd);
+    ref.from_u8(img);
+    ref.normalize(kMean, kStd);
+    const bool same = same_f32(lut, ref);
+    printf("CHECK,normalize_lut,1,%s\n", same ? "ok" : "MISMATCH");
+    return same;
+}
+
+// Preprocess the image with hand-set hparams at 1 and n threads and compare
+// the float buffers byte for byte; false on any difference
+bool check_thread_determinism(const std::vector<unsigned char> &rgb, int nx, int ny, int n_threads) {
+    const clip_image_u8 img = make_u8(rgb, nx, ny);
+    bool ok = true;
+
+    clip_hparams hp;
+    std::copy(kMean, kMean + 3, hp.image_mean);
+    std::copy(kStd, kStd + 3, hp.image_std);
+
+    struct check_case {
+        const char *name;
+        std::function<void(clip_hparams &)> setup;
+        std::function<mtmd_image_preproc_out(const clip_hparams &, const clip_image_u8 &)> run;
+    };
+    auto fixed = [](const clip_hparams &h, const clip_image_u8 &im) { return mtmd_image_preprocessor_fixed_size(h).preprocess(im); };
+    auto dyn = [](const clip_hparams &h, const clip_image_u8 &im) { return mtmd_image_preprocessor_dyn_size(h).preprocess(im); };
+    auto uhd = [](const clip_hparams &h, const clip_image_u8 &im) { return mtmd_image_preprocessor_llava_uhd(h).preprocess(im); };
+    const std::vector<check_case> cases = {
+        { "fixed_bilinear", [](clip_hparams &h) { h.image_size = 896; h.image_resize_algo = RESIZE_ALGO_BILINEAR; }, fixed },
+        { "fixed_bicubic", [](clip_hparams &h) { h.image_size = 896; h.image_resize_algo = RESIZE_ALGO_BICUBIC; }, fixed },
+        { "fixed_bicubic_pillow", [](clip_hparams &h) { h.image_size = 896; h.image_resize_algo = RESIZE_ALGO_BICUBIC_PILLOW; }, fixed },
+        { "fixed_lanczos", [](clip_hparams &h) { h.image_size = 896; h.image_resize_algo = RESIZE_ALGO_LANCZOS; }, fixed },
+        { "dyn_bicubic", [](clip_hparams &h) {
+              h.patch_size = 14; h.n_merge = 2;
+              h.image_min_pixels = 256 * 256; h.image_max_pixels = 1024 * 1024;
+          }, dyn },
+        { "llava_uhd_tiles", [](clip_hparams &h) {
+              h.image_size = 336; h.patch_size = 14;
+              h.image_res_candidates = { { 672, 672 }, { 1008, 672 }, { 1344, 1008 } };
+          }, uhd },
+    };
+    for (const auto &c : cases) {
+        clip_hparams h = hp;
+        c.setup(h);
+        mtmd_image_preproc_out serial, parallel;
+        {
+            mtmd_image_threads_scope scope(1);
+            serial = c.run(h, img);
+        }
+        {
+            mtmd_image_threads_scope scope(n_threads);
+            parallel = c.run(h, img);
+        }
+        const bool same = !serial.entries.empty() && same_output(serial, parallel);
+        printf("CHECK,%s,%d,%s\n", c.name, n_threads, same ? "ok" : "MISMATCH");
+        ok = ok && same;
+    }
+    fflush(stdout);
+    return ok;
+}
+
+// Average ms per mtmd_tokenize call; -1 on failure
+double time_preprocess(const llama_model *model, const std::string &mmproj, int n_threads,
+                       const std::vector<unsigned char> &rgb, int nx, int ny, int repeats,
+                       size_t &n_tokens) {
+    mtmd_context_params params = mtmd_context_params_default();
+    params.use_gpu = false;
+    params.print_timings = false;
+    params.warmup = false;
+    params.n_threads = n_threads;
+    mtmd_context *ctx = mtmd_init_from_file(mmproj.c_str(), model, params);
+    if (ctx == nullptr) return -1;
+
+    const std::string prompt = std::string("Describe this image: ") + mtmd_default_marker();
+    mtmd_input_text text = { prompt.c_str(), prompt.size(), true, true };
+    mtmd_bitmap *bitmap = mtmd_bitmap_init(nx, ny, rgb.data());
+    const mtmd_bitmap *bitmaps[] = { bitmap };
+
+    double total_ms = 0;
+    bool ok = true;
+    // One untimed run warms the allocator and the page cache
+    for (int r = 0; r <= repeats && ok; r++) {
+        mtmd_input_chunks *chunks = mtmd_input_chunks_init();
+        const auto t0 = std::chrono::steady_clock::now();
+        ok = mtmd_tokenize(ctx, chunks, &text, bitmaps, 1) == 0;
+        const auto t1 = std::chrono::steady_clock::now();
+        if (r > 0) total_ms += std::chrono::duration<double, std::milli>(t1 - t0).count();
+        n_tokens = 0;
+        for (size_t i = 0; i < mtmd_input_chunks_size(chunks); i++) {
+            const mtmd_input_chunk *chunk = mtmd_input_chunks_get(chunks, i);
+            if (mtmd_input_chunk_get_type(chunk) != MTMD_INPUT_CHUNK_TYPE_TEXT) {
+                n_tokens += mtmd_input_chunk_get_n_tokens(chunk);
+            }
+        }
+        mtmd_input_chunks_free(chunks);
+    }
+    mtmd_bitmap_free(bitmap);
+    mtmd_free(ctx);
+    return ok ? total_ms / repeats : -1;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const char *env_dir = std::getenv("MODELS_DIR");
+    const std::filesystem::path models_dir = env_dir
+        ? std::filesystem::path(env_dir)
+        : std::filesystem::path(__FILE__).parent_path() / "models";
+    const int nx = env_i("BENCH_WIDTH", 4032);
+    const int ny = env_i("BENCH_HEIGHT", 3024);
+    const int n_threads = std::max(1, env_i("BENCH_THREADS", (int) std::thread::hardware_concurrency()));
+    const int repeats = std::max(1, env_i("BENCH_REPEAT", 5));
+    // Vision models from models/download.sh (subset that exists is run)
+    const std::vector<std::string> models = { "smolvlm", "lfm2vl", "gemma4", "qwen35" };
+    std::vector<std::string> want;
+    for (int i = 1; i < argc; i++) want.push_back(argv[i]);
+
+    llama_backend_init();
+    const std::vector<unsigned char> rgb = make_photo(nx, ny);
+    // An odd thread count leaves a short last range
+    bool deterministic = check_normalize_lut(rgb, nx, ny);
+    for (int t : { 3, std::max(2, n_threads) }) {
+        deterministic = check_thread_determinism(rgb, nx, ny, t) && deterministic;
+    }
+    if (!deterministic) {
+        fprintf(stderr, "preprocessing output depends on the thread count\n");
+        llama_backend_free();
+        return 1;
+    }
+    printf("BENCH_HEADER,model,threads,size,ms_per_image,n_tokens\n");
+    for (const auto &key : models) {
+        if (!want.empty() && std::find(want.begin(), want.end(), key) == want.end()) continue;
+        const auto path = models_dir / (key + ".gguf");
+        const std::string mmproj = find_mmproj(models_dir, key);
+        if (!std::filesystem::exists(path) || mmproj.empty()) continue;
+
+        llama_model_params mparams = llama_model_default_params();
+        mparams.n_gpu_layers = 0;
+        llama_model *model = llama_model_load_from_file(path.string().c_str(), mparams);
+        if (model == nullptr) {
+            printf("BENCH,%s,load-failed,0,0,0\n", key.c_str());
+            continue;
+        }
+        std::vector<int> thread_counts = { 1 };
+        if (n_threads > 1) thread_counts.push_back(n_threads);
+        for (int t : thread_counts) {
+            size_t n_tokens = 0;
+            const double ms = time_preprocess(model, mmproj, t, rgb, nx, ny, repeats, n_tokens);
+            printf("BENCH,%s,%d,%dx%d,%.2f,%zu\n", key.c_str(), t, nx, ny, ms, n_tokens);
+            fflush(stdout);
+        }
+        llama_model_free(model);
+    }
+    llama_backend_free();
+    return 0;
+}
@@ -1110,9 +1110,9 @@ std::vector<Check> run_media_identity_probe(const std::string &key,
     };
     auto checkpoint_at = [&](size_t pos) -> std::pair<size_t, std::string> {
         for (const auto &checkpoint : cmpl->state_checkpoints) {
-            if (checkpoint.n_tokens() == pos && !checkpoint.data.empty()) {
-                return {checkpoint.data.size(),
-                        fnv_hash(checkpoint.data.data(), checkpoint.data.size())};
+            rn_state_reader reader;
+            if (checkpoint.n_tokens() == pos && reader.open(checkpoint) && reader.size() > 0) {
+                return {reader.size(), fnv_hash(reader.data(), reader.size())};
             }
         }
         return {0, ""};
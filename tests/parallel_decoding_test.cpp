@@ -2,7 +2,14 @@
 #include <fstream>
 #include <iomanip>
 #include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <filesystem>
+#include <iterator>
+#include <map>
+#include <random>
 #include <vector>
 #include <string>
 #include <thread>
@@ -13,7 +20,11 @@
 #include "rn-completion.h"
 #include "rn-slot.h"
 #include "rn-slot-manager.h"
+#include "rn-media-cache.h"
 #include "common.h"
+#include "gguf.h"
+
+#include "bpe_vocab_fixture.h"
 
 using namespace rnllama;
 
@@ -966,7 +977,9 @@ bool test_queue_request_with_state() {
             return false;
         }
 
-        // Step 3: Verify the limited state file has the correct size
+        // Step 3: Verify the limited state file has the correct size; state
+        // files are written in the background
+        ctx.slot_manager->state_writer.flush();
         if (!std::filesystem::exists(limited_state_path)) {
             std::cout << "[Limited state file was not created] ";
             std::filesystem::remove(full_state_path);
@@ -1077,7 +1090,8 @@ bool test_state_reuse() {
             return false;
         }
 
-        // Verify state file was created
+        // Verify state file was created (written in the background)
+        ctx.slot_manager->state_writer.flush();
         if (!std::filesystem::exists(save_path)) {
             std::cout << "[State file was not created] ";
             return false;
@@ -1509,6 +1523,1248 @@ bool test_status_request_metrics() {
     }
 }
 
+// Test 28: Prefix-aware slot routing (no model needed)
+bool test_prefix_slot_routing() {
+    try {
+        llama_rn_slot_manager manager(nullptr);
+        if (!manager.init(3, 32, 768)) return false;
+
+        // Slot 0 is the LRU candidate; slots 1 and 2 hold cached histories,
+        // published to the prefix index on release
+        manager.slots[1].cache_tokens = {1, 2, 3};
+        manager.slots[2].cache_tokens = {1, 2, 3, 4, 5, 6, 9};
+        manager.release_slot(&manager.slots[1]);
+        manager.release_slot(&manager.slots[2]);
+        manager.slots[0].t_last_used = 1;
+        manager.slots[1].t_last_used = 2;
+        manager.slots[2].t_last_used = 3;
+
+        // Longest reusable prefix wins over LRU
+        std::vector<llama_token> prompt = {1, 2, 3, 4, 5, 6, 7, 8};
+        llama_rn_slot* slot = manager.get_available_slot(prompt);
+        if (slot == nullptr || slot->id != 2 || !slot->routed_by_prefix || slot->routed_prefix_n != 6) {
+            return false;
+        }
+
+        // Below the similarity threshold falls back to LRU
+        std::vector<llama_token> unrelated = {1, 20, 30, 40, 50, 60};
+        slot = manager.get_available_slot(unrelated);
+        if (slot == nullptr || slot->id != 0 || slot->routed_by_prefix) return false;
+
+        // Embedding/rerank style requests always take the LRU slot
+        slot = manager.get_available_slot(prompt, {}, false);
+        if (slot == nullptr || slot->id != 0 || slot->routed_by_prefix) return false;
+
+        // Media placeholders only count when the media identities match
+        manager.slots[1].cache_tokens = {1, LLAMA_TOKEN_NULL, LLAMA_TOKEN_NULL, 4};
+        manager.slots[1].bitmap_past_hashes = {"source:a"};
+        std::vector<llama_token> media_prompt = {1, LLAMA_TOKEN_NULL, LLAMA_TOKEN_NULL, 4, 5};
+        if (manager.get_reusable_prefix(manager.slots[1], media_prompt, {"source:b"}) != 1) return false;
+        if (manager.get_reusable_prefix(manager.slots[1], media_prompt, {"source:a"}) != 4) return false;
+
+        slot = manager.get_available_slot(media_prompt, {"source:a"});
+        return slot != nullptr && slot->id == 1 && slot->routed_by_prefix;
+    } catch (...) {
+        return false;
+    }
+}
+
+// Test 29: Cross-slot shared prefix via llama_memory_seq_cp
+bool test_shared_prefix_across_slots() {
+    try {
+        llama_rn_context ctx;
+
+        common_params params;
+        params.model.path = "../tiny-random-llama.gguf";
+        params.n_ctx = 512;
+        params.n_batch = 128;
+        params.n_parallel = 2;
+        params.cpuparams.n_threads = 1;
+        params.n_gpu_layers = 0;
+        params.no_kv_offload = true;
+        params.kv_unified = true;
+        params.n_predict = 3;
+
+        if (!ctx.loadModel(params)) {
+            std::cout << "[SKIP: Model not loaded] ";
+            return true;
+        }
+
+        ctx.enableParallelMode(2, 128);
+        // Disable prefix routing so the second request lands on the other slot
+        ctx.slot_manager->slot_prompt_similarity = 1.1f;
+
+        const std::string system = "You are a helpful assistant. Answer briefly and precisely. ";
+        auto run = [&](const std::string& text, int32_t& cache_n) -> bool {
+            bool complete = false;
+            std::vector<llama_token> prompt = common_tokenize(ctx.ctx, text, false);
+            ctx.slot_manager->queue_request(
+                params, prompt, std::vector<std::string>(), text, 0,
+                COMMON_REASONING_FORMAT_NONE, "", "", "", "", "", "", -1, -1,
+                [](const completion_token_output& token) {},
+                [&](llama_rn_slot* slot) {
+                    cache_n = slot->n_prompt_tokens_cache;
+                    complete = true;
+                }
+            );
+            for (int i = 0; i < 100 && !complete; i++) {
+                ctx.slot_manager->update_slots();
+            }
+            return complete;
+        };
+
+        int32_t cache_a = -1, cache_b = -1;
+        if (!run(system + "What is the capital of France?", cache_a)) return false;
+        if (!run(system + "Name a prime number.", cache_b)) return false;
+
+        auto status = ctx.slot_manager->get_status();
+        std::cout << "[shared " << status.shared_prefix_tokens << " tokens] ";
+        return cache_a == 0 && cache_b > 0 &&
+               status.shared_prefix_hits == 1 &&
+               status.shared_prefix_tokens == cache_b;
+    } catch (...) {
+        return false;
+    }
+}
+
+// Test 30: Radix prefix index lookups across inserts, splits and removals
+bool test_prefix_index() {
+    try {
+        rn_prefix_index index;
+        index.insert(RN_PREFIX_SLOT, 0, std::vector<llama_token>{1, 2, 3, 4, 5});
+        index.insert(RN_PREFIX_SLOT, 1, std::vector<llama_token>{1, 2, 3, 7});
+        index.insert(RN_PREFIX_CHECKPOINT, 3, std::vector<llama_token>{1, 2, 3});
+        index.insert(RN_PREFIX_CHECKPOINT, 5, std::vector<llama_token>{1, 2, 3, 4, 5});
+        if (index.size(RN_PREFIX_SLOT) != 2 || index.size(RN_PREFIX_CHECKPOINT) != 2) return false;
+
+        const std::vector<llama_token> query = {1, 2, 3, 4, 9, 9};
+
+        // Truncatable: slot 0 shares four tokens
+        rn_prefix_match m = index.find_longest_shared(RN_PREFIX_SLOT, query, query.size());
+        if (m.key != 0 || m.n_match != 4 || m.n_tokens != 5) return false;
+
+        // Exact: only the 3-token checkpoint is a whole prefix of the query
+        m = index.find_longest_entry(RN_PREFIX_CHECKPOINT, query, query.size());
+        if (m.key != 3 || m.n_match != 3) return false;
+        m = index.find_longest_entry(RN_PREFIX_CHECKPOINT, {1, 2, 3, 4, 5, 6}, 6);
+        if (m.key != 5 || m.n_match != 5) return false;
+        m = index.find_longest_entry(RN_PREFIX_CHECKPOINT, {1, 2, 3, 4, 5, 6}, 4);
+        if (m.key != 3) return false;
+
+        // Kinds don't leak into each other's lookups
+        index.remove(RN_PREFIX_SLOT, 0);
+        m = index.find_longest_shared(RN_PREFIX_SLOT, query, query.size());
+        if (m.key != 1 || m.n_match != 3) return false;
+
+        // Replacing an entry re-keys it; removal prunes and merges nodes
+        index.insert(RN_PREFIX_SLOT, 1, std::vector<llama_token>{8, 9});
+        m = index.find_longest_shared(RN_PREFIX_SLOT, query, query.size());
+        if (m.key != -1 || m.n_match != 0) return false;
+        index.remove(RN_PREFIX_CHECKPOINT, 3);
+        m = index.find_longest_entry(RN_PREFIX_CHECKPOINT, {1, 2, 3, 4, 5}, 5);
+        if (m.key != 5 || index.contains(RN_PREFIX_CHECKPOINT, 3)) return false;
+
+        index.clear(RN_PREFIX_CHECKPOINT);
+        return index.size(RN_PREFIX_CHECKPOINT) == 0 && index.size(RN_PREFIX_SLOT) == 1 &&
+               index.find_longest_shared(RN_PREFIX_SLOT, {8, 9, 10}, 3).n_match == 2;
+    } catch (...) {
+        return false;
+    }
+}
+
+// Test 31: Sampling pool runs every task exactly once, across repeated jobs
+bool test_sampling_pool() {
+    try {
+        llama_rn_sampling_pool pool;
+        pool.start(3);
+        for (int round = 0; round < 200; round++) {
+            const int32_t n = 1 + round % 9;
+            std::vector<std::atomic<int>> hits(n);
+            for (auto& h : hits) h.store(0);
+            pool.run(n, [&](int32_t i) { hits[i]++; });
+            for (auto& h : hits) {
+                if (h.load() != 1) return false;
+            }
+        }
+        pool.stop();
+
+        // Without workers the tasks run inline, in order
+        std::vector<int32_t> order;
+        pool.run(4, [&](int32_t i) { order.push_back(i); });
+        return order == std::vector<int32_t>{0, 1, 2, 3};
+    } catch (...) {
+        return false;
+    }
+}
+
+// Test 32: Batched embeddings match one-at-a-time embeddings, in input order
+bool test_embedding_batch() {
+    try {
+        llama_rn_context ctx;
+
+        common_params params;
+        params.model.path = "../tiny-random-llama.gguf";
+        params.n_ctx = 512;
+        params.n_batch = 128;
+        params.n_parallel = 2;
+        params.cpuparams.n_threads = 1;
+        params.n_gpu_layers = 0;
+        params.no_kv_offload = true;
+        params.embedding = true;
+        params.pooling_type = LLAMA_POOLING_TYPE_MEAN;
+        params.embd_normalize = 2;
+
+        if (!ctx.loadModel(params)) {
+            std::cout << "[SKIP: Model not loaded] ";
+            return true;
+        }
+        if (ctx.completion == nullptr) ctx.completion = new llama_rn_context_completion(&ctx);
+
+        const std::vector<std::string> texts = {
+            "The quick brown fox", "jumps over", "the lazy dog near the river bank",
+        };
+        const int n_embd = llama_model_n_embd(ctx.model);
+
+        auto close = [](const float* a, const float* b, int n) {
+            for (int i = 0; i < n; i++) {
+                if (std::fabs(a[i] - b[i]) > 1e-3f) return false;
+            }
+            return true;
+        };
+
+        // Completion path: one call vs. one embedding() per text
+        const std::vector<float> batched = ctx.completion->embeddingBatch(texts, 2);
+        if (batched.size() != texts.size() * n_embd) return false;
+        for (size_t i = 0; i < texts.size(); i++) {
+            common_params embd_params = ctx.params;
+            ctx.params.prompt = texts[i];
+            const std::vector<float> single = ctx.completion->embedding(embd_params);
+            if (!close(single.data(), batched.data() + i * n_embd, n_embd)) return false;
+        }
+
+        // Slot path: inputs split across both slots, gathered in input order
+        ctx.enableParallelMode(2, 128);
+        const bool add_bos = llama_vocab_get_add_bos(llama_model_get_vocab(ctx.model));
+        std::vector<std::vector<llama_token>> inputs;
+        for (const auto& text : texts) {
+            inputs.push_back(common_tokenize(ctx.ctx, text, add_bos, true));
+        }
+        bool done = false;
+        std::vector<float> queued;
+        ctx.slot_manager->queue_embedding_batch_request(inputs, 2,
+            [&](int32_t, const std::vector<float>& result, bool) {
+                queued = result;
+                done = true;
+            });
+        for (int i = 0; i < 100 && !done; i++) {
+            ctx.slot_manager->update_slots();
+        }
+        if (!done || queued.size() != batched.size()) return false;
+        return close(queued.data(), batched.data(), (int) batched.size());
+    } catch (...) {
+        return false;
+    }
+}
+
+// Test 33: Fair prefill scheduling and request priority
+bool test_fair_prefill_scheduling() {
+    try {
+        llama_rn_slot_manager manager(nullptr);
+        if (!manager.init(3, 32, 768)) return false;
+
+        auto start_prompt = [](llama_rn_slot& slot, size_t n_tokens) {
+            slot.state = SLOT_STATE_PROCESSING_PROMPT;
+            slot.task_type = SLOT_TASK_TYPE_COMPLETION;
+            slot.prompt_tokens.assign(n_tokens, 7);
+            slot.num_prompt_tokens = n_tokens;
+            slot.n_past = 0;
+        };
+        auto tokens_of = [&manager](int32_t seq) {
+            int32_t n = 0;
+            for (int32_t i = 0; i < manager.batch.n_tokens; i++) {
+                if (manager.batch.seq_id[i][0] == seq) n++;
+            }
+            return n;
+        };
+
+        // FIFO: slot 0 takes the whole batch
+        start_prompt(manager.slots[0], 40);
+        start_prompt(manager.slots[1], 40);
+        manager.build_batch();
+        if (tokens_of(0) != 32 || tokens_of(1) != 0) return false;
+
+        // Fair: one generated token, the rest split evenly
+        manager.prefill_policy = PREFILL_POLICY_FAIR;
+        start_prompt(manager.slots[0], 40);
+        start_prompt(manager.slots[1], 40);
+        manager.slots[2].state = SLOT_STATE_GENERATING;
+        manager.slots[2].generated_tokens = {5};
+        manager.build_batch();
+        if (tokens_of(2) != 1 || tokens_of(0) + tokens_of(1) != 31) return false;
+        if (std::abs(tokens_of(0) - tokens_of(1)) > 1) return false;
+
+        // Decode budget bounds prefill while a slot generates; the higher
+        // priority slot is served first
+        manager.prefill_decode_budget = 8;
+        manager.prefill_chunk = 6;
+        start_prompt(manager.slots[0], 40);
+        start_prompt(manager.slots[1], 40);
+        manager.slots[1].priority = 1;
+        manager.build_batch();
+        if (tokens_of(1) != 6 || tokens_of(0) != 2) return false;
+
+        // Embedding prompts go in whole but are charged to the same budget:
+        // the one in front takes the room, the next waits for a later step
+        manager.slots[0].priority = 1;
+        manager.slots[1].priority = 0;
+        manager.prefill_chunk = 0;
+        start_prompt(manager.slots[0], 12);
+        start_prompt(manager.slots[1], 4);
+        manager.slots[0].task_type = SLOT_TASK_TYPE_EMBEDDING;
+        manager.slots[1].task_type = SLOT_TASK_TYPE_EMBEDDING;
+        manager.build_batch();
+        if (tokens_of(0) != 12 || tokens_of(1) != 0) return false;
+        manager.slots[0].state = SLOT_STATE_DONE;
+        manager.build_batch();
+        if (tokens_of(1) != 4) return false;
+
+        // Higher priority requests jump ahead in the queue, equal ones keep order
+        llama_rn_queued_request a, b, c;
+        a.request_id = 1;
+        b.request_id = 2;
+        c.request_id = 3;
+        c.priority = 2;
+        manager.enqueue_request(std::move(a));
+        manager.enqueue_request(std::move(b));
+        manager.enqueue_request(std::move(c));
+        return manager.queue_requests.size() == 3 &&
+               manager.queue_requests[0].request_id == 3 &&
+               manager.queue_requests[1].request_id == 1 &&
+               manager.queue_requests[2].request_id == 2;
+    } catch (...) {
+        return false;
+    }
+}
+
+// Test 34: Media embedding cache LRU, disk spill, reload, disk budget on startup
+// and corrupt spill files
+bool test_media_embd_cache() {
+    try {
+        namespace fs = std::filesystem;
+        const fs::path dir = fs::temp_directory_path() / "rn_media_cache_test";
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+
+        const std::vector<float> a(64, 1.0f), b(64, 2.0f), c(64, 3.0f);
+        std::vector<float> out;
+
+        // Room for two entries in memory; the third pushes the oldest to disk
+        rn_media_embd_cache cache;
+        cache.configure(2 * 64 * sizeof(float), dir.string(), 1 << 20);
+        cache.put("p:a", a.data(), a.size());
+        cache.put("p:b", b.data(), b.size());
+        if (!cache.get("p:a", out) || out != a) return false;
+        cache.put("p:c", c.data(), c.size());
+
+        auto s = cache.get_stats();
+        if (s.n_entries != 2 || s.n_disk_entries != 1 || s.hits != 1) return false;
+        if (cache.get("p:x", out)) return false;
+
+        // b was least recently used: it comes back from disk
+        if (!cache.get("p:b", out) || out != b) return false;
+        s = cache.get_stats();
+        if (s.disk_hits != 1 || s.misses != 1) return false;
+
+        // A fresh cache on the same directory reuses the spilled files
+        rn_media_embd_cache reopened;
+        reopened.configure(64 * sizeof(float), dir.string(), 1 << 20);
+        if (!reopened.get("p:b", out) || out != b) return false;
+
+        // Spilled files count against the disk budget as soon as the
+        // directory is configured, and a smaller budget trims them right away
+        rn_media_embd_cache scanned;
+        scanned.configure(64 * sizeof(float), dir.string(), 1 << 20);
+        s = scanned.get_stats();
+        if (s.n_disk_entries != 2 || s.n_disk_bytes == 0) return false;
+        const size_t file_bytes = s.n_disk_bytes / 2;
+        rn_media_embd_cache capped;
+        capped.configure(64 * sizeof(float), dir.string(), file_bytes);
+        s = capped.get_stats();
+        size_t n_files = 0;
+        for (const auto & entry : fs::directory_iterator(dir)) {
+            n_files += entry.path().extension() == ".embd";
+        }
+        if (s.n_disk_entries != 1 || s.n_disk_bytes != file_bytes || n_files != 1) return false;
+
+        // A corrupt element count in a spilled file is a miss, not an
+        // allocation of whatever the file claims
+        for (const auto & entry : fs::directory_iterator(dir)) {
+            if (entry.path().extension() != ".embd") continue;
+            FILE * f = fopen(entry.path().string().c_str(), "r+b");
+            if (f == nullptr) return false;
+            const uint64_t bogus = ~0ULL >> 4;
+            fseek(f, 3 * sizeof(uint32_t) + 3, SEEK_SET);  // Past the header and key
+            fwrite(&bogus, sizeof(bogus), 1, f);
+            fclose(f);
+        }
+        rn_media_embd_cache corrupt;
+        corrupt.configure(64 * sizeof(float), dir.string(), 1 << 20);
+        if (corrupt.get("p:a", out) || corrupt.get("p:b", out)) return false;
+        if (corrupt.get_stats().misses != 2) return false;
+
+        // Disabled cache never hits
+        reopened.configure(0);
+        reopened.put("p:a", a.data(), a.size());
+        bool ok = !reopened.get("p:a", out);
+        fs::remove_all(dir);
+        return ok;
+    } catch (...) {
+        return false;
+    }
+}
+
+// Test 35: cached custom templates and formatted chats give the same prompt as
+// a fresh format, across repeats, appended turns and template switches
+bool test_chat_format_cache() {
+    try {
+        namespace fs = std::filesystem;
+        std::vector<std::string> vocab_tokens;
+        const std::vector<std::string> merges = train_bpe_vocab({}, 0, vocab_tokens);
+        std::vector<int32_t> token_types(vocab_tokens.size(), LLAMA_TOKEN_TYPE_NORMAL);
+        const int32_t eos_id = (int32_t) vocab_tokens.size();
+        vocab_tokens.push_back("</s>");
+        token_types.push_back(LLAMA_TOKEN_TYPE_CONTROL);
+        const fs::path path = fs::temp_directory_path() / "rn_chat_format_test.gguf";
+        if (!write_bpe_vocab(path.string(), "llama-bpe", vocab_tokens, token_types, merges, eos_id)) return false;
+
+        llama_model_params mparams = llama_model_default_params();
+        mparams.vocab_only = true;
+        llama_model * model = llama_model_load_from_file(path.string().c_str(), mparams);
+        fs::remove(path);
+        if (model == nullptr) return false;
+
+        const std::string chatml =
+            "{% for message in messages %}<|im_start|>{{ message.role }}\n{{ message.content }}<|im_end|>\n{% endfor %}"
+            "{% if add_generation_prompt %}<|im_start|>assistant\n{% endif %}";
+        const std::string plain =
+            "{% for message in messages %}### {{ message.role | upper }}: {{ message.content }}\n{% endfor %}"
+            "{% if add_generation_prompt %}### ASSISTANT:{% endif %}";
+        const std::string turn1 = R"([{"role":"system","content":"Be brief."},{"role":"user","content":"Hi"}])";
+        const std::string turn2 = R"([{"role":"system","content":"Be brief."},{"role":"user","content":"Hi"},)"
+                                  R"({"role":"assistant","content":"Hello!"},{"role":"user","content":"Bye"}])";
+
+        llama_rn_context cached;
+        cached.model = model;
+        auto format = [](const llama_rn_context & c, const std::string & msgs, const std::string & tmpl, bool gen) {
+            return c.getFormattedChatWithJinja(msgs, tmpl, "", "", false, "", false, "none", gen).prompt;
+        };
+        auto fresh = [&](const std::string & msgs, const std::string & tmpl, bool gen) {
+            llama_rn_context c;
+            c.model = model;
+            return format(c, msgs, tmpl, gen);
+        };
+
+        bool ok = true;
+        const struct { const std::string * msgs; const std::string * tmpl; bool gen; } cases[] = {
+            { &turn1, &chatml, true }, { &turn1, &chatml, true }, { &turn2, &chatml, true },
+            { &turn2, &chatml, false }, { &turn2, &plain, true }, { &turn1, &chatml, true },
+        };
+        for (const auto & c : cases) {
+            const std::string got = format(cached, *c.msgs, *c.tmpl, c.gen);
+            if (got != fresh(*c.msgs, *c.tmpl, c.gen) || got.find("Hi") == std::string::npos) {
+                std::cout << "  formatted chat mismatch" << std::endl;
+                ok = false;
+            }
+        }
+        ok = ok && cached.chat_template_cache.size() == 2 && cached.chat_format_cache.size() == 4;
+        ok = ok && cached.getChatTemplates(chatml) == cached.getChatTemplates(chatml);
+
+        cached.clearChatCaches();
+        ok = ok && cached.chat_template_cache.empty() && cached.chat_format_cache.empty();
+        llama_model_free(model);
+        return ok;
+    } catch (const std::exception & e) {
+        std::cout << "  exception: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+// Test 36: per-sequence LoRA - one batch mixing an adapted and a base sequence
+// gives the logits of decoding each alone with the adapter applied (or not)
+// context-wide; slots only reuse caches decoded under the same adapters and
+// keep an adapter loaded only while routed through it
+bool test_lora_per_sequence() {
+    try {
+        namespace fs = std::filesystem;
+        llama_rn_context ctx;
+
+        common_params params;
+        params.model.path = "../tiny-random-llama.gguf";
+        params.n_ctx = 256;
+        params.n_batch = 64;
+        params.n_parallel = 2;
+        params.cpuparams.n_threads = 1;
+        params.n_gpu_layers = 0;
+        params.no_kv_offload = true;
+        params.n_predict = 2;
+
+        if (!ctx.loadModel(params)) {
+            std::cout << "[SKIP: Model not loaded] ";
+            return true;
+        }
+
+        // Rank-2 adapter on an attention projection (rows = tokens) and the LM
+        // head (rows = outputs)
+        const fs::path path = fs::temp_directory_path() / "rn_lora_seq_test.gguf";
+        {
+            lm_ggml_init_params iparams = { 16 * 1024 * 1024, nullptr, false };
+            lm_ggml_context * tctx = lm_ggml_init(iparams);
+            lm_gguf_context * gctx = lm_gguf_init_empty();
+            lm_gguf_set_val_str(gctx, "general.architecture", "llama");
+            lm_gguf_set_val_str(gctx, "general.type", "adapter");
+            lm_gguf_set_val_str(gctx, "adapter.type", "lora");
+            lm_gguf_set_val_f32(gctx, "adapter.lora.alpha", 4.0f);
+            int n_weights = 0;
+            for (const char * name : { "blk.0.attn_q.weight", "output.weight" }) {
+                const lm_ggml_tensor * w = ctx.model->get_tensor(name);
+                if (w == nullptr) {
+                    continue;
+                }
+                lm_ggml_tensor * a = lm_ggml_new_tensor_2d(tctx, LM_GGML_TYPE_F32, w->ne[0], 2);
+                lm_ggml_tensor * b = lm_ggml_new_tensor_2d(tctx, LM_GGML_TYPE_F32, 2, w->ne[1]);
+                lm_ggml_set_name(a, (std::string(name) + ".lora_a").c_str());
+                lm_ggml_set_name(b, (std::string(name) + ".lora_b").c_str());
+                for (lm_ggml_tensor * t : { a, b }) {
+                    float * data = (float *) t->data;
+                    for (int64_t i = 0; i < lm_ggml_nelements(t); ++i) {
+                        data[i] = 0.5f * std::sin(0.37f * (float) i + (t == a ? 0.0f : 1.0f));
+                    }
+                    lm_gguf_add_tensor(gctx, t);
+                }
+                n_weights++;
+            }
+            const bool written = n_weights > 0 && lm_gguf_write_to_file(gctx, path.string().c_str(), false);
+            lm_gguf_free(gctx);
+            lm_ggml_free(tctx);
+            if (!written) return false;
+        }
+
+        llama_adapter_lora * adapter = ctx.getLoraAdapter(path.string());
+        fs::remove(path);
+        if (adapter == nullptr || ctx.getLoraAdapter(path.string()) != adapter) return false;
+
+        const int n_vocab = llama_vocab_n_tokens(llama_model_get_vocab(ctx.model));
+        const std::vector<llama_token> prompt = common_tokenize(ctx.ctx, "The quick brown fox jumps", false);
+        auto * mem = llama_get_memory(ctx.ctx);
+
+        // Last-token logits of prompt decoded alone as sequence 0
+        auto decode_alone = [&](float scale) {
+            llama_memory_clear(mem, true);
+            llama_set_adapters_lora(ctx.ctx, &adapter, 1, &scale);
+            llama_batch batch = llama_batch_init(prompt.size(), 0, 1);
+            for (size_t i = 0; i < prompt.size(); ++i) {
+                common_batch_add(batch, prompt[i], i, {0}, i + 1 == prompt.size());
+            }
+            std::vector<float> logits;
+            if (llama_decode(ctx.ctx, batch) == 0) {
+                const float * l = llama_get_logits_ith(ctx.ctx, -1);
+                logits.assign(l, l + n_vocab);
+            }
+            llama_batch_free(batch);
+            return logits;
+        };
+        const std::vector<float> ref_base = decode_alone(0.0f);
+        const std::vector<float> ref_lora = decode_alone(0.75f);
+        llama_set_adapters_lora(ctx.ctx, nullptr, 0, nullptr);
+
+        auto max_diff = [](const std::vector<float> & x, const float * y) {
+            float d = 0.0f;
+            for (size_t i = 0; i < x.size(); ++i) {
+                d = std::max(d, std::fabs(x[i] - y[i]));
+            }
+            return d;
+        };
+        if (ref_base.empty() || ref_lora.empty() || max_diff(ref_base, ref_lora.data()) < 1e-3f) {
+            std::cout << "  adapter has no effect" << std::endl;
+            return false;
+        }
+
+        // Both sequences in one batch, only sequence 1 routed through the adapter
+        llama_memory_clear(mem, true);
+        float scale = 0.75f;
+        llama_set_adapters_lora_seq(ctx.ctx, 1, &adapter, 1, &scale);
+        llama_batch batch = llama_batch_init(2 * prompt.size(), 0, 1);
+        for (llama_seq_id seq : { 0, 1 }) {
+            for (size_t i = 0; i < prompt.size(); ++i) {
+                common_batch_add(batch, prompt[i], i, {seq}, i + 1 == prompt.size());
+            }
+        }
+        const bool decoded = llama_decode(ctx.ctx, batch) == 0;
+        llama_batch_free(batch);
+        llama_set_adapters_lora_seq(ctx.ctx, 1, nullptr, 0, nullptr);
+        if (!decoded) return false;
+
+        const float d_base = max_diff(ref_base, llama_get_logits_ith(ctx.ctx, prompt.size() - 1));
+        const float d_lora = max_diff(ref_lora, llama_get_logits_ith(ctx.ctx, 2 * prompt.size() - 1));
+        std::cout << "[max diff base " << d_base << ", lora " << d_lora << "] ";
+        if (d_base > 1e-3f || d_lora > 1e-3f) return false;
+
+        // A slot decoded under the adapter serves no prefix to a base request
+        ctx.enableParallelMode(2, 64);
+        common_adapter_lora_info la;
+        la.path = path.string();
+        la.scale = scale;
+        la.ptr = adapter;
+        bool complete = false;
+        int32_t slot_id = -1;
+        ctx.slot_manager->queue_request(
+            params, prompt, std::vector<std::string>(), "", 0,
+            COMMON_REASONING_FORMAT_NONE, "", "", "", "", "", "", -1, -1,
+            [](const completion_token_output& token) {},
+            [&](llama_rn_slot* slot) {
+                slot_id = slot->id;
+                complete = !slot->incomplete;
+            },
+            -1, {}, 0, {la}
+        );
+        for (int i = 0; i < 100 && !complete; i++) {
+            ctx.slot_manager->update_slots();
+        }
+        if (!complete || slot_id < 0) return false;
+
+        llama_rn_slot & slot = ctx.slot_manager->slots[slot_id];
+        bool ok = ctx.slot_manager->get_reusable_prefix(slot, prompt, {}) == 0 &&
+                  ctx.slot_manager->get_reusable_prefix(slot, prompt, {}, {la}) >= prompt.size();
+
+        // The slot holds the adapter while routed through it; once it is not,
+        // the adapter is idle and goes when the idle cap says so
+        auto n_refs = [&]() {
+            auto it = ctx.lora_registry.find(path.string());
+            return it != ctx.lora_registry.end() ? it->second.n_refs : -1;
+        };
+        ok = ok && n_refs() == 1;
+        ok = ok && ctx.slot_manager->set_slot_lora(slot, {}) && n_refs() == 0;
+        ctx.lora_registry_max_idle = 0;
+        ok = ok && ctx.acquireLoraAdapter(path.string()) == adapter && n_refs() == 1;
+        ctx.releaseLoraAdapter(path.string());
+        return ok && n_refs() == -1 && ctx.lora_registry.empty();
+    } catch (const std::exception & e) {
+        std::cout << "  exception: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+// Test 37: tiered prompt-state store - LZ round trips, and snapshots past the
+// hot share / RAM budget get packed / spilled yet restore byte-exact
+bool test_tiered_state_store() {
+    try {
+        namespace fs = std::filesystem;
+        std::mt19937 rng(7);
+        auto blob = [&](size_t n, int seed, bool compressible) {
+            std::vector<uint8_t> b(n);
+            for (size_t i = 0; i < n; ++i) {
+                b[i] = compressible ? (uint8_t) ((i % 64 < 48) ? 0 : (i / 64 + seed) & 0xff) : (uint8_t) rng();
+            }
+            return b;
+        };
+
+        bool ok = true;
+        for (const auto & src : { blob(200000, 1, true), blob(50000, 0, false), std::vector<uint8_t>(), blob(3, 2, true) }) {
+            std::vector<uint8_t> packed;
+            rn_lz_compress(src.data(), src.size(), packed);
+            std::vector<uint8_t> out(src.size());
+            ok = ok && rn_lz_decompress(packed.data(), packed.size(), out.data(), out.size()) && out == src;
+            if (src.size() > 1000) {
+                // Truncated input or a wrong size must fail, not overrun
+                std::vector<uint8_t> big(src.size() + 1);
+                ok = ok && !rn_lz_decompress(packed.data(), packed.size() / 2, out.data(), out.size());
+                ok = ok && !rn_lz_decompress(packed.data(), packed.size(), big.data(), big.size());
+            }
+        }
+        std::vector<uint8_t> packed;
+        rn_lz_compress(blob(200000, 1, true).data(), 200000, packed);
+        ok = ok && packed.size() < 200000 / 8;
+        if (!ok) {
+            std::cout << "  codec round trip failed" << std::endl;
+            return false;
+        }
+
+        const size_t n_blob = 64 * 1024;
+        const fs::path dir = fs::temp_directory_path() / "rn_state_store_test";
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+
+        llama_rn_context parent;
+        llama_rn_context_completion cmpl(&parent);
+        cmpl.state_cache_max_checkpoints = 8;
+        cmpl.state_cache_hot_bytes = n_blob;
+        cmpl.state_cache_budget_bytes = n_blob + n_blob / 8;
+        cmpl.state_cache_dir = dir.string();
+        cmpl.state_cache_disk_bytes = 16 * n_blob;
+
+        // One conversation growing by ten tokens per snapshot
+        std::vector<llama_token> conv;
+        std::vector<std::vector<uint8_t>> blobs;
+        for (int i = 0; i < 6; ++i) {
+            for (int k = 0; k < 10; ++k) conv.push_back(100 + i * 10 + k);
+            blobs.push_back(blob(n_blob, i, i != 3));
+            rn_state_checkpoint c;
+            c.n = conv.size();
+            c.data = blobs.back();
+            c.raw_size = c.data.size();
+            cmpl.checkpoint_index.insert(RN_PREFIX_CHECKPOINT, (int32_t) c.n, conv.data(), c.n);
+            cmpl.state_checkpoints.push_back(std::move(c));
+            cmpl.evictStateCheckpoints();
+        }
+
+        auto verify = [&](size_t expected_count) {
+            // Packs run in the background; settle them before counting tiers
+            for (auto & c : cmpl.state_checkpoints) {
+                c.finish_compress(true);
+            }
+            size_t ram = 0;
+            std::map<int, int> tiers;
+            for (const auto & c : cmpl.state_checkpoints) {
+                rn_state_reader reader;
+                const auto & want = blobs[c.n_tokens() / 10 - 1];
+                if (!reader.open(c) || reader.size() != want.size() ||
+                    memcmp(reader.data(), want.data(), want.size()) != 0) {
+                    std::cout << "  snapshot " << c.n_tokens() << " unreadable" << std::endl;
+                    return false;
+                }
+                if (c.tier != RN_STATE_TIER_DISK) ram += c.size_bytes();
+                tiers[c.tier]++;
+            }
+            return cmpl.state_checkpoints.size() == expected_count &&
+                   ram <= cmpl.state_cache_budget_bytes &&
+                   cmpl.state_checkpoints.back().tier == RN_STATE_TIER_HOT &&
+                   tiers[RN_STATE_TIER_COMPRESSED] > 0 && tiers[RN_STATE_TIER_DISK] > 0;
+        };
+        ok = verify(6);
+
+        // Lookups go through the shared-prefix index, whatever the tier
+        std::vector<llama_token> query(conv.begin(), conv.begin() + 35);
+        const int idx = cmpl.findStateCheckpoint(query, query.size());
+        ok = ok && idx >= 0 && cmpl.state_checkpoints[idx].n_tokens() == 30;
+
+        // Spill files are unlinked as soon as they are written
+        ok = ok && fs::is_empty(dir);
+
+        // Shrinking the disk budget drops the spilled snapshots, except the
+        // smallest-position one
+        cmpl.state_cache_disk_bytes = 0;
+        cmpl.evictStateCheckpoints();
+        for (const auto & c : cmpl.state_checkpoints) {
+            ok = ok && (c.tier != RN_STATE_TIER_DISK || c.n_tokens() == 10);
+        }
+        ok = ok && cmpl.state_checkpoints.size() < 6 && cmpl.state_checkpoints.front().n_tokens() == 10;
+        cmpl.clearStateCheckpoints();
+
+        // A spill that fails turns the disk tier off; the RAM budget is then
+        // met by dropping snapshots
+        cmpl.state_cache_dir = (dir / "missing").string();
+        cmpl.state_cache_disk_bytes = 16 * n_blob;
+        cmpl.state_cache_hot_bytes = n_blob;
+        cmpl.state_cache_budget_bytes = 2 * n_blob;
+        for (int i = 0; i < 4; ++i) {
+            rn_state_checkpoint c;
+            c.n = (size_t) (i + 1) * 10;
+            c.data = blob(n_blob, i, false);
+            c.raw_size = c.data.size();
+            cmpl.checkpoint_index.insert(RN_PREFIX_CHECKPOINT, (int32_t) c.n, conv.data(), c.n);
+            cmpl.state_checkpoints.push_back(std::move(c));
+            cmpl.evictStateCheckpoints();
+        }
+        size_t ram = 0;
+        for (const auto & c : cmpl.state_checkpoints) {
+            ok = ok && c.tier != RN_STATE_TIER_DISK;
+            ram += c.size_bytes();
+        }
+        ok = ok && cmpl.state_cache_disk_failed && ram <= cmpl.state_cache_budget_bytes &&
+             cmpl.state_checkpoints.front().n_tokens() == 10;
+
+        cmpl.clearStateCheckpoints();
+        fs::remove_all(dir);
+        return ok;
+    } catch (const std::exception & e) {
+        std::cout << "  exception: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+// Test 38: background state writer - staged files land in submit order via a
+// temp file + rename, hooks run off the caller's thread, failures are reported
+bool test_async_state_save() {
+    try {
+        namespace fs = std::filesystem;
+        const fs::path dir = fs::temp_directory_path() / "rn_state_writer_test";
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+        const std::string path = (dir / "slot.bin").string();
+
+        auto make_job = [](const std::string & p, uint8_t fill, size_t n) {
+            rn_state_save_job job;
+            job.path = p;
+            job.header = { 'H', fill };
+            job.blob.assign(n, fill);
+            job.blob[0] = 0xee;  // Skipped prefix
+            job.blob_offset = 1;
+            return job;
+        };
+
+        rn_state_writer writer;
+        std::mutex log_mutex;
+        std::vector<std::string> log;
+        const std::thread::id caller = std::this_thread::get_id();
+        bool off_thread = true;
+        for (uint8_t i = 1; i <= 4; ++i) {
+            auto job = make_job(path, i, 256 * 1024);
+            job.before_commit = [&, i]() {
+                std::lock_guard<std::mutex> lock(log_mutex);
+                log.push_back("commit " + std::to_string(i));
+            };
+            job.on_done = [&, i](bool ok) {
+                std::lock_guard<std::mutex> lock(log_mutex);
+                off_thread = off_thread && std::this_thread::get_id() != caller;
+                log.push_back(std::string(ok ? "done " : "failed ") + std::to_string(i));
+            };
+            writer.submit(std::move(job));
+        }
+
+        bool ok = writer.wait(path) && writer.n_pending() == 0 && off_thread;
+        const std::vector<std::string> expected_log = {
+            "commit 1", "done 1", "commit 2", "done 2", "commit 3", "done 3", "commit 4", "done 4"
+        };
+        ok = ok && log == expected_log;
+
+        // The last save wins, written without the skipped blob prefix
+        std::ifstream in(path, std::ios::binary);
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        std::vector<uint8_t> want = { 'H', 4 };
+        want.insert(want.end(), 256 * 1024 - 1, 4);
+        ok = ok && data == want && !fs::exists(path + ".tmp");
+        if (!ok) {
+            std::cout << "  ordered saves failed" << std::endl;
+            return false;
+        }
+
+        // A save into a missing directory fails without touching other paths
+        const std::string bad_path = (dir / "missing" / "slot.bin").string();
+        writer.submit(make_job(bad_path, 5, 1024));
+        writer.submit(make_job(path, 6, 1024));
+        ok = !writer.wait(bad_path) && writer.wait(path) && !writer.flush() && writer.flush();
+
+        // The synchronous path writes the same file
+        const std::string sync_path = (dir / "session.bin").string();
+        ok = ok && rn_write_state_file(make_job(sync_path, 7, 1024)) && fs::file_size(sync_path) == 2 + 1023;
+
+        writer.stop();
+        fs::remove_all(dir);
+        return ok;
+    } catch (const std::exception & e) {
+        std::cout << "  exception: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+// Test 39: lazy state load - restoring only the prompt-shared prefix of a slot
+// state file gives the same next-token logits as restoring it whole and
+// trimming, and the header tokens are readable without touching the KV data
+bool test_lazy_state_load() {
+    try {
+        namespace fs = std::filesystem;
+        llama_rn_context ctx;
+
+        common_params params;
+        params.model.path = "../tiny-random-llama.gguf";
+        params.n_ctx = 256;
+        params.n_batch = 64;
+        params.cpuparams.n_threads = 1;
+        params.n_gpu_layers = 0;
+        params.no_kv_offload = true;
+
+        if (!ctx.loadModel(params)) {
+            std::cout << "[SKIP: Model not loaded] ";
+            return true;
+        }
+
+        const int n_vocab = llama_vocab_n_tokens(llama_model_get_vocab(ctx.model));
+        std::vector<llama_token> prompt = common_tokenize(
+            ctx.ctx, "The quick brown fox jumps over the lazy dog while the cat sleeps in the warm sun", false);
+        prompt.resize(std::min<size_t>(prompt.size(), params.n_batch));
+        const int n_keep = (int) prompt.size() / 2;
+        auto * mem = llama_get_memory(ctx.ctx);
+
+        llama_memory_clear(mem, true);
+        llama_batch batch = llama_batch_init(prompt.size(), 0, 1);
+        for (size_t i = 0; i < prompt.size(); ++i) {
+            common_batch_add(batch, prompt[i], i, {0}, false);
+        }
+        const bool decoded = llama_decode(ctx.ctx, batch) == 0;
+        llama_batch_free(batch);
+        if (!decoded) return false;
+
+        const fs::path path = fs::temp_directory_path() / "rn_lazy_state_test.bin";
+        if (llama_state_seq_save_file(ctx.ctx, path.string().c_str(), 0, prompt.data(), prompt.size()) == 0) {
+            return false;
+        }
+
+        std::vector<llama_token> header_tokens;
+        bool ok = read_state_file_tokens(path.string(), header_tokens) && header_tokens == prompt;
+
+        // Logits of the token after the first n_keep positions, given how the
+        // memory was restored
+        auto next_logits = [&](bool prefix_only) {
+            std::vector<float> logits;
+            llama_memory_clear(mem, true);
+            std::vector<llama_token> tokens(prompt.size());
+            size_t n_tokens = 0;
+            const size_t nread = llama_state_seq_load_file_prefix(
+                ctx.ctx, path.string().c_str(), 0, prefix_only ? n_keep : -1,
+                tokens.data(), tokens.size(), &n_tokens);
+            if (nread == 0) return logits;
+            if (prefix_only) {
+                if (n_tokens != (size_t) n_keep || llama_memory_seq_pos_max(mem, 0) != n_keep - 1) {
+                    return logits;
+                }
+            } else {
+                if (n_tokens != prompt.size()) return logits;
+                llama_memory_seq_rm(mem, 0, n_keep, -1);
+            }
+            llama_batch next = llama_batch_init(1, 0, 1);
+            common_batch_add(next, prompt[n_keep], n_keep, {0}, true);
+            if (llama_decode(ctx.ctx, next) == 0) {
+                const float * l = llama_get_logits_ith(ctx.ctx, -1);
+                logits.assign(l, l + n_vocab);
+            }
+            llama_batch_free(next);
+            return logits;
+        };
+        const std::vector<float> ref = next_logits(false);
+        const std::vector<float> lazy = next_logits(true);
+        ok = ok && !ref.empty() && lazy.size() == ref.size();
+        for (size_t i = 0; ok && i < ref.size(); ++i) {
+            ok = std::fabs(ref[i] - lazy[i]) < 1e-4f;
+        }
+        if (!ok) {
+            std::cout << "  prefix restore differs from full restore" << std::endl;
+        }
+
+        fs::remove(path);
+        return ok;
+    } catch (const std::exception & e) {
+        std::cout << "  exception: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+// Test 40: batched MTP step budget - each slot's draft fits the batch room it
+// is given, its token budget and the context, and stop conditions keep the
+// slot out of the shared verify batch
+bool test_mtp_draft_budget() {
+    try {
+        llama_rn_slot slot;
+        slot.id = 0;
+        slot.reset();
+
+        common_params params;
+        params.speculative.types = { COMMON_SPECULATIVE_TYPE_DRAFT_MTP };
+        params.speculative.draft.n_max = 4;
+        slot.params_storage = params;
+        slot.params = &slot.params_storage;
+
+        slot.n_ctx = 100;
+        slot.spec_n_past = 10;
+        slot.n_remaining = -1;
+        bool ok = slot.mtp_draft_limit(64) == 4 &&  // n_max
+                  slot.mtp_draft_limit(3) == 2 &&   // Room, less the id_last row
+                  slot.mtp_draft_limit(1) == 0;
+        slot.n_remaining = 2;
+        ok = ok && slot.mtp_draft_limit(64) == 1;   // id_last's successor is always verified
+        slot.n_remaining = -1;
+        slot.spec_n_past = 97;
+        ok = ok && slot.mtp_draft_limit(64) == 2;   // Context
+        if (!ok) {
+            std::cout << "  draft limits wrong" << std::endl;
+            return false;
+        }
+
+        // Stop conditions are settled before the shared draft step
+        slot.spec_n_past = 10;
+        slot.spec_id_last = 1;
+        slot.n_remaining = 0;
+        ok = !slot.begin_mtp_draft(64) && slot.stopped_limit && slot.spec_i_batch == -1;
+        slot.stopped_limit = false;
+        slot.n_remaining = -1;
+        slot.spec_n_past = 99;
+        ok = ok && !slot.begin_mtp_draft(64) && slot.context_full;
+
+        slot.reset();
+        return ok && slot.spec_n_draft_max == 0 && slot.spec_i_batch == -1;
+    } catch (...) {
+        return false;
+    }
+}
+
+// Test 41: cancelling a split embedding batch delivers its gathered results
+// once, marked incomplete, and drops every part from the status report
+bool test_split_request_cancel() {
+    try {
+        llama_rn_context ctx;
+
+        common_params params;
+        params.model.path = "../tiny-random-llama.gguf";
+        params.n_ctx = 512;
+        params.n_batch = 128;
+        params.n_parallel = 2;
+        params.cpuparams.n_threads = 1;
+        params.n_gpu_layers = 0;
+        params.no_kv_offload = true;
+        params.embedding = true;
+        params.pooling_type = LLAMA_POOLING_TYPE_MEAN;
+
+        if (!ctx.loadModel(params)) {
+            std::cout << "[SKIP: Model not loaded] ";
+            return true;
+        }
+        ctx.enableParallelMode(2, 128);
+
+        const bool add_bos = llama_vocab_get_add_bos(llama_model_get_vocab(ctx.model));
+        std::vector<std::vector<llama_token>> inputs;
+        for (const char* text : {"one", "two", "three", "four"}) {
+            inputs.push_back(common_tokenize(ctx.ctx, text, add_bos, true));
+        }
+
+        int n_calls = 0;
+        bool incomplete = false;
+        size_t n_values = 0;
+        const int32_t request_id = ctx.slot_manager->queue_embedding_batch_request(inputs, 2,
+            [&](int32_t, const std::vector<float>& result, bool is_incomplete) {
+                n_calls++;
+                incomplete = is_incomplete;
+                n_values = result.size();
+            });
+        if (ctx.slot_manager->get_status().requests.size() != 2) return false;
+
+        ctx.slot_manager->cancel_request(request_id);
+        for (int i = 0; i < 4; i++) {
+            ctx.slot_manager->update_slots();
+        }
+
+        return n_calls == 1 && incomplete &&
+               n_values == inputs.size() * llama_model_n_embd(ctx.model) &&
+               ctx.slot_manager->get_status().requests.empty();
+    } catch (...) {
+        return false;
+    }
+}
+
+// Test 42: batched MTP verify is lossless - greedy slots verifying drafts in
+// one shared batch emit exactly the tokens plain greedy decoding does. Needs a
+// checkpoint with an MTP head (RNLLAMA_TEST_MTP_MODEL); skipped without one.
+bool test_mtp_batched_matches_greedy() {
+    try {
+        const char * model_path = getenv("RNLLAMA_TEST_MTP_MODEL");
+        if (model_path == nullptr || *model_path == '\0') {
+            std::cout << "[SKIP: RNLLAMA_TEST_MTP_MODEL not set] ";
+            return true;
+        }
+
+        llama_rn_context ctx;
+        common_params params;
+        params.model.path = model_path;
+        params.n_ctx = 1024;
+        params.n_batch = 256;
+        params.n_parallel = 2;
+        params.cpuparams.n_threads = 2;
+        params.n_gpu_layers = 0;
+        params.no_kv_offload = true;
+        params.n_predict = 24;
+        params.sampling.temp = 0.0f;
+        params.sampling.top_k = 1;
+        if (!ctx.loadModel(params)) {
+            std::cout << "[SKIP: Model not loaded] ";
+            return true;
+        }
+        ctx.enableParallelMode(2, 256);
+
+        const std::vector<std::string> prompts = { "The capital of France is", "Once upon a time" };
+        auto run = [&](const common_params & req_params) {
+            std::vector<std::vector<llama_token>> out(prompts.size());
+            int n_done = 0;
+            for (size_t i = 0; i < prompts.size(); i++) {
+                const int32_t id = ctx.slot_manager->queue_request(
+                    req_params, common_tokenize(ctx.ctx, prompts[i], true), std::vector<std::string>(),
+                    prompts[i], 0, COMMON_REASONING_FORMAT_NONE, "", "", "", "", "", "", -1, -1,
+                    [&out, i](const completion_token_output & token) { out[i].push_back(token.tok); },
+                    [&n_done](llama_rn_slot *) { n_done++; });
+                if (id < 0) {
+                    return std::vector<std::vector<llama_token>>();
+                }
+            }
+            for (int iter = 0; iter < 1000 && n_done < (int) prompts.size(); iter++) {
+                ctx.slot_manager->update_slots();
+            }
+            return out;
+        };
+
+        // Both requests run together, so their drafts share one verify batch
+        const auto plain = run(params);
+        common_params mtp_params = params;
+        mtp_params.speculative.types = { COMMON_SPECULATIVE_TYPE_DRAFT_MTP };
+        mtp_params.speculative.draft.n_max = 4;
+        const auto batched = run(mtp_params);
+
+        bool ok = plain.size() == prompts.size() && batched == plain;
+        for (const auto & tokens : plain) {
+            ok = ok && !tokens.empty();
+        }
+        if (!ok) {
+            std::cout << "  batched MTP output differs from greedy" << std::endl;
+        }
+        return ok;
+    } catch (const std::exception & e) {
+        std::cout << "  exception: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+// Test 43: cancelling a slot's media job - a queued job is skipped by the
+// worker, a taken one is discarded, and the slot can queue a fresh job
+bool test_media_job_cancel() {
+    try {
+        llama_rn_context ctx;  // No multimodal: every encode fails fast
+        llama_rn_slot_manager manager(&ctx);
+        if (!manager.init(2, 32, 768)) return false;
+        for (auto& slot : manager.slots) {
+            slot.request_id = slot.id + 1;
+            slot.prompt_text = "<__media__>";
+            slot.media_paths = {"/path/to/image.jpg"};
+        }
+        auto wait_done = [](const std::shared_ptr<llama_rn_media_job>& job) {
+            for (int i = 0; i < 500 && !job->done.load(); i++) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            return job->done.load();
+        };
+
+        std::shared_ptr<llama_rn_media_job> running, queued;
+        {
+            // The worker reports each finished job under slots_mutex, so
+            // holding it keeps the second job in the queue
+            std::unique_lock<std::mutex> lock(manager.slots_mutex);
+            manager.submit_media_job(manager.slots[0]);
+            manager.submit_media_job(manager.slots[1]);
+            running = manager.media_jobs[0];
+            queued = manager.media_jobs[1];
+            if (!wait_done(running)) return false;
+            {
+                std::lock_guard<std::mutex> media_lock(manager.media_mutex);
+                if (manager.media_queue.size() != 1 || manager.media_queue.front() != queued) return false;
+            }
+
+            manager.drop_media_job(0);
+            manager.drop_media_job(1);
+            if (!manager.media_jobs.empty() || !running->cancelled.load() || !queued->cancelled.load()) return false;
+            if (manager.is_waiting_for_media(manager.slots[1])) return false;
+        }
+
+        // The queued job is never encoded; the taken one keeps its result,
+        // which no slot picks up any more
+        if (!wait_done(queued) || !queued->error.empty() || queued->prepared) return false;
+        if (running->error.empty()) return false;
+
+        // A new request on the slot gets its own job
+        std::shared_ptr<llama_rn_media_job> again;
+        {
+            std::lock_guard<std::mutex> lock(manager.slots_mutex);
+            manager.slots[0].request_id = 3;
+            manager.submit_media_job(manager.slots[0]);
+            again = manager.media_jobs[0];
+            if (again == running || again->request_id != 3 || again->cancelled.load()) return false;
+        }
+        return wait_done(again) && !again->error.empty();
+    } catch (...) {
+        return false;
+    }
+}
+
+// Test 44: stopping the media worker fails the jobs still queued instead of
+// leaving their slots waiting, a later job restarts it, and the manager shuts
+// down with jobs pending
+bool test_media_job_shutdown() {
+    try {
+        llama_rn_context ctx;
+        auto wait_done = [](const std::shared_ptr<llama_rn_media_job>& job) {
+            for (int i = 0; i < 500 && !job->done.load(); i++) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            return job->done.load();
+        };
+        std::vector<std::shared_ptr<llama_rn_media_job>> jobs;
+        {
+            llama_rn_slot_manager manager(&ctx);
+            if (!manager.init(3, 32, 768)) return false;
+            for (auto& slot : manager.slots) {
+                slot.request_id = slot.id + 1;
+                slot.prompt_text = "<__media__>";
+                slot.media_paths = {"/path/to/image.jpg"};
+            }
+
+            std::thread stopper;
+            {
+                std::unique_lock<std::mutex> lock(manager.slots_mutex);
+                for (auto& slot : manager.slots) {
+                    manager.submit_media_job(slot);
+                    jobs.push_back(manager.media_jobs[slot.id]);
+                }
+                if (!wait_done(jobs[0])) return false;
+
+                // The worker is parked on slots_mutex with two jobs queued
+                stopper = std::thread([&manager]() { manager.stop_media_worker(); });
+                for (int i = 0; i < 500; i++) {
+                    std::lock_guard<std::mutex> media_lock(manager.media_mutex);
+                    if (manager.media_stopping) break;
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            }
+            stopper.join();
+
+            if (manager.media_thread.joinable() || !manager.media_queue.empty()) return false;
+            for (size_t i = 1; i < jobs.size(); i++) {
+                if (!jobs[i]->done.load() || jobs[i]->error != "Media encoding stopped") return false;
+            }
+            {
+                std::lock_guard<std::mutex> lock(manager.slots_mutex);
+                if (manager.is_waiting_for_media(manager.slots[1]) || manager.is_waiting_for_media(manager.slots[2])) {
+                    return false;
+                }
+
+                // Submitting again brings the worker back
+                manager.slots[0].request_id = 4;
+                manager.submit_media_job(manager.slots[0]);
+                jobs[0] = manager.media_jobs[0];
+            }
+            if (!wait_done(jobs[0]) || jobs[0]->error == "Media encoding stopped") return false;
+
+            // Leave jobs queued for the destructor
+            std::lock_guard<std::mutex> lock(manager.slots_mutex);
+            for (auto& slot : manager.slots) {
+                slot.request_id += 10;
+                manager.submit_media_job(slot);
+                jobs[slot.id] = manager.media_jobs[slot.id];
+            }
+        }
+        // Every job is settled once the manager is gone
+        for (const auto& job : jobs) {
+            if (!job->done.load()) return false;
+        }
+        return true;
+    } catch (...) {
+        return false;
+    }
+}
+
 int main() {
     std::cout << "=== Parallel Decoding Tests ===" << std::endl;
     std::cout << "Testing parallel decoding implementation for llama.rn" << std::endl;
@@ -1523,6 +2779,7 @@ int main() {
     results.run_test("Slot State Transitions", test_slot_state_transitions());
     results.run_test("Slot Prompt Loading", test_slot_prompt_loading());
     results.run_test("Slot MTP Params and Reset", test_slot_mtp_params_and_reset());
+    results.run_test("MTP Draft Budget", test_mtp_draft_budget());
     results.run_test("Slot Cache Prefix Matching", test_cache_prefix_matching());
     results.run_test("Slot has_next_token Logic", test_has_next_token());
     results.run_test("Slot Request Lifecycle", test_slot_request_lifecycle());
@@ -1531,6 +2788,14 @@ int main() {
     results.run_test("Slot Manager Initialization", test_slot_manager_initialization());
     results.run_test("Queue Request Structure", test_queue_request_structure());
     results.run_test("Multimodal Request", test_multimodal_request());
+    results.run_test("Prefix-Aware Slot Routing", test_prefix_slot_routing());
+    results.run_test("Radix Prefix Index", test_prefix_index());
+    results.run_test("Sampling Pool", test_sampling_pool());
+    results.run_test("Fair Prefill Scheduling", test_fair_prefill_scheduling());
+    results.run_test("Media Embedding Cache", test_media_embd_cache());
+    results.run_test("Chat Format Cache", test_chat_format_cache());
+    results.run_test("Tiered State Store", test_tiered_state_store());
+    results.run_test("Async State Save", test_async_state_save());
 
     // Context integration tests
     results.run_test("Parallel Mode Toggle", test_parallel_mode_toggle());
@@ -1552,6 +2817,12 @@ int main() {
     results.run_test("Queue Overflow Handling", test_queue_overflow());
     results.run_test("Queue Request with State", test_queue_request_with_state());
     results.run_test("State Reuse", test_state_reuse());
+    results.run_test("Shared Prefix Across Slots", test_shared_prefix_across_slots());
+    results.run_test("Embedding Batch", test_embedding_batch());
+    results.run_test("Per-Sequence LoRA", test_lora_per_sequence());
+    results.run_test("Lazy State Load", test_lazy_state_load());
+    results.run_test("Split Request Cancel", test_split_request_cancel());
+    results.run_test("MTP Batched Matches Greedy", test_mtp_batched_matches_greedy());
 
     std::cout << "\n--- Status API Tests ---" << std::endl;
 
@@ -1561,6 +2832,8 @@ int main() {
     results.run_test("Status Subscription", test_status_subscription());
     results.run_test("Status Unsubscribe", test_status_unsubscribe());
     results.run_test("Status Request Metrics", test_status_request_metrics());
+    results.run_test("Media Job Cancel", test_media_job_cancel());
+    results.run_test("Media Job Shutdown", test_media_job_shutdown());
 
     // Print summary
     results.print_summary();
@@ -0,0 +1,144 @@
+// Throughput benchmark for rerank: scores the same (query, documents) set one
+// document per call (the old sequential path) and in one batched call, which
+// packs documents into shared decodes and forks the query prefix where the
+// model allows it. Reports docs/sec and the largest score difference between
+// the two runs.
+//
+//   BENCH,<model>,<mode>,<n_docs>,<total_ms>,<docs_per_s>,<max_abs_diff>
+//
+// Env: MODELS_DIR, RNLLAMA_NGL, BENCH_DOCS (default 32), BENCH_SEQ (default 8),
+//      BENCH_REPEAT (default 3).
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rn-llama.h"
+#include "rn-completion.h"
+#include "common.h"
+
+using namespace rnllama;
+
+namespace {
+
+int env_i(const char *k, int d) {
+    const char *v = std::getenv(k);
+    return v ? std::atoi(v) : d;
+}
+
+bool load(llama_rn_context &ctx, const std::string &path, int n_seq) {
+    common_params params;
+    params.model.path = path;
+    params.n_ctx = 8192;
+    params.n_batch = 2048;
+    params.n_ubatch = 2048;
+    params.n_parallel = n_seq;
+    params.kv_unified = true;
+    params.embedding = true;
+    params.pooling_type = LLAMA_POOLING_TYPE_RANK;
+    params.cpuparams.n_threads = std::max(1u, std::thread::hardware_concurrency() / 2);
+    const char *ngl = std::getenv("RNLLAMA_NGL");
+    params.n_gpu_layers = ngl ? std::atoi(ngl) : 0;
+    params.no_kv_offload = params.n_gpu_layers == 0;
+    if (!ctx.loadModel(params)) return false;
+    if (ctx.completion == nullptr) ctx.completion = new llama_rn_context_completion(&ctx);
+    return true;
+}
+
+std::vector<std::string> make_documents(int n) {
+    static const char *topics[] = {
+        "the water cycle", "photosynthesis in plants", "the history of the printing press",
+        "how vaccines train the immune system", "plate tectonics", "the rules of chess",
+        "compound interest", "the migration of monarch butterflies",
+    };
+    std::vector<std::string> docs;
+    for (int i = 0; i < n; i++) {
+        std::string d = "Document " + std::to_string(i + 1) + " explains " +
+            topics[i % (sizeof(topics) / sizeof(topics[0]))] + ".";
+        for (int j = 0; j <= i % 4; j++) d += " It covers the basics and a few common misconceptions.";
+        docs.push_back(d);
+    }
+    return docs;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const char *env_dir = std::getenv("MODELS_DIR");
+    std::filesystem::path models_dir =
+        env_dir ? std::filesystem::path(env_dir)
+                : std::filesystem::path(__FILE__).parent_path() / "models";
+    const int n_docs  = env_i("BENCH_DOCS", 32);
+    const int n_seq   = env_i("BENCH_SEQ", 8);
+    const int repeats = std::max(1, env_i("BENCH_REPEAT", 3));
+
+    // key -> file (subset that exists is run)
+    const std::vector<std::pair<std::string, std::string>> models = {
+        {"qwen3-reranker", "qwen3-reranker.gguf"},
+        {"bge-reranker", "bge-reranker.gguf"},
+        {"jina-reranker", "jina-reranker.gguf"},
+    };
+    std::vector<std::string> want;
+    for (int i = 1; i < argc; i++) want.push_back(argv[i]);
+
+    const std::string query =
+        "Which of these explains how living things turn sunlight into chemical energy?";
+    const std::vector<std::string> docs = make_documents(n_docs);
+
+    printf("BENCH_HEADER,model,mode,n_docs,total_ms,docs_per_s,max_abs_diff\n");
+    for (const auto &m : models) {
+        if (!want.empty() && std::find(want.begin(), want.end(), m.first) == want.end()) continue;
+        const auto p = models_dir / m.second;
+        if (!std::filesystem::exists(p)) continue;
+
+        llama_rn_context ctx;
+        if (!load(ctx, p.string(), n_seq)) {
+            printf("BENCH,%s,load-failed,0,0,0,0\n", m.first.c_str());
+            continue;
+        }
+        auto *cmpl = ctx.completion;
+        auto ms = [](auto d) { return std::chrono::duration<double, std::milli>(d).count(); };
+
+        // Warm up both paths once
+        cmpl->rerank(query, {docs[0]});
+        cmpl->rerank(query, docs);
+
+        std::vector<float> sequential(docs.size());
+        double seq_ms = 0;
+        for (int r = 0; r < repeats; r++) {
+            const auto t0 = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < docs.size(); i++) {
+                sequential[i] = cmpl->rerank(query, {docs[i]})[0];
+            }
+            seq_ms += ms(std::chrono::steady_clock::now() - t0);
+        }
+        seq_ms /= repeats;
+
+        std::vector<float> batched;
+        double batch_ms = 0;
+        for (int r = 0; r < repeats; r++) {
+            const auto t0 = std::chrono::steady_clock::now();
+            batched = cmpl->rerank(query, docs);
+            batch_ms += ms(std::chrono::steady_clock::now() - t0);
+        }
+        batch_ms /= repeats;
+
+        float max_diff = 0.0f;
+        for (size_t i = 0; i < docs.size(); i++) {
+            max_diff = std::max(max_diff, std::fabs(sequential[i] - batched[i]));
+        }
+
+        printf("BENCH,%s,sequential,%zu,%.1f,%.2f,0\n",
+               m.first.c_str(), docs.size(), seq_ms, docs.size() * 1000.0 / seq_ms);
+        printf("BENCH,%s,batched,%zu,%.1f,%.2f,%.6f\n",
+               m.first.c_str(), docs.size(), batch_ms, docs.size() * 1000.0 / batch_ms, max_diff);
+        fflush(stdout);
+    }
+    return 0;
+}
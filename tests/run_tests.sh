@@ -34,6 +34,18 @@ if [ ! -f "chat_parse_utf8_test" ]; then
     exit 1
 fi
 
+if [ ! -f "tokenizer_test" ]; then
+    echo "Error: tokenizer_test executable not found"
+    echo "Please run ./build_and_test.sh first"
+    exit 1
+fi
+
+if [ ! -f "tts_codec_test" ]; then
+    echo "Error: tts_codec_test executable not found"
+    echo "Please run ./build_and_test.sh first"
+    exit 1
+fi
+
 echo "Found all test executables"
 
 TESTS_PASSED=0
@@ -75,10 +87,34 @@ fi
 
 echo ""
 
+# Run tokenizer and grammar tests
+echo "--- Running Tokenizer and Grammar Tests ---"
+if ./tokenizer_test; then
+    echo "✓ Tokenizer and grammar tests passed"
+    TESTS_PASSED=$((TESTS_PASSED + 1))
+else
+    echo "✗ Tokenizer and grammar tests failed"
+    TESTS_FAILED=$((TESTS_FAILED + 1))
+fi
+
+echo ""
+
+# Run TTS codec runtime tests
+echo "--- Running TTS Codec Runtime Tests ---"
+if ./tts_codec_test; then
+    echo "✓ TTS codec runtime tests passed"
+    TESTS_PASSED=$((TESTS_PASSED + 1))
+else
+    echo "✗ TTS codec runtime tests failed"
+    TESTS_FAILED=$((TESTS_FAILED + 1))
+fi
+
+echo ""
+
 # Run KV-cache-reuse tests (only if the GGUF models have been downloaded)
-TOTAL_SUITES=3
+TOTAL_SUITES=5
 if [ -f "kv_cache_reuse_test" ] && ls ../models/*.gguf >/dev/null 2>&1; then
-    TOTAL_SUITES=4
+    TOTAL_SUITES=6
     echo "--- Running KV-cache-reuse Tests ---"
     if ./kv_cache_reuse_test; then
         echo "✓ KV-cache-reuse tests passed"
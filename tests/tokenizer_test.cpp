@@ -0,0 +1,461 @@
+// Tokenizer and grammar tests on small vocab-only models (no weights needed):
+// BPE fast path, parallel / batched tokenize, grammar token masks and
+// jump-forward.  The vocabs come from bpe_vocab_fixture.h.
+
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "rn-llama.h"
+#include "common.h"
+#include "bpe_vocab_fixture.h"
+
+using namespace rnllama;
+
+// Test result tracking (same shape as parallel_decoding_test.cpp)
+struct TestResults {
+    int total_tests = 0;
+    int passed_tests = 0;
+
+    void run_test(const std::string& name, bool result) {
+        total_tests++;
+        std::cout << "TEST: " << name << " ... ";
+        if (result) {
+            std::cout << "\033[0;32mPASSED\033[0m" << std::endl;
+            passed_tests++;
+        } else {
+            std::cout << "\033[0;31mFAILED\033[0m" << std::endl;
+        }
+    }
+
+    void print_summary() {
+        std::cout << "\n=== Test Summary ===" << std::endl;
+        std::cout << "Total tests: " << total_tests << std::endl;
+        std::cout << "Passed: " << passed_tests << std::endl;
+        std::cout << "Failed: " << (total_tests - passed_tests) << std::endl;
+    }
+};
+
+// Test 1: BPE tokenizer fast path (compiled merges, word cache, number pre-tokenizers)
+// must match the string-pair merge path and std::regex splitting byte for byte
+bool test_bpe_tokenizer_fast_path() {
+    try {
+        namespace fs = std::filesystem;
+        const std::vector<std::string> texts = {
+            "The quick brown fox jumps over the lazy dog. The dog didn't care; it's lazy.",
+            "int main() {\n    return tokenize(text, 1234567) + 89;\n}\n\n\n",
+            "naïve café — 東京タワー 😀 numbers: ٣٤٥٦ and ² ³ ½",
+            "  leading and   multiple   spaces\t\ttabs\r\nwindows newline   ",
+            "unseen wordsxyz qqqq zzzz thethethe 0000000000",
+        };
+
+        // Number pre-tokenizers vs std::regex (the non-capturing group bypasses the custom path)
+        const std::vector<std::pair<std::string, std::string>> number_exprs = {
+            { "\\p{N}",      "(?:\\p{N})" },
+            { "\\p{N}{1,3}", "(?:\\p{N}){1,3}" },
+            { "\\p{N}+",     "(?:\\p{N})+" },
+        };
+        for (const auto & text : texts) {
+            for (const auto & expr : number_exprs) {
+                if (unicode_regex_split(text, { expr.first }, false) != unicode_regex_split(text, { expr.second }, false)) {
+                    std::cout << "  number split mismatch for " << expr.first << std::endl;
+                    return false;
+                }
+            }
+            // Byte-level encoding matches a per-byte lookup of the raw words
+            const auto raw = unicode_regex_split(text, { "\\p{N}" }, false);
+            const auto enc = unicode_regex_split(text, { "\\p{N}" }, true);
+            if (raw.size() != enc.size()) return false;
+            for (size_t i = 0; i < raw.size(); i++) {
+                std::string expected;
+                for (const char c : raw[i]) expected += unicode_byte_to_utf8((uint8_t) c);
+                if (expected != enc[i]) return false;
+            }
+        }
+
+        std::vector<std::string> vocab_tokens;
+        const std::vector<std::string> merges = train_bpe_vocab(texts, 150, vocab_tokens);
+
+        const fs::path path = fs::temp_directory_path() / "rn_bpe_fast_path_test.gguf";
+        const std::vector<int32_t> token_types(vocab_tokens.size(), LLAMA_TOKEN_TYPE_NORMAL);
+
+        bool ok = true;
+        for (const char * pre : { "gpt-2", "llama-bpe", "qwen2", "starcoder", "deepseek-v3" }) {
+            if (!write_bpe_vocab(path.string(), pre, vocab_tokens, token_types, merges)) return false;
+
+            llama_model_params mparams = llama_model_default_params();
+            mparams.vocab_only = true;
+            setenv("LLAMA_BPE_NO_FAST_PATH", "1", 1);
+            llama_model * reference = llama_model_load_from_file(path.string().c_str(), mparams);
+            unsetenv("LLAMA_BPE_NO_FAST_PATH");
+            llama_model * fast = llama_model_load_from_file(path.string().c_str(), mparams);
+            if (reference == nullptr || fast == nullptr) {
+                llama_model_free(reference);
+                llama_model_free(fast);
+                return false;
+            }
+
+            // Twice: the second pass is served from the word cache
+            for (int pass = 0; pass < 2 && ok; pass++) {
+                for (const auto & text : texts) {
+                    const auto expected = tokenize_vocab(llama_model_get_vocab(reference), text);
+                    if (expected.empty() || tokenize_vocab(llama_model_get_vocab(fast), text) != expected) {
+                        std::cout << "  token mismatch (pre=" << pre << ", pass " << pass << ")" << std::endl;
+                        ok = false;
+                        break;
+                    }
+                }
+            }
+            llama_model_free(reference);
+            llama_model_free(fast);
+        }
+        fs::remove(path);
+        return ok;
+    } catch (...) {
+        return false;
+    }
+}
+
+// Test 2: parallel tokenization of long texts and the batched tokenize API
+// must produce exactly the sequential tokens
+bool test_parallel_tokenize() {
+    try {
+        namespace fs = std::filesystem;
+        const std::vector<std::string> texts = {
+            "The quick brown fox jumps over the lazy dog. The dog didn't care; it's lazy.",
+            "int main() {\n    return tokenize(text, 1234567) + 89;\n}\n\n\n",
+            "naïve café — 東京タワー 😀 numbers: ٣٤٥٦ and ² ³ ½",
+            "  leading and   multiple   spaces\t\ttabs\r\nwindows newline   ",
+        };
+        std::vector<std::string> vocab_tokens;
+        const std::vector<std::string> merges = train_bpe_vocab(texts, 120, vocab_tokens);
+        std::vector<int32_t> token_types(vocab_tokens.size(), LLAMA_TOKEN_TYPE_NORMAL);
+        const int32_t sep_id = (int32_t) vocab_tokens.size();
+        vocab_tokens.push_back("<|sep|>");
+        token_types.push_back(LLAMA_TOKEN_TYPE_CONTROL);
+
+        // ~200 KB of mixed text with special tokens, so it is cut into pieces
+        std::string long_text;
+        for (int i = 0; long_text.size() < 200 * 1024; i++) {
+            long_text += texts[i % texts.size()];
+            long_text += i % 7 == 0 ? "<|sep|>" : " word ";
+        }
+
+        const fs::path path = fs::temp_directory_path() / "rn_parallel_tokenize_test.gguf";
+        bool ok = true;
+        // The last vocab has a user-defined token with a space, which must
+        // disable cutting (and still tokenize identically)
+        for (int variant = 0; variant < 3 && ok; variant++) {
+            const char * pre = variant == 1 ? "qwen2" : "llama-bpe";
+            std::vector<std::string> tokens = vocab_tokens;
+            std::vector<int32_t> types = token_types;
+            if (variant == 2) {
+                tokens.push_back("fox jumps");
+                types.push_back(LLAMA_TOKEN_TYPE_USER_DEFINED);
+            }
+            if (!write_bpe_vocab(path.string(), pre, tokens, types, merges, sep_id)) return false;
+
+            llama_model_params mparams = llama_model_default_params();
+            mparams.vocab_only = true;
+            llama_model * model = llama_model_load_from_file(path.string().c_str(), mparams);
+            if (model == nullptr) return false;
+            const llama_vocab * vocab = llama_model_get_vocab(model);
+            const bool word_local = vocab_splits_at_word_boundaries(vocab);
+
+            for (const bool add_special : { false, true }) {
+                for (const bool parse_special : { false, true }) {
+                    const auto expected = common_tokenize(vocab, long_text, add_special, parse_special);
+                    if (expected.empty() || tokenize_parallel(vocab, long_text, add_special, parse_special, 4, word_local) != expected) {
+                        std::cout << "  long text mismatch (variant " << variant << ", add_special " << add_special
+                                  << ", parse_special " << parse_special << ")" << std::endl;
+                        ok = false;
+                    }
+                }
+            }
+
+            std::vector<std::string> batch = texts;
+            batch.push_back(long_text);
+            batch.push_back("");
+            const auto batch_tokens = tokenize_batch(vocab, batch, true, true, 3, word_local);
+            if (batch_tokens.size() != batch.size()) ok = false;
+            for (size_t i = 0; ok && i < batch.size(); i++) {
+                if (batch_tokens[i] != common_tokenize(vocab, batch[i], true, true)) {
+                    std::cout << "  batch mismatch (variant " << variant << ", text " << i << ")" << std::endl;
+                    ok = false;
+                }
+            }
+            llama_model_free(model);
+        }
+        fs::remove(path);
+        return ok;
+    } catch (...) {
+        return false;
+    }
+}
+
+// Test 3: cached allowed-token masks of a grammar must reject exactly what
+// the per-candidate stack walk rejects, on full and partial candidate lists
+bool test_grammar_token_masks() {
+    try {
+        namespace fs = std::filesystem;
+        const std::vector<std::string> texts = {
+            "{\"name\": \"fox\", \"tags\": [\"quick\", \"brown\"], \"age\": 12, \"ok\": true}",
+            "{\"nested\": {\"a\": [1, 2.5, -3e4], \"b\": null, \"c\": \"café 東京\"}}",
+            "The quick brown fox jumps over the lazy dog.",
+        };
+        const char * grammar_str = R"(
+root   ::= object
+value  ::= object | array | string | number | ("true" | "false" | "null") ws
+object ::= "{" ws ( string ":" ws value ("," ws string ":" ws value)* )? "}" ws
+array  ::= "[" ws ( value ("," ws value)* )? "]" ws
+string ::= "\"" ( [^"\\\x7F\x00-\x1F] | "\\" (["\\bfnrt] | "u" [0-9a-fA-F]{4}) )* "\"" ws
+number ::= ("-"? ([0-9] | [1-9] [0-9]{0,15})) ("." [0-9]+)? ([eE] [-+]? [0-9] [1-9]{0,15})? ws
+ws     ::= | " " | "\n" [ \t]{0,20}
+)";
+        std::vector<std::string> vocab_tokens;
+        const std::vector<std::string> merges = train_bpe_vocab(texts, 100, vocab_tokens);
+        const std::vector<int32_t> token_types(vocab_tokens.size(), LLAMA_TOKEN_TYPE_NORMAL);
+        const fs::path path = fs::temp_directory_path() / "rn_grammar_masks_test.gguf";
+        if (!write_bpe_vocab(path.string(), "llama-bpe", vocab_tokens, token_types, merges)) return false;
+
+        llama_model_params mparams = llama_model_default_params();
+        mparams.vocab_only = true;
+        llama_model * model = llama_model_load_from_file(path.string().c_str(), mparams);
+        fs::remove(path);
+        if (model == nullptr) return false;
+        const llama_vocab * vocab = llama_model_get_vocab(model);
+        const int32_t n_vocab = llama_vocab_n_tokens(vocab);
+
+        auto rejected = [](llama_sampler * smpl, std::vector<llama_token_data> cur) {
+            llama_token_data_array arr = { cur.data(), cur.size(), -1, false };
+            llama_sampler_apply(smpl, &arr);
+            std::vector<llama_token> ids;
+            for (const auto & td : cur) {
+                if (std::isinf(td.logit)) ids.push_back(td.id);
+            }
+            return ids;
+        };
+
+        bool ok = true;
+        // Later runs start from masks cached by earlier grammars
+        for (uint32_t seed = 1; seed <= 3 && ok; seed++) {
+            llama_sampler * reference = llama_sampler_init_grammar(vocab, grammar_str, "root");
+            llama_sampler * masked    = llama_sampler_init_grammar(vocab, grammar_str, "root");
+            if (reference == nullptr || masked == nullptr) {
+                llama_sampler_free(reference);
+                llama_sampler_free(masked);
+                llama_model_free(model);
+                return false;
+            }
+            std::mt19937 rng(seed);
+            for (int step = 0; step < 120 && ok; step++) {
+                std::vector<llama_token_data> full(n_vocab);
+                for (int32_t id = 0; id < n_vocab; id++) full[id] = { id, 0.0f, 0.0f };
+                std::vector<llama_token_data> subset;
+                for (int k = 0; k < 8; k++) subset.push_back({ (llama_token) (rng() % n_vocab), 0.0f, 0.0f });
+
+                if (step == 0) setenv("LLAMA_GRAMMAR_NO_MASK_CACHE", "1", 1);
+                const auto expected_full = rejected(reference, full);
+                if (step == 0) unsetenv("LLAMA_GRAMMAR_NO_MASK_CACHE");
+                if (rejected(masked, full) != expected_full ||
+                    rejected(masked, subset) != rejected(reference, subset)) {
+                    std::cout << "  mask mismatch (seed " << seed << ", step " << step << ")" << std::endl;
+                    ok = false;
+                    break;
+                }
+
+                std::vector<llama_token> allowed;
+                for (int32_t id = 0, r = 0; id < n_vocab; id++) {
+                    if (r < (int32_t) expected_full.size() && expected_full[r] == id) {
+                        r++;
+                    } else {
+                        allowed.push_back(id);
+                    }
+                }
+                if (allowed.empty()) break;
+                const llama_token next = allowed[rng() % allowed.size()];
+                llama_sampler_accept(reference, next);
+                llama_sampler_accept(masked, next);
+            }
+            llama_sampler_free(reference);
+            llama_sampler_free(masked);
+        }
+        llama_model_free(model);
+        return ok;
+    } catch (...) {
+        return false;
+    }
+}
+
+// Test 4: jump-forward finds exactly the runs the grammar pins (literals
+// around free text), respects the token cap and never forces EOG
+bool test_jump_forward_tokens() {
+    try {
+        namespace fs = std::filesystem;
+        // Byte-level vocab: each literal character is the only token that fits
+        std::vector<std::string> vocab_tokens;
+        const std::vector<std::string> merges = train_bpe_vocab({}, 0, vocab_tokens);
+        std::vector<int32_t> token_types(vocab_tokens.size(), LLAMA_TOKEN_TYPE_NORMAL);
+        const int32_t eos_id = (int32_t) vocab_tokens.size();
+        vocab_tokens.push_back("</s>");
+        token_types.push_back(LLAMA_TOKEN_TYPE_CONTROL);
+        const fs::path path = fs::temp_directory_path() / "rn_jump_forward_test.gguf";
+        if (!write_bpe_vocab(path.string(), "llama-bpe", vocab_tokens, token_types, merges, eos_id)) return false;
+
+        llama_model_params mparams = llama_model_default_params();
+        mparams.vocab_only = true;
+        llama_model * model = llama_model_load_from_file(path.string().c_str(), mparams);
+        fs::remove(path);
+        if (model == nullptr) return false;
+        const llama_vocab * vocab = llama_model_get_vocab(model);
+
+        common_params_sampling sparams;
+        sparams.grammar = common_grammar(COMMON_GRAMMAR_TYPE_USER,
+            R"(root ::= "{\"name\": \"" [a-z]+ "\", \"ok\": " ("true" | "false") "}")");
+        common_sampler * smpl = common_sampler_init(model, sparams);
+        if (smpl == nullptr) {
+            llama_model_free(model);
+            return false;
+        }
+
+        auto text_of = [&](const std::vector<llama_token> & toks) {
+            std::string out;
+            for (const llama_token tok : toks) out += common_token_to_piece(vocab, tok);
+            return out;
+        };
+        auto accept_text = [&](const std::string & text) {
+            for (const llama_token tok : tokenize_vocab(vocab, text)) common_sampler_accept(smpl, tok, true);
+        };
+
+        bool ok = true;
+        // Capped run, then the rest of the literal up to the free name
+        ok = ok && text_of(sample_forced_tokens(smpl, vocab, 3)) == "{\"n";
+        ok = ok && text_of(sample_forced_tokens(smpl, vocab, 64)) == "ame\": \"";
+        ok = ok && sample_forced_tokens(smpl, vocab, 64).empty();
+        accept_text("fox");
+        ok = ok && sample_forced_tokens(smpl, vocab, 64).empty();
+        accept_text("\"");
+        ok = ok && text_of(sample_forced_tokens(smpl, vocab, 64)) == ", \"ok\": ";
+        // "true" | "false": ambiguous until the first letter
+        ok = ok && sample_forced_tokens(smpl, vocab, 64).empty();
+        accept_text("f");
+        // Forced up to the end; only EOG is left, which is never forced
+        ok = ok && text_of(sample_forced_tokens(smpl, vocab, 64)) == "alse}";
+        ok = ok && common_sampler_forced_token(smpl, vocab) == LLAMA_TOKEN_NULL;
+        if (!ok) std::cout << "  unexpected forced run" << std::endl;
+
+        // Without a grammar nothing is forced
+        common_params_sampling free_params;
+        common_sampler * free_smpl = common_sampler_init(model, free_params);
+        ok = ok && free_smpl != nullptr && sample_forced_tokens(free_smpl, vocab, 64).empty();
+
+        common_sampler_free(free_smpl);
+        common_sampler_free(smpl);
+        llama_model_free(model);
+        return ok;
+    } catch (...) {
+        return false;
+    }
+}
+
+// Test 5: jump-forward on a vocab with merges - the pinned text is forced as
+// its own tokenization (held back by one token where free text follows), and
+// a grammar with several paths forces nothing
+bool test_jump_forward_merged_vocab() {
+    try {
+        namespace fs = std::filesystem;
+        std::vector<std::string> texts;
+        for (const char * name : { "fox", "dog", "cat", "owl" }) {
+            texts.push_back(std::string("{\"name\": \"") + name + "\", \"ok\": true}");
+            texts.push_back(std::string("{\"name\": \"") + name + "\", \"ok\": false}");
+        }
+        std::vector<std::string> vocab_tokens;
+        const std::vector<std::string> merges = train_bpe_vocab(texts, 60, vocab_tokens);
+        std::vector<int32_t> token_types(vocab_tokens.size(), LLAMA_TOKEN_TYPE_NORMAL);
+        const int32_t eos_id = (int32_t) vocab_tokens.size();
+        vocab_tokens.push_back("</s>");
+        token_types.push_back(LLAMA_TOKEN_TYPE_CONTROL);
+        const fs::path path = fs::temp_directory_path() / "rn_jump_forward_merges_test.gguf";
+        if (!write_bpe_vocab(path.string(), "llama-bpe", vocab_tokens, token_types, merges, eos_id)) return false;
+
+        llama_model_params mparams = llama_model_default_params();
+        mparams.vocab_only = true;
+        llama_model * model = llama_model_load_from_file(path.string().c_str(), mparams);
+        fs::remove(path);
+        if (model == nullptr) return false;
+        const llama_vocab * vocab = llama_model_get_vocab(model);
+
+        auto text_of = [&](const std::vector<llama_token> & toks) {
+            std::string out;
+            for (const llama_token tok : toks) out += common_token_to_piece(vocab, tok);
+            return out;
+        };
+        auto starts_with = [](const std::string & s, const std::string & prefix) {
+            return s.compare(0, prefix.size(), prefix) == 0;
+        };
+
+        common_params_sampling sparams;
+        sparams.grammar = common_grammar(COMMON_GRAMMAR_TYPE_USER,
+            R"(root ::= "{\"name\": \"" [a-z]+ "\", \"ok\": " ("true" | "false") "}")");
+        common_sampler * smpl = common_sampler_init(model, sparams);
+        if (smpl == nullptr) {
+            llama_model_free(model);
+            return false;
+        }
+
+        bool ok = true;
+        // The literal has several valid first tokens ("{", "{\"", ...), so a
+        // vocab scan alone forces nothing; the grammar text is forced in its
+        // own tokenization, its last token only if nothing merges onto it
+        const std::string head = "{\"name\": \"";
+        const auto run = sample_forced_tokens(smpl, vocab, 64);
+        ok = ok && run.size() >= 2 && starts_with(head, text_of(run));
+        ok = ok && run == tokenize_vocab(vocab, text_of(run));
+        if (!ok) std::cout << "  head run: '" << text_of(run) << "'" << std::endl;
+
+        // Free text, then the next literal up to the true/false choice
+        const std::string rest = head.substr(text_of(run).size()) + "fox\"";
+        for (const llama_token tok : tokenize_vocab(vocab, rest)) common_sampler_accept(smpl, tok, true);
+        const auto mid = sample_forced_tokens(smpl, vocab, 64);
+        ok = ok && starts_with(", \"ok\": ", text_of(mid)) && !mid.empty();
+        if (!ok) std::cout << "  middle run: '" << text_of(mid) << "'" << std::endl;
+
+        // A run that ends the grammar is forced through its last token
+        const std::string choice = std::string(", \"ok\": ").substr(text_of(mid).size()) + "f";
+        for (const llama_token tok : tokenize_vocab(vocab, choice)) common_sampler_accept(smpl, tok, true);
+        const auto tail = sample_forced_tokens(smpl, vocab, 64);
+        ok = ok && text_of(tail) == "alse}" && tail == tokenize_vocab(vocab, "alse}");
+        if (!ok) std::cout << "  final run: '" << text_of(tail) << "'" << std::endl;
+        common_sampler_free(smpl);
+
+        // Two alternates share a first char but the grammar has two paths
+        common_params_sampling alt_params;
+        alt_params.grammar = common_grammar(COMMON_GRAMMAR_TYPE_USER, R"(root ::= "{\"name\"" | "{\"ok\"")");
+        common_sampler * alt = common_sampler_init(model, alt_params);
+        ok = ok && alt != nullptr && sample_forced_tokens(alt, vocab, 64).empty();
+        common_sampler_free(alt);
+
+        llama_model_free(model);
+        return ok;
+    } catch (...) {
+        return false;
+    }
+}
+
+int main() {
+    std::cout << "=== Tokenizer and Grammar Tests ===" << std::endl;
+
+    TestResults results;
+    results.run_test("BPE Tokenizer Fast Path", test_bpe_tokenizer_fast_path());
+    results.run_test("Parallel Tokenize", test_parallel_tokenize());
+    results.run_test("Grammar Token Masks", test_grammar_token_masks());
+    results.run_test("Jump-Forward Tokens", test_jump_forward_tokens());
+    results.run_test("Jump-Forward Merged Vocab", test_jump_forward_merged_vocab());
+
+    results.print_summary();
+    return results.passed_tests == results.total_tests ? 0 : 1;
+}
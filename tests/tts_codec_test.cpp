@@ -0,0 +1,449 @@
+// TTS codec runtime tests (host-only: no model needed).
+//
+// Decode graph buckets and the graph cache are exercised through a synthetic
+// causal "codec" graph built on the real runtime (codec_graph_cache_get_or_build,
+// codec_graph_compute), decoded the same way the Mimi / Qwen3-TTS tokenizer
+// decoders do it.  Streaming decode (llama_rn_audio_stream_step, which
+// startAudioStream / pumpAudioStream / finishAudioStream drive) is checked
+// against one-shot decode with a CPU decoder of known receptive field.
+// Set RNLLAMA_TEST_CODEC to a Mimi or Qwen3-TTS tokenizer
+// GGUF to also compare bucket-padded and exact-shape decode of a real codec.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "codec.h"
+#include "codec/src/runtime/graph.h"
+#include "codec/src/runtime/tensor_utils.h"
+#include "ggml-cpu.h"
+#include "rn-tts.h"
+
+using rnllama::llama_rn_audio_stream_options;
+using rnllama::llama_rn_audio_stream_step;
+
+// Test result tracking (same shape as simple_test.cpp)
+struct TestResults {
+    int total_tests = 0;
+    int passed_tests = 0;
+
+    void run_test(const std::string& name, bool result) {
+        total_tests++;
+        std::cout << "TEST: " << name << " ... ";
+        if (result) {
+            std::cout << "PASSED" << std::endl;
+            passed_tests++;
+        } else {
+            std::cout << "FAILED" << std::endl;
+        }
+    }
+
+    void print_summary() {
+        std::cout << "\n=== Test Summary ===" << std::endl;
+        std::cout << "Total tests: " << total_tests << std::endl;
+        std::cout << "Passed: " << passed_tests << std::endl;
+        std::cout << "Failed: " << (total_tests - passed_tests) << std::endl;
+    }
+};
+
+// ---------------------------------------------------------------------------
+// Synthetic causal codec: frame t becomes `hop` samples of the running sum of
+// frames [0, t], so trailing pad frames cannot change earlier samples - the
+// property bucketed decode relies on.
+// ---------------------------------------------------------------------------
+
+static constexpr int32_t kSyntheticGraphKind = 1000;
+static constexpr int32_t kSyntheticHop = 8;
+
+struct synthetic_build {
+    int32_t n_frames;
+    int32_t hop;
+};
+
+static bool synthetic_build_decode(lm_ggml_context * ctx_eval, void * user_data, lm_ggml_tensor ** out) {
+    const synthetic_build * p = static_cast<const synthetic_build *>(user_data);
+    lm_ggml_tensor * in = lm_ggml_new_tensor_1d(ctx_eval, LM_GGML_TYPE_F32, p->n_frames);
+    lm_ggml_set_name(in, "synthetic.decode.in");
+    lm_ggml_tensor * shape = lm_ggml_new_tensor_2d(ctx_eval, LM_GGML_TYPE_F32, p->hop, p->n_frames);
+    lm_ggml_tensor * sum = lm_ggml_reshape_2d(ctx_eval, lm_ggml_cumsum(ctx_eval, in), 1, p->n_frames);
+    lm_ggml_tensor * pcm = lm_ggml_reshape_1d(ctx_eval, lm_ggml_repeat(ctx_eval, sum, shape), (int64_t) p->hop * p->n_frames);
+    lm_ggml_set_name(pcm, "synthetic.decode.out");
+    *out = pcm;
+    return true;
+}
+
+struct synthetic_codec {
+    codec_model model {};
+    codec_context ctx {};
+
+    synthetic_codec(int32_t bucket_frames, int32_t cache_max) {
+        model.backend = lm_ggml_backend_cpu_init();
+        model.n_threads = 1;
+        ctx.model = &model;
+        ctx.params = codec_context_default_params();
+        ctx.params.graph_bucket_frames = bucket_frames;
+        ctx.params.graph_cache_max = cache_max;
+        std::string err;
+        if (!codec_runtime_init(&ctx, &err)) {
+            std::cout << "[runtime init: " << err << "] ";
+        }
+    }
+
+    ~synthetic_codec() {
+        codec_runtime_free(&ctx);
+        lm_ggml_backend_free(model.backend);
+    }
+
+    // Mirrors the Mimi decode path: build for the bucketed frame count, pad
+    // the input with zeros and keep the first t frames of PCM
+    bool decode(const std::vector<float> & frames, std::vector<float> * pcm) {
+        const int32_t t = (int32_t) frames.size();
+        const int32_t t_graph = codec_graph_bucket_frames(&ctx, t);
+        codec_graph_eval_guard eval_guard(&ctx, /*persist=*/ctx.params.graph_bucket_frames != 0);
+        synthetic_build build = { t_graph, kSyntheticHop };
+        codec_graph_cache_entry * entry = nullptr;
+        std::string err;
+        if (!codec_graph_cache_get_or_build(
+                &ctx,
+                { kSyntheticGraphKind, /*n_frames=*/t_graph, /*n_q=*/1, /*hop=*/kSyntheticHop, /*n_in=*/0, /*latent_dim=*/0 },
+                synthetic_build_decode, &build, sizeof(build), &entry, &err)) {
+            return false;
+        }
+        lm_ggml_tensor * t_in = codec_graph_get_tensor(&ctx, entry, "synthetic.decode.in");
+        lm_ggml_tensor * t_out = codec_graph_get_tensor(&ctx, entry, "synthetic.decode.out");
+        if (t_in == nullptr || t_out == nullptr || !codec_graph_prepare_io(&ctx, entry, &err)) {
+            return false;
+        }
+        std::vector<float> padded((size_t) t_graph, 0.0f);
+        std::copy(frames.begin(), frames.end(), padded.begin());
+        if (!codec_runtime_write_tensor(t_in, padded.data(), padded.size() * sizeof(float), &err) ||
+            !codec_graph_compute(&ctx, entry, 1, &err)) {
+            return false;
+        }
+        std::vector<float> out((size_t) lm_ggml_nelements(t_out));
+        if (!codec_runtime_read_tensor(t_out, out.data(), out.size() * sizeof(float), &err)) {
+            return false;
+        }
+        out.resize((size_t) t * kSyntheticHop);
+        pcm->swap(out);
+        return true;
+    }
+
+    bool cached(int32_t n_frames) const {
+        return ctx.graph_cache_index.count(
+                   { kSyntheticGraphKind, n_frames, 1, kSyntheticHop, 0, 0 }) != 0;
+    }
+};
+
+static std::vector<float> test_frames(int32_t n, int32_t seed) {
+    std::vector<float> frames((size_t) n);
+    for (int32_t i = 0; i < n; ++i) {
+        frames[(size_t) i] = std::sin(0.37f * (float) (i + 1) + (float) seed);
+    }
+    return frames;
+}
+
+static bool near(const std::vector<float> & a, const std::vector<float> & b, float tol) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (std::fabs(a[i] - b[i]) > tol) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Bucket rounding for multiples and powers of two
+static bool test_bucket_frames() {
+    codec_context ctx {};
+    ctx.params.graph_bucket_frames = 16;
+    if (codec_graph_bucket_frames(&ctx, 1) != 16 || codec_graph_bucket_frames(&ctx, 16) != 16 ||
+        codec_graph_bucket_frames(&ctx, 17) != 32 || codec_graph_bucket_frames(&ctx, 0) != 0) {
+        return false;
+    }
+    ctx.params.graph_bucket_frames = CODEC_GRAPH_BUCKET_POW2;
+    if (codec_graph_bucket_frames(&ctx, 5) != 8 || codec_graph_bucket_frames(&ctx, 64) != 64) {
+        return false;
+    }
+    ctx.params.graph_bucket_frames = 0;
+    if (codec_graph_bucket_frames(&ctx, 13) != 13) {
+        return false;
+    }
+    // Streams switch buckets on a live context
+    codec_set_graph_bucket_frames(&ctx, 16);
+    if (codec_graph_bucket_frames(&ctx, 13) != 16) {
+        return false;
+    }
+    codec_set_graph_bucket_frames(&ctx, 0);
+    return codec_graph_bucket_frames(&ctx, 13) == 13;
+}
+
+// Bucket-padded decode (graph_bucket_frames = 16, as rn-tts streams use it)
+// returns the same samples as exact-shape decode, below, at and across
+// bucket boundaries
+static bool test_bucketed_matches_exact() {
+    synthetic_codec exact(0, 0);
+    synthetic_codec bucketed(16, 0);
+    for (int32_t n : { 1, 3, 13, 16, 17, 30, 33 }) {
+        const std::vector<float> frames = test_frames(n, n);
+        std::vector<float> a, b;
+        if (!exact.decode(frames, &a) || !bucketed.decode(frames, &b)) {
+            std::cout << "[decode failed at " << n << " frames] ";
+            return false;
+        }
+        if (a.size() != (size_t) n * kSyntheticHop || !near(a, b, 1e-5f)) {
+            std::cout << "[mismatch at " << n << " frames] ";
+            return false;
+        }
+    }
+    return true;
+}
+
+// The graph cache keeps the most recently used shapes: back-to-back calls in
+// one bucket hit, and the cap evicts the least recently used entry
+static bool test_graph_cache_lru() {
+    synthetic_codec codec(16, 2);
+    std::vector<float> pcm;
+    auto decode = [&](int32_t n) { return codec.decode(test_frames(n, 0), &pcm); };
+
+    if (!decode(3) || !decode(13)) return false;  // bucket 16: miss, then hit
+    if (codec.ctx.graph_cache_hits != 1 || codec.ctx.graph_cache_misses != 1) return false;
+
+    if (!decode(20)) return false;                // bucket 32: miss
+    if (!decode(5)) return false;                 // bucket 16 again, not consecutive: rebuilt, moved to front
+    if (codec.ctx.graph_cache_hits != 1 || codec.ctx.graph_cache_misses != 3) return false;
+    if (codec.ctx.graph_cache.size() != 2) return false;
+
+    if (!decode(40)) return false;                // bucket 48: evicts 32, the least recently used
+    return codec.ctx.graph_cache_hits == 1 && codec.ctx.graph_cache_misses == 4 &&
+           codec.ctx.graph_cache.size() == 2 &&
+           codec.cached(16) && codec.cached(48) && !codec.cached(32);
+}
+
+// ---------------------------------------------------------------------------
+// Streaming decode.  The causal CPU decoder below sees three frames of history
+// (frames before the window start count as silence), so a window with at
+// least that much left context reproduces one-shot samples exactly.
+// ---------------------------------------------------------------------------
+
+static std::vector<float> causal_decode(const std::vector<float> & frames, size_t begin, size_t end, size_t hop) {
+    std::vector<float> pcm;
+    for (size_t t = begin; t < end; ++t) {
+        float v = frames[t];
+        v += t >= begin + 1 ? 0.5f * frames[t - 1] : 0.0f;
+        v += t >= begin + 2 ? 0.25f * frames[t - 2] : 0.0f;
+        v += t >= begin + 3 ? 0.125f * frames[t - 3] : 0.0f;
+        for (size_t j = 0; j < hop; ++j) {
+            pcm.push_back(v + 0.01f * (float) j * frames[t]);
+        }
+    }
+    return pcm;
+}
+
+struct stream_run {
+    std::vector<std::vector<float>> chunks;
+    std::vector<std::pair<size_t, size_t>> windows;
+    int n_final = 0;
+    size_t frames_done = 0;
+    std::vector<float> tail;
+
+    bool step(const llama_rn_audio_stream_options & opts, size_t n_frames, bool is_final, int32_t hop,
+              const rnllama::llama_rn_audio_window_decode_fn & decode) {
+        const auto recording = [&](size_t begin, size_t end) {
+            windows.emplace_back(begin, end);
+            return decode(begin, end);
+        };
+        const auto on_chunk = [&](const std::vector<float> & pcm, bool final_chunk) {
+            chunks.push_back(pcm);
+            n_final += final_chunk ? 1 : 0;
+        };
+        return llama_rn_audio_stream_step(opts, n_frames, is_final, hop, recording, on_chunk, frames_done, tail);
+    }
+};
+
+// Window, hop and crossfade arithmetic at the first chunk, a middle chunk
+// whose left context is clipped, and the short final chunk.  The decoder
+// tags every sample with its window start so the crossfade is visible.
+static bool test_stream_chunk_arithmetic() {
+    llama_rn_audio_stream_options opts;
+    opts.first_chunk_frames = 4;
+    opts.chunk_frames = 16;
+    opts.context_frames = 16;
+    opts.lookahead_frames = 2;
+    opts.crossfade_samples = 4;
+    const int32_t hop = 8;
+    const auto tagged = [](size_t begin, size_t end) {
+        std::vector<float> pcm((end - begin) * 8);
+        for (size_t i = 0; i < pcm.size(); ++i) pcm[i] = (float) (begin * 1000 + i);
+        return pcm;
+    };
+    stream_run run;
+
+    // First chunk: 4 frames + 2 lookahead, emitted up to the held tail
+    if (!run.step(opts, 5, false, hop, tagged) || !run.windows.empty()) return false;
+    if (!run.step(opts, 6, false, hop, tagged)) return false;
+    if (run.windows.back() != std::make_pair((size_t) 0, (size_t) 6) || run.frames_done != 4) return false;
+    if (run.chunks.back().size() != 4 * 8 - 4 || run.tail != std::vector<float>({ 28, 29, 30, 31 })) return false;
+
+    // Second chunk: context reaches back to frame 0
+    if (!run.step(opts, 21, false, hop, tagged) || run.windows.size() != 1) return false;
+    if (!run.step(opts, 22, false, hop, tagged) || run.frames_done != 20) return false;
+    if (run.windows.back() != std::make_pair((size_t) 0, (size_t) 22) || run.chunks.back().size() != 16 * 8) return false;
+
+    // Middle chunk: context clipped to 16 frames, the tail (samples 156..159
+    // of window 0) fades into the same samples of window 4
+    if (!run.step(opts, 38, false, hop, tagged) || run.frames_done != 36) return false;
+    if (run.windows.back() != std::make_pair((size_t) 4, (size_t) 38)) return false;
+    const std::vector<float> & mid = run.chunks.back();
+    if (mid.size() != 16 * 8) return false;
+    for (size_t i = 0; i < 4; ++i) {
+        const float w = ((float) i + 0.5f) / 4.0f;
+        const float want = (float) (156 + i) * (1.0f - w) + (float) (4000 + 124 + i) * w;
+        if (std::fabs(mid[i] - want) > 1e-3f) return false;
+    }
+    if (mid[4] != 4000.0f + 128.0f || run.tail.front() != 4000.0f + 252.0f) return false;
+
+    // Final short chunk: 5 frames left, no lookahead or tail held back
+    if (!run.step(opts, 41, true, hop, tagged) || run.frames_done != 41 || !run.tail.empty()) return false;
+    if (run.windows.back() != std::make_pair((size_t) 20, (size_t) 41)) return false;
+    if (run.chunks.back().size() != 4 + 5 * 8 || run.n_final != 1) return false;
+
+    size_t total = 0;
+    for (const auto & c : run.chunks) total += c.size();
+    if (total != 41 * 8) return false;
+
+    // Finishing again with nothing new releases an empty final chunk
+    if (!run.step(opts, 41, true, hop, tagged) || run.windows.size() != 4) return false;
+    return run.chunks.back().empty() && run.n_final == 2;
+}
+
+// Frames arriving one at a time, pumped after each and finished at the end,
+// concatenate to the one-shot decode; also with the hop derived from the
+// window (hop_size 0) and with a first chunk of one frame
+static bool test_stream_matches_one_shot() {
+    const size_t hop = 8;
+    const std::vector<float> frames = test_frames(37, 3);
+    const std::vector<float> want = causal_decode(frames, 0, frames.size(), hop);
+    const auto decode = [&](size_t begin, size_t end) { return causal_decode(frames, begin, end, hop); };
+
+    for (int first : { 1, 4 }) {
+        for (int32_t hop_size : { (int32_t) hop, 0 }) {
+            llama_rn_audio_stream_options opts;
+            opts.first_chunk_frames = first;
+            opts.chunk_frames = 6;
+            opts.context_frames = 4;
+            opts.lookahead_frames = 2;
+            opts.crossfade_samples = 5;
+            stream_run run;
+            for (size_t n = 1; n <= frames.size(); ++n) {
+                if (!run.step(opts, n, false, hop_size, decode)) return false;
+            }
+            if (!run.step(opts, frames.size(), true, hop_size, decode)) return false;
+
+            std::vector<float> got;
+            for (const auto & c : run.chunks) got.insert(got.end(), c.begin(), c.end());
+            if (run.n_final != 1 || run.chunks.size() < 3 || !near(got, want, 1e-5f)) {
+                std::cout << "[first=" << first << " hop=" << hop_size << " mismatch] ";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// A failed window decode flushes the held tail as the final chunk and
+// reports the stream as stopped
+static bool test_stream_decode_failure() {
+    llama_rn_audio_stream_options opts;
+    opts.first_chunk_frames = 2;
+    opts.chunk_frames = 2;
+    opts.lookahead_frames = 0;
+    opts.crossfade_samples = 3;
+    bool fail = false;
+    const auto decode = [&](size_t begin, size_t end) {
+        return fail ? std::vector<float>() : std::vector<float>((end - begin) * 4, 1.0f);
+    };
+    stream_run run;
+    if (!run.step(opts, 2, false, 4, decode) || run.tail.size() != 3) return false;
+    fail = true;
+    if (run.step(opts, 4, false, 4, decode)) return false;
+    return run.n_final == 1 && run.chunks.back().size() == 3 && run.tail.empty() && run.frames_done == 2;
+}
+
+// Same comparison on a real causal codec, when one is provided
+static bool test_real_codec_bucketed_decode() {
+    const char * path = std::getenv("RNLLAMA_TEST_CODEC");
+    if (path == nullptr || *path == '\0') {
+        std::cout << "[SKIP: RNLLAMA_TEST_CODEC not set] ";
+        return true;
+    }
+    codec_model_params mparams = codec_model_default_params();
+    mparams.use_gpu = false;
+    codec_model * model = codec_model_load_from_file(path, mparams);
+    if (model == nullptr) {
+        std::cout << "[SKIP: codec not loaded] ";
+        return true;
+    }
+    const codec_arch arch = codec_model_arch(model);
+    if (arch != CODEC_ARCH_MIMI && arch != CODEC_ARCH_QWEN3_TTS_TOKENIZER) {
+        codec_model_free(model);
+        std::cout << "[SKIP: codec has no bucketed decode] ";
+        return true;
+    }
+
+    codec_context_params exact_params = codec_context_default_params();
+    codec_context_params bucket_params = exact_params;
+    bucket_params.graph_bucket_frames = 16;
+    codec_context * exact = codec_init_from_model(model, exact_params);
+    codec_context * bucketed = codec_init_from_model(model, bucket_params);
+
+    bool ok = exact != nullptr && bucketed != nullptr;
+    const int32_t n_q = codec_model_n_q(model);
+    const int32_t codebook = std::max(1, codec_model_codebook_size(model));
+    for (int32_t n : { 5, 16, 21 }) {
+        if (!ok) break;
+        std::vector<int32_t> codes((size_t) n * n_q);
+        for (size_t i = 0; i < codes.size(); ++i) {
+            codes[i] = (int32_t) ((i * 7919) % (size_t) codebook);
+        }
+        codec_token_buffer tokens {};
+        tokens.data = codes.data();
+        tokens.n_tokens = (int32_t) codes.size();
+        tokens.n_frames = n;
+        tokens.n_q = n_q;
+        codec_pcm_buffer a {}, b {};
+        const codec_decode_params dparams = codec_decode_default_params();
+        ok = codec_decode(exact, &tokens, &a, dparams) == CODEC_STATUS_SUCCESS &&
+             codec_decode(bucketed, &tokens, &b, dparams) == CODEC_STATUS_SUCCESS &&
+             near(std::vector<float>(a.data, a.data + a.n_samples),
+                  std::vector<float>(b.data, b.data + b.n_samples), 1e-3f);
+        codec_pcm_buffer_free(&a);
+        codec_pcm_buffer_free(&b);
+    }
+
+    codec_free(exact);
+    codec_free(bucketed);
+    codec_model_free(model);
+    return ok;
+}
+
+int main() {
+    std::cout << "=== TTS codec runtime tests ===" << std::endl;
+
+    TestResults results;
+    results.run_test("graph bucket frame rounding", test_bucket_frames());
+    results.run_test("bucket-padded decode matches exact shape", test_bucketed_matches_exact());
+    results.run_test("graph cache LRU hits and eviction", test_graph_cache_lru());
+    results.run_test("real codec bucket-padded decode", test_real_codec_bucketed_decode());
+    results.run_test("stream window, hop and crossfade arithmetic", test_stream_chunk_arithmetic());
+    results.run_test("streamed chunks match one-shot decode", test_stream_matches_one_shot());
+    results.run_test("stream decode failure flushes the tail", test_stream_decode_failure());
+
+    results.print_summary();
+    return results.passed_tests == results.total_tests ? 0 : 1;
+}